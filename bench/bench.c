@@ -0,0 +1,439 @@
+// lgb-bench: microbenchmarks for the cpu core, memory map and ppu.
+//
+// Every benchmark is run `samples` times (after one warmup sample) and printed as one
+// JSON object per line, so results can be diffed or gated by a script:
+//   {"name":"cpu/ld_r8_r8","unit":"ns/op","samples":31,"iters":4096,
+//    "min":..,"median":..,"p90":..,"p99":..,"max":..,"mean":..}
+
+#include <Emulator/machine.h>
+#include <Emulator/cpu/instruction.h>
+#include <Emulator/cpu/ppu.h>
+#include <util.h>
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_SAMPLES 31
+#define BENCH_MAX_SAMPLES 1001
+
+#define PROGRAM_START 0x0150
+#define ROM_SIZE      0x8000
+#define INSTR_ITERS   4096
+#define MEM_ITERS     (64 * 1024)
+#define DECODE_ITERS  (64 * 1024)
+
+typedef struct {
+  int samples;
+  const char* filter;
+  bool list;
+} BenchOptions;
+
+// One benchmark: `run` does `iters` operations and returns false on failure
+typedef struct Bench {
+  const char* name;
+  const char* unit;
+  u64 iters;
+  bool (*run)(const struct Bench* bench, Machine* machine);
+
+  const u8* opcodes; // opcode family for cpu/ and decode/ benchmarks
+  int opcode_count;
+  bool cb;           // opcodes follow a 0xCB prefix
+  u16 addr;          // first address for mem/ benchmarks
+  u16 size;          // size of the region
+} Bench;
+
+static volatile u64 sink;
+
+//
+// Opcode families
+//
+
+static const u8 NOP_OPS[] = { 0x00 };
+
+static const u8 LD_R8_R8_OPS[] = {
+  0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4F,
+  0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5F,
+  0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6F,
+  0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7F,
+};
+
+static const u8 LD_R8_IMM_OPS[] = { 0x06, 0x0E, 0x16, 0x1E, 0x26, 0x2E, 0x3E };
+
+static const u8 LOGIC_R8_OPS[] = {
+  0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8F,
+  0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9F,
+  0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAF,
+  0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBF,
+};
+
+// LD r16, d16 then LD (r16), A. The immediates point BC/DE/HL into WRAM
+static const u8 LD_R16_PROGRAM[] = {
+  0x01, 0x00, 0xC0, // LD BC, 0xC000
+  0x11, 0x10, 0xC0, // LD DE, 0xC010
+  0x21, 0x20, 0xC0, // LD HL, 0xC020
+  0x31, 0xFE, 0xDF, // LD SP, 0xDFFE
+  0x02, 0x12, 0x22, 0x32,
+};
+
+static const u8 LD_R16_OPS[] = { 0x01, 0x11, 0x21, 0x31, 0x02, 0x12, 0x22, 0x32 };
+
+static const u8 INC_DEC_R16_OPS[] = { 0x03, 0x13, 0x23, 0x33, 0x0B, 0x1B, 0x2B, 0x3B };
+
+// CB opcodes on registers ((HL) forms excluded)
+static u8 CB_OPS[224];
+
+static void init_cb_ops(void) {
+  int n = 0;
+  for (int op = 0; op < 256; op++) {
+    if ((op & 0x07) != 6)
+      CB_OPS[n++] = (u8)op;
+  }
+}
+
+//
+// Helpers
+//
+
+static int compare_double(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+static double percentile(const double* sorted, int count, double p) {
+  int rank = (int)(p / 100.0 * count + 0.5);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+  return sorted[rank - 1];
+}
+
+// Builds a rom image with `program` repeated from PROGRAM_START to the end of bank 1
+static void build_rom(u8* rom, const u8* program, int program_size) {
+  memset(rom, 0, ROM_SIZE);
+  for (int addr = PROGRAM_START; addr + program_size <= ROM_SIZE; addr += program_size)
+    memcpy(&rom[addr], program, (size_t)program_size);
+  rom[0x147] = 0x00; // ROM only
+}
+
+// Builds the instruction stream of a family: every opcode once, with operands
+static int build_family_program(const Bench* bench, u8* program, int capacity) {
+  if (bench->opcodes == LD_R16_OPS) {
+    memcpy(program, LD_R16_PROGRAM, sizeof(LD_R16_PROGRAM));
+    return (int)sizeof(LD_R16_PROGRAM);
+  }
+
+  int n = 0;
+  for (int i = 0; i < bench->opcode_count && n + 2 <= capacity; i++) {
+    u8 op = bench->opcodes[i];
+    if (bench->cb) {
+      program[n++] = 0xCB;
+      program[n++] = op;
+    } else {
+      program[n++] = op;
+      if (bench->opcodes == LD_R8_IMM_OPS)
+        program[n++] = (u8)(0x11 * (i + 1));
+    }
+  }
+  return n;
+}
+
+// Restarts execution at PROGRAM_START
+static void restart(Machine* machine) {
+  machine_skip_bootrom(machine);
+  machine->cpu.registers[PC].v = PROGRAM_START;
+}
+
+// Ticks through one whole instruction (leaves the cpu on the next instruction boundary)
+static bool step_instruction(Machine* machine) {
+  Cpu* cpu = &machine->cpu;
+  int status = 0;
+
+  do {
+    status = machine_clock_tick(machine);
+  } while (!status && !cpu->paused && !cpu->has_instr);
+
+  while (!status && !cpu->paused && cpu->has_instr)
+    status = machine_clock_tick(machine);
+
+  if (status || cpu->paused) {
+    fprintf(stderr, "cpu stopped at PC=0x%04X: %s\n", cpu->registers[PC].v,
+            status ? cpu->error.message : "");
+    return false;
+  }
+  return true;
+}
+
+static Result load_family(const Bench* bench, Machine* machine) {
+  static u8 rom[ROM_SIZE];
+  u8 program[512];
+
+  int size = build_family_program(bench, program, (int)sizeof(program));
+  build_rom(rom, program, size);
+  return mem_load_rom_data(&machine->mem, rom, ROM_SIZE);
+}
+
+//
+// Benchmarks
+//
+
+static bool run_cpu(const Bench* bench, Machine* machine) {
+  restart(machine);
+  for (u64 i = 0; i < bench->iters; i++) {
+    if (!step_instruction(machine))
+      return false;
+  }
+  return true;
+}
+
+static bool run_decode(const Bench* bench, Machine* machine) {
+  (void)machine;
+
+  u64 acc = 0;
+  for (u64 i = 0; i < bench->iters; i++) {
+    u8 op = bench->cb ? 0xCB : bench->opcodes[i % (u64)bench->opcode_count];
+    ResultInstr r = instruction_decode(op);
+    if (result_Instr_is_err(&r))
+      return false;
+    acc += (u64)result_Instr_get_data(&r).mcycle_count;
+  }
+  sink = acc;
+  return true;
+}
+
+static bool run_mem_read(const Bench* bench, Machine* machine) {
+  u64 acc = 0;
+  for (u64 i = 0; i < bench->iters; i++) {
+    u16 addr = (u16)(bench->addr + (i % bench->size));
+    acc += mem_read8(&machine->mem, &machine->cpu, addr);
+  }
+  sink = acc;
+  return true;
+}
+
+static bool run_mem_write(const Bench* bench, Machine* machine) {
+  for (u64 i = 0; i < bench->iters; i++) {
+    u16 addr = (u16)(bench->addr + (i % bench->size));
+    mem_write8(&machine->mem, &machine->cpu, addr, (u8)i);
+  }
+  return true;
+}
+
+// Fills VRAM/OAM with a busy scene: random tiles, both maps, window and 40 sprites
+static void setup_scene(Machine* machine) {
+  Mem* mem = &machine->mem;
+  Ppu* ppu = &machine->cpu.ppu;
+
+  u32 seed = 0x12345678;
+  for (int i = 0; i < VRAM_SIZE; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    mem->vram[i] = (u8)(seed >> 24);
+  }
+  for (int i = 0; i < OAM_SIZE / 4; i++) {
+    mem->oam[i * 4 + 0] = (u8)(16 + (i * 7) % 144);
+    mem->oam[i * 4 + 1] = (u8)(8 + (i * 13) % 160);
+    mem->oam[i * 4 + 2] = (u8)i;
+    mem->oam[i * 4 + 3] = (u8)((i & 7) << 4);
+  }
+
+  ppu->lcdc = 0xF7; // LCD, window (9C00), sprites 8x16, bg
+  ppu->wy   = 72;
+  ppu->wx   = 87;
+  ppu->scx  = 3;
+  ppu->scy  = 5;
+  ppu->bgp  = 0xE4;
+  ppu->obp0 = 0xD2;
+  ppu->obp1 = 0x1B;
+}
+
+static bool run_ppu_render(const Bench* bench, Machine* machine) {
+  Ppu* ppu = &machine->cpu.ppu;
+  for (u64 i = 0; i < bench->iters; i++) {
+    ppu->window_line = 0;
+    for (int ly = 0; ly < LCD_HEIGHT; ly++) {
+      ppu->ly = (u8)ly;
+      ppu_render_line(ppu, &machine->mem);
+    }
+  }
+  sink = ppu->framebuffer[LCD_HEIGHT - 1][LCD_WIDTH - 1];
+  return true;
+}
+
+static bool run_ppu_step(const Bench* bench, Machine* machine) {
+  Cpu* cpu = &machine->cpu;
+  for (u64 i = 0; i < bench->iters; i++) {
+    for (int dot = 0; dot < CYCLES_PER_FRAME; dot++) {
+      if (ppu_step(&cpu->ppu, &machine->mem, &cpu->interrupt_flag))
+        return false;
+    }
+  }
+  return true;
+}
+
+// A whole emulated frame: cpu running logic_r8 ops with the ppu drawing the scene
+static bool run_machine_frame(const Bench* bench, Machine* machine) {
+  for (u64 i = 0; i < bench->iters; i++) {
+    restart(machine);
+    Result r = machine_run_cycles(machine, CYCLES_PER_FRAME);
+    if (result_is_error(&r) || machine->cpu.paused) {
+      fprintf(stderr, "machine stopped: %s\n", r.message);
+      return false;
+    }
+  }
+  return true;
+}
+
+#define CPU_BENCH(NAME, OPS, IS_CB) \
+  { "cpu/" NAME, "ns/instr", INSTR_ITERS, run_cpu, OPS, (int)sizeof(OPS), IS_CB, 0, 0 }
+#define DECODE_BENCH(NAME, OPS, IS_CB) \
+  { "decode/" NAME, "ns/decode", DECODE_ITERS, run_decode, OPS, (int)sizeof(OPS), IS_CB, 0, 0 }
+#define MEM_BENCH(NAME, RUN, ADDR, SIZE) \
+  { NAME, "ns/access", MEM_ITERS, RUN, NULL, 0, false, ADDR, SIZE }
+
+static const Bench BENCHES[] = {
+  CPU_BENCH("nop",         NOP_OPS,         false),
+  CPU_BENCH("ld_r8_r8",    LD_R8_R8_OPS,    false),
+  CPU_BENCH("ld_r8_imm",   LD_R8_IMM_OPS,   false),
+  CPU_BENCH("logic_r8",    LOGIC_R8_OPS,    false),
+  CPU_BENCH("cb",          CB_OPS,          true),
+  CPU_BENCH("ld_r16",      LD_R16_OPS,      false),
+  CPU_BENCH("inc_dec_r16", INC_DEC_R16_OPS, false),
+
+  DECODE_BENCH("ld_r8_r8",    LD_R8_R8_OPS,    false),
+  DECODE_BENCH("ld_r8_imm",   LD_R8_IMM_OPS,   false),
+  DECODE_BENCH("logic_r8",    LOGIC_R8_OPS,    false),
+  DECODE_BENCH("cb",          CB_OPS,          true),
+  DECODE_BENCH("ld_r16",      LD_R16_OPS,      false),
+  DECODE_BENCH("inc_dec_r16", INC_DEC_R16_OPS, false),
+
+  MEM_BENCH("mem/read8/rom0",   run_mem_read,  0x0000, 0x4000),
+  MEM_BENCH("mem/read8/romx",   run_mem_read,  0x4000, 0x4000),
+  MEM_BENCH("mem/read8/vram",   run_mem_read,  0x8000, 0x2000),
+  MEM_BENCH("mem/read8/eram",   run_mem_read,  0xA000, 0x2000),
+  MEM_BENCH("mem/read8/wram",   run_mem_read,  0xC000, 0x2000),
+  MEM_BENCH("mem/read8/echo",   run_mem_read,  0xE000, 0x1E00),
+  MEM_BENCH("mem/read8/oam",    run_mem_read,  0xFE00, 0x00A0),
+  MEM_BENCH("mem/read8/io",     run_mem_read,  0xFF00, 0x0080),
+  MEM_BENCH("mem/read8/hram",   run_mem_read,  0xFF80, 0x007F),
+  MEM_BENCH("mem/write8/vram",  run_mem_write, 0x8000, 0x2000),
+  MEM_BENCH("mem/write8/eram",  run_mem_write, 0xA000, 0x2000),
+  MEM_BENCH("mem/write8/wram",  run_mem_write, 0xC000, 0x2000),
+  MEM_BENCH("mem/write8/echo",  run_mem_write, 0xE000, 0x1E00),
+  MEM_BENCH("mem/write8/oam",   run_mem_write, 0xFE00, 0x00A0),
+  MEM_BENCH("mem/write8/hram",  run_mem_write, 0xFF80, 0x007F),
+
+  { "ppu/render_frame",  "ns/frame", 16, run_ppu_render,    NULL, 0, false, 0, 0 },
+  { "ppu/step_frame",    "ns/frame", 4,  run_ppu_step,      NULL, 0, false, 0, 0 },
+  { "machine/frame",     "ns/frame", 1,  run_machine_frame, LOGIC_R8_OPS, (int)sizeof(LOGIC_R8_OPS), false, 0, 0 },
+};
+
+#define BENCH_COUNT ((int)(sizeof(BENCHES) / sizeof(BENCHES[0])))
+
+// A fresh machine per benchmark, with the rom (and scene) the benchmark runs on
+static Machine* setup_machine(const Bench* bench) {
+  Machine* machine = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!machine) return NULL;
+
+  Result r = machine_init(machine);
+  if (!result_is_error(&r)) {
+    if (bench->opcodes)
+      r = load_family(bench, machine);
+    else
+      r = load_family(&BENCHES[0], machine);
+  }
+  if (result_is_error(&r)) {
+    fprintf(stderr, "%s: setup failed: %s\n", bench->name, r.message);
+    machine_destroy(machine);
+    free(machine);
+    return NULL;
+  }
+
+  restart(machine);
+  setup_scene(machine);
+  return machine;
+}
+
+static bool run_bench(const Bench* bench, int samples, FILE* out) {
+  static double times[BENCH_MAX_SAMPLES];
+
+  Machine* machine = setup_machine(bench);
+  if (!machine) return false;
+
+  bool ok = bench->run(bench, machine); // warmup
+  for (int s = 0; s < samples && ok; s++) {
+    u64 start = time_now_ns();
+    ok = bench->run(bench, machine);
+    times[s] = (double)(time_now_ns() - start) / (double)bench->iters;
+  }
+
+  machine_destroy(machine);
+  free(machine);
+
+  if (!ok) {
+    fprintf(out, "{\"name\":\"%s\",\"error\":\"run failed\"}\n", bench->name);
+    return false;
+  }
+
+  double sum = 0.0;
+  for (int s = 0; s < samples; s++)
+    sum += times[s];
+  qsort(times, (size_t)samples, sizeof(double), compare_double);
+
+  fprintf(out,
+          "{\"name\":\"%s\",\"unit\":\"%s\",\"samples\":%d,\"iters\":%llu,"
+          "\"min\":%.3f,\"median\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f,\"mean\":%.3f}\n",
+          bench->name, bench->unit, samples, (unsigned long long)bench->iters,
+          times[0], percentile(times, samples, 50.0), percentile(times, samples, 90.0),
+          percentile(times, samples, 99.0), times[samples - 1], sum / samples);
+  fflush(out);
+  return true;
+}
+
+static void print_usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--samples N] [--filter SUBSTRING] [--list]\n"
+          "  Prints one JSON object per benchmark on stdout\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options = { .samples = BENCH_DEFAULT_SAMPLES, .filter = NULL, .list = false };
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      options.samples = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      options.filter = argv[++i];
+    } else if (strcmp(argv[i], "--list") == 0) {
+      options.list = true;
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.samples < 1 || options.samples > BENCH_MAX_SAMPLES) {
+    fprintf(stderr, "--samples must be in [1, %d]\n", BENCH_MAX_SAMPLES);
+    return EXIT_FAILURE;
+  }
+
+  init_cb_ops();
+
+  int failed = 0;
+  for (int i = 0; i < BENCH_COUNT; i++) {
+    const Bench* bench = &BENCHES[i];
+    if (options.filter && !strstr(bench->name, options.filter))
+      continue;
+
+    if (options.list) {
+      printf("%s\n", bench->name);
+      continue;
+    }
+
+    if (!run_bench(bench, options.samples, stdout))
+      failed++;
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
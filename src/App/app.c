@@ -4,6 +4,7 @@
 #include <Emulator/mem.h>
 #include "input.h"
 #include <SDL_ttf.h>
+#include "glyph_atlas.h"
 #include <llog.h>
 #include <lresult.h>
 #include <util.h>
@@ -21,32 +22,22 @@ static void   close_diagram_window(App* app);
 static Result create_cpu_window(App* app);
 static void   close_cpu_window(App* app);
 static int emulation_thread_func(void* data);
+static void print_events(App* app);
 
 // Helper function for diagram window
-static void draw_text(SDL_Renderer* r, TTF_Font* font, int x, int y, const char* text, SDL_Color color);
+static void draw_text(SDL_Renderer* r, const GlyphAtlas* atlas, int x, int y, const char* text, SDL_Color color);
 static SDL_Color pin_color(EPinState state);
-static void draw_pin_label(SDL_Renderer* r, TTF_Font* font, int x, int y, Pin* pin);
-static void draw_bus_value(SDL_Renderer* r, TTF_Font* font, int x, int y, Pin* bus_pins, int bit_count);
+static void draw_bus_value(SDL_Renderer* r, const GlyphAtlas* atlas, int x, int y, Pin* bus_pins, int bit_count);
 static void draw_signal_line(SDL_Renderer* r, int x, int y, int width, bool high);
 static void draw_clock_cycle(SDL_Renderer* r, int x, int y, int width);
 
-static void draw_timing_diagram(SDL_Renderer* r, TTF_Font* font, App* app);
-static void draw_cpu_diagram(SDL_Renderer* r, TTF_Font* font, App* app);
-static void draw_cpu_registers(SDL_Renderer* r, TTF_Font* font, Cpu* cpu);
+static void draw_timing_diagram(SDL_Renderer* r, const GlyphAtlas* atlas, App* app);
+static void draw_cpu_diagram(SDL_Renderer* r, const GlyphAtlas* atlas, App* app);
+static void draw_cpu_registers(SDL_Renderer* r, const GlyphAtlas* atlas, Cpu* cpu);
+static void draw_diagram_window(App* app, bool changed);
+static void draw_cpu_window(App* app, bool changed);
 
-void update_timing_history(App* app) {
-  TimingPoint current = {
-    .phase     = app->cpu->clock_phase,
-    .mem_read  = app->cpu->pin_RD.state == PIN_LOW,
-    .mem_write = app->cpu->pin_WR.state == PIN_LOW,
-    .mem_addr  = app->cpu->addr_value
-  };
-
-  app->timing_history[app->timing_history_pos] = current;
-  app->timing_history_pos = (app->timing_history_pos + 1) % MAX_TIMING_HISTORY;
-}
-
-ResultApp app_create() {
+ResultApp app_create(const char* rom_path, const char* debug_path) {
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) != 0) {
     return result_err_App(AppError_SDL_Init, "SDL init failed: %s", SDL_GetError());
   }
@@ -62,7 +53,10 @@ ResultApp app_create() {
   app.resources_valid = true;
 
   app.cpu_mutex = SDL_CreateMutex();
-  app.timing_mutex = SDL_CreateMutex();
+  app.emu_wake = SDL_CreateSemaphore(0);
+  app.stepped_event = SDL_RegisterEvents(1);
+  app.wave_zoom = -3;
+  app.wave_follow = true;
 
   WindowProps props = {
     .title  = "GameBoy",
@@ -90,31 +84,20 @@ ResultApp app_create() {
   }
   app.active_window = EAppWindow_GameBoy;
 
-  app.mem = malloc(sizeof(Mem));
-  if (!app.mem) {
-    return result_err_App(Error_NullPointer, "No mem for Mem struct");
-  }
-  Result res_mem = mem_init(app.mem);
-  if (result_is_error(&res_mem)) {
-    SDL_Quit();
-    TTF_Quit();
-    return result_err_App(res_mem.error_code,
-                          "Could not create mem instance: %s",
-                          error_string(res_mem.error_code));    
-  }
-
-  app.cpu = malloc(sizeof(Cpu));
-  if (!app.cpu) {
-    return result_err_App(Error_NullPointer, "No mem for Cpu struct");
+  app.machine = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!app.machine) {
+    return result_err_App(Error_NullPointer, "No mem for Machine struct");
   }
-  Result res_cpu = cpu_init(app.cpu, app.mem);
-  if (result_is_error(&res_cpu)) {
+  Result res_machine = machine_init(app.machine);
+  if (result_is_error(&res_machine)) {
     SDL_Quit();
     TTF_Quit();
-    return result_err_App(res_cpu.error_code,
-                          "Could not create cpu instance: %s",
-                          error_string(res_cpu.error_code));    
+    return result_err_App(res_machine.error_code,
+                          "Could not create machine instance: %s",
+                          error_string(res_machine.error_code));    
   }
+  app.cpu = &app.machine->cpu;
+  app.mem = &app.machine->mem;
 
   Result res_load = cpu_load_bootrom(app.cpu);
   if (result_is_error(&res_load)) {
@@ -125,6 +108,45 @@ ResultApp app_create() {
                           error_string(res_load.error_code));
   }
 
+  if (rom_path) {
+    Result res_rom = machine_load_rom(app.machine, rom_path);
+    if (result_is_error(&res_rom)) {
+      SDL_Quit();
+      TTF_Quit();
+      return result_err_App(res_rom.error_code,
+                            "Failed to load rom: %s", res_rom.message);
+    }
+  }
+
+  movie_init(&app.movie);
+
+  debugger_init(&app.debugger);
+  if (debug_path) {
+    Result res_debug = debugger_load(&app.debugger, debug_path);
+    if (result_is_error(&res_debug)) {
+      SDL_Quit();
+      TTF_Quit();
+      return result_err_App(res_debug.error_code,
+                            "Failed to load debug script: %s", res_debug.message);
+    }
+  }
+
+  Result res_events = emu_event_channel_init(&app.events, APP_EVENT_CAPACITY);
+  if (result_is_error(&res_events)) {
+    SDL_Quit();
+    TTF_Quit();
+    return result_err_App(res_events.error_code,
+                          "Failed to create event channel: %s", res_events.message);
+  }
+
+  Result res_wave = waveform_init(&app.waveform, WAVEFORM_CAPACITY);
+  if (result_is_error(&res_wave)) {
+    SDL_Quit();
+    TTF_Quit();
+    return result_err_App(res_wave.error_code,
+                          "Failed to create waveform capture: %s", res_wave.message);
+  }
+
   LOG_TRACE("app created successfully");
   return result_ok_App(app);
 }
@@ -136,6 +158,7 @@ void app_destroy(App *app) {
   app->should_quit = true;
   app->resources_valid = false;
   SDL_UnlockMutex(app->cpu_mutex);
+  SDL_SemPost(app->emu_wake);
 
   if (app->thread_inititalized) {
     while (app->thread_running)
@@ -154,18 +177,24 @@ void app_destroy(App *app) {
   close_cpu_window(app);
   window_destroy(&app->gameboy_window);
 
-  if (app->cpu) {
-    free(app->cpu);
+  if (app->machine) {
+    machine_destroy(app->machine);
+    free(app->machine);
+    app->machine = NULL;
     app->cpu = NULL;
-  }
-
-  if (app->mem) {
-    free(app->mem);
     app->mem = NULL;
   }
 
-  SDL_DestroyMutex(app->timing_mutex);
+  emu_event_channel_destroy(&app->events);
+  waveform_destroy(&app->waveform);
+
+  if (app->movie.mode == MOVIE_RECORDING)
+    LOG_WARNING("recording discarded (%u frames), stop it with 'r' to save", app->movie.frame_count);
+  movie_destroy(&app->movie);
+  profiler_destroy(&app->profile);
+
   SDL_DestroyMutex(app->cpu_mutex);
+  SDL_DestroySemaphore(app->emu_wake);
 
   SDL_Quit();
   TTF_Quit();
@@ -178,6 +207,11 @@ Result app_run(App* app) {
     return result_error(Error_NullPointer, "Null App pointer in app_run");
   }
 
+  // The channel and debugger live in the App, which is copied out of app_create
+  app->cpu->events = &app->events;
+  if (!debugger_empty(&app->debugger))
+    app->cpu->debugger = &app->debugger;
+
   if (!app->thread_inititalized) {
     app->emulation_thread = SDL_CreateThread(emulation_thread_func, 
                                              "EmulationThread", 
@@ -185,47 +219,59 @@ Result app_run(App* app) {
     app->thread_inititalized = (app->emulation_thread != NULL);
   }
 
+  // The app starts paused: without a first copy the windows would show a zeroed cpu until
+  // something steps
+  SDL_LockMutex(app->cpu_mutex);
+  app->cpu_view = *app->cpu;
+  app->view_generation = waveform_head(&app->waveform);
+  SDL_UnlockMutex(app->cpu_mutex);
+
   while (app->running) {
     handle_input(app);
+    print_events(app);
 
     if (app->cpu->paused) {
       app->auto_run = false;
       app->paused = true;
-    }
 
-    if (app->auto_run && !app->paused) {
-      SDL_LockMutex(app->timing_mutex);
-      update_timing_history(app);
-      SDL_UnlockMutex(app->timing_mutex);
+      if (app->debugger.hit.kind != DEBUG_HIT_NONE) {
+        char hit[128];
+        debugger_describe_hit(&app->debugger, hit, sizeof(hit));
+        LOG_INFO("stopped: %s, 'enter' resumes", hit);
+        app->debugger.hit.kind = DEBUG_HIT_NONE;
+      }
     }
 
-    SDL_SetRenderDrawColor(app->gameboy_window.renderer, 0, 0, 0, 255);
-    SDL_RenderClear(app->gameboy_window.renderer);
-    window_draw(&app->gameboy_window);
-
-    if (app->diagram_window_open) {
-      SDL_SetRenderDrawColor(app->diagram_window.renderer, 40, 40, 40, 255);
-      SDL_RenderClear(app->diagram_window.renderer);
-
+    // The waveform head counts ticks, so it doubles as the generation of the cpu state.
+    // The windows draw from a copy so the emulation thread only waits for the memcpy,
+    // and the timing view reads the waveform ring, which needs no lock at all
+    u64 generation = waveform_head(&app->waveform);
+    bool changed = generation != app->view_generation;
+    if (changed && (app->diagram_window_open || app->cpu_window_open)) {
       SDL_LockMutex(app->cpu_mutex);
-      SDL_LockMutex(app->timing_mutex);
-      draw_cpu_diagram(app->diagram_window.renderer, app->font, app);
-      SDL_UnlockMutex(app->timing_mutex);
+      app->cpu_view = *app->cpu;
       SDL_UnlockMutex(app->cpu_mutex);
+      app->view_generation = generation;
+    }
 
-      window_draw(&app->diagram_window);
+    if (app->gameboy_window.exposed) {
+      SDL_SetRenderDrawColor(app->gameboy_window.renderer, 0, 0, 0, 255);
+      SDL_RenderClear(app->gameboy_window.renderer);
+      window_draw(&app->gameboy_window);
+      app->gameboy_window.exposed = false;
     }
 
-    if (app->cpu_window_open) {
-      SDL_SetRenderDrawColor(app->cpu_window.renderer, 40, 40, 40, 255);
-      SDL_RenderClear(app->cpu_window.renderer);
+    if (app->diagram_window_open)
+      draw_diagram_window(app, changed);
 
-      draw_cpu_registers(app->cpu_window.renderer, app->font, app->cpu);
+    if (app->cpu_window_open)
+      draw_cpu_window(app, changed);
 
-      window_draw(&app->cpu_window);
-    }
+    app->dirty = 0;
 
-    SDL_Delay(16);
+    // Redraw at ~60Hz while running. Paused, sleep until an input or a finished step
+    bool running = app->auto_run && !app->paused;
+    SDL_WaitEventTimeout(NULL, running ? 16 : 500);
   }
 
   return result_ok();
@@ -333,8 +379,12 @@ static int emulation_thread_func(void* data) {
   app->thread_running = true;
 
 
+  // Single steps from the UI are run here too, so this stays the only waveform producer
   while (!app->should_quit && app->resources_valid) {
-    if (app->auto_run && !app->paused) {
+    bool running = app->auto_run && !app->paused;
+    bool step = !running && atomic_load(&app->step_requests) > 0;
+
+    if (running || step) {
       SDL_LockMutex(app->cpu_mutex);
 
       if (!app->resources_valid) {
@@ -342,15 +392,23 @@ static int emulation_thread_func(void* data) {
         break;
       }
 
-      if (!app->cpu->paused)
-        cpu_clock_tick(app->cpu);
-
-      SDL_LockMutex(app->timing_mutex);
-      update_timing_history(app);
-      SDL_UnlockMutex(app->timing_mutex);
+      if (step || !app->cpu->paused)
+        machine_clock_tick(app->machine);
+      waveform_capture(&app->waveform, app->cpu);
 
       SDL_UnlockMutex(app->cpu_mutex);
 
+      if (step) {
+        atomic_fetch_sub(&app->step_requests, 1);
+        if (app->stepped_event != (u32)-1) {
+          SDL_Event e;
+          memset(&e, 0, sizeof(e));
+          e.type = app->stepped_event;
+          SDL_PushEvent(&e);
+        }
+        continue;
+      }
+
       cycles++;
       u64 now = SDL_GetTicks64();
       if (now - last_time >= 1000) {
@@ -359,7 +417,7 @@ static int emulation_thread_func(void* data) {
         last_time = now;
       }
     } else {
-      SDL_Delay(1);  
+      SDL_SemWaitTimeout(app->emu_wake, 100);
     }
   }
 
@@ -368,43 +426,48 @@ static int emulation_thread_func(void* data) {
 }
 
 
-static void draw_text(SDL_Renderer* r, TTF_Font* font, int x, int y, const char* text, SDL_Color color) {
-  if (!text || !font) {
-    LOG_WARNING("Invalid font/text in draw_text. Doing nothing");
-    return;
+// Formats the emulation thread's trace events, off the emulation thread
+static void print_events(App* app) {
+  EmuEvent events[256];
+  u32 count;
+
+  while ((count = emu_event_drain(&app->events, events, 256)) > 0) {
+    for (u32 i = 0; i < count; i++) {
+      const EmuEvent* e = &events[i];
+
+      if (e->kind == EMU_EVENT_INSTR) {
+        ResultInstr rdec = instruction_decode(e->value);
+        const char* mnemonic = result_Instr_is_err(&rdec) ? "???" : result_Instr_get_data(&rdec).mnemonic;
+        LOG_INFO("INSTRUCTION: (%s) at PC=0x%04X", mnemonic, e->pc);
+      } else {
+        LOG_INFO("%s: addr=0x%04X value=0x%02X at PC=0x%04X cycle=%llu",
+                 emu_event_kind_string(e->kind), e->addr, e->value, e->pc,
+                 (unsigned long long)e->cycle);
+      }
+    }
   }
 
-  SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
-  if (!surface) {
-    LOG_WARNING("Invalid surface in draw_text. Doing nothing");
-    return;
+  u64 dropped = atomic_load(&app->events.dropped);
+  if (dropped != app->events_dropped) {
+    LOG_WARNING("%llu trace events dropped", (unsigned long long)(dropped - app->events_dropped));
+    app->events_dropped = dropped;
   }
+}
 
-  SDL_Texture* texture = SDL_CreateTextureFromSurface(r, surface);
-  SDL_FreeSurface(surface);
-  if (!texture) {
-    LOG_WARNING("Invalid texture in draw_text. Doing nothing");
+static void draw_text(SDL_Renderer* r, const GlyphAtlas* atlas, int x, int y, const char* text, SDL_Color color) {
+  if (!text) {
+    LOG_WARNING("Invalid text in draw_text. Doing nothing");
     return;
   }
 
-  SDL_Rect dst;
-  dst.x = x;
-  dst.y = y;
-  TTF_SizeText(font, text, &dst.w, &dst.h);
-  SDL_RenderCopy(r, texture, NULL, &dst);
-  SDL_DestroyTexture(texture);
+  glyph_atlas_draw(atlas, r, x, y, text, color);
 }
 
 static SDL_Color pin_color(EPinState state) {
   return state == PIN_HIGH ? COLOR_GREEN : COLOR_GRAY;
 }
 
-static void draw_pin_label(SDL_Renderer* r, TTF_Font* font, int x, int y, Pin* pin) {
-  SDL_Color c = pin_color(pin->state);
-  draw_text(r, font, x, y, pin->name, c);
-}
-
-static void draw_bus_value(SDL_Renderer* r, TTF_Font* font, int x, int y, Pin* bus_pins, int bit_count) {
+static void draw_bus_value(SDL_Renderer* r, const GlyphAtlas* atlas, int x, int y, Pin* bus_pins, int bit_count) {
   unsigned val = 0;
   for (int i = 0; i < bit_count; i++) {
     if (bus_pins[i].state == PIN_HIGH)
@@ -418,7 +481,7 @@ static void draw_bus_value(SDL_Renderer* r, TTF_Font* font, int x, int y, Pin* b
     snprintf(buf, sizeof(buf), "0x%02X", val);
   }
 
-  draw_text(r, font, x, y, buf, COLOR_WHITE);
+  draw_text(r, atlas, x, y, buf, COLOR_WHITE);
 }
 
 static void draw_signal_line(SDL_Renderer* r, int x, int y, int width, bool high) {
@@ -436,93 +499,257 @@ static void draw_clock_cycle(SDL_Renderer* r, int x, int y, int width) {
   SDL_RenderDrawLine(r, x + width, y + 20, x + width, y);
 }
 
-static void draw_timing_diagram(SDL_Renderer* r, TTF_Font* font, App* app) {
-  const int START_X = 500;  
-  const int START_Y = 50;
-  const int SIGNAL_HEIGHT = 30;
-  const int PHASE_WIDTH = 20;  
+#define TIMING_WIDTH 1040
 
-  draw_text(r, font, START_X - 80, START_Y, "CLK", COLOR_WHITE);
-  draw_text(r, font, START_X - 80, START_Y + SIGNAL_HEIGHT, "Mem R/W", COLOR_WHITE);
-  draw_text(r, font, START_X - 80, START_Y + SIGNAL_HEIGHT * 2, "Mem Addr", COLOR_WHITE);
+// Phases covered by the timing view at the current zoom
+static u64 waveform_span(const App* app) {
+  if (app->wave_zoom < 0)
+    return TIMING_WIDTH >> -app->wave_zoom;
+  return (u64)TIMING_WIDTH << app->wave_zoom;
+}
 
-  // Draw vertical grid lines for timing reference
-  SDL_SetRenderDrawColor(r, 60, 60, 60, 255);
-  for (int x = 0; x <= MAX_TIMING_HISTORY; x++) {
-    int grid_x = START_X + (x * PHASE_WIDTH);
-    SDL_RenderDrawLine(r, grid_x, START_Y - 10, grid_x, START_Y + SIGNAL_HEIGHT * 3);
-  }
-
-  for (int i = 0; i < MAX_TIMING_HISTORY - 1; i++) {
-    int idx = (app->timing_history_pos + i) % MAX_TIMING_HISTORY;
-    int next_idx = (app->timing_history_pos + i + 1) % MAX_TIMING_HISTORY;
-    TimingPoint state = app->timing_history[idx];
-    TimingPoint next_state = app->timing_history[next_idx];
-    int x = START_X + (i * PHASE_WIDTH);
-
-    int y = START_Y;
-    int level = 0;
-    switch(state.phase) {
-      case CLOCK_LOW:
-      case CLOCK_FALLING:
-        level = 20;  
-        break;
-      case CLOCK_HIGH:
-      case CLOCK_RISING:
-        level = 0;   
-        break;
-    }
+static u64 waveform_view_end(const App* app) {
+  return app->wave_follow ? waveform_head(&app->waveform) : app->wave_end;
+}
+
+void app_scroll_waveform(App* app, int quarters) {
+  u64 head = waveform_head(&app->waveform);
+  u64 oldest = waveform_oldest(&app->waveform);
+  u64 span = waveform_span(app);
+  u64 end = waveform_view_end(app);
+  u64 step = span / 4 ? span / 4 : 1;
+
+  if (quarters < 0) {
+    u64 back = step * (u64)-quarters;
+    u64 min_end = oldest + span < head ? oldest + span : head;
+    end = end > min_end + back ? end - back : min_end;
+    app->wave_follow = false;
+  } else {
+    end += step * (u64)quarters;
+  }
+
+  if (end >= head) {
+    app->wave_follow = true;
+    end = head;
+  }
+  app->wave_end = end;
+  app->dirty |= DIRTY_WAVEFORM;
+}
+
+void app_zoom_waveform(App* app, int delta) {
+  u64 end = waveform_view_end(app);
+  u64 half = waveform_span(app) / 2;
+  u64 mid = end > half ? end - half : 0;
 
-    SDL_RenderDrawLine(r, x, y + level, x + PHASE_WIDTH, y + level);
+  int zoom = app->wave_zoom + delta;
+  if (zoom < APP_WAVE_ZOOM_MIN) zoom = APP_WAVE_ZOOM_MIN;
+  if (zoom > APP_WAVE_ZOOM_MAX) zoom = APP_WAVE_ZOOM_MAX;
+  app->wave_zoom = zoom;
+  app->dirty |= DIRTY_WAVEFORM;
 
-    if (state.phase != next_state.phase) {
-      int next_level = (next_state.phase == CLOCK_LOW || 
-        next_state.phase == CLOCK_FALLING) ? 20 : 0;
-      SDL_RenderDrawLine(r, x + PHASE_WIDTH, y + level, 
-                         x + PHASE_WIDTH, y + next_level);
+  // Keep the middle of the view in place unless following the live edge
+  if (!app->wave_follow) {
+    app->wave_end = mid + waveform_span(app) / 2;
+    app_scroll_waveform(app, 0);
+  }
+}
+
+void app_export_waveform(App* app, const char* path) {
+  u64 end = waveform_view_end(app);
+  u64 oldest = waveform_oldest(&app->waveform);
+
+  Result r = waveform_export_vcd(&app->waveform, path, oldest, end);
+  if (result_is_error(&r))
+    LOG_ERROR("failed to export waveform: %s", r.message);
+  else
+    LOG_INFO("exported %llu phases to %s", (unsigned long long)(end - oldest), path);
+}
+
+// One column of the timing view, which covers one or more samples
+typedef struct {
+  u8 high;      // signals high in any sample
+  u8 low;       // signals low in any sample
+  u32 bus_in[2];  // addr/data value (bit 16 set when not driven) of the first sample
+  u32 bus_out[2]; // and of the last one
+  bool bus_changed[2];
+} TimingColumn;
+
+static void draw_bus_row(SDL_Renderer* r, const GlyphAtlas* atlas, const TimingColumn* cols, int count,
+                         int bus, int x0, int y) {
+  const int LEVEL = 20;
+  const int LABEL_WIDTH = bus == 0 ? 44 : 28;
+
+  int seg_start = 0;
+  for (int x = 0; x <= count; x++) {
+    bool edge = x == count || cols[x].bus_changed[bus] ||
+                (x > 0 && cols[x].bus_in[bus] != cols[x - 1].bus_out[bus]);
+
+    if (x > 0 && edge) {
+      u32 value = cols[seg_start].bus_out[bus];
+      if (x - seg_start >= LABEL_WIDTH && !(value & 0x10000)) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), bus == 0 ? "%04X" : "%02X", value & 0xFFFF);
+        draw_text(r, atlas, x0 + seg_start + 3, y + 1, buf, COLOR_WHITE);
+      }
+      seg_start = x;
     }
+    if (x == count) break;
 
-    y = START_Y + SIGNAL_HEIGHT;
-    if (state.mem_read)
-      draw_text(r, font, x, y - 10, "R", COLOR_GREEN);
-    else if (state.mem_write)
-      draw_text(r, font, x, y - 10, "W", COLOR_GREEN);
-
-    if (i % 4 == 0) {  
-      y = START_Y + SIGNAL_HEIGHT * 2;
-      char addr_buf[32];
-      snprintf(addr_buf, sizeof(addr_buf), "%04X", state.mem_addr);
-      draw_text(r, font, x, y - 10, addr_buf, COLOR_WHITE);
+    SDL_SetRenderDrawColor(r, 200, 200, 80, 255);
+    if (edge) {
+      SDL_RenderDrawLine(r, x0 + x, y, x0 + x, y + LEVEL);
+    } else if (cols[x].bus_out[bus] & 0x10000) {
+      SDL_RenderDrawPoint(r, x0 + x, y + LEVEL / 2);
+    } else {
+      SDL_RenderDrawPoint(r, x0 + x, y);
+      SDL_RenderDrawPoint(r, x0 + x, y + LEVEL);
     }
   }
 }
 
-static void draw_cpu_diagram(SDL_Renderer* r, TTF_Font* font, App* app) {
-  Cpu* cpu = app->cpu;
+static void draw_timing_diagram(SDL_Renderer* r, const GlyphAtlas* atlas, App* app) {
+  const int START_X = 500;
+  const int START_Y = 50;
+  const int SIGNAL_HEIGHT = 40;
+  const int LEVEL = 20;
+
+  static const struct { const char* name; u8 bit; } SIGNALS[] = {
+    { "CLK",  WAVE_CLK },
+    { "/RD",  WAVE_RD  },
+    { "/WR",  WAVE_WR  },
+    { "/MCS", WAVE_MCS },
+  };
+  const int signal_count = (int)(sizeof(SIGNALS) / sizeof(SIGNALS[0]));
+
+  const Waveform* wave = &app->waveform;
+  u64 span = waveform_span(app);
+  u64 end = waveform_view_end(app);
+  u64 first = end > span ? end - span : 0;
+  int zoom = app->wave_zoom;
+
+  // Gather the columns straight from the ring, then drop whatever the producer
+  // overwrote while we were reading
+  static TimingColumn cols[TIMING_WIDTH];
+  int count = 0;
+  u64 column_first[TIMING_WIDTH];
+
+  for (int x = 0; x < TIMING_WIDTH; x++) {
+    u64 lo = zoom < 0 ? first + ((u64)x >> -zoom) : first + ((u64)x << zoom);
+    u64 hi = zoom < 0 ? lo + 1 : lo + ((u64)1 << zoom);
+    if (hi > end) hi = end;
+    if (lo >= hi) break;
+
+    TimingColumn* c = &cols[x];
+    memset(c, 0, sizeof(*c));
+    column_first[x] = lo;
+
+    for (u64 i = lo; i < hi; i++) {
+      WaveSample s = waveform_at(wave, i);
+      u32 bus[2] = {
+        s.addr | ((s.signals & WAVE_ADDR_Z) ? 0x10000u : 0),
+        s.data | ((s.signals & WAVE_DATA_Z) ? 0x10000u : 0),
+      };
+      c->high |= s.signals;
+      c->low  |= (u8)~s.signals;
+      for (int b = 0; b < 2; b++) {
+        if (i == lo) c->bus_in[b] = bus[b];
+        else if (bus[b] != c->bus_out[b]) c->bus_changed[b] = true;
+        c->bus_out[b] = bus[b];
+      }
+    }
+    count = x + 1;
+  }
 
-  if (!cpu) {
-    LOG_WARNING("invalid cpu in draw_cpu_diagram. Doing nothing");
+  u64 oldest = waveform_oldest(wave);
+  int skip = 0;
+  while (skip < count && column_first[skip] < oldest)
+    skip++;
+
+  // Labels
+  for (int i = 0; i < signal_count; i++)
+    draw_text(r, atlas, START_X - 80, START_Y + SIGNAL_HEIGHT * i, SIGNALS[i].name, COLOR_WHITE);
+  draw_text(r, atlas, START_X - 80, START_Y + SIGNAL_HEIGHT * signal_count, "Addr", COLOR_WHITE);
+  draw_text(r, atlas, START_X - 80, START_Y + SIGNAL_HEIGHT * (signal_count + 1), "Data", COLOR_WHITE);
+
+  // Grid: one line per T-cycle, doubled until lines are at least 40 pixels apart
+  u64 grid = 4;
+  while ((zoom < 0 ? grid << -zoom : grid >> zoom) < 40)
+    grid <<= 1;
+  SDL_SetRenderDrawColor(r, 60, 60, 60, 255);
+  for (u64 g = (first + grid - 1) / grid * grid; g < first + span; g += grid) {
+    int x = START_X + (int)(zoom < 0 ? (g - first) << -zoom : (g - first) >> zoom);
+    SDL_RenderDrawLine(r, x, START_Y - 10, x, START_Y + SIGNAL_HEIGHT * (signal_count + 2));
+  }
+
+  // Single bit signals: a vertical line wherever the level changes within or between columns
+  for (int i = 0; i < signal_count; i++) {
+    u8 bit = SIGNALS[i].bit;
+    int y = START_Y + SIGNAL_HEIGHT * i;
+    SDL_SetRenderDrawColor(r, 0, 255, 0, 255);
+
+    for (int x = skip; x < count; x++) {
+      bool high = cols[x].high & bit;
+      bool low = cols[x].low & bit;
+      bool prev_high = x > skip && (cols[x - 1].high & bit) && !(cols[x - 1].low & bit);
+
+      if ((high && low) || (x > skip && high != prev_high))
+        SDL_RenderDrawLine(r, START_X + x, y, START_X + x, y + LEVEL);
+      else
+        SDL_RenderDrawPoint(r, START_X + x, high ? y : y + LEVEL);
+    }
+  }
+
+  int bus_y = START_Y + SIGNAL_HEIGHT * signal_count;
+  draw_bus_row(r, atlas, cols + skip, count - skip, 0, START_X + skip, bus_y);
+  draw_bus_row(r, atlas, cols + skip, count - skip, 1, START_X + skip, bus_y + SIGNAL_HEIGHT);
+
+  // Status
+  char buf[160];
+  if (zoom < 0)
+    snprintf(buf, sizeof(buf), "%s  phases %llu-%llu  %d px/phase",
+             app->wave_follow ? "LIVE" : "HOLD",
+             (unsigned long long)first, (unsigned long long)end, 1 << -zoom);
+  else
+    snprintf(buf, sizeof(buf), "%s  phases %llu-%llu  %d phases/px",
+             app->wave_follow ? "LIVE" : "HOLD",
+             (unsigned long long)first, (unsigned long long)end, 1 << zoom);
+  draw_text(r, atlas, START_X, START_Y + SIGNAL_HEIGHT * (signal_count + 2), buf, COLOR_WHITE);
+  draw_text(r, atlas, START_X, START_Y + SIGNAL_HEIGHT * (signal_count + 2) + 20,
+            "left/right scroll, +/- zoom, 'f' follow, 'e' export " WAVEFORM_VCD_PATH, COLOR_GRAY);
+}
+
+static void add_diagram_label(App* app, const GlyphAtlas* atlas, int x, int y,
+                              const char* text, const Pin* pin) {
+  if (app->diagram_label_count >= APP_DIAGRAM_LABELS) {
+    LOG_WARNING("too many diagram labels, dropping %s", text);
     return;
   }
 
-  SDL_Rect cpu_rect = {50, 50, 300, 750};
-  SDL_SetRenderDrawColor(r, 80, 80, 200, 255);
-  SDL_RenderFillRect(r, &cpu_rect);
+  DiagramLabel* label = &app->diagram_labels[app->diagram_label_count++];
+  glyph_run_build(atlas, &label->run, x, y, text);
+  label->pin = pin;
+}
+
+// Lays out the chip once, later frames only pick the pin colors
+static void build_diagram_labels(App* app, const GlyphAtlas* atlas, const SDL_Rect* cpu_rect) {
+  // Pin names are set once by cpu_init, so they are read from the live cpu. The labels
+  // point at the pins of cpu_view for their colors
+  const Cpu* names = app->cpu;
+  Cpu* cpu = &app->cpu_view;
+  app->diagram_label_count = 0;
+  app->diagram_labels_texture = atlas->texture;
 
   // Label
   const char* label = "LR35902 CPU";
-  int text_w, text_h;
-  TTF_SizeText(font, label, &text_w, &text_h);
-  int label_x = cpu_rect.x + (cpu_rect.w - text_w) / 2;
-  int label_y = cpu_rect.y + 5;
-
-  SDL_Color color_white = {255, 255, 255, 255};
-  draw_text(r, font, label_x, label_y, label, color_white);
+  int text_w = glyph_atlas_text_width(atlas, label);
+  int label_x = cpu_rect->x + (cpu_rect->w - text_w) / 2;
+  int label_y = cpu_rect->y + 5;
+  add_diagram_label(app, atlas, label_x, label_y, label, NULL);
 
   // Pins
   // Left
-  int pin_x = cpu_rect.x + 5; 
-  int pin_y = cpu_rect.y + 40;
+  int pin_x = cpu_rect->x + 5; 
+  int pin_y = cpu_rect->y + 40;
   int spacing = 20; 
 
   pin_y += spacing; // X0
@@ -535,45 +762,45 @@ static void draw_cpu_diagram(SDL_Renderer* r, TTF_Font* font, App* app) {
   pin_y += spacing; 
 
   pin_y += spacing; // MWR
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_MCS);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_MCS.name, &cpu->pin_MCS);
   pin_y += spacing; 
   pin_y += spacing; // MOE
 
   // others...
 
   // Right
-  pin_x = cpu_rect.x + cpu_rect.w - 50; 
-  pin_y = cpu_rect.y + 60;
+  pin_x = cpu_rect->x + cpu_rect->w - 50; 
+  pin_y = cpu_rect->y + 60;
   spacing = 20;
 
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_RST);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_RST.name, &cpu->pin_RST);
   pin_y += spacing;
   pin_y += spacing; // SOUT
   pin_y += spacing; // SIN
   pin_y += spacing; // SCX
   pin_y += spacing; // space
   pin_y += spacing; // space
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_CLK);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_CLK.name, &cpu->pin_CLK);
   pin_y += spacing; 
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_WR);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_WR.name, &cpu->pin_WR);
   pin_y += spacing; 
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_RD);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_RD.name, &cpu->pin_RD);
   pin_y += spacing; 
   pin_y += spacing; // CS
 
   for (int i = 0; i < 16; i++) {
-    draw_pin_label(r, font, pin_x, pin_y, &cpu->addr_bus[i]);
+    add_diagram_label(app, atlas, pin_x, pin_y, names->addr_bus[i].name, &cpu->addr_bus[i]);
     pin_y += spacing;
   }
 
   pin_y += spacing; 
 
   for (int i = 0; i < 8; i++) {
-    draw_pin_label(r, font, pin_x, pin_y, &cpu->data_bus[i]);
+    add_diagram_label(app, atlas, pin_x, pin_y, names->data_bus[i].name, &cpu->data_bus[i]);
     pin_y += spacing;
   }
 
-  draw_pin_label(r, font, pin_x, pin_y, &cpu->pin_VIN);
+  add_diagram_label(app, atlas, pin_x, pin_y, names->pin_VIN.name, &cpu->pin_VIN);
   pin_y += spacing; 
   pin_y += spacing; // LOUT
   pin_y += spacing; // ROUT
@@ -581,20 +808,42 @@ static void draw_cpu_diagram(SDL_Renderer* r, TTF_Font* font, App* app) {
   pin_y += spacing; // T2
 
   // Addr/Data
-  label_x = cpu_rect.x + 10;
-  label_y = cpu_rect.y + cpu_rect.h + 5;
+  label_x = cpu_rect->x + 10;
+  label_y = cpu_rect->y + cpu_rect->h + 5;
+  add_diagram_label(app, atlas, label_x, label_y, "Addr:", NULL);
+  add_diagram_label(app, atlas, label_x, label_y + 20, "Data:", NULL);
+}
 
-  draw_text(r, font, label_x, label_y, "Addr:", COLOR_WHITE);
-  draw_bus_value(r, font, label_x + 50, label_y, cpu->addr_bus, 16);
+static void draw_cpu_diagram(SDL_Renderer* r, const GlyphAtlas* atlas, App* app) {
+  Cpu* cpu = &app->cpu_view;
 
-  label_y += 20;
-  draw_text(r, font, label_x, label_y, "Data:", COLOR_WHITE);
-  draw_bus_value(r, font, label_x + 50, label_y, cpu->data_bus, 8);
+  if (!app->cpu) {
+    LOG_WARNING("invalid cpu in draw_cpu_diagram. Doing nothing");
+    return;
+  }
 
-  draw_timing_diagram(r, font, app);
+  SDL_Rect cpu_rect = {50, 50, 300, 750};
+  SDL_SetRenderDrawColor(r, 80, 80, 200, 255);
+  SDL_RenderFillRect(r, &cpu_rect);
+
+  // The pins in cpu_view never move, only a new atlas changes the layout
+  if (app->diagram_labels_texture != atlas->texture || app->diagram_label_count == 0)
+    build_diagram_labels(app, atlas, &cpu_rect);
+
+  for (int i = 0; i < app->diagram_label_count; i++) {
+    const DiagramLabel* label = &app->diagram_labels[i];
+    SDL_Color c = label->pin ? pin_color(label->pin->state) : COLOR_WHITE;
+    glyph_run_draw(atlas, r, &label->run, c);
+  }
+
+  // Addr/Data
+  int label_x = cpu_rect.x + 10;
+  int label_y = cpu_rect.y + cpu_rect.h + 5;
+  draw_bus_value(r, atlas, label_x + 50, label_y, cpu->addr_bus, 16);
+  draw_bus_value(r, atlas, label_x + 50, label_y + 20, cpu->data_bus, 8);
 }
 
-static void draw_cpu_registers(SDL_Renderer* renderer, TTF_Font* font, Cpu* cpu) {
+static void draw_cpu_registers(SDL_Renderer* renderer, const GlyphAtlas* atlas, Cpu* cpu) {
   if (!cpu) return;
 
   SDL_Color color = { 255, 255, 255, 255 };
@@ -605,7 +854,7 @@ static void draw_cpu_registers(SDL_Renderer* renderer, TTF_Font* font, Cpu* cpu)
   char buf[64];\
   u16 val = cpu->registers[idx].v;\
   snprintf(buf, sizeof(buf), #REGNAME " = 0x%04X", val);\
-  draw_text(renderer, font, x, y, buf, color);\
+  draw_text(renderer, atlas, x, y, buf, color);\
   y += 20;\
 } while (0)
 
@@ -618,3 +867,79 @@ static void draw_cpu_registers(SDL_Renderer* renderer, TTF_Font* font, Cpu* cpu)
 
   #undef DRAW_REG
 }
+
+// The diagram is split in two regions redrawn separately: the chip on the left,
+// the timing view from DIAGRAM_SPLIT_X on
+#define DIAGRAM_SPLIT_X 420
+
+static void clear_region(SDL_Renderer* r, int x, int y, int w, int h) {
+  SDL_Rect rect = { x, y, w, h };
+  SDL_SetRenderDrawColor(r, 40, 40, 40, 255);
+  SDL_RenderFillRect(r, &rect);
+}
+
+// Compares the pins shown by the diagram against cpu_view and remembers the new states
+static bool diagram_pins_changed(App* app) {
+  if (app->diagram_label_count == 0)
+    return true;
+
+  bool changed = false;
+  for (int i = 0; i < app->diagram_label_count; i++) {
+    const Pin* pin = app->diagram_labels[i].pin;
+    if (pin && app->drawn_pins[i] != (u8)pin->state) {
+      app->drawn_pins[i] = (u8)pin->state;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+static void draw_diagram_window(App* app, bool changed) {
+  Window* w = &app->diagram_window;
+  const GlyphAtlas* atlas = window_text(w, app->font);
+
+  u32 regions = app->dirty & (DIRTY_PINS | DIRTY_WAVEFORM);
+  if (changed) {
+    if (diagram_pins_changed(app)) regions |= DIRTY_PINS;
+    if (app->wave_follow) regions |= DIRTY_WAVEFORM;
+  }
+  if (!regions && !w->exposed)
+    return;
+
+  if (window_begin_canvas(w))
+    regions |= DIRTY_PINS | DIRTY_WAVEFORM;
+
+  if (regions & DIRTY_PINS) {
+    clear_region(w->renderer, 0, 0, DIAGRAM_SPLIT_X, w->canvas_h);
+    draw_cpu_diagram(w->renderer, atlas, app);
+    diagram_pins_changed(app);
+  }
+  if (regions & DIRTY_WAVEFORM) {
+    clear_region(w->renderer, DIAGRAM_SPLIT_X, 0, w->canvas_w - DIAGRAM_SPLIT_X, w->canvas_h);
+    draw_timing_diagram(w->renderer, atlas, app);
+  }
+
+  window_end_canvas(w);
+}
+
+static void draw_cpu_window(App* app, bool changed) {
+  Window* w = &app->cpu_window;
+  const GlyphAtlas* atlas = window_text(w, app->font);
+
+  bool registers = (app->dirty & DIRTY_REGISTERS) ||
+                   (changed && memcmp(app->drawn_registers, app->cpu_view.registers,
+                                      sizeof(app->drawn_registers)) != 0);
+  if (!registers && !w->exposed)
+    return;
+
+  if (window_begin_canvas(w))
+    registers = true;
+
+  if (registers) {
+    clear_region(w->renderer, 0, 0, w->canvas_w, w->canvas_h);
+    draw_cpu_registers(w->renderer, atlas, &app->cpu_view);
+    memcpy(app->drawn_registers, app->cpu_view.registers, sizeof(app->drawn_registers));
+  }
+
+  window_end_canvas(w);
+}
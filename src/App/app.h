@@ -2,22 +2,33 @@
 #define APP_H
 
 #include "window.h"
+#include "waveform.h"
 #include <Emulator/cpu/cpu.h>
 #include <Emulator/mem.h>
+#include <Emulator/machine.h>
+#include <Emulator/movie.h>
+#include <Emulator/event.h>
+#include <Emulator/profiler.h>
+#include <Emulator/debugger.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_thread.h>
 #include <stdbool.h>
 #include <lresult.h>
 
-#define MAX_TIMING_HISTORY 32
+#define APP_EVENT_CAPACITY (64 * 1024)
+#define APP_WAVE_ZOOM_MIN (-4) // 16 pixels per phase
+#define APP_WAVE_ZOOM_MAX 11   // 2048 phases per pixel
+#define WAVEFORM_VCD_PATH "waveform.vcd"
+#define APP_DIAGRAM_LABELS 48
 
-typedef struct {
-  EClockPhase phase;
-  bool mem_read;
-  bool mem_write;
-  u16 mem_addr;
-} TimingPoint;
+// Parts of the debug windows that have to be drawn again
+typedef enum {
+  DIRTY_PINS      = 1 << 0, // chip and bus values of the diagram
+  DIRTY_WAVEFORM  = 1 << 1, // timing view of the diagram
+  DIRTY_REGISTERS = 1 << 2, // cpu window
+  DIRTY_ALL       = DIRTY_PINS | DIRTY_WAVEFORM | DIRTY_REGISTERS,
+} EDirtyRegion;
 
 typedef enum {
   EAppWindow_None = 0,
@@ -26,6 +37,12 @@ typedef enum {
   EAppWindow_Cpu,
 } EAppWindow;
 
+// Static text of the diagram window, laid out once. `pin` picks the color, NULL for white
+typedef struct {
+  GlyphRun run;
+  const Pin* pin;
+} DiagramLabel;
+
 typedef struct App {
   bool running;
   bool paused;
@@ -40,29 +57,53 @@ typedef struct App {
 
   SDL_Thread* emulation_thread;
   SDL_mutex* cpu_mutex;
-  SDL_mutex* timing_mutex;
+  SDL_sem* emu_wake;  // posted when the idle emulation thread has something to do
+  u32 stepped_event;  // SDL event the emulation thread pushes after a single step
   bool thread_inititalized;
   volatile bool should_quit; // for thread
   volatile bool thread_running;
   volatile bool resources_valid;
 
   u64 cycles_per_second;
+  _Atomic int step_requests; // single phase steps for the emulation thread to run
+
+  Waveform waveform; // pin levels of every phase, written by the emulation thread
+  u64 wave_end;      // first sample past the timing view when not following
+  int wave_zoom;     // < 0: 1 << -zoom pixels per phase, >= 0: 1 << zoom phases per pixel
+  bool wave_follow;  // timing view tracks the newest samples
 
-  TimingPoint timing_history[MAX_TIMING_HISTORY];
-  int timing_history_pos;
+  DiagramLabel diagram_labels[APP_DIAGRAM_LABELS];
+  int diagram_label_count;
+  const SDL_Texture* diagram_labels_texture; // atlas the labels were laid out with
 
-  Cpu* cpu;
-  Mem* mem;
+  Machine* machine;
+  Cpu* cpu; // &machine->cpu
+  Cpu cpu_view; // copy of *cpu taken when it changed, the windows draw from it
+  u64 view_generation; // waveform head when cpu_view was taken
+  u32 dirty; // EDirtyRegion not caused by the emulation (scrolling, new windows, ...)
+  u8 drawn_pins[APP_DIAGRAM_LABELS]; // pin states the diagram shows
+  Register drawn_registers[PC + 1]; // BC through PC as the cpu window last drew them
+  Mem* mem; // &machine->mem
+  Movie movie; // input recording, attached to the machine while recording
+  EmuEventChannel events; // trace events from the emulation thread, printed by app_run
+  Profiler profile; // guest profiler, attached to the cpu while profiling
+  Debugger debugger; // attached to the cpu when the debug script set anything
+  u64 events_dropped;
 
   TTF_Font* font;
 } App;
 
 DEFINE_RESULT_TYPE(App, App);
 
-ResultApp app_create();
+// rom_path may be NULL to run the bootrom with no cartridge, debug_path to set no
+// breakpoints (see debugger_command for the script syntax)
+ResultApp app_create(const char* rom_path, const char* debug_path);
 void app_destroy(App* app);
 Result app_run(App* app);
 
-void app_update_timing_history(App* app);
+// Timing view controls of the diagram window
+void app_scroll_waveform(App* app, int quarters);
+void app_zoom_waveform(App* app, int delta);
+void app_export_waveform(App* app, const char* path);
 
 #endif // !APP_H
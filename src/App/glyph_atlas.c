@@ -0,0 +1,137 @@
+#include "glyph_atlas.h"
+#include <llog.h>
+#include <util.h>
+#include <string.h>
+
+#define ATLAS_WIDTH 512
+
+static int glyph_index(char c) {
+  if (c < GLYPH_FIRST || c > GLYPH_LAST)
+    return '?' - GLYPH_FIRST;
+  return c - GLYPH_FIRST;
+}
+
+Result glyph_atlas_init(GlyphAtlas* atlas, SDL_Renderer* renderer, TTF_Font* font) {
+  if (!atlas || !renderer || !font) {
+    return result_error(Error_NullPointer, "invalid args to glyph_atlas_init");
+  }
+  memset(atlas, 0, sizeof(*atlas));
+
+  SDL_Color white = {255, 255, 255, 255};
+  SDL_Surface* glyphs[GLYPH_COUNT];
+  memset(glyphs, 0, sizeof(glyphs));
+
+  // Render every glyph and lay them out in rows
+  int x = 0, y = 0, row_h = 0;
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    u16 ch = (u16)(GLYPH_FIRST + i);
+    int minx, maxx, miny, maxy, advance;
+    if (TTF_GlyphMetrics(font, ch, &minx, &maxx, &miny, &maxy, &advance) != 0)
+      advance = 0;
+
+    glyphs[i] = TTF_RenderGlyph_Blended(font, ch, white);
+    if (!glyphs[i]) {
+      atlas->advance[i] = advance;
+      continue;
+    }
+
+    int w = glyphs[i]->w, h = glyphs[i]->h;
+    if (x + w > ATLAS_WIDTH) {
+      x = 0;
+      y += row_h;
+      row_h = 0;
+    }
+    atlas->glyphs[i] = (SDL_Rect){ x, y, w, h };
+    atlas->advance[i] = advance;
+    x += w;
+    if (h > row_h) row_h = h;
+  }
+
+  Result res = result_ok();
+  SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_WIDTH, y + row_h, 32, SDL_PIXELFORMAT_RGBA32);
+  if (!sheet) {
+    res = result_error(AppError_TTF_Init, "failed to create glyph sheet: %s", SDL_GetError());
+    goto done;
+  }
+
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    if (!glyphs[i]) continue;
+    // Copy alpha as is instead of blending it onto the empty sheet
+    SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+    SDL_BlitSurface(glyphs[i], NULL, sheet, &atlas->glyphs[i]);
+  }
+
+  atlas->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+  SDL_FreeSurface(sheet);
+  if (!atlas->texture) {
+    res = result_error(AppError_CreateRenderer, "failed to create glyph texture: %s", SDL_GetError());
+    goto done;
+  }
+  SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+  atlas->height = TTF_FontHeight(font);
+
+  LOG_TRACE("glyph atlas created (%dx%d)", ATLAS_WIDTH, y + row_h);
+
+done:
+  for (int i = 0; i < GLYPH_COUNT; i++)
+    if (glyphs[i]) SDL_FreeSurface(glyphs[i]);
+  return res;
+}
+
+void glyph_atlas_destroy(GlyphAtlas* atlas) {
+  if (!atlas) return;
+
+  if (atlas->texture) {
+    SDL_DestroyTexture(atlas->texture);
+    atlas->texture = NULL;
+  }
+}
+
+int glyph_atlas_text_width(const GlyphAtlas* atlas, const char* text) {
+  int w = 0;
+  for (; *text; text++)
+    w += atlas->advance[glyph_index(*text)];
+  return w;
+}
+
+void glyph_atlas_draw(const GlyphAtlas* atlas, SDL_Renderer* renderer, int x, int y,
+                      const char* text, SDL_Color color) {
+  if (!atlas->texture || !text) return;
+
+  SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+  for (; *text; text++) {
+    int i = glyph_index(*text);
+    const SDL_Rect* src = &atlas->glyphs[i];
+    if (src->w > 0) {
+      SDL_Rect dst = { x, y, src->w, src->h };
+      SDL_RenderCopy(renderer, atlas->texture, src, &dst);
+    }
+    x += atlas->advance[i];
+  }
+}
+
+void glyph_run_build(const GlyphAtlas* atlas, GlyphRun* run, int x, int y, const char* text) {
+  int start = x;
+  run->count = 0;
+
+  for (; *text && run->count < GLYPH_RUN_MAX; text++) {
+    int i = glyph_index(*text);
+    const SDL_Rect* src = &atlas->glyphs[i];
+    if (src->w > 0) {
+      run->src[run->count] = *src;
+      run->dst[run->count] = (SDL_Rect){ x, y, src->w, src->h };
+      run->count++;
+    }
+    x += atlas->advance[i];
+  }
+  run->width = x - start;
+}
+
+void glyph_run_draw(const GlyphAtlas* atlas, SDL_Renderer* renderer, const GlyphRun* run,
+                    SDL_Color color) {
+  if (!atlas->texture) return;
+
+  SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+  for (int i = 0; i < run->count; i++)
+    SDL_RenderCopy(renderer, atlas->texture, &run->src[i], &run->dst[i]);
+}
@@ -0,0 +1,46 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <lresult.h>
+#include <types.h>
+
+// Printable ascii rendered once into a single texture per renderer. Text is then drawn as
+// one SDL_RenderCopy per glyph out of the same texture, which SDL batches, instead of a
+// surface + texture upload per string per frame. The glyphs are white and tinted with
+// the texture color mod.
+
+#define GLYPH_FIRST ' '
+#define GLYPH_LAST  '~'
+#define GLYPH_COUNT (GLYPH_LAST - GLYPH_FIRST + 1)
+#define GLYPH_RUN_MAX 24
+
+typedef struct {
+  SDL_Texture* texture;
+  SDL_Rect glyphs[GLYPH_COUNT]; // source rect in the texture
+  int advance[GLYPH_COUNT];
+  int height;
+} GlyphAtlas;
+
+// A string laid out once, for labels that never move
+typedef struct {
+  int count;
+  int width;
+  SDL_Rect src[GLYPH_RUN_MAX];
+  SDL_Rect dst[GLYPH_RUN_MAX];
+} GlyphRun;
+
+Result glyph_atlas_init(GlyphAtlas* atlas, SDL_Renderer* renderer, TTF_Font* font);
+void glyph_atlas_destroy(GlyphAtlas* atlas);
+
+int glyph_atlas_text_width(const GlyphAtlas* atlas, const char* text);
+void glyph_atlas_draw(const GlyphAtlas* atlas, SDL_Renderer* renderer, int x, int y,
+                      const char* text, SDL_Color color);
+
+// Characters past GLYPH_RUN_MAX are dropped
+void glyph_run_build(const GlyphAtlas* atlas, GlyphRun* run, int x, int y, const char* text);
+void glyph_run_draw(const GlyphAtlas* atlas, SDL_Renderer* renderer, const GlyphRun* run,
+                    SDL_Color color);
+
+#endif // !GLYPH_ATLAS_H
@@ -1,10 +1,99 @@
 #include "input.h"
 #include "app.h"
 #include <Emulator/cpu/cpu.h>
+#include <Emulator/cpu/joypad.h>
+#include <Emulator/movie.h>
+#include <Emulator/profiler.h>
 #include <llog.h>
 
 #include <Emulator/cpu/cpu.h>
 
+#define RECORDING_PATH "recording.lgbm"
+#define PROFILE_PATH   "profile.folded"
+#define PROFILE_TOP    20
+
+// GameBoy button bound to a key, 0 if none
+static u8 joypad_button(SDL_Keycode key) {
+  switch (key) {
+    case SDLK_RIGHT:     return JOYPAD_RIGHT;
+    case SDLK_LEFT:      return JOYPAD_LEFT;
+    case SDLK_UP:        return JOYPAD_UP;
+    case SDLK_DOWN:      return JOYPAD_DOWN;
+    case SDLK_z:         return JOYPAD_A;
+    case SDLK_x:         return JOYPAD_B;
+    case SDLK_BACKSPACE: return JOYPAD_SELECT;
+    case SDLK_s:         return JOYPAD_START;
+    default:             return 0;
+  }
+}
+
+// Buttons only reach the joypad at the next frame start (see machine_begin_frame)
+static void set_joypad_button(struct App* app, u8 button, bool pressed) {
+  SDL_LockMutex(app->cpu_mutex);
+  if (pressed)
+    app->machine->input |= button;
+  else
+    app->machine->input &= (u8)~button;
+  SDL_UnlockMutex(app->cpu_mutex);
+}
+
+static void toggle_recording(struct App* app) {
+  SDL_LockMutex(app->cpu_mutex);
+
+  Movie* movie = &app->movie;
+  if (movie->mode != MOVIE_RECORDING) {
+    // Batch runs play movies from the end of the bootrom, so recording restarts there
+    Result r = machine_reset(app->machine);
+    if (result_is_error(&r)) {
+      LOG_ERROR("failed to reset the machine for recording: %s", r.message);
+      SDL_UnlockMutex(app->cpu_mutex);
+      return;
+    }
+    movie_destroy(movie);
+    movie->mode = MOVIE_RECORDING;
+    app->machine->movie = movie;
+    LOG_INFO("machine reset, recording input from frame 0");
+  } else {
+    movie->mode = MOVIE_IDLE;
+    app->machine->movie = NULL;
+
+    Result r = movie_save(movie, RECORDING_PATH);
+    if (result_is_error(&r))
+      LOG_ERROR("failed to save recording: %s", r.message);
+    else
+      LOG_INFO("saved %u frames to %s", movie->frame_count, RECORDING_PATH);
+  }
+
+  SDL_UnlockMutex(app->cpu_mutex);
+}
+
+static void toggle_profiling(struct App* app) {
+  SDL_LockMutex(app->cpu_mutex);
+
+  Cpu* cpu = app->cpu;
+  if (!cpu->profiler) {
+    Result r = profiler_init(&app->profile, app->mem);
+    if (result_is_error(&r)) {
+      LOG_ERROR("failed to start profiling: %s", r.message);
+    } else {
+      cpu->profiler = &app->profile;
+      LOG_INFO("profiling guest code");
+    }
+  } else {
+    cpu->profiler = NULL;
+
+    profiler_report(&app->profile, stdout, PROFILE_TOP);
+    Result r = profiler_export_folded(&app->profile, PROFILE_PATH);
+    if (result_is_error(&r))
+      LOG_ERROR("failed to save profile: %s", r.message);
+    else
+      LOG_INFO("saved folded stacks to %s", PROFILE_PATH);
+    profiler_destroy(&app->profile);
+  }
+
+  SDL_UnlockMutex(app->cpu_mutex);
+}
+
 static EInputCode handle_keydown(struct App *app, SDL_Keycode key) {
   if (key == SDLK_ESCAPE)
     return ICODE_QUIT_ACTIVE;
@@ -19,6 +108,12 @@ static EInputCode handle_keydown(struct App *app, SDL_Keycode key) {
                  "  'h'     -> Show help\n"
                  "  'space' -> Step one tcycle\n"
                  "  'enter' -> Enable/disable auto-play\n"
+                 "  'r'     -> Start/stop recording input to " RECORDING_PATH "\n"
+                 "  'p'     -> Start/stop profiling guest code, saves " PROFILE_PATH "\n"
+                 "  arrows  -> D-pad\n"
+                 "  'z' 'x' -> A, B\n"
+                 "  'bksp'  -> Select\n"
+                 "  's'     -> Start\n"
                  "  'Esc'   -> Quit active window\n");
         return ICODE_SHOW_HELP;
       } else if (key == SDLK_SPACE) {
@@ -39,6 +134,12 @@ static EInputCode handle_keydown(struct App *app, SDL_Keycode key) {
           app->auto_run = false;
         }
         return ICODE_AUTO;
+      } else if (key == SDLK_r) {
+        return ICODE_RECORD;
+      } else if (key == SDLK_p) {
+        return ICODE_PROFILE;
+      } else if (joypad_button(key)) {
+        set_joypad_button(app, joypad_button(key), true);
       } else {
         static bool pressed_v = false;
         if (key == SDLK_v) {
@@ -55,6 +156,31 @@ static EInputCode handle_keydown(struct App *app, SDL_Keycode key) {
       }
     } break;
 
+    case EAppWindow_Diagram: {
+      if (key == SDLK_h) {
+        LOG_INFO("[Help]\n"
+                 "  left/right -> Scroll the timing view\n"
+                 "  '+' '-'    -> Zoom in/out\n"
+                 "  'f'        -> Follow the newest phases\n"
+                 "  'e'        -> Export the captured waveform to " WAVEFORM_VCD_PATH "\n"
+                 "  'Esc'      -> Close the diagram\n");
+        return ICODE_SHOW_HELP;
+      } else if (key == SDLK_LEFT) {
+        app_scroll_waveform(app, -1);
+      } else if (key == SDLK_RIGHT) {
+        app_scroll_waveform(app, 1);
+      } else if (key == SDLK_EQUALS || key == SDLK_PLUS) {
+        app_zoom_waveform(app, -1);
+      } else if (key == SDLK_MINUS) {
+        app_zoom_waveform(app, 1);
+      } else if (key == SDLK_f) {
+        app->wave_follow = true;
+        app->dirty |= DIRTY_WAVEFORM;
+      } else if (key == SDLK_e) {
+        return ICODE_EXPORT_WAVEFORM;
+      }
+    } break;
+
     default:
       break;
   }
@@ -81,18 +207,42 @@ void handle_input(struct App* app) {
         app->active_window = EAppWindow_Cpu;
     }
 
-    if (e.type == SDL_KEYDOWN) {
+    if (e.type == SDL_WINDOWEVENT &&
+        (e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
+      u32 window_id = e.window.windowID;
+      if (window_id == SDL_GetWindowID(app->gameboy_window.window))
+        app->gameboy_window.exposed = true;
+      else if (app->diagram_window_open && window_id == SDL_GetWindowID(app->diagram_window.window))
+        app->diagram_window.exposed = true;
+      else if (app->cpu_window_open && window_id == SDL_GetWindowID(app->cpu_window.window))
+        app->cpu_window.exposed = true;
+    }
+
+    // Render target contents are gone, redraw everything
+    if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+      window_invalidate(&app->gameboy_window);
+      if (app->diagram_window_open) window_invalidate(&app->diagram_window);
+      if (app->cpu_window_open) window_invalidate(&app->cpu_window);
+    }
+
+    if (e.type == SDL_KEYUP && app->active_window == EAppWindow_GameBoy) {
+      u8 button = joypad_button(e.key.keysym.sym);
+      if (button)
+        set_joypad_button(app, button, false);
+    }
+
+    if (e.type == SDL_KEYDOWN && !e.key.repeat) {
       EInputCode code = handle_keydown(app, e.key.keysym.sym);
       switch (code) {
         case ICODE_QUIT_ACTIVE: {
           if (app->active_window == EAppWindow_GameBoy) {
             app->running = false;
           } else if (app->active_window == EAppWindow_Diagram) {
-            SDL_DestroyWindow(app->diagram_window.window);
+            window_destroy(&app->diagram_window);
             app->diagram_window_open = false;
             app->active_window = EAppWindow_GameBoy;
           } else if (app->active_window == EAppWindow_Cpu) {
-            SDL_DestroyWindow(app->cpu_window.window);
+            window_destroy(&app->cpu_window);
             app->cpu_window_open = false;
             app->active_window = EAppWindow_GameBoy;
           }
@@ -146,9 +296,24 @@ void handle_input(struct App* app) {
         } break;
 
         case ICODE_STEP: {
-          SDL_LockMutex(app->cpu_mutex);
-          cpu_clock_tick(app->cpu);
-          SDL_UnlockMutex(app->cpu_mutex);
+          atomic_fetch_add(&app->step_requests, 1);
+          SDL_SemPost(app->emu_wake);
+        } break;
+
+        case ICODE_AUTO: {
+          SDL_SemPost(app->emu_wake);
+        } break;
+
+        case ICODE_EXPORT_WAVEFORM: {
+          app_export_waveform(app, WAVEFORM_VCD_PATH);
+        } break;
+
+        case ICODE_RECORD: {
+          toggle_recording(app);
+        } break;
+
+        case ICODE_PROFILE: {
+          toggle_profiling(app);
         } break;
 
         default:
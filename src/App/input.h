@@ -14,6 +14,9 @@ typedef enum {
   ICODE_QUIT_ACTIVE,
   ICODE_STEP,
   ICODE_AUTO,
+  ICODE_RECORD,
+  ICODE_PROFILE,
+  ICODE_EXPORT_WAVEFORM,
   ICODE_UNKNOWN
 } EInputCode;
 
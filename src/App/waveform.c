@@ -0,0 +1,116 @@
+#include "waveform.h"
+#include <util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One clock phase of the 4.194304MHz DMG clock is ~59.6ns
+#define VCD_TIMESCALE      "100ps"
+#define VCD_UNITS_PER_PHASE 596
+
+Result waveform_init(Waveform* wave, u32 capacity) {
+  if (!wave || capacity == 0) {
+    return result_error(Error_NullPointer, "invalid args to waveform_init");
+  }
+
+  u32 size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  memset(wave, 0, sizeof(*wave));
+  wave->samples = calloc(size, sizeof(WaveSample));
+  if (!wave->samples) {
+    return result_error(Error_NullPointer, "no mem for %u waveform samples", size);
+  }
+
+  wave->capacity = size;
+  atomic_init(&wave->head, 0);
+  return result_ok();
+}
+
+void waveform_destroy(Waveform* wave) {
+  if (!wave) return;
+
+  free(wave->samples);
+  wave->samples = NULL;
+  wave->capacity = 0;
+}
+
+static void vcd_bit(FILE* f, bool high, char id) {
+  fprintf(f, "%c%c\n", high ? '1' : '0', id);
+}
+
+static void vcd_bus(FILE* f, unsigned value, int bits, bool highz, char id) {
+  fputc('b', f);
+  for (int i = bits - 1; i >= 0; i--)
+    fputc(highz ? 'z' : ((value >> i) & 1 ? '1' : '0'), f);
+  fprintf(f, " %c\n", id);
+}
+
+Result waveform_export_vcd(const Waveform* wave, const char* path, u64 first, u64 last) {
+  if (!wave || !path) {
+    return result_error(Error_NullPointer, "invalid args to waveform_export_vcd");
+  }
+
+  u64 oldest = waveform_oldest(wave);
+  if (first < oldest) first = oldest;
+  if (last > waveform_head(wave)) last = waveform_head(wave);
+  if (first >= last) {
+    return result_error(Error_FileIO, "no waveform samples to export");
+  }
+
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    return result_error(Error_FileIO, "failed to open %s", path);
+  }
+
+  fprintf(f,
+          "$version lgb waveform $end\n"
+          "$timescale " VCD_TIMESCALE " $end\n"
+          "$scope module lr35902 $end\n"
+          "$var wire 1 ! CLK $end\n"
+          "$var wire 1 \" RD_n $end\n"
+          "$var wire 1 # WR_n $end\n"
+          "$var wire 1 $ MCS_n $end\n"
+          "$var wire 16 %% A $end\n"
+          "$var wire 8 & D $end\n"
+          "$upscope $end\n"
+          "$enddefinitions $end\n");
+
+  WaveSample prev = {0};
+  for (u64 i = first; i < last; i++) {
+    WaveSample s = waveform_at(wave, i);
+    u8 changed = (u8)(s.signals ^ prev.signals);
+    bool addr_changed = i == first || s.addr != prev.addr || (changed & WAVE_ADDR_Z);
+    bool data_changed = i == first || s.data != prev.data || (changed & WAVE_DATA_Z);
+
+    if (i != first && !changed && !addr_changed && !data_changed)
+      continue;
+
+    fprintf(f, "#%llu\n", (unsigned long long)((i - first) * VCD_UNITS_PER_PHASE));
+    if (i == first) fputs("$dumpvars\n", f);
+
+    if (i == first || (changed & WAVE_CLK)) vcd_bit(f, s.signals & WAVE_CLK, '!');
+    if (i == first || (changed & WAVE_RD))  vcd_bit(f, s.signals & WAVE_RD,  '"');
+    if (i == first || (changed & WAVE_WR))  vcd_bit(f, s.signals & WAVE_WR,  '#');
+    if (i == first || (changed & WAVE_MCS)) vcd_bit(f, s.signals & WAVE_MCS, '$');
+    if (addr_changed) vcd_bus(f, s.addr, 16, s.signals & WAVE_ADDR_Z, '%');
+    if (data_changed) vcd_bus(f, s.data, 8,  s.signals & WAVE_DATA_Z, '&');
+
+    if (i == first) fputs("$end\n", f);
+    prev = s;
+  }
+  fprintf(f, "#%llu\n", (unsigned long long)((last - first) * VCD_UNITS_PER_PHASE));
+
+  bool failed = ferror(f);
+  fclose(f);
+  if (failed) {
+    return result_error(Error_FileIO, "failed to write %s", path);
+  }
+
+  // The producer kept running and lapped the start of what we wrote
+  if (waveform_oldest(wave) > first) {
+    return result_error(Error_FileIO, "waveform overwritten during export, pause before exporting");
+  }
+  return result_ok();
+}
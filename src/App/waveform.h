@@ -0,0 +1,77 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <Emulator/cpu/cpu.h>
+#include <types.h>
+#include <lresult.h>
+#include <stdatomic.h>
+
+// Pin level capture for the diagram window: one 4 byte sample per clock phase, written
+// by the emulation thread into a power-of-two ring and read by the UI without locks.
+// Single producer, single reader. The producer never waits: it overwrites the oldest
+// samples, and the reader checks `head` again after reading to find out how much of
+// what it read is still valid (see waveform_oldest).
+
+#define WAVEFORM_CAPACITY (1u << 22) // ~4M phases, ~1M T-cycles, 16MB
+
+typedef enum {
+  WAVE_CLK    = 1 << 0,
+  WAVE_RD     = 1 << 1, // pin levels, /RD /WR /MCS are active low
+  WAVE_WR     = 1 << 2,
+  WAVE_MCS    = 1 << 3,
+  WAVE_ADDR_Z = 1 << 4, // address bus not driven
+  WAVE_DATA_Z = 1 << 5, // data bus not driven
+} EWaveSignal;
+
+typedef struct {
+  u16 addr;
+  u8 data;
+  u8 signals; // EWaveSignal
+} WaveSample;
+
+typedef struct {
+  WaveSample* samples;
+  u32 capacity; // power of two
+  _Atomic u64 head; // samples written since the capture started
+} Waveform;
+
+Result waveform_init(Waveform* wave, u32 capacity);
+void waveform_destroy(Waveform* wave);
+
+// Writes samples [first, last) as a VCD file for GTKWave, one time unit per phase
+Result waveform_export_vcd(const Waveform* wave, const char* path, u64 first, u64 last);
+
+static inline u64 waveform_head(const Waveform* wave) {
+  return atomic_load_explicit(&wave->head, memory_order_acquire);
+}
+
+// First index still held by the ring. Samples read before this call are only valid
+// if their index is >= the value returned after the read
+static inline u64 waveform_oldest(const Waveform* wave) {
+  u64 head = waveform_head(wave);
+  return head > wave->capacity ? head - wave->capacity : 0;
+}
+
+static inline WaveSample waveform_at(const Waveform* wave, u64 index) {
+  return wave->samples[index & (wave->capacity - 1)];
+}
+
+static inline void waveform_capture(Waveform* wave, const Cpu* cpu) {
+  u8 signals = 0;
+  if (cpu->pin_CLK.state == PIN_HIGH)   signals |= WAVE_CLK;
+  if (cpu->pin_RD.state  != PIN_LOW)    signals |= WAVE_RD;
+  if (cpu->pin_WR.state  != PIN_LOW)    signals |= WAVE_WR;
+  if (cpu->pin_MCS.state != PIN_LOW)    signals |= WAVE_MCS;
+  if (cpu->addr_bus[0].state == PIN_HIGHZ) signals |= WAVE_ADDR_Z;
+  if (cpu->data_bus[0].state == PIN_HIGHZ) signals |= WAVE_DATA_Z;
+
+  u64 head = atomic_load_explicit(&wave->head, memory_order_relaxed);
+  wave->samples[head & (wave->capacity - 1)] = (WaveSample){
+    .addr    = cpu->addr_value,
+    .data    = cpu->data_value,
+    .signals = signals,
+  };
+  atomic_store_explicit(&wave->head, head + 1, memory_order_release);
+}
+
+#endif // !WAVEFORM_H
@@ -2,6 +2,7 @@
 #include <SDL_video.h>
 #include <llog.h>
 #include <util.h>
+#include <string.h>
 
 ResultWindow window_create(const WindowProps *props) {
   if (!props) {
@@ -37,8 +38,10 @@ ResultWindow window_create(const WindowProps *props) {
   }
 
   Window window;
+  memset(&window, 0, sizeof(window));
   window.window = sdl_window;
   window.renderer = sdl_renderer;
+  window.exposed = true;
 
   LOG_TRACE("Window created successfully");
   return result_ok_Window(window);
@@ -47,6 +50,8 @@ ResultWindow window_create(const WindowProps *props) {
 void window_destroy(Window* window) {
   if (!window) return;
 
+  glyph_atlas_destroy(&window->text);
+  window_invalidate(window);
   if (window->renderer) {
     SDL_DestroyRenderer(window->renderer);
     window->renderer = NULL;
@@ -60,6 +65,51 @@ void window_destroy(Window* window) {
   LOG_TRACE("Window destroyed successfully");
 }
 
+const GlyphAtlas* window_text(Window* window, TTF_Font* font) {
+  if (!window->text.texture && window->renderer) {
+    Result r = glyph_atlas_init(&window->text, window->renderer, font);
+    if (result_is_error(&r))
+      LOG_WARNING("no text in window: %s", r.message);
+  }
+  return &window->text;
+}
+
+bool window_begin_canvas(Window* window) {
+  int w = 0, h = 0;
+  SDL_GetRendererOutputSize(window->renderer, &w, &h);
+
+  bool fresh = false;
+  if (!window->canvas || w != window->canvas_w || h != window->canvas_h) {
+    window_invalidate(window);
+    window->canvas = SDL_CreateTexture(window->renderer, SDL_PIXELFORMAT_RGBA8888,
+                                       SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!window->canvas)
+      LOG_WARNING("no canvas for window, drawing straight to it: %s", SDL_GetError());
+    window->canvas_w = w;
+    window->canvas_h = h;
+    fresh = true;
+  }
+
+  SDL_SetRenderTarget(window->renderer, window->canvas);
+  return fresh;
+}
+
+void window_end_canvas(Window* window) {
+  SDL_SetRenderTarget(window->renderer, NULL);
+  if (window->canvas)
+    SDL_RenderCopy(window->renderer, window->canvas, NULL, NULL);
+  SDL_RenderPresent(window->renderer);
+  window->exposed = false;
+}
+
+void window_invalidate(Window* window) {
+  if (window->canvas) {
+    SDL_DestroyTexture(window->canvas);
+    window->canvas = NULL;
+  }
+  window->exposed = true;
+}
+
 void window_draw(Window *window) {
   if (window && window->renderer) {
     SDL_RenderPresent(window->renderer);
@@ -1,9 +1,11 @@
 #ifndef WINDOW_H
 #define WINDOW_H
 
+#include "glyph_atlas.h"
 #include <SDL2/SDL.h>
 #include <lresult.h>
 #include <types.h>
+#include <stdbool.h>
 
 typedef struct {
   const char* title;
@@ -17,6 +19,11 @@ typedef struct {
 typedef struct {
   SDL_Window* window;
   SDL_Renderer* renderer;
+  GlyphAtlas text; // built on first use, see window_text
+  SDL_Texture* canvas; // keeps what was drawn between frames, see window_begin_canvas
+  int canvas_w;
+  int canvas_h;
+  bool exposed; // the system needs the canvas shown again
 } Window;
 
 DEFINE_RESULT_TYPE(Window, Window);
@@ -27,6 +34,19 @@ ResultWindow window_create(const WindowProps* props);
 // Clears window resources
 void window_destroy(Window* window);
 
+// Glyph atlas of `font` for this window's renderer, built the first time it's needed
+const GlyphAtlas* window_text(Window* window, TTF_Font* font);
+
+// Points the renderer at the window's persistent canvas, so only the parts that changed
+// need drawing. Returns true when the canvas is new (or was lost) and must be redrawn whole
+bool window_begin_canvas(Window* window);
+
+// Shows the canvas in the window
+void window_end_canvas(Window* window);
+
+// Drops the canvas, e.g. after the renderer lost its render targets
+void window_invalidate(Window* window);
+
 // Draws the current state of the window (might make something more elaborate later)
 void window_draw(Window* window);
 
@@ -2,7 +2,7 @@
 #include "types.h"
 #include <util.h>
 #include <lresult.h>
-#include <llog.h>
+#include <Emulator/emu_log.h>
 #include <string.h>
 
 static void init_pin(Pin *pin, const char *name, EPinType type, EPinState default_state) {
@@ -53,14 +53,12 @@ Result apu_init(Apu* apu) {
   for (int i = 0; i < 16; i++) 
     apu->wave_ram[i] = 0xFF;
 
-  LOG_TRACE("apu initialized successfully");
+  EMU_LOG_TRACE(EMU_LOG_APU, "apu initialized successfully");
   return result_ok();
 }
 
-Result apu_step(Apu* apu) {
-  if (!apu) {
-    return result_error(Error_NullPointer, "invalid apu to apu_step");
-  }
+int apu_step(Apu* apu) {
+  if (!apu) return Error_NullPointer;
 
-  return result_ok();
+  return 0;
 }
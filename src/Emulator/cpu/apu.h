@@ -45,7 +45,7 @@ typedef struct {
 // To be called internally by cpu. Inititalizes the ppu's internals to default values
 Result apu_init(Apu* apu);
 
-// TODO (empty)
-Result apu_step(Apu* apu);
+// TODO (empty). Returns 0 or an EAppError code, like ppu_step
+int apu_step(Apu* apu);
 
 #endif // !APU_H
@@ -3,13 +3,15 @@
 #include <Emulator/cpu/instructions/instructions.h>
 #include <util.h>
 #include <lresult.h>
-#include <llog.h>
+#include <Emulator/emu_log.h>
+#include <Emulator/event.h>
+#include <Emulator/trace.h>
+#include <Emulator/profiler.h>
+#include <Emulator/debugger.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 
-static Instruction g_currentInstr;
-static bool g_hasInstr = false;
-
 static void init_pin(Pin *pin, const char *name, EPinType type, EPinState default_state) {
   memset(pin, 0, sizeof(*pin));
   if (name) {
@@ -39,7 +41,7 @@ Result cpu_load_bootrom(Cpu* cpu) {
 
   cpu->bootrom_mapped = true;
 
-  LOG_TRACE("bootrom loaded successfully");
+  EMU_LOG_TRACE(EMU_LOG_CPU, "bootrom loaded successfully");
   return result_ok();
 }
 
@@ -59,9 +61,6 @@ Result cpu_init(Cpu* cpu, Mem* mem) {
   }
   cpu->data_value = 0;
 
-  cpu->temp_l = 0xFF;
-  cpu->temp_h = 0xFF;
-
   init_pin(&cpu->pin_X0,  "X0",  PIN_INPUT,  PIN_LOW); 
   init_pin(&cpu->pin_X1,  "X1",  PIN_INPUT,  PIN_LOW);
 
@@ -107,9 +106,10 @@ Result cpu_init(Cpu* cpu, Mem* mem) {
   init_pin(&cpu->pin_VSS0, "VSS0",  PIN_POWER, PIN_LOW);
   init_pin(&cpu->pin_VSS1, "VSS1",  PIN_POWER, PIN_LOW);
 
-  for (int i = 0; i < 6; i++) {
+  for (int i = 0; i < CPU_REGISTER_COUNT; i++) {
     cpu->registers[i].v = 0;
   }
+  cpu->registers[WZ].v = 0xFFFF;
   cpu->registers[AF].v = 0x01B0;
   cpu->registers[BC].v = 0x0013;
   cpu->registers[DE].v = 0x00D8;
@@ -117,9 +117,14 @@ Result cpu_init(Cpu* cpu, Mem* mem) {
   cpu->registers[SP].v = 0xFFFE;
   cpu->registers[PC].v = 0xFFFF;
   cpu->IR = 0x00;
+  cpu->has_instr = false;
 
   cpu->interrupt_enable = 0x00;
   cpu->interrupt_flag   = 0xE0;
+  cpu->ime         = false;
+  cpu->ime_pending = false;
+  cpu->halted      = false;
+  cpu->stopped     = false;
 
   cpu->clock_phase = CLOCK_LOW;
   cpu->clock_cycles = 0;
@@ -138,25 +143,97 @@ Result cpu_init(Cpu* cpu, Mem* mem) {
                         "failed to init apu: %s", rapu.message);
   }
 
-  cpu->mem = mem;
+  Result rjoy = joypad_init(&cpu->joypad);
+  if (result_is_error(&rjoy)) {
+    return result_error(rjoy.error_code,
+                        "failed to init joypad: %s", rjoy.message);
+  }
+
+  Result rtimer = timer_init(&cpu->timer);
+  if (result_is_error(&rtimer)) {
+    return result_error(rtimer.error_code,
+                        "failed to init timer: %s", rtimer.message);
+  }
+
+  Result rserial = serial_init(&cpu->serial);
+  if (result_is_error(&rserial)) {
+    return result_error(rserial.error_code,
+                        "failed to init serial: %s", rserial.message);
+  }
 
+  cpu->mem = mem;
+  cpu->events = NULL;
+  cpu->trace = NULL;
+  cpu->bus_access = 0;
+  cpu->profiler = NULL;
+  cpu->debugger = NULL;
+  cpu->frame_sinks = NULL;
+  cpu->sink_frames = 0;
+
+  cpu->error = result_ok();
   cpu->paused = false;
 
-  LOG_TRACE("cpu initialized successfully");
+  EMU_LOG_TRACE(EMU_LOG_CPU, "cpu initialized successfully");
   return result_ok();
 }
 
-Result cpu_clock_tick(Cpu *cpu) {
+int cpu_fail(Cpu* cpu, int code, const char* fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  cpu->error.error_code = code;
+  vsnprintf(cpu->error.message, sizeof(cpu->error.message), fmt, args);
+  va_end(args);
+  return code;
+}
+
+void cpu_add_frame_sink(Cpu* cpu, FrameSink* sink) {
+  sink->next = cpu->frame_sinks;
+  cpu->frame_sinks = sink;
+  cpu->sink_frames = cpu->ppu.frames;
+}
+
+void cpu_remove_frame_sink(Cpu* cpu, FrameSink* sink) {
+  for (FrameSink** p = &cpu->frame_sinks; *p; p = &(*p)->next) {
+    if (*p == sink) {
+      *p = sink->next;
+      sink->next = NULL;
+      return;
+    }
+  }
+}
+
+static void notify_frame(Cpu* cpu) {
+  cpu->sink_frames = cpu->ppu.frames;
+  for (FrameSink* sink = cpu->frame_sinks; sink; sink = sink->next)
+    sink->frame(sink, cpu);
+}
+
+int cpu_clock_tick(Cpu *cpu) {
   switch (cpu->clock_phase) {
     case CLOCK_LOW:
       cpu->clock_phase = CLOCK_RISING;
       pin_set_high(&cpu->pin_CLK);
       break;
 
-    case CLOCK_RISING:
+    case CLOCK_RISING: {
       cpu->clock_phase = CLOCK_HIGH;
       cpu->clock_cycles++;
-      break;
+
+      int status = ppu_step(&cpu->ppu, cpu->mem, &cpu->interrupt_flag);
+      if (status) return cpu_fail(cpu, status, "bad args to ppu_step");
+
+      if (cpu->frame_sinks && cpu->ppu.frames != cpu->sink_frames)
+        notify_frame(cpu);
+
+      if (cpu->clock_cycles >= cpu->timer.next_event)
+        timer_event(&cpu->timer, cpu->clock_cycles, &cpu->interrupt_flag);
+
+      if (cpu->clock_cycles >= cpu->serial.next_event)
+        serial_event(&cpu->serial, cpu->clock_cycles, &cpu->interrupt_flag);
+
+      if (cpu->clock_cycles >= cpu->mem->dma.next)
+        mem_dma_run(cpu->mem, cpu, cpu->clock_cycles);
+    } break;
 
     case CLOCK_HIGH:
       cpu->clock_phase = CLOCK_FALLING;
@@ -171,47 +248,98 @@ Result cpu_clock_tick(Cpu *cpu) {
   return cpu_step(cpu);
 }
 
-Result cpu_step(Cpu* cpu) {
-  if (!cpu) {
-    return result_error(Error_NullPointer, "invalid cpu to cpu_step");
+int cpu_step(Cpu* cpu) {
+  if (!cpu) return Error_NullPointer;
+
+  // Halted: nothing is stepped until an interrupt is requested, whether IME then lets the
+  // cpu take it or not
+  if (cpu->halted && !cpu->has_instr) {
+    if (cpu->clock_phase != CLOCK_LOW)
+      return 0;
+
+    u8 wake = cpu->stopped ? (cpu->interrupt_flag & INT_JOYPAD) : cpu_pending_interrupts(cpu);
+    if (!wake)
+      return 0;
+
+    cpu->halted  = false;
+    cpu->stopped = false;
   }
 
-  if (!g_hasInstr && cpu->clock_phase == CLOCK_LOW) {
-    ResultInstr rdec = instruction_decode(cpu->IR);
+  if (!cpu->has_instr && cpu->clock_phase == CLOCK_LOW && cpu->ime && cpu_pending_interrupts(cpu)) {
+    // IR was already fetched: the dispatch discards it and pushes its address
+    cpu->ime = false;
+    ResultInstr rint = build_interrupt_dispatch();
+    cpu->instr     = result_Instr_get_data(&rint);
+    cpu->instr.pc  = (u16)(cpu->registers[PC].v - 1);
+    cpu->has_instr = true;
+
+    EMU_EVENT(cpu, EMU_LOG_CPU,
+              .cycle = cpu->clock_cycles,
+              .pc    = (u16)(cpu->registers[PC].v - 1),
+              .kind  = EMU_EVENT_INTERRUPT,
+              .value = cpu_pending_interrupts(cpu));
+
+    if (cpu->trace && cpu->trace->granularity == TRACE_PER_INSTRUCTION)
+      trace_record(cpu->trace, cpu, (u16)(cpu->registers[PC].v - 1), cpu->IR, TRACE_FLAG_INTERRUPT, 0);
+    cpu->bus_access = 0;
+  } else if (!cpu->has_instr && cpu->clock_phase == CLOCK_LOW) {
+    // EI takes effect once the instruction after it is done
+    if (cpu->ime_pending) {
+      cpu->ime         = true;
+      cpu->ime_pending = false;
+    }
+
+    ResultInstr rdec;
+    EMU_STAT_TIMED(cpu->stats.decode_host_cycles, rdec = instruction_decode(cpu->IR));
+    EMU_STAT_INC(cpu->stats.decodes);
 
     if (result_Instr_is_err(&rdec)) {
-      LOG_WARNING("UNIMPLEMENTED OPCODE 0x%02X at PC=0x%04X", cpu->IR, cpu->registers[PC].v - 1);
+      EMU_LOG_WARNING(EMU_LOG_CPU, "UNIMPLEMENTED OPCODE 0x%02X at PC=0x%04X", cpu->IR, cpu->registers[PC].v - 1);
       cpu->paused = true;
-      g_hasInstr = false;
-      return result_error(rdec.error_code, "Decode Error: %s", rdec.message);
+      cpu->has_instr = false;
+      return cpu_fail(cpu, rdec.error_code, "Decode Error: %s", rdec.message);
     }
 
-    g_currentInstr = result_Instr_get_data(&rdec);
-    g_hasInstr     = true;
+    cpu->instr     = result_Instr_get_data(&rdec);
+    cpu->instr.pc  = (u16)(cpu->registers[PC].v - 1);
+    cpu->has_instr = true;
+
+    EMU_EVENT(cpu, EMU_LOG_EXEC,
+              .cycle = cpu->clock_cycles,
+              .pc    = (u16)(cpu->registers[PC].v - 1),
+              .kind  = EMU_EVENT_INSTR,
+              .value = cpu->IR);
+
+    if (cpu->profiler)
+      profiler_enter(cpu->profiler, cpu, (u16)(cpu->registers[PC].v - 1), cpu->IR);
 
-    LOG_INFO("INSTRUCTION: (%s) at PC=0x%04X", g_currentInstr.mnemonic, cpu->registers[PC].v - 1);
+    if (cpu->trace && cpu->trace->granularity == TRACE_PER_INSTRUCTION)
+      trace_record(cpu->trace, cpu, (u16)(cpu->registers[PC].v - 1), cpu->IR, TRACE_FLAG_INSTR, 0);
+    cpu->bus_access = 0;
+
+    if (cpu->debugger)
+      debugger_on_instruction(cpu->debugger, cpu, (u16)(cpu->registers[PC].v - 1));
   }
 
-  Result r = instruction_step(cpu, cpu->mem, &g_currentInstr);
-  if (result_is_error(&r)) {
-    LOG_ERROR("Error stepping instruction: %s", r.message);
-    return r;
+  int status = instruction_step(cpu, cpu->mem, &cpu->instr);
+  if (status) {
+    EMU_LOG_ERROR(EMU_LOG_CPU, "Error stepping instruction: %s", cpu->error.message);
+    return status;
   }
 
-  if (instruction_is_complete(&g_currentInstr))
-    g_hasInstr = false;
+  if (instruction_is_complete(&cpu->instr))
+    cpu->has_instr = false;
 
-  return result_ok();
+  return 0;
 }
 
 void cpu_set_flag(Cpu* cpu, EFlag flag, bool value) {
   u8 f = cpu->registers[AF].bytes.l;
-  
-  f = f >> 4;
-  f |= (1 << flag);
-  f = f << 4;
+  u8 mask = (u8)(1 << (flag + 4));
 
-  cpu->registers[AF].bytes.l = f;
+  f = value ? (f | mask) : (f & ~mask);
+
+  cpu->registers[AF].bytes.l = f & 0xF0;
 }
 
 bool cpu_get_flag(Cpu* cpu, EFlag flag) {
@@ -223,87 +351,3 @@ bool cpu_get_flag(Cpu* cpu, EFlag flag) {
 
   return v;
 }
-
-u16* cpu_get_reg16(Cpu* cpu, ERegisterFull reg) {
-  if (!cpu) return NULL;
-  switch (reg) {
-    case AF: return &cpu->registers[AF].v;
-    case BC: return &cpu->registers[BC].v;
-    case DE: return &cpu->registers[DE].v;
-    case HL: return &cpu->registers[HL].v;
-    case SP: return &cpu->registers[SP].v;
-    case PC: return &cpu->registers[PC].v;
-    default:
-      return NULL;
-  }
-}
-
-u8* cpu_get_reg8(Cpu* cpu, ERegisterHalf regHalf) {
-  if (!cpu) return NULL;
-  switch (regHalf) {
-    case A:   return &cpu->registers[AF].bytes.h;
-    case F:   return &cpu->registers[AF].bytes.l;
-    case B:   return &cpu->registers[BC].bytes.h;
-    case C:   return &cpu->registers[BC].bytes.l;
-    case D:   return &cpu->registers[DE].bytes.h;
-    case E:   return &cpu->registers[DE].bytes.l;
-    case H:   return &cpu->registers[HL].bytes.h;
-    case L:   return &cpu->registers[HL].bytes.l;
-    case SPL: return &cpu->registers[SP].bytes.l; 
-    case SPH: return &cpu->registers[SP].bytes.h; 
-    case PCL: return &cpu->registers[PC].bytes.l; 
-    case PCH: return &cpu->registers[PC].bytes.h;
-    default:
-      return NULL;
-  }
-}
-
-u16* cpu_get_reg16_opcode(Cpu* cpu, u8 index) {
-  if (!cpu) return NULL;
-
-  switch ((index >> 4) & 0x03) {
-    case 0: return &cpu->registers[BC].v;
-    case 1: return &cpu->registers[DE].v;
-    case 2: return &cpu->registers[HL].v;
-    case 3: return &cpu->registers[SP].v;
-  }
-
-  return NULL;
-}
-
-u16* cpu_get_reg16mem_opcode(Cpu* cpu, u8 index) {
-  if (!cpu) return NULL;
-
-  switch ((index >> 4) & 0x03) {
-    case 0: return &cpu->registers[BC].v; break;
-    case 1: return &cpu->registers[DE].v; break;
-    case 2: case 3:
-      return &cpu->registers[HL].v; break;
-  }
-
-  return NULL;
-}
-
-u8* cpu_get_reg8_opcode(Cpu* cpu, u8 index) {
-  if (!cpu) return NULL;
-  switch (index & 0x07) {
-    case 0: 
-      return &cpu->registers[BC].bytes.h;
-    case 1: 
-      return &cpu->registers[BC].bytes.l;
-    case 2: 
-      return &cpu->registers[DE].bytes.h;
-    case 3: 
-      return &cpu->registers[DE].bytes.l;
-    case 4: 
-      return &cpu->registers[HL].bytes.h;
-    case 5: 
-      return &cpu->registers[HL].bytes.l;
-    case 6: 
-      return NULL;
-    case 7: 
-      return &cpu->registers[AF].bytes.h;
-    default:
-      return NULL;
-  }
-}
@@ -5,8 +5,15 @@
 #include <lresult.h>
 #include "ppu.h"
 #include "apu.h"
+#include "joypad.h"
+#include "timer.h"
+#include "serial.h"
+#include "instruction.h"
 #include <Emulator/mem.h>
 
+struct EmuEventChannel;
+struct TraceRecorder;
+
 #define DMG_BOOTROM_SIZE 0x100
 #define CLOCK_PERIOD (1.0 / 4194304.0)
 
@@ -17,24 +24,34 @@ typedef enum {
   CLOCK_LOW
 } EClockPhase;
 
+// Indexed directly by the opcode's 2-bit r16 field (BC DE HL SP). WZ is the internal
+// temporary holding operands read from memory (Z low, W high)
 typedef enum {
-  AF = 0,
-  BC,
+  BC = 0,
   DE,
   HL,
   SP,
-  PC
+  AF,
+  PC,
+  WZ,
+  CPU_REGISTER_COUNT
 } ERegisterFull;
 
+// Byte offsets into Cpu.r8, the little endian halves of Cpu.registers
 typedef enum {
-  A = 0, F,
-  B, C,
-  D, E,
-  H, L,
+  C = 0, B,
+  E, D,
+  L, H,
   SPL, SPH,
-  PCL, PCH
+  F, A,
+  PCL, PCH,
+  Z, W
 } ERegisterHalf;
 
+// ERegisterHalf for each value of the opcode's 3-bit r8 field: B C D E H L (HL) A.
+// (HL) operands are latched in Z, like the byte of any other memory operand
+static const u8 CPU_R8_FIELD[8] = { B, C, D, E, H, L, Z, A };
+
 typedef enum {
   FC = 0,
   FH,
@@ -42,6 +59,15 @@ typedef enum {
   FZ
 } EFlag;
 
+// IE/IF bits, in priority order (lowest bit is dispatched first)
+typedef enum {
+  INT_VBLANK = 1 << 0,
+  INT_STAT   = 1 << 1,
+  INT_TIMER  = 1 << 2,
+  INT_SERIAL = 1 << 3,
+  INT_JOYPAD = 1 << 4,
+} EInterrupt;
+
 typedef struct {
   union {
     u16 v;
@@ -52,15 +78,21 @@ typedef struct {
   };
 } Register;
 
+struct Cpu;
+
+// Notified on the emulation thread each time the ppu completes a frame (enters VBlank),
+// with the framebuffer complete. See cpu_add_frame_sink
+typedef struct FrameSink {
+  void (*frame)(struct FrameSink* sink, struct Cpu* cpu);
+  struct FrameSink* next;
+} FrameSink;
+
 typedef struct Cpu {
   Pin addr_bus[16];
   u16 addr_value;
   Pin data_bus[8];
   u8 data_value;
 
-  u8 temp_l;
-  u8 temp_h;
-
   Pin pin_X0;
   Pin pin_X1;
 
@@ -101,11 +133,23 @@ typedef struct Cpu {
   Pin pin_VSS0;
   Pin pin_VSS1;
 
-  Register registers[6];
+  // Both views of the register file, see ERegisterFull and ERegisterHalf
+  union {
+    Register registers[CPU_REGISTER_COUNT];
+    u8 r8[CPU_REGISTER_COUNT * 2];
+  };
   u8 IR;
 
+  // Instruction currently being stepped, decoded from IR on the first LOW phase
+  Instruction instr;
+  bool has_instr;
+
   u8 interrupt_enable;
   u8 interrupt_flag;
+  bool ime;         // interrupt master enable
+  bool ime_pending; // EI: ime is set after the next instruction
+  bool halted;      // HALT/STOP: no instruction is stepped until an interrupt wakes the cpu
+  bool stopped;     // STOP: only a joypad interrupt wakes the cpu
 
   EClockPhase clock_phase;
   u64 clock_cycles;
@@ -115,9 +159,36 @@ typedef struct Cpu {
 
   Ppu ppu;
   Apu apu;
+  Joypad joypad;
+  Timer timer;
+  Serial serial;
 
   Mem* mem;
 
+  // Binary trace events (see Emulator/event.h), NULL when nobody listens
+  struct EmuEventChannel* events;
+
+  // Execution trace (see Emulator/trace.h), NULL when not recording
+  struct TraceRecorder* trace;
+  u8 bus_access; // ETraceFlag READ/WRITE bits since the last trace record
+
+  // Guest profiler (see Emulator/profiler.h), NULL when not profiling
+  struct Profiler* profiler;
+
+  // Breakpoints and watchpoints (see Emulator/debugger.h), NULL when none are set
+  struct Debugger* debugger;
+
+  // Frame listeners (frame hashes, video dumps), NULL when nobody listens
+  FrameSink* frame_sinks;
+  u64 sink_frames; // Ppu.frames the sinks were last notified of
+
+#if EMU_STATS
+  EMU_STATS_ALIGN CpuStats stats; // see Emulator/stats.h
+#endif
+
+  // Details of the last failure reported by a step function (see cpu_fail)
+  Result error;
+
   // DEBUG
   bool paused;
 } Cpu;
@@ -127,17 +198,44 @@ Result cpu_init(Cpu* cpu, Mem* mem);
 
 Result cpu_load_bootrom(Cpu* cpu);
 
-Result cpu_clock_tick(Cpu* cpu);
+// The per clock phase functions (cpu_clock_tick, cpu_step, instruction_step, ppu_step,
+// machine_clock_tick) return 0 or an EAppError code. The message goes to Cpu.error, only
+// written when something fails
+int cpu_clock_tick(Cpu* cpu);
+
+int cpu_step(Cpu* cpu);
 
-Result cpu_step(Cpu* cpu);
+// Adds `sink` to the frame listeners, from the next completed frame on
+void cpu_add_frame_sink(Cpu* cpu, FrameSink* sink);
+void cpu_remove_frame_sink(Cpu* cpu, FrameSink* sink);
+
+// Records a failure in cpu->error and returns `code`
+int cpu_fail(Cpu* cpu, int code, const char* fmt, ...)
+  __attribute__((cold, format(printf, 3, 4)));
+
+// Requested and enabled interrupts (IE & IF)
+static inline u8 cpu_pending_interrupts(const Cpu* cpu) {
+  return cpu->interrupt_enable & cpu->interrupt_flag & 0x1F;
+}
 
 void cpu_set_flag(Cpu* cpu, EFlag flag, bool value);
 bool cpu_get_flag(Cpu* cpu, EFlag flag);
 
-u16* cpu_get_reg16(Cpu* cpu, ERegisterFull reg);
-u8*  cpu_get_reg8(Cpu* cpu, ERegisterHalf regHalf);
-u16* cpu_get_reg16_opcode(Cpu* cpu, u8 index);
-u16* cpu_get_reg16mem_opcode(Cpu* cpu, u8 index);
-u8*  cpu_get_reg8_opcode(Cpu* cpu, u8 index);
+static inline u16* cpu_get_reg16(Cpu* cpu, ERegisterFull reg) {
+  return &cpu->registers[reg].v;
+}
+
+static inline u8* cpu_get_reg8(Cpu* cpu, ERegisterHalf regHalf) {
+  return &cpu->r8[regHalf];
+}
+
+// Operands named by the opcode's register fields, r16 in bits 4-5, r8 in bits 0-2 or 3-5
+static inline u16* cpu_get_reg16_field(Cpu* cpu, u8 field) {
+  return &cpu->registers[field & 0x03].v;
+}
+
+static inline u8* cpu_get_reg8_field(Cpu* cpu, u8 field) {
+  return &cpu->r8[CPU_R8_FIELD[field & 0x07]];
+}
 
 #endif // !CPU_H
@@ -3,6 +3,7 @@
 #include <lresult.h>
 #include <util.h>
 #include <llog.h>
+#include <Emulator/trace.h>
 #include <string.h>
 #include <types.h>
 
@@ -88,6 +89,15 @@ ResultInstr instruction_decode(u8 opcode) {
     case 0xB8: case 0xB9: case 0xBA: case 0xBB: case 0xBC: case 0xBD: case 0xBF: // CP A,r8
       return build_logic_r8(opcode);
 
+    // ALU A, d8
+    case 0xC6: case 0xCE: case 0xD6: case 0xDE:
+    case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+      return build_logic_imm(opcode);
+
+    // LDH [a8], A / LDH A, [a8]
+    case 0xE0: case 0xF0:
+      return build_ldh(opcode);
+
     // LD r16, d16
     case 0x01: case 0x11: case 0x21: case 0x31:
       return build_ld_r16_imm(opcode);
@@ -98,9 +108,27 @@ ResultInstr instruction_decode(u8 opcode) {
 
     // 16-bit INC/DEC
     case 0x03: case 0x13: case 0x23: case 0x33:
-    case 0x08: case 0x18: case 0x28: case 0x38:
+    case 0x0B: case 0x1B: case 0x2B: case 0x3B:
       return build_inc_dec_r16(opcode);
 
+    // JP a16
+    case 0xC3:
+      return build_jp_a16(opcode);
+
+    // JR e8, JR cc, e8
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+      return build_jr(opcode);
+
+    // Interrupt control
+    case 0xF3: case 0xFB:
+      return build_ei_di(opcode);
+    case 0x76:
+      return build_halt(opcode);
+    case 0x10:
+      return build_stop(opcode);
+    case 0xD9:
+      return build_reti(opcode);
+
     // 0xCB prefix
     case 0xCB:
       return build_cb();
@@ -111,20 +139,18 @@ ResultInstr instruction_decode(u8 opcode) {
   }
 }
 
-Result instruction_step(Cpu* cpu, Mem* mem, Instruction* instruction) {
-  if (!cpu || !mem || !instruction)
-    return result_error(Error_NullPointer, "null pointer in instruction_step");
+int instruction_step(Cpu* cpu, Mem* mem, Instruction* instruction) {
+  if (!cpu) return Error_NullPointer;
+  if (!mem || !instruction)
+    return cpu_fail(cpu, Error_NullPointer, "null pointer in instruction_step");
 
   if (instruction_is_complete(instruction))
-    return result_ok();
+    return 0;
 
   MCycle* mc = &instruction->mcycles[instruction->current_mcycle];
-  if (!mc)
-    return result_error(Error_NullPointer, "null MCycle in instruction_step");
-
   TCycle_fn fn = mc->tcycles[instruction->current_tcycle];
   if (!fn)
-    return result_error(Error_NullPointer, "null TCycle in instruction_step");
+    return cpu_fail(cpu, Error_NullPointer, "null TCycle in instruction_step");
 
   if (cpu->clock_phase == CLOCK_RISING || cpu->clock_phase == CLOCK_HIGH) {
     fn(cpu, mem);
@@ -133,11 +159,19 @@ Result instruction_step(Cpu* cpu, Mem* mem, Instruction* instruction) {
   if (cpu->clock_phase == CLOCK_FALLING) {
     instruction->current_tcycle++;
     if (instruction->current_tcycle >= mc->tcycle_count) {
+      if (cpu->trace && cpu->trace->granularity == TRACE_PER_MCYCLE) {
+        u8 first = instruction->interrupt ? TRACE_FLAG_INTERRUPT : TRACE_FLAG_INSTR;
+        u8 flags = cpu->bus_access | (instruction->current_mcycle == 0 ? first : 0);
+        trace_record(cpu->trace, cpu, instruction->pc, instruction->opcode, flags,
+                     (u8)instruction->current_mcycle);
+        cpu->bus_access = 0;
+      }
+
       instruction->current_mcycle++;
       instruction->current_tcycle = 0;
     }
   }
-  return result_ok();
+  return 0;
 }
 
 // Basic MCycle
@@ -3,13 +3,14 @@
 
 #include <lresult.h>
 #include <types.h>
-#include "cpu.h"
 #include <Emulator/mem.h>
 
+struct Cpu;
+
 #define MAX_TCYCLES 8
 #define MAX_MCYCLES 8
 
-typedef void (*TCycle_fn)(Cpu* cpu, Mem* mem);
+typedef void (*TCycle_fn)(struct Cpu* cpu, Mem* mem);
 
 typedef struct {
   TCycle_fn tcycles[MAX_TCYCLES];
@@ -23,6 +24,8 @@ typedef struct {
 
   u8 opcode;
   const char* mnemonic;
+  bool interrupt; // an interrupt dispatch rather than an opcode
+  u16 pc;         // address of the opcode, set by the cpu when it starts the instruction
 
   int current_mcycle;
   int current_tcycle;
@@ -34,7 +37,8 @@ ResultInstr instruction_create(u8 opcode, const char* mnemonic,
                                const MCycle* cycles, int mc_count);
 ResultInstr instruction_decode(u8 opcode);
 bool instruction_is_complete(const Instruction* instr);
-Result instruction_step(Cpu* cpu, Mem* mem, Instruction* instruction);
+// 0 or an EAppError code, see cpu_clock_tick
+int instruction_step(struct Cpu* cpu, Mem* mem, Instruction* instruction);
 
 // Common MCycles
 MCycle mcycle_new(bool uses_memory, int tcycle_count);
@@ -42,15 +46,15 @@ MCycle idle_cycle_create();
 MCycle fetch_cycle_create();
 
 // Common TCycles
-void idle_t(Cpu* cpu, Mem* mem);
-void idle_reset_bus_t(Cpu* cpu, Mem* mem);
-void inc_pc_t(Cpu* cpu, Mem* mem);
+void idle_t(struct Cpu* cpu, Mem* mem);
+void idle_reset_bus_t(struct Cpu* cpu, Mem* mem);
+void inc_pc_t(struct Cpu* cpu, Mem* mem);
 
 // Fetch TCycles
-void fetch_t0(Cpu* cpu, Mem* mem);
-void fetch_t1(Cpu* cpu, Mem* mem);
-void fetch_t2(Cpu* cpu, Mem* mem);
-void fetch_t3(Cpu* cpu, Mem* mem);
+void fetch_t0(struct Cpu* cpu, Mem* mem);
+void fetch_t1(struct Cpu* cpu, Mem* mem);
+void fetch_t2(struct Cpu* cpu, Mem* mem);
+void fetch_t3(struct Cpu* cpu, Mem* mem);
 
 #endif
 
@@ -0,0 +1,78 @@
+#ifndef ALU_H
+#define ALU_H
+
+#include <types.h>
+#include <Emulator/cpu/cpu.h>
+#include "opcode_spec.h"
+
+// 8-bit ALU operations on A, one per OPCODE_ALU entry, named alu_<op>. Shared by the
+// r8 and d8 forms (build_logic_r8, build_logic_imm) and by machine_skip_idle, which
+// replays the CP/AND of a polling loop
+
+static inline void alu_add(Cpu* cpu, u8 value) {
+  u8 a = CPU_R8_A(cpu);
+  u8 result = a + value;
+  cpu_set_flag(cpu, FZ, result == 0);
+  cpu_set_flag(cpu, FN, false);
+  cpu_set_flag(cpu, FH, (a & 0x0F) + (value & 0x0F) > 0x0F);
+  cpu_set_flag(cpu, FC, (u16)a + (u16)value > 0xFF);
+  CPU_R8_A(cpu) = result;
+}
+
+// Carry is added as a separate term so value + carry can't wrap
+static inline void alu_adc(Cpu* cpu, u8 value) {
+  u8 a = CPU_R8_A(cpu);
+  u8 c = cpu_get_flag(cpu, FC) ? 1 : 0;
+  u8 result = a + value + c;
+  cpu_set_flag(cpu, FZ, result == 0);
+  cpu_set_flag(cpu, FN, false);
+  cpu_set_flag(cpu, FH, (a & 0x0F) + (value & 0x0F) + c > 0x0F);
+  cpu_set_flag(cpu, FC, (u16)a + (u16)value + c > 0xFF);
+  CPU_R8_A(cpu) = result;
+}
+
+static inline u8 alu_sub_flags(Cpu* cpu, u8 a, u8 value, u8 c) {
+  u8 result = a - value - c;
+  cpu_set_flag(cpu, FZ, result == 0);
+  cpu_set_flag(cpu, FN, true);
+  cpu_set_flag(cpu, FH, (a & 0x0F) < (value & 0x0F) + c);
+  cpu_set_flag(cpu, FC, (u16)a < (u16)value + c);
+  return result;
+}
+
+static inline void alu_sub(Cpu* cpu, u8 value) {
+  CPU_R8_A(cpu) = alu_sub_flags(cpu, CPU_R8_A(cpu), value, 0);
+}
+
+static inline void alu_sbc(Cpu* cpu, u8 value) {
+  u8 c = cpu_get_flag(cpu, FC) ? 1 : 0;
+  CPU_R8_A(cpu) = alu_sub_flags(cpu, CPU_R8_A(cpu), value, c);
+}
+
+static inline void alu_cp(Cpu* cpu, u8 value) {
+  alu_sub_flags(cpu, CPU_R8_A(cpu), value, 0);
+}
+
+static inline void alu_logic_flags(Cpu* cpu, u8 result, bool half) {
+  cpu_set_flag(cpu, FZ, result == 0);
+  cpu_set_flag(cpu, FN, false);
+  cpu_set_flag(cpu, FH, half);
+  cpu_set_flag(cpu, FC, false);
+}
+
+static inline void alu_and(Cpu* cpu, u8 value) {
+  CPU_R8_A(cpu) &= value;
+  alu_logic_flags(cpu, CPU_R8_A(cpu), true);
+}
+
+static inline void alu_xor(Cpu* cpu, u8 value) {
+  CPU_R8_A(cpu) ^= value;
+  alu_logic_flags(cpu, CPU_R8_A(cpu), false);
+}
+
+static inline void alu_or(Cpu* cpu, u8 value) {
+  CPU_R8_A(cpu) |= value;
+  alu_logic_flags(cpu, CPU_R8_A(cpu), false);
+}
+
+#endif // !ALU_H
@@ -1,4 +1,5 @@
 #include "cb.h"
+#include "opcode_spec.h"
 #include "Emulator/cpu/cpu.h"
 #include "Emulator/cpu/instruction.h"
 #include <Emulator/mem.h>
@@ -24,11 +25,10 @@ static void cb_fetch_t0(Cpu* cpu, Mem* mem) {
 
 static void cb_fetch_t1(Cpu* cpu, Mem* mem) {
   if (cpu->clock_phase == CLOCK_RISING) {
-    u8 data = mem_read8(mem, cpu, cpu->registers[PC].v + 1);
+    u8 data = mem_read8(mem, cpu, cpu->registers[PC].v);
     set_data_bus_value(cpu, data);
   } else if (cpu->clock_phase == CLOCK_HIGH) {
     pin_set_low(&cpu->pin_RD);
-    cpu->registers[PC].v++;
   }
 }
 
@@ -64,86 +64,120 @@ static MCycle cb_fetch_cycle_create() {
   return m;
 }
 
+//
+// cb ops, one handler per CB opcode (see OPCODE_CB_ROT, OPCODE_CB_BITOP x OPCODE_R8)
+//
+typedef void (*CbOp_fn)(Cpu* cpu);
+
+static inline u8 cb_rlc(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, (v & 0x80) != 0);
+  return (u8)((v << 1) | (v >> 7));
+}
+
+static inline u8 cb_rrc(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, (v & 0x01) != 0);
+  return (u8)((v >> 1) | (v << 7));
+}
+
+static inline u8 cb_rl(Cpu* cpu, u8 v) {
+  bool old_carry = cpu_get_flag(cpu, FC);
+  cpu_set_flag(cpu, FC, (v & 0x80) != 0);
+  return (u8)((v << 1) | (old_carry ? 1 : 0));
+}
+
+static inline u8 cb_rr(Cpu* cpu, u8 v) {
+  bool old_carry = cpu_get_flag(cpu, FC);
+  cpu_set_flag(cpu, FC, (v & 0x01) != 0);
+  return (u8)((v >> 1) | (old_carry ? 0x80 : 0));
+}
+
+static inline u8 cb_sla(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, (v & 0x80) != 0);
+  return (u8)(v << 1);
+}
+
+static inline u8 cb_sra(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, (v & 0x01) != 0);
+  return (u8)((v >> 1) | (v & 0x80));
+}
+
+static inline u8 cb_swap(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, false);
+  return (u8)((v << 4) | (v >> 4));
+}
+
+static inline u8 cb_srl(Cpu* cpu, u8 v) {
+  cpu_set_flag(cpu, FC, (v & 0x01) != 0);
+  return (u8)(v >> 1);
+}
+
+#define CB_ROT_OP(reg_idx, reg, op) \
+  static void cb_##op##_##reg(Cpu* cpu) { \
+    CPU_R8_##reg(cpu) = cb_##op(cpu, CPU_R8_##reg(cpu)); \
+    cpu_set_flag(cpu, FZ, CPU_R8_##reg(cpu) == 0); \
+    cpu_set_flag(cpu, FN, false); \
+    cpu_set_flag(cpu, FH, false); \
+  }
+#define CB_ROT_ROW(op_idx, op, mnemonic, ...) OPCODE_R8(CB_ROT_OP, op)
+
+OPCODE_CB_ROT(CB_ROT_ROW)
+
+#undef CB_ROT_ROW
+#undef CB_ROT_OP
+
+#define CB_BIT_OP(reg_idx, reg, bit) \
+  static void cb_bit_##bit##_##reg(Cpu* cpu) { \
+    cpu_set_flag(cpu, FZ, (CPU_R8_##reg(cpu) & (1 << bit)) == 0); \
+    cpu_set_flag(cpu, FN, false); \
+    cpu_set_flag(cpu, FH, true); \
+  } \
+  static void cb_res_##bit##_##reg(Cpu* cpu) { \
+    CPU_R8_##reg(cpu) &= (u8)~(1 << bit); \
+  } \
+  static void cb_set_##bit##_##reg(Cpu* cpu) { \
+    CPU_R8_##reg(cpu) |= (u8)(1 << bit); \
+  }
+#define CB_BIT_ROW(bit, ...) OPCODE_R8(CB_BIT_OP, bit)
+
+OPCODE_BIT(CB_BIT_ROW)
+
+#undef CB_BIT_ROW
+#undef CB_BIT_OP
+
+// [HL] operands need extra memory cycles, they don't do anything yet
+static void cb_hl_unimplemented(Cpu* cpu) {
+  (void)cpu;
+}
+
+#define CB_ROT_ENTRY(reg_idx, reg, op_idx, op) [(op_idx << 3) | reg_idx] = cb_##op##_##reg,
+#define CB_ROT_ROW(op_idx, op, mnemonic, ...) \
+  OPCODE_R8(CB_ROT_ENTRY, op_idx, op) [(op_idx << 3) | 6] = cb_hl_unimplemented,
+#define CB_BITOP_ENTRY(reg_idx, reg, bit, op_idx, op) \
+  [(op_idx << 6) | (bit << 3) | reg_idx] = cb_##op##_##bit##_##reg,
+#define CB_BITOP_BIT(bit, op_idx, op) \
+  OPCODE_R8(CB_BITOP_ENTRY, bit, op_idx, op) [(op_idx << 6) | (bit << 3) | 6] = cb_hl_unimplemented,
+#define CB_BITOP_ROW(op_idx, op, mnemonic, ...) OPCODE_BIT(CB_BITOP_BIT, op_idx, op)
+
+// Indexed by the CB opcode
+static const CbOp_fn cb_ops[256] = {
+  OPCODE_CB_ROT(CB_ROT_ROW)
+  OPCODE_CB_BITOP(CB_BITOP_ROW)
+};
+
+#undef CB_BITOP_ROW
+#undef CB_BITOP_BIT
+#undef CB_BITOP_ENTRY
+#undef CB_ROT_ROW
+#undef CB_ROT_ENTRY
+
 //
 // cb op + fetch
 //
 static void cb_op_t0(Cpu* cpu, Mem* mem) {
   (void)mem;
 
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u8 op_type = (cpu->IR >> 6) & 0x03;
-    u8* reg_ptr = cpu_get_reg8_opcode(cpu, cpu->IR);
-    u8 bit_pos = (cpu->IR >> 3) & 0x07;
-    if (!reg_ptr) return;
-
-    switch (op_type) {
-      case 0x00: {
-        u8 rop_type = (cpu->IR >> 3) & 0x07;
-        bool old_carry = cpu_get_flag(cpu, FC);
-
-        switch (rop_type) {
-          case 0x00: 
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x80) != 0);
-            *reg_ptr = (*reg_ptr << 1) | (cpu_get_flag(cpu, FC) ? 1 : 0);
-            break;
-
-          case 0x01: 
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x01) != 0);
-            *reg_ptr = (*reg_ptr >> 1) | (cpu_get_flag(cpu, FC) ? 0x80 : 0);
-            break;
-
-          case 0x02:
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x80) != 0);
-            *reg_ptr = (*reg_ptr << 1) | (old_carry ? 1 : 0);
-            break;
-
-          case 0x03: 
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x01) != 0);
-            *reg_ptr = (*reg_ptr >> 1) | (old_carry ? 0x80 : 0);
-            break;
-
-          case 0x04:
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x80) != 0);
-            *reg_ptr <<= 1;
-            break;
-
-          case 0x05:
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x01) != 0);
-            *reg_ptr = (*reg_ptr >> 1) | (*reg_ptr & 0x80);
-            break;
-
-          case 0x06:
-            *reg_ptr = ((*reg_ptr & 0x0F) << 4) | ((*reg_ptr & 0xF0) >> 4);
-            cpu_set_flag(cpu, FC, false);
-            break;
-
-          case 0x07:
-            cpu_set_flag(cpu, FC, (*reg_ptr & 0x01) != 0);
-            *reg_ptr >>= 1;
-            break;
-        }
-
-        cpu_set_flag(cpu, FZ, *reg_ptr == 0);
-        cpu_set_flag(cpu, FN, false);
-        cpu_set_flag(cpu, FH, false);
-      } break;
-
-      case 0x01: {
-        cpu_set_flag(cpu, FZ, (*reg_ptr & (1 << bit_pos)) == 0);
-        cpu_set_flag(cpu, FN, false);
-        cpu_set_flag(cpu, FH, true);
-      } break;
-
-      case 0x02: {
-        *reg_ptr &= ~(1 << bit_pos);
-      } break;
-
-      case 0x03: {
-        *reg_ptr |= (1 << bit_pos);
-      } break;
-    }
-  }
-
+  if (cpu->clock_phase == CLOCK_RISING)
+    cb_ops[cpu->IR](cpu);
 }
 
 static void cb_op_t1(Cpu* cpu, Mem* mem) {
@@ -166,7 +200,7 @@ static void cb_op_t3(Cpu* cpu, Mem* mem) {
 }
 
 static MCycle cb_op_cycle_create() {
-  MCycle m = mcycle_new(4, false);
+  MCycle m = mcycle_new(true, 4);
 
   m.tcycles[0] = cb_op_t0;
   m.tcycles[1] = cb_op_t1;
@@ -180,6 +214,8 @@ ResultInstr build_cb() {
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
 
+  instr.opcode       = 0xCB;
+  instr.mnemonic     = "PREFIX CB";
   instr.mcycle_count = 2;
 
   instr.mcycles[0] = cb_fetch_cycle_create();
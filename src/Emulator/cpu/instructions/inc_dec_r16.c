@@ -1,28 +1,48 @@
 #include "inc_dec_r16.h"
+#include "opcode_spec.h"
 #include <types.h>
 #include <util.h>
 #include <string.h>
 
-static void inc_dec_r16_t(Cpu* cpu, Mem* mem) {
-  (void)mem;
+// One handler per register and direction (see OPCODE_R16)
+#define INC_DEC_R16_T(reg_idx, reg, ...) \
+  static void inc_r16_##reg##_t(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      set_addr_bus_value(cpu, CPU_R16_##reg(cpu)); \
+      CPU_R16_##reg(cpu)++; \
+    } \
+  } \
+  static void dec_r16_##reg##_t(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      set_addr_bus_value(cpu, CPU_R16_##reg(cpu)); \
+      CPU_R16_##reg(cpu)--; \
+    } \
+  }
 
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u16* reg_ptr = cpu_get_reg16_opcode(cpu, cpu->IR);
-    if (!reg_ptr) return;
+OPCODE_R16(INC_DEC_R16_T)
 
-    set_addr_bus_value(cpu, *reg_ptr);
+#undef INC_DEC_R16_T
 
-    u8 low = cpu->IR & 0x0F;
-    bool is_inc = (low == 0x03);
+// Indexed by bits 3-5 of the opcode (0x03 + 8 * index)
+#define INC_DEC_R16_ENTRY(reg_idx, reg, ...) \
+  [reg_idx << 1]       = { inc_r16_##reg##_t, "INC " #reg }, \
+  [(reg_idx << 1) | 1] = { dec_r16_##reg##_t, "DEC " #reg },
 
-    if (is_inc) 
-      (*reg_ptr)++;
-    else
-      (*reg_ptr)--;
-  }
-}
+static const struct {
+  TCycle_fn op_t;
+  const char* mnemonic;
+} inc_dec_r16_ops[8] = {
+  OPCODE_R16(INC_DEC_R16_ENTRY)
+};
+
+#undef INC_DEC_R16_ENTRY
 
 ResultInstr build_inc_dec_r16(u8 opcode) {
+  if ((opcode & 0xC7) != 0x03)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_inc_r16: %02X", opcode);
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
   instr.opcode = opcode;
@@ -30,46 +50,19 @@ ResultInstr build_inc_dec_r16(u8 opcode) {
   instr.current_mcycle = 0;
   instr.current_tcycle = 0;
 
-  switch (opcode) {
-    case 0x03:
-      instr.mnemonic = "INC BC";
-      break;
-    case 0x13:
-      instr.mnemonic = "INC DE";
-      break;
-    case 0x23:
-      instr.mnemonic = "INC HL";
-      break;
-    case 0x33:
-      instr.mnemonic = "INC SP";
-      break;
-    case 0x08:
-      instr.mnemonic = "DEC BC";
-      break;
-    case 0x18:
-      instr.mnemonic = "DEC DE";
-      break;
-    case 0x28:
-      instr.mnemonic = "DEC HL";
-      break;
-    case 0x38:
-      instr.mnemonic = "DEC SP";
-      break;
-
-    default:
-      return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_inc_r16: %02X", opcode);
-  }
+  instr.mnemonic = inc_dec_r16_ops[(opcode >> 3) & 0x07].mnemonic;
 
+  instr.mcycles[0] = inc_dec_16_cycle_create(inc_dec_r16_ops[(opcode >> 3) & 0x07].op_t);
   instr.mcycles[1] = fetch_cycle_create();
 
   return result_ok_Instr(instr);
 }
 
-MCycle inc_dec_16_cycle_create() {
+MCycle inc_dec_16_cycle_create(TCycle_fn op_t) {
   MCycle m = mcycle_new(false, 4);
 
   m.tcycles[0] = idle_t;
-  m.tcycles[1] = inc_dec_r16_t;
+  m.tcycles[1] = op_t;
   m.tcycles[2] = idle_t;
   m.tcycles[3] = idle_reset_bus_t;
 
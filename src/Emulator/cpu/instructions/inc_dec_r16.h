@@ -7,6 +7,6 @@
 // Creates an Instruction inc_rr with the specified register depending on the opcode
 ResultInstr build_inc_dec_r16(u8 opcode);
 
-MCycle inc_dec_16_cycle_create();
+MCycle inc_dec_16_cycle_create(TCycle_fn op_t);
 
 #endif
@@ -6,5 +6,9 @@
 #include "ld_r16.h"
 #include "logic_r8.h"
 #include "cb.h"
+#include "jp.h"
+#include "jr.h"
+#include "ldh.h"
+#include "interrupt.h"
 
 #endif // !INSTRUCTIONS_H
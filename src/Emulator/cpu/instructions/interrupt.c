@@ -0,0 +1,331 @@
+#include "interrupt.h"
+#include "Emulator/cpu/cpu.h"
+#include "Emulator/cpu/instruction.h"
+#include <Emulator/mem.h>
+#include <types.h>
+#include <util.h>
+#include <string.h>
+
+//
+// ei / di
+//
+static void ei_t3(Cpu* cpu, Mem* mem) {
+  fetch_t3(cpu, mem);
+
+  // Takes effect after the next instruction (see cpu_step)
+  if (cpu->clock_phase == CLOCK_RISING)
+    cpu->ime_pending = true;
+}
+
+static void di_t3(Cpu* cpu, Mem* mem) {
+  fetch_t3(cpu, mem);
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->ime = false;
+    cpu->ime_pending = false;
+  }
+}
+
+ResultInstr build_ei_di(u8 opcode) {
+  if (opcode != 0xFB && opcode != 0xF3)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for EI/DI: 0x%02X", opcode);
+
+  MCycle m = fetch_cycle_create();
+  m.tcycles[3] = opcode == 0xFB ? ei_t3 : di_t3;
+
+  return instruction_create(opcode, opcode == 0xFB ? "EI" : "DI", &m, 1);
+}
+
+//
+// halt / stop
+//
+
+// The opcode after HALT is fetched like for any instruction, then the cpu stops stepping
+// instructions until an enabled interrupt is requested. With IME clear and one already
+// pending it doesn't halt, and PC misses its increment (the halt bug: that byte is read
+// twice)
+static void halt_t3(Cpu* cpu, Mem* mem) {
+  fetch_t3(cpu, mem);
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    if (!cpu->ime && cpu_pending_interrupts(cpu))
+      cpu->registers[PC].v--;
+    else
+      cpu->halted = true;
+  }
+}
+
+ResultInstr build_halt(u8 opcode) {
+  if (opcode != 0x76)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for HALT: 0x%02X", opcode);
+
+  MCycle m = fetch_cycle_create();
+  m.tcycles[3] = halt_t3;
+
+  return instruction_create(opcode, "HALT", &m, 1);
+}
+
+// STOP skips the byte after it, then sleeps until a button is pressed
+static void stop_skip_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void stop_t3(Cpu* cpu, Mem* mem) {
+  fetch_t3(cpu, mem);
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->halted = true;
+    cpu->stopped = true;
+  }
+}
+
+ResultInstr build_stop(u8 opcode) {
+  if (opcode != 0x10)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for STOP: 0x%02X", opcode);
+
+  MCycle cycles[2] = {
+    fetch_cycle_create(),
+    fetch_cycle_create(),
+  };
+  cycles[0].tcycles[2] = stop_skip_t2;
+  cycles[1].tcycles[3] = stop_t3;
+
+  return instruction_create(opcode, "STOP", cycles, 2);
+}
+
+//
+// reti
+//
+
+// Stack read, low byte into Z then high byte into W
+static void pop_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[SP].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void pop_t1(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    u8 data = mem_read8(mem, cpu, cpu->registers[SP].v);
+    set_data_bus_value(cpu, data);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_RD);
+  }
+}
+
+static void pop_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[SP].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void pop_low_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[Z] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static void pop_high_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[W] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle pop_cycle_create(TCycle_fn last) {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = pop_t0;
+  m.tcycles[1] = pop_t1;
+  m.tcycles[2] = pop_t2;
+  m.tcycles[3] = last;
+
+  return m;
+}
+
+// Internal cycle: PC <- WZ, IME set right away (unlike EI)
+static void reti_set_pc_t(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v = cpu->registers[WZ].v;
+    cpu->ime = true;
+    cpu->ime_pending = false;
+  }
+}
+
+ResultInstr build_reti(u8 opcode) {
+  if (opcode != 0xD9)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for RETI: 0x%02X", opcode);
+
+  MCycle internal = mcycle_new(false, 4);
+  internal.tcycles[0] = reti_set_pc_t;
+  internal.tcycles[1] = idle_t;
+  internal.tcycles[2] = idle_t;
+  internal.tcycles[3] = idle_reset_bus_t;
+
+  MCycle cycles[4] = {
+    pop_cycle_create(pop_low_t3),
+    pop_cycle_create(pop_high_t3),
+    internal,
+    fetch_cycle_create(),
+  };
+
+  return instruction_create(opcode, "RETI", cycles, 4);
+}
+
+//
+// interrupt dispatch
+//
+
+// M1: PC back to the address of the opcode in IR, which is discarded
+static void dispatch_dec_pc_t(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING)
+    cpu->registers[PC].v--;
+}
+
+// M2: SP--
+static void dispatch_dec_sp_t(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING)
+    cpu->registers[SP].v--;
+}
+
+static MCycle dispatch_internal_cycle_create(TCycle_fn op) {
+  MCycle m = mcycle_new(false, 4);
+
+  m.tcycles[0] = idle_t;
+  m.tcycles[1] = op;
+  m.tcycles[2] = idle_t;
+  m.tcycles[3] = idle_reset_bus_t;
+
+  return m;
+}
+
+// M3/M4: PCH then PCL written to [SP]
+static void push_pch_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_data_bus_value(cpu, cpu->r8[PCH]);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+// The interrupt is picked once PCH is pushed: if that write cleared its IE bit, nothing is
+// left pending and the cpu jumps to 0x0000 instead
+static void push_pcl_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_data_bus_value(cpu, cpu->r8[PCL]);
+
+    u8 pending = cpu_pending_interrupts(cpu);
+    if (pending) {
+      int bit = __builtin_ctz(pending);
+      cpu->interrupt_flag &= (u8)~(1 << bit);
+      cpu->registers[PC].v = (u16)(0x0040 + bit * 8);
+    } else {
+      cpu->registers[PC].v = 0x0000;
+    }
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void push_t1(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[SP].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_WR);
+  }
+}
+
+static void push_t2(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    mem_write8(mem, cpu, cpu->addr_value, cpu->data_value);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void push_pch_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->registers[SP].v--;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static void push_pcl_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle push_cycle_create(TCycle_fn first, TCycle_fn last) {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = first;
+  m.tcycles[1] = push_t1;
+  m.tcycles[2] = push_t2;
+  m.tcycles[3] = last;
+
+  return m;
+}
+
+ResultInstr build_interrupt_dispatch(void) {
+  MCycle cycles[5] = {
+    dispatch_internal_cycle_create(dispatch_dec_pc_t),
+    dispatch_internal_cycle_create(dispatch_dec_sp_t),
+    push_cycle_create(push_pch_t0, push_pch_t3),
+    push_cycle_create(push_pcl_t0, push_pcl_t3),
+    fetch_cycle_create(),
+  };
+
+  ResultInstr r = instruction_create(0x00, "INT", cycles, 5);
+  r.data.interrupt = true;
+  return r;
+}
@@ -0,0 +1,22 @@
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <types.h>
+#include <Emulator/cpu/instruction.h>
+
+// EI, DI
+ResultInstr build_ei_di(u8 opcode);
+
+// HALT, STOP
+ResultInstr build_halt(u8 opcode);
+ResultInstr build_stop(u8 opcode);
+
+// RETI
+ResultInstr build_reti(u8 opcode);
+
+// Not an opcode: what the cpu runs instead of IR when it takes an interrupt. Pushes the
+// address of the instruction in IR, then jumps to the vector of the highest priority
+// pending interrupt and fetches from there (5 M-cycles)
+ResultInstr build_interrupt_dispatch(void);
+
+#endif // !INTERRUPT_H
@@ -0,0 +1,110 @@
+#include "jp.h"
+#include "Emulator/cpu/cpu.h"
+#include "Emulator/cpu/instruction.h"
+#include <Emulator/mem.h>
+#include <types.h>
+#include <util.h>
+#include <string.h>
+
+//
+// jp_a16
+//
+
+// Operand read (low byte into Z on the first mcycle, high byte into W on the second)
+static void jp_read_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[PC].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void jp_read_t1(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    u8 data = mem_read8(mem, cpu, cpu->registers[PC].v);
+    set_data_bus_value(cpu, data);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_RD);
+  }
+}
+
+static void jp_read_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void jp_read_low_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[Z] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static void jp_read_high_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[W] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle jp_read_cycle_create(TCycle_fn last) {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = jp_read_t0;
+  m.tcycles[1] = jp_read_t1;
+  m.tcycles[2] = jp_read_t2;
+  m.tcycles[3] = last;
+
+  return m;
+}
+
+// Internal cycle: PC <- a16
+static void jp_set_pc_t(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING)
+    cpu->registers[PC].v = cpu->registers[WZ].v;
+}
+
+static MCycle jp_internal_cycle_create() {
+  MCycle m = mcycle_new(false, 4);
+
+  m.tcycles[0] = jp_set_pc_t;
+  m.tcycles[1] = idle_t;
+  m.tcycles[2] = idle_t;
+  m.tcycles[3] = idle_reset_bus_t;
+
+  return m;
+}
+
+ResultInstr build_jp_a16(u8 opcode) {
+  if (opcode != 0xC3) {
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for JP a16: 0x%02X", opcode);
+  }
+
+  MCycle cycles[4] = {
+    jp_read_cycle_create(jp_read_low_t3),
+    jp_read_cycle_create(jp_read_high_t3),
+    jp_internal_cycle_create(),
+    fetch_cycle_create(),
+  };
+
+  return instruction_create(opcode, "JP a16", cycles, 4);
+}
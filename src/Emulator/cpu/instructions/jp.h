@@ -0,0 +1,10 @@
+#ifndef JP_H
+#define JP_H
+
+#include <types.h>
+#include <Emulator/cpu/instruction.h>
+
+// JP a16
+ResultInstr build_jp_a16(u8 opcode);
+
+#endif // !JP_H
@@ -0,0 +1,132 @@
+#include "jr.h"
+#include "opcode_spec.h"
+#include "Emulator/cpu/cpu.h"
+#include "Emulator/cpu/instruction.h"
+#include <Emulator/mem.h>
+#include <types.h>
+#include <util.h>
+#include <string.h>
+
+// Offset read into Z
+static void jr_read_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[PC].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void jr_read_t1(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    u8 data = mem_read8(mem, cpu, cpu->registers[PC].v);
+    set_data_bus_value(cpu, data);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_RD);
+  }
+}
+
+static void jr_read_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void jr_read_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[Z] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+// Not taken: the internal cycle is dropped and the next one is the fetch at PC
+#define JR_CC_READ_T3(cc_idx, cc, flag, taken, ...) \
+  static void jr_read_##cc##_t3(Cpu* cpu, Mem* mem) { \
+    jr_read_t3(cpu, mem); \
+    if (cpu->clock_phase == CLOCK_RISING && cpu_get_flag(cpu, flag) != taken) { \
+      cpu->instr.mcycles[1]  = cpu->instr.mcycles[2]; \
+      cpu->instr.mcycle_count = 2; \
+    } \
+  }
+
+OPCODE_CC(JR_CC_READ_T3)
+
+#undef JR_CC_READ_T3
+
+static MCycle jr_read_cycle_create(TCycle_fn last) {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = jr_read_t0;
+  m.tcycles[1] = jr_read_t1;
+  m.tcycles[2] = jr_read_t2;
+  m.tcycles[3] = last;
+
+  return m;
+}
+
+// Internal cycle: WZ <- PC + e, PC <- WZ
+static void jr_add_t(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[WZ].v = (u16)(cpu->registers[PC].v + (int8_t)cpu->r8[Z]);
+    cpu->registers[PC].v = cpu->registers[WZ].v;
+  }
+}
+
+static MCycle jr_internal_cycle_create() {
+  MCycle m = mcycle_new(false, 4);
+
+  m.tcycles[0] = jr_add_t;
+  m.tcycles[1] = idle_t;
+  m.tcycles[2] = idle_t;
+  m.tcycles[3] = idle_reset_bus_t;
+
+  return m;
+}
+
+// Indexed by bits 3-4 of the opcode (JR cc, 0x20-0x38)
+#define JR_CC_ENTRY(cc_idx, cc, ...) [cc_idx] = { jr_read_##cc##_t3, "JR " #cc ", e8" },
+
+static const struct {
+  TCycle_fn read_t3;
+  const char* mnemonic;
+} jr_cc_ops[4] = {
+  OPCODE_CC(JR_CC_ENTRY)
+};
+
+#undef JR_CC_ENTRY
+
+ResultInstr build_jr(u8 opcode) {
+  TCycle_fn read_t3;
+  const char* mnemonic;
+
+  if (opcode == 0x18) {
+    read_t3  = jr_read_t3;
+    mnemonic = "JR e8";
+  } else if ((opcode & 0xE7) == 0x20) {
+    read_t3  = jr_cc_ops[(opcode >> 3) & 0x03].read_t3;
+    mnemonic = jr_cc_ops[(opcode >> 3) & 0x03].mnemonic;
+  } else {
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for JR: 0x%02X", opcode);
+  }
+
+  MCycle cycles[3] = {
+    jr_read_cycle_create(read_t3),
+    jr_internal_cycle_create(),
+    fetch_cycle_create(),
+  };
+
+  return instruction_create(opcode, mnemonic, cycles, 3);
+}
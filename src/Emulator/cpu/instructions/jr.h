@@ -0,0 +1,10 @@
+#ifndef JR_H
+#define JR_H
+
+#include <types.h>
+#include <Emulator/cpu/instruction.h>
+
+// JR e8, JR cc, e8
+ResultInstr build_jr(u8 opcode);
+
+#endif // !JR_H
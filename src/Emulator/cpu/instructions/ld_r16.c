@@ -1,4 +1,5 @@
 #include "ld_r16.h"
+#include "opcode_spec.h"
 #include "Emulator/cpu/cpu.h"
 #include "Emulator/cpu/instruction.h"
 #include <Emulator/mem.h>
@@ -46,7 +47,7 @@ static void ld_r16_readlow_t3(Cpu* cpu, Mem* mem) {
   (void)mem;
   if (cpu->clock_phase == CLOCK_RISING) {
     pin_set_high(&cpu->pin_MCS);
-    cpu->temp_l = cpu->data_value;
+    cpu->r8[Z] = cpu->data_value;
   } else if (cpu->clock_phase == CLOCK_HIGH) {
     set_bus_hiz(cpu);
   }
@@ -99,7 +100,7 @@ static void ld_r16_readhigh_t3(Cpu* cpu, Mem* mem) {
 
   if (cpu->clock_phase == CLOCK_RISING) {
     pin_set_high(&cpu->pin_MCS);
-    cpu->temp_h = cpu->data_value;
+    cpu->r8[W] = cpu->data_value;
   } else if (cpu->clock_phase == CLOCK_HIGH) {
     set_bus_hiz(cpu);
   }
@@ -116,19 +117,19 @@ static MCycle ld_r16_read_high_cycle_create() {
   return m;
 }
 
-// Load/store 
-static void ld_r16_store_t0(Cpu* cpu, Mem* mem) {
-  (void)mem;
+// Load/store, one t0 per register (see OPCODE_R16)
+#define LD_R16_STORE_T0(reg_idx, reg, ...) \
+  static void ld_r16_store_##reg##_t0(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      CPU_R16_##reg(cpu) = cpu->registers[WZ].v; \
+      set_addr_bus_value(cpu, CPU_R16_##reg(cpu)); \
+    } \
+  }
 
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u16* reg = cpu_get_reg16_opcode(cpu, cpu->IR);
+OPCODE_R16(LD_R16_STORE_T0)
 
-    if (reg) {
-      *reg = (u16)((cpu->temp_h << 8) | (cpu->temp_l));
-      set_addr_bus_value(cpu, *reg);
-    }
-  } 
-}
+#undef LD_R16_STORE_T0
 
 static void ld_r16_store_t1(Cpu* cpu, Mem* mem) {
   (void)mem;
@@ -164,10 +165,10 @@ static void ld_r16_store_t3(Cpu* cpu, Mem* mem) {
   }
 }
 
-static MCycle ld_r16_store_cycle_create() {
+static MCycle ld_r16_store_cycle_create(TCycle_fn store_t0) {
   MCycle m = mcycle_new(true, 4);
 
-  m.tcycles[0] = ld_r16_store_t0;
+  m.tcycles[0] = store_t0;
   m.tcycles[1] = ld_r16_store_t1;
   m.tcycles[2] = ld_r16_store_t2;
   m.tcycles[3] = ld_r16_store_t3;
@@ -175,29 +176,37 @@ static MCycle ld_r16_store_cycle_create() {
   return m;
 }
 
+// Indexed by bits 4-5 of the opcode
+#define LD_R16_IMM_ENTRY(reg_idx, reg, ...) \
+  [reg_idx] = { ld_r16_store_##reg##_t0, "LD " #reg ", d16" },
+
+static const struct {
+  TCycle_fn store_t0;
+  const char* mnemonic;
+} ld_r16_imm_ops[4] = {
+  OPCODE_R16(LD_R16_IMM_ENTRY)
+};
+
+#undef LD_R16_IMM_ENTRY
+
 ResultInstr build_ld_r16_imm(u8 opcode) {
+  if ((opcode & 0xCF) != 0x01)
+    return result_err_Instr(
+      EmuError_InstrInvalid,
+      "Invalid opcode for LD r16, d16: 0x%02X", opcode
+    );
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
   instr.opcode         = opcode;
   instr.current_mcycle = 0;
   instr.current_tcycle = 0;
   instr.mcycle_count   = 3;
-
-  switch (opcode) {
-    case 0x01: instr.mnemonic = "LD BC, d16"; break;
-    case 0x11: instr.mnemonic = "LD DE, d16"; break;
-    case 0x21: instr.mnemonic = "LD HL, d16"; break;
-    case 0x31: instr.mnemonic = "LD SP, d16"; break;
-    default:
-      return result_err_Instr(
-        EmuError_InstrInvalid,
-        "Invalid opcode for LD r16, d16: 0x%02X", opcode
-      );
-  }
+  instr.mnemonic       = ld_r16_imm_ops[(opcode >> 4) & 0x03].mnemonic;
 
   instr.mcycles[0] = ld_r16_read_low_cycle_create();
   instr.mcycles[1] = ld_r16_read_high_cycle_create();
-  instr.mcycles[2] = ld_r16_store_cycle_create();
+  instr.mcycles[2] = ld_r16_store_cycle_create(ld_r16_imm_ops[(opcode >> 4) & 0x03].store_t0);
 
   return result_ok_Instr(instr);
 }
@@ -218,17 +227,6 @@ static void ld_r16mem_a_t0(Cpu* cpu, Mem* mem) {
   }
 }
 
-static void ld_r16mem_a_t1(Cpu* cpu, Mem* mem) {
-  (void)mem;
-
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u16* reg_ptr = cpu_get_reg16mem_opcode(cpu, cpu->IR);
-    set_addr_bus_value(cpu, *reg_ptr);
-  } else if (cpu->clock_phase == CLOCK_HIGH) {
-    pin_set_low(&cpu->pin_WR);
-  }
-}
-
 static void ld_r16mem_a_t2(Cpu* cpu, Mem* mem) {
   if (cpu->clock_phase == CLOCK_RISING) {
     mem_write8(mem, cpu, cpu->addr_value, cpu->data_value);
@@ -237,56 +235,71 @@ static void ld_r16mem_a_t2(Cpu* cpu, Mem* mem) {
   }
 }
 
-static void ld_r16mem_a_t3(Cpu* cpu, Mem* mem) {
-  (void)mem;
-
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u8 op_type = (cpu->IR >> 4) & 0x02;
-    bool inc_dec = (op_type & 0x02) != 0;
-
-    if (inc_dec) {
-      if ((op_type & 0x01) == 0)
-        cpu->registers[HL].v++;
-      else 
-        cpu->registers[HL].v--;
-    }
-  } else if (cpu->clock_phase == CLOCK_HIGH) {
-    set_bus_hiz(cpu);
+// Address and HL step, one t1/t3 per pointer (see OPCODE_R16MEM)
+#define LD_R16MEM_A_T(mem_idx, name, reg, step, mnemonic, ...) \
+  static void ld_r16mem_a_##name##_t1(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      set_addr_bus_value(cpu, CPU_R16_##reg(cpu)); \
+    } else if (cpu->clock_phase == CLOCK_HIGH) { \
+      pin_set_low(&cpu->pin_WR); \
+    } \
+  } \
+  static void ld_r16mem_a_##name##_t3(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      CPU_R16_HL(cpu) += (step); \
+    } else if (cpu->clock_phase == CLOCK_HIGH) { \
+      set_bus_hiz(cpu); \
+    } \
   }
-}
 
-static MCycle ld_r16mem_a_cycle_create() {
-  MCycle m = mcycle_new(4, true);
+OPCODE_R16MEM(LD_R16MEM_A_T)
+
+#undef LD_R16MEM_A_T
+
+static MCycle ld_r16mem_a_cycle_create(TCycle_fn addr_t1, TCycle_fn step_t3) {
+  MCycle m = mcycle_new(true, 4);
 
   m.tcycles[0] = ld_r16mem_a_t0;
-  m.tcycles[1] = ld_r16mem_a_t1;
+  m.tcycles[1] = addr_t1;
   m.tcycles[2] = ld_r16mem_a_t2;
-  m.tcycles[3] = ld_r16mem_a_t3;
+  m.tcycles[3] = step_t3;
 
   return m;
 }
 
+// Indexed by bits 4-5 of the opcode
+#define LD_R16MEM_A_ENTRY(mem_idx, name, reg, step, mnemonic, ...) \
+  [mem_idx] = { ld_r16mem_a_##name##_t1, ld_r16mem_a_##name##_t3, "LD (" mnemonic "), A" },
+
+static const struct {
+  TCycle_fn addr_t1;
+  TCycle_fn step_t3;
+  const char* mnemonic;
+} ld_r16mem_a_ops[4] = {
+  OPCODE_R16MEM(LD_R16MEM_A_ENTRY)
+};
+
+#undef LD_R16MEM_A_ENTRY
+
 ResultInstr build_ld_r16mem_a(u8 opcode) {
+  if ((opcode & 0xCF) != 0x02)
+    return result_err_Instr(
+      EmuError_InstrInvalid,
+      "Invalid opcode for LD (r16), A: 0x%02X", opcode
+    );
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
   instr.opcode         = opcode;
   instr.current_mcycle = 0;
   instr.current_tcycle = 0;
   instr.mcycle_count   = 2;
+  instr.mnemonic       = ld_r16mem_a_ops[(opcode >> 4) & 0x03].mnemonic;
 
-  switch (opcode) {
-    case 0x02: instr.mnemonic = "LD (BC), A"; break;
-    case 0x12: instr.mnemonic = "LD (DE), A"; break;
-    case 0x22: instr.mnemonic = "LD (HL+), A"; break;
-    case 0x32: instr.mnemonic = "LD (HL-), A"; break;
-    default:
-      return result_err_Instr(
-        EmuError_InstrInvalid,
-        "Invalid opcode for LD r16, d16: 0x%02X", opcode
-      );
-  }
-
-  instr.mcycles[0] = ld_r16mem_a_cycle_create();
+  instr.mcycles[0] = ld_r16mem_a_cycle_create(ld_r16mem_a_ops[(opcode >> 4) & 0x03].addr_t1,
+                                              ld_r16mem_a_ops[(opcode >> 4) & 0x03].step_t3);
   instr.mcycles[1] = fetch_cycle_create();
 
   return result_ok_Instr(instr);
@@ -1,4 +1,5 @@
 #include "ld_r8.h"
+#include "opcode_spec.h"
 #include <Emulator/mem.h>
 #include <types.h>
 #include <util.h>
@@ -51,15 +52,17 @@ static MCycle ld_r8_read_imm_cycle_create() {
   return m;
 }
 
-static void ld_r8_store_t0(Cpu* cpu, Mem* mem) {
-  (void)mem;
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u8 reg_idx = (cpu->IR >> 3) & 0x07;
-    u8* reg_ptr = cpu_get_reg8_opcode(cpu, reg_idx);
-
-    if (reg_ptr) *reg_ptr = cpu->data_value;
+// One store per destination register (see OPCODE_R8)
+#define LD_R8_STORE_T0(reg_idx, reg, ...) \
+  static void ld_r8_store_##reg##_t0(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) \
+      CPU_R8_##reg(cpu) = cpu->data_value; \
   }
-}
+
+OPCODE_R8(LD_R8_STORE_T0)
+
+#undef LD_R8_STORE_T0
 
 static void ld_r8_fetch_t1(Cpu* cpu, Mem* mem) { fetch_t0(cpu, mem); }
 static void ld_r8_fetch_t2(Cpu* cpu, Mem* mem) { fetch_t1(cpu, mem); }
@@ -75,30 +78,33 @@ static void ld_r8_fetch_t3(Cpu* cpu, Mem* mem) {
   }
 }
 
-static MCycle ld_r8_fetch_next_cycle_create() {
+static MCycle ld_r8_fetch_next_cycle_create(TCycle_fn store_t0) {
   MCycle m = mcycle_new(true, 4);
-  m.tcycles[0] = ld_r8_store_t0; 
+  m.tcycles[0] = store_t0;
   m.tcycles[1] = ld_r8_fetch_t1; 
   m.tcycles[2] = ld_r8_fetch_t2; 
   m.tcycles[3] = ld_r8_fetch_t3; 
   return m;
 }
 
-static const char* ld_r8_imm_mnemonic(u8 opcode) {
-  static const char* reg_names[8] = {
-    "B","C","D","E","H","L","[HL]","A"
-  };
-  static char buffer[16];
-
-  u8 dst_idx = (opcode >> 3) & 0x07;
+// Indexed by bits 3-5 of the opcode, NULL for LD [HL], d8
+#define LD_R8_IMM_ENTRY(reg_idx, reg, ...) \
+  [reg_idx] = { ld_r8_store_##reg##_t0, "LD " #reg ", d8" },
 
-  snprintf(buffer, sizeof(buffer), "LD %s, d8",
-           reg_names[dst_idx]);
+static const struct {
+  TCycle_fn store_t0;
+  const char* mnemonic;
+} ld_r8_imm_ops[8] = {
+  OPCODE_R8(LD_R8_IMM_ENTRY)
+};
 
-  return buffer;
-}
+#undef LD_R8_IMM_ENTRY
 
 ResultInstr build_ld_r8_imm(u8 opcode) {
+  TCycle_fn store_t0 = ld_r8_imm_ops[(opcode >> 3) & 0x07].store_t0;
+  if (!store_t0)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_ld_r8_imm: %02X", opcode);
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
   instr.opcode       = opcode;
@@ -106,38 +112,37 @@ ResultInstr build_ld_r8_imm(u8 opcode) {
   instr.current_tcycle = 0;
   instr.mcycle_count   = 2;
 
-  instr.mnemonic = ld_r8_imm_mnemonic(opcode);
+  instr.mnemonic = ld_r8_imm_ops[(opcode >> 3) & 0x07].mnemonic;
 
   instr.mcycles[0] = ld_r8_read_imm_cycle_create();
-  instr.mcycles[1] = ld_r8_fetch_next_cycle_create();
+  instr.mcycles[1] = ld_r8_fetch_next_cycle_create(store_t0);
 
   return result_ok_Instr(instr);
 }
 
 
-// LD r8, r8
-static void ld_r8_r8_t0(Cpu* cpu, Mem* mem) {
-  (void)mem;
+// LD r8, r8, one t0 per destination x source (see OPCODE_R8)
+#define LD_R8_R8_T0(src_idx, src, dst) \
+  static void ld_r8_r8_##dst##_##src##_t0(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) \
+      CPU_R8_##dst(cpu) = CPU_R8_##src(cpu); \
+  }
+#define LD_R8_R8_ROW(dst_idx, dst, ...) OPCODE_R8(LD_R8_R8_T0, dst)
 
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u8 dst_idx = (cpu->IR >> 3) & 0x07;
-    u8 src_idx = (cpu->IR) & 0x07;
+OPCODE_R8_DST(LD_R8_R8_ROW)
 
-    u8* dst_reg = cpu_get_reg8_opcode(cpu, dst_idx);
-    u8* src_reg = cpu_get_reg8_opcode(cpu, src_idx);
-
-    if (dst_reg && src_reg) *dst_reg = *src_reg;
-  }
-}
+#undef LD_R8_R8_ROW
+#undef LD_R8_R8_T0
 
 static void ld_r8_r8_fetch_t1(Cpu* cpu, Mem* mem) { ld_r8_fetch_t1(cpu, mem); }
 static void ld_r8_r8_fetch_t2(Cpu* cpu, Mem* mem) { ld_r8_fetch_t2(cpu, mem); }
 static void ld_r8_r8_fetch_t3(Cpu* cpu, Mem* mem) { ld_r8_fetch_t3(cpu, mem); }
 
-static MCycle ld_r8_r8_cycle_create() {
+static MCycle ld_r8_r8_cycle_create(TCycle_fn op_t0) {
   MCycle m = mcycle_new(true, 4);
 
-  m.tcycles[0] = ld_r8_r8_t0;
+  m.tcycles[0] = op_t0;
   m.tcycles[1] = ld_r8_r8_fetch_t1;
   m.tcycles[2] = ld_r8_r8_fetch_t2;
   m.tcycles[3] = ld_r8_r8_fetch_t3;
@@ -145,24 +150,26 @@ static MCycle ld_r8_r8_cycle_create() {
   return m;
 }
 
-// TODO Would have been a giant switch case, might do something similar for all instrs
-static const char* ld_r8_r8_mnemonic(u8 opcode) {
-  static const char* reg_names[8] = {
-    "B","C","D","E","H","L","[HL]","A"
-  };
-  static char buffer[16];
-
-  u8 dst_idx = (opcode >> 3) & 0x07;
-  u8 src_idx = opcode & 0x07;
+// Indexed by the low 6 bits of the opcode, NULL when either operand is [HL]
+#define LD_R8_R8_ENTRY(src_idx, src, dst_idx, dst) \
+  [(dst_idx << 3) | src_idx] = { ld_r8_r8_##dst##_##src##_t0, "LD " #dst ", " #src },
+#define LD_R8_R8_ROW(dst_idx, dst, ...) OPCODE_R8(LD_R8_R8_ENTRY, dst_idx, dst)
 
-  snprintf(buffer, sizeof(buffer), "LD %s, %s",
-           reg_names[dst_idx],
-           reg_names[src_idx]);
+static const struct {
+  TCycle_fn op_t0;
+  const char* mnemonic;
+} ld_r8_r8_ops[64] = {
+  OPCODE_R8_DST(LD_R8_R8_ROW)
+};
 
-  return buffer;
-}
+#undef LD_R8_R8_ROW
+#undef LD_R8_R8_ENTRY
 
 ResultInstr build_ld_r8_r8(u8 opcode) {
+  TCycle_fn op_t0 = ld_r8_r8_ops[opcode & 0x3F].op_t0;
+  if (!op_t0)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_ld_r8_r8: %02X", opcode);
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
 
@@ -171,9 +178,9 @@ ResultInstr build_ld_r8_r8(u8 opcode) {
   instr.current_mcycle = 0;
   instr.current_tcycle = 0;
 
-  instr.mnemonic = ld_r8_r8_mnemonic(opcode);
+  instr.mnemonic = ld_r8_r8_ops[opcode & 0x3F].mnemonic;
 
-  instr.mcycles[0] = ld_r8_r8_cycle_create();
+  instr.mcycles[0] = ld_r8_r8_cycle_create(op_t0);
 
   return result_ok_Instr(instr);
 }
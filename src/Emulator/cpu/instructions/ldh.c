@@ -0,0 +1,157 @@
+#include "ldh.h"
+#include "Emulator/cpu/cpu.h"
+#include "Emulator/cpu/instruction.h"
+#include <Emulator/mem.h>
+#include <types.h>
+#include <util.h>
+#include <string.h>
+
+// M1: a8 read into Z, W is 0xFF
+static void ldh_read_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[PC].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void ldh_read_t1(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    u8 data = mem_read8(mem, cpu, cpu->registers[PC].v);
+    set_data_bus_value(cpu, data);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_RD);
+  }
+}
+
+static void ldh_read_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void ldh_read_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[Z] = cpu->data_value;
+    cpu->r8[W] = 0xFF;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle ldh_read_cycle_create() {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = ldh_read_t0;
+  m.tcycles[1] = ldh_read_t1;
+  m.tcycles[2] = ldh_read_t2;
+  m.tcycles[3] = ldh_read_t3;
+
+  return m;
+}
+
+// M2: access at WZ
+static void ldh_access_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[WZ].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+// LDH A, [a8]
+static void ldh_load_t1(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    u8 data = mem_read8(mem, cpu, cpu->registers[WZ].v);
+    set_data_bus_value(cpu, data);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_RD);
+  }
+}
+
+static void ldh_load_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_HIGH)
+    pin_set_high(&cpu->pin_RD);
+}
+
+static void ldh_load_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[A] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+// LDH [a8], A
+static void ldh_store_t1(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_data_bus_value(cpu, cpu->r8[A]);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_WR);
+  }
+}
+
+static void ldh_store_t2(Cpu* cpu, Mem* mem) {
+  if (cpu->clock_phase == CLOCK_RISING) {
+    mem_write8(mem, cpu, cpu->addr_value, cpu->data_value);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void ldh_store_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle ldh_access_cycle_create(bool load) {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = ldh_access_t0;
+  m.tcycles[1] = load ? ldh_load_t1 : ldh_store_t1;
+  m.tcycles[2] = load ? ldh_load_t2 : ldh_store_t2;
+  m.tcycles[3] = load ? ldh_load_t3 : ldh_store_t3;
+
+  return m;
+}
+
+ResultInstr build_ldh(u8 opcode) {
+  if (opcode != 0xE0 && opcode != 0xF0)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid opcode for LDH: 0x%02X", opcode);
+
+  bool load = opcode == 0xF0;
+  MCycle cycles[3] = {
+    ldh_read_cycle_create(),
+    ldh_access_cycle_create(load),
+    fetch_cycle_create(),
+  };
+
+  return instruction_create(opcode, load ? "LDH A, [a8]" : "LDH [a8], A", cycles, 3);
+}
@@ -0,0 +1,10 @@
+#ifndef LDH_H
+#define LDH_H
+
+#include <types.h>
+#include <Emulator/cpu/instruction.h>
+
+// LDH [a8], A and LDH A, [a8] (address 0xFF00 + a8)
+ResultInstr build_ldh(u8 opcode);
+
+#endif // !LDH_H
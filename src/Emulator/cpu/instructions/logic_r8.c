@@ -1,4 +1,6 @@
 #include "logic_r8.h"
+#include "alu.h"
+#include "opcode_spec.h"
 #include "Emulator/cpu/cpu.h"
 #include <Emulator/mem.h>
 #include <types.h>
@@ -6,59 +8,24 @@
 #include <llog.h>
 #include <string.h>
 
-// Op + fetch
-static void logic_r8_op_t0(Cpu* cpu, Mem* mem) {
-  (void)mem;
-
-  if (cpu->clock_phase == CLOCK_RISING) {
-    u8* reg_ptr = cpu_get_reg8_opcode(cpu, cpu->IR);
-    u8* a_ptr = cpu_get_reg8(cpu, A);
-    u8 old_a = *a_ptr;
-    u8 reg_val = reg_ptr ? *reg_ptr : 0;
-    u8 result = 0;
-
-    u8 op_type = (cpu->IR >> 3) & 0x07;
-    u8 carry = cpu_get_flag(cpu, FC) ? 1 : 0;
-    bool is_arithmetic = op_type < 4;
-    bool is_subtract = op_type == 2 || op_type == 3;
-
-    switch (op_type) {
-      case 0: result = old_a + reg_val; break;
-      case 1: result = old_a + reg_val + carry; break;
-      case 2: result = old_a - reg_val; break;
-      case 3: result = old_a - reg_val - carry; break;
-      case 4: result = old_a & reg_val; break;
-      case 5: result = old_a ^ reg_val; break;
-      case 6: result = old_a | reg_val; break;
-      case 7: result = old_a - reg_val; break;
-    }
-
-    cpu_set_flag(cpu, FZ, result == 0);
-    cpu_set_flag(cpu, FN, is_subtract);
-
-    if (is_arithmetic) {
-      if (is_subtract) {
-        u8 op = reg_val + (op_type == 3 ? carry : 0);
-        cpu_set_flag(cpu, FH, (old_a & 0x0F) < (op & 0x0F));
-        cpu_set_flag(cpu, FC, (u16)old_a < (u16)op);
-      } else {
-        u8 op = reg_val + (op_type == 1 ? carry : 0);
-        cpu_set_flag(cpu, FH, (old_a & 0x0F) + (op & 0x0F) > 0x0F);
-        cpu_set_flag(cpu, FC, (u16)old_a + (u16)op > 0xFF);
-      }
-    } else {
-        cpu_set_flag(cpu, FH, op_type == 4);
-        cpu_set_flag(cpu, FC, false);
-    }
-
-    if (op_type != 7)
-      *a_ptr = result;
-  } else if (cpu->clock_phase == CLOCK_HIGH) {
-    pin_set_low(&cpu->pin_MCS);
-    pin_set_high(&cpu->pin_RD);
-    pin_set_high(&cpu->pin_WR);
+// Op + fetch, one t0 per opcode (see OPCODE_ALU x OPCODE_R8)
+#define LOGIC_R8_OP_T0(reg_idx, reg, op) \
+  static void logic_r8_##op##_##reg##_t0(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      alu_##op(cpu, CPU_R8_##reg(cpu)); \
+    } else if (cpu->clock_phase == CLOCK_HIGH) { \
+      pin_set_low(&cpu->pin_MCS); \
+      pin_set_high(&cpu->pin_RD); \
+      pin_set_high(&cpu->pin_WR); \
+    } \
   }
-}
+#define LOGIC_R8_OP_ROW(op_idx, op, mnemonic, ...) OPCODE_R8(LOGIC_R8_OP_T0, op)
+
+OPCODE_ALU(LOGIC_R8_OP_ROW)
+
+#undef LOGIC_R8_OP_ROW
+#undef LOGIC_R8_OP_T0
 
 static void logic_r8_op_t1(Cpu* cpu, Mem* mem) {
   if (cpu->clock_phase == CLOCK_RISING) {
@@ -90,10 +57,10 @@ static void logic_r8_op_t3(Cpu* cpu, Mem* mem) {
   }
 }
 
-static MCycle logic_r8_cycle_create() {
+static MCycle logic_r8_cycle_create(TCycle_fn op_t0) {
   MCycle m = mcycle_new(true, 4);
 
-  m.tcycles[0] = logic_r8_op_t0;
+  m.tcycles[0] = op_t0;
   m.tcycles[1] = logic_r8_op_t1;
   m.tcycles[2] = logic_r8_op_t2;
   m.tcycles[3] = logic_r8_op_t3;
@@ -101,35 +68,123 @@ static MCycle logic_r8_cycle_create() {
   return m;
 }
 
-static const char* logic_r8_mnemonic(u8 opcode) {
-  u8 op_type = (opcode >> 3) & 0x07;
-  u8 reg_idx = opcode & 0x07;
-
-  static const char* op_names[] = {
-    "ADD A,", "ADC A,", "SUB A,", "SBC A,",
-    "AND A,", "XOR A,", "OR A,", "CP A,"
-  };
-
-  static const char* reg_names[] = {
-    "B", "C", "D", "E", "H", "L", "(HL)", "A"
-  };
-
-  static char mnemonic[16];
+// Indexed by the low 6 bits of the opcode, NULL for the [HL] operand
+#define LOGIC_R8_ENTRY(reg_idx, reg, op_idx, op, mnemonic) \
+  [(op_idx << 3) | reg_idx] = { logic_r8_##op##_##reg##_t0, mnemonic #reg },
+#define LOGIC_R8_ROW(op_idx, op, mnemonic, ...) \
+  OPCODE_R8(LOGIC_R8_ENTRY, op_idx, op, mnemonic)
 
-  snprintf(mnemonic, sizeof(mnemonic), "%s%s", 
-           op_names[op_type], reg_names[reg_idx]);
+static const struct {
+  TCycle_fn op_t0;
+  const char* mnemonic;
+} logic_r8_ops[64] = {
+  OPCODE_ALU(LOGIC_R8_ROW)
+};
 
-  return mnemonic;
-}
+#undef LOGIC_R8_ROW
+#undef LOGIC_R8_ENTRY
 
 ResultInstr build_logic_r8(u8 opcode) {
+  TCycle_fn op_t0 = logic_r8_ops[opcode & 0x3F].op_t0;
+  if (!op_t0)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_logic_r8: %02X", opcode);
+
   Instruction instr;
   memset(&instr, 0, sizeof(instr));
   instr.opcode = opcode;
   instr.mcycle_count = 1;
-  instr.mnemonic = logic_r8_mnemonic(opcode);
+  instr.mnemonic = logic_r8_ops[opcode & 0x3F].mnemonic;
 
-  instr.mcycles[0] = logic_r8_cycle_create();
+  instr.mcycles[0] = logic_r8_cycle_create(op_t0);
 
   return result_ok_Instr(instr);
 }
+
+// ALU A, d8: the operand is read into Z, then the op runs with the next fetch
+static void logic_imm_read_t0(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    set_addr_bus_value(cpu, cpu->registers[PC].v);
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_low(&cpu->pin_MCS);
+    pin_set_high(&cpu->pin_RD);
+    pin_set_high(&cpu->pin_WR);
+  }
+}
+
+static void logic_imm_read_t1(Cpu* cpu, Mem* mem) { logic_r8_op_t1(cpu, mem); }
+
+static void logic_imm_read_t2(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    cpu->registers[PC].v++;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    pin_set_high(&cpu->pin_RD);
+  }
+}
+
+static void logic_imm_read_t3(Cpu* cpu, Mem* mem) {
+  (void)mem;
+
+  if (cpu->clock_phase == CLOCK_RISING) {
+    pin_set_high(&cpu->pin_MCS);
+    cpu->r8[Z] = cpu->data_value;
+  } else if (cpu->clock_phase == CLOCK_HIGH) {
+    set_bus_hiz(cpu);
+  }
+}
+
+static MCycle logic_imm_read_cycle_create() {
+  MCycle m = mcycle_new(true, 4);
+
+  m.tcycles[0] = logic_imm_read_t0;
+  m.tcycles[1] = logic_imm_read_t1;
+  m.tcycles[2] = logic_imm_read_t2;
+  m.tcycles[3] = logic_imm_read_t3;
+
+  return m;
+}
+
+// Op on Z + fetch, one t0 per OPCODE_ALU entry
+#define LOGIC_IMM_OP_T0(op_idx, op, ...) \
+  static void logic_imm_##op##_t0(Cpu* cpu, Mem* mem) { \
+    (void)mem; \
+    if (cpu->clock_phase == CLOCK_RISING) { \
+      alu_##op(cpu, cpu->r8[Z]); \
+    } else if (cpu->clock_phase == CLOCK_HIGH) { \
+      pin_set_low(&cpu->pin_MCS); \
+      pin_set_high(&cpu->pin_RD); \
+      pin_set_high(&cpu->pin_WR); \
+    } \
+  }
+
+OPCODE_ALU(LOGIC_IMM_OP_T0)
+
+#undef LOGIC_IMM_OP_T0
+
+// Indexed by bits 3-5 of the opcode (0xC6-0xFE)
+#define LOGIC_IMM_ENTRY(op_idx, op, mnemonic, ...) \
+  [op_idx] = { logic_imm_##op##_t0, mnemonic "d8" },
+
+static const struct {
+  TCycle_fn op_t0;
+  const char* mnemonic;
+} logic_imm_ops[8] = {
+  OPCODE_ALU(LOGIC_IMM_ENTRY)
+};
+
+#undef LOGIC_IMM_ENTRY
+
+ResultInstr build_logic_imm(u8 opcode) {
+  if ((opcode & 0xC7) != 0xC6)
+    return result_err_Instr(EmuError_InstrInvalid, "invalid instruction build_logic_imm: %02X", opcode);
+
+  MCycle cycles[2] = {
+    logic_imm_read_cycle_create(),
+    logic_r8_cycle_create(logic_imm_ops[(opcode >> 3) & 0x07].op_t0),
+  };
+
+  return instruction_create(opcode, logic_imm_ops[(opcode >> 3) & 0x07].mnemonic, cycles, 2);
+}
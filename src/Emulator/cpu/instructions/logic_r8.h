@@ -4,6 +4,10 @@
 #include <types.h>
 #include <Emulator/cpu/instruction.h>
 
+// ALU A, r8 (0x80-0xBF)
 ResultInstr build_logic_r8(u8 opcode);
 
+// ALU A, d8 (0xC6, 0xCE, ... 0xFE)
+ResultInstr build_logic_imm(u8 opcode);
+
 #endif // !LOGIC_R8_H
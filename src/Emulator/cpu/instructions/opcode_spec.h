@@ -0,0 +1,78 @@
+#ifndef OPCODE_SPEC_H
+#define OPCODE_SPEC_H
+
+#include <Emulator/cpu/cpu.h>
+
+// Opcode operand and operation tables. Each list calls X once per entry with the opcode
+// field value first, so an instruction file expands it into one handler per opcode (the
+// operand register and the operation are then constants in every handler) and into the
+// handler/mnemonic tables indexed by the same opcode bits.
+//
+// Extra arguments are passed through to X, which is how two lists are nested (e.g. ALU
+// operation x register): the outer X expands the inner list with its own fields as extra
+// arguments. A list can't be nested in itself, hence the OPCODE_R8_DST copy.
+
+// Register operands, as lvalues
+#define CPU_R8_A(cpu) ((cpu)->r8[A])
+#define CPU_R8_B(cpu) ((cpu)->r8[B])
+#define CPU_R8_C(cpu) ((cpu)->r8[C])
+#define CPU_R8_D(cpu) ((cpu)->r8[D])
+#define CPU_R8_E(cpu) ((cpu)->r8[E])
+#define CPU_R8_H(cpu) ((cpu)->r8[H])
+#define CPU_R8_L(cpu) ((cpu)->r8[L])
+
+#define CPU_R16_BC(cpu) ((cpu)->registers[BC].v)
+#define CPU_R16_DE(cpu) ((cpu)->registers[DE].v)
+#define CPU_R16_HL(cpu) ((cpu)->registers[HL].v)
+#define CPU_R16_SP(cpu) ((cpu)->registers[SP].v)
+
+// r8 field (bits 0-2 or 3-5): X(index, reg, ...). Index 6 is [HL], which needs extra
+// memory cycles and has no entry here
+#define OPCODE_R8(X, ...) \
+  X(0, B, __VA_ARGS__) X(1, C, __VA_ARGS__) X(2, D, __VA_ARGS__) X(3, E, __VA_ARGS__) \
+  X(4, H, __VA_ARGS__) X(5, L, __VA_ARGS__) X(7, A, __VA_ARGS__)
+
+#define OPCODE_R8_DST(X, ...) \
+  X(0, B, __VA_ARGS__) X(1, C, __VA_ARGS__) X(2, D, __VA_ARGS__) X(3, E, __VA_ARGS__) \
+  X(4, H, __VA_ARGS__) X(5, L, __VA_ARGS__) X(7, A, __VA_ARGS__)
+
+// r16 field (bits 4-5): X(index, reg, ...)
+#define OPCODE_R16(X, ...) \
+  X(0, BC, __VA_ARGS__) X(1, DE, __VA_ARGS__) X(2, HL, __VA_ARGS__) X(3, SP, __VA_ARGS__)
+
+// r16mem field (bits 4-5): X(index, name, pointer reg, HL step, mnemonic, ...)
+#define OPCODE_R16MEM(X, ...) \
+  X(0, BC,  BC, 0,  "BC",  __VA_ARGS__) \
+  X(1, DE,  DE, 0,  "DE",  __VA_ARGS__) \
+  X(2, HLI, HL, 1,  "HL+", __VA_ARGS__) \
+  X(3, HLD, HL, -1, "HL-", __VA_ARGS__)
+
+// ALU operation on A (bits 3-5 of 0x80-0xBF): X(index, op, mnemonic, ...)
+#define OPCODE_ALU(X, ...) \
+  X(0, add, "ADD A,", __VA_ARGS__) X(1, adc, "ADC A,", __VA_ARGS__) \
+  X(2, sub, "SUB A,", __VA_ARGS__) X(3, sbc, "SBC A,", __VA_ARGS__) \
+  X(4, and, "AND A,", __VA_ARGS__) X(5, xor, "XOR A,", __VA_ARGS__) \
+  X(6, or,  "OR A,",  __VA_ARGS__) X(7, cp,  "CP A,",  __VA_ARGS__)
+
+// CB rotates and shifts (bits 3-5 of CB 0x00-0x3F): X(index, op, mnemonic, ...)
+#define OPCODE_CB_ROT(X, ...) \
+  X(0, rlc,  "RLC",  __VA_ARGS__) X(1, rrc, "RRC", __VA_ARGS__) \
+  X(2, rl,   "RL",   __VA_ARGS__) X(3, rr,  "RR",  __VA_ARGS__) \
+  X(4, sla,  "SLA",  __VA_ARGS__) X(5, sra, "SRA", __VA_ARGS__) \
+  X(6, swap, "SWAP", __VA_ARGS__) X(7, srl, "SRL", __VA_ARGS__)
+
+// CB bit operations (bits 6-7 of CB 0x40-0xFF): X(index, op, mnemonic, ...)
+#define OPCODE_CB_BITOP(X, ...) \
+  X(1, bit, "BIT", __VA_ARGS__) X(2, res, "RES", __VA_ARGS__) X(3, set, "SET", __VA_ARGS__)
+
+// Branch condition (bits 3-4 of JR/JP/CALL/RET cc): X(index, cc, flag, taken when, ...)
+#define OPCODE_CC(X, ...) \
+  X(0, NZ, FZ, false, __VA_ARGS__) X(1, Z, FZ, true, __VA_ARGS__) \
+  X(2, NC, FC, false, __VA_ARGS__) X(3, C,  FC, true, __VA_ARGS__)
+
+// Bit number (bits 3-5): X(bit, ...)
+#define OPCODE_BIT(X, ...) \
+  X(0, __VA_ARGS__) X(1, __VA_ARGS__) X(2, __VA_ARGS__) X(3, __VA_ARGS__) \
+  X(4, __VA_ARGS__) X(5, __VA_ARGS__) X(6, __VA_ARGS__) X(7, __VA_ARGS__)
+
+#endif // !OPCODE_SPEC_H
@@ -0,0 +1,40 @@
+#include "joypad.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <string.h>
+
+Result joypad_init(Joypad* joypad) {
+  if (!joypad) {
+    return result_error(Error_NullPointer, "invalid joypad to joypad_init");
+  }
+  memset(joypad, 0, sizeof(*joypad));
+
+  joypad->select  = 0x00;
+  joypad->buttons = 0x00;
+
+  EMU_LOG_TRACE(EMU_LOG_JOYPAD, "joypad initialized successfully");
+  return result_ok();
+}
+
+u8 joypad_read(const Joypad* joypad) {
+  u8 lines = 0x0F;
+
+  if (!(joypad->select & 0x10))
+    lines &= ~(joypad->buttons & 0x0F);
+  if (!(joypad->select & 0x20))
+    lines &= ~(joypad->buttons >> 4);
+
+  return 0xC0 | joypad->select | lines;
+}
+
+void joypad_write(Joypad* joypad, u8 val) {
+  joypad->select = val & 0x30;
+}
+
+bool joypad_set_buttons(Joypad* joypad, u8 buttons) {
+  u8 before = joypad_read(joypad) & 0x0F;
+  joypad->buttons = buttons;
+  u8 after = joypad_read(joypad) & 0x0F;
+
+  return (before & ~after) != 0;
+}
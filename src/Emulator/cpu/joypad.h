@@ -0,0 +1,38 @@
+#ifndef JOYPAD_H
+#define JOYPAD_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+
+// Button bits as stored in movies and Joypad.buttons (1 = pressed)
+typedef enum {
+  JOYPAD_RIGHT  = 1 << 0,
+  JOYPAD_LEFT   = 1 << 1,
+  JOYPAD_UP     = 1 << 2,
+  JOYPAD_DOWN   = 1 << 3,
+  JOYPAD_A      = 1 << 4,
+  JOYPAD_B      = 1 << 5,
+  JOYPAD_SELECT = 1 << 6,
+  JOYPAD_START  = 1 << 7,
+} EJoypadButton;
+
+typedef struct {
+  u8 select;  // P14/P15 select lines, as written to 0xFF00 (bits 4-5, 0 = selected)
+  u8 buttons; // EJoypadButton bits
+} Joypad;
+
+// To be called internally by cpu. Inititalizes the joypad to no buttons pressed
+Result joypad_init(Joypad* joypad);
+
+// Value of the P1 register (0xFF00)
+u8 joypad_read(const Joypad* joypad);
+
+// Write to the P1 register (only the select lines are writable)
+void joypad_write(Joypad* joypad, u8 val);
+
+// Updates the pressed buttons. Returns true when a selected input line went from high
+// to low, which requests the joypad interrupt
+bool joypad_set_buttons(Joypad* joypad, u8 buttons);
+
+#endif // !JOYPAD_H
@@ -1,6 +1,6 @@
 #include "ppu.h"
 #include <util.h>
-#include <llog.h>
+#include <Emulator/emu_log.h>
 #include <string.h>
 
 static void init_pin(Pin *pin, const char *name, EPinType type, EPinState default_state) {
@@ -36,16 +36,254 @@ Result ppu_init(Ppu *ppu) {
   ppu->wy   = 0x00;
   ppu->wx   = 0x00;
 
-  LOG_TRACE("ppu initialized successfully");
+  EMU_LOG_TRACE(EMU_LOG_PPU, "ppu initialized successfully");
   return result_ok();
 }
 
-Result ppu_step(Ppu* ppu) {
-  if (!ppu) {
-    return result_error(Error_NullPointer, "bad ppu to ppu_init");
+static EPpuMode ppu_mode(const Ppu* ppu) {
+  return (EPpuMode)(ppu->stat & 0x03);
+}
+
+static void set_mode(Ppu* ppu, EPpuMode mode) {
+  ppu->stat = (u8)((ppu->stat & ~0x03) | mode);
+}
+
+// Updates the LYC flag and the STAT interrupt line, requesting LCD STAT on a rising edge
+static void update_stat(Ppu* ppu, u8* interrupt_flag) {
+  if (ppu->ly == ppu->lyc)
+    ppu->stat |= 0x04;
+  else
+    ppu->stat &= (u8)~0x04;
+
+  EPpuMode mode = ppu_mode(ppu);
+  bool line = ((ppu->stat & 0x40) && (ppu->stat & 0x04)) ||
+              ((ppu->stat & 0x20) && mode == PPU_MODE_OAM) ||
+              ((ppu->stat & 0x10) && mode == PPU_MODE_VBLANK) ||
+              ((ppu->stat & 0x08) && mode == PPU_MODE_HBLANK);
+
+  if (line && !ppu->stat_line)
+    *interrupt_flag |= 0x02;
+  ppu->stat_line = line;
+}
+
+int ppu_step(Ppu* ppu, const Mem* mem, u8* interrupt_flag) {
+  if (!ppu || !mem || !interrupt_flag)
+    return Error_NullPointer;
+
+  // LCD off: LY stays at 0 in HBlank
+  if (!(ppu->lcdc & 0x80))
+    return 0;
+
+  ppu->dot++;
+
+  if (ppu->dot == PPU_DOTS_PER_LINE) {
+    ppu->dot = 0;
+    ppu->ly++;
+
+    if (ppu->ly == LCD_HEIGHT) {
+      set_mode(ppu, PPU_MODE_VBLANK);
+      *interrupt_flag |= 0x01;
+      ppu->frames++;
+    } else if (ppu->ly == PPU_LINES_PER_FRAME) {
+      ppu->ly = 0;
+      ppu->window_line = 0;
+      set_mode(ppu, PPU_MODE_OAM);
+    } else if (ppu->ly < LCD_HEIGHT) {
+      set_mode(ppu, PPU_MODE_OAM);
+    }
+  } else if (ppu->ly < LCD_HEIGHT) {
+    if (ppu->dot == PPU_OAM_SCAN_DOTS) {
+      set_mode(ppu, PPU_MODE_DRAW);
+    } else if (ppu->dot == PPU_OAM_SCAN_DOTS + PPU_DRAW_DOTS) {
+      EMU_STAT_TIMED(ppu->stats.render_host_cycles, ppu_render_line(ppu, mem));
+      EMU_STAT_INC(ppu->stats.lines);
+      set_mode(ppu, PPU_MODE_HBLANK);
+    }
   }
 
-  // TODO
+  update_stat(ppu, interrupt_flag);
+  return 0;
+}
 
-  return result_ok();
+u32 ppu_dots_to_event(const Ppu* ppu) {
+  if (!(ppu->lcdc & 0x80))
+    return UINT32_MAX;
+
+  u32 next = PPU_DOTS_PER_LINE;
+  if (ppu->ly < LCD_HEIGHT) {
+    if (ppu->dot < PPU_OAM_SCAN_DOTS)
+      next = PPU_OAM_SCAN_DOTS;
+    else if (ppu->dot < PPU_OAM_SCAN_DOTS + PPU_DRAW_DOTS)
+      next = PPU_OAM_SCAN_DOTS + PPU_DRAW_DOTS;
+  }
+
+  return next - ppu->dot;
+}
+
+void ppu_skip(Ppu* ppu, u32 dots) {
+  if (ppu->lcdc & 0x80)
+    ppu->dot = (u16)(ppu->dot + dots);
+}
+
+// Color index of pixel (x, y) of a tile, with the tile data at `tile`
+static inline u8 tile_pixel(const u8* tile, int x, int y) {
+  u8 lo = tile[y * 2];
+  u8 hi = tile[y * 2 + 1];
+  int bit = 7 - x;
+  return (u8)((((hi >> bit) & 1) << 1) | ((lo >> bit) & 1));
+}
+
+static inline u8 palette_shade(u8 palette, u8 color) {
+  return (palette >> (color * 2)) & 0x03;
+}
+
+// VRAM offset of a background/window tile, following LCDC.4 addressing
+static inline u16 bg_tile_offset(u8 lcdc, u8 index) {
+  if (lcdc & 0x10)
+    return (u16)(index * 16);
+  return (u16)(0x1000 + (int8_t)index * 16);
+}
+
+void ppu_render_line(Ppu* ppu, const Mem* mem) {
+  u8 ly = ppu->ly;
+  if (ly >= LCD_HEIGHT) return;
+
+  u8* out = ppu->framebuffer[ly];
+  u8 bg_color[LCD_WIDTH]; // color index before the palette, for sprite priority
+
+  u8 lcdc = ppu->lcdc;
+
+  if (lcdc & 0x01) {
+    const u8* bg_map  = &mem->vram[(lcdc & 0x08) ? 0x1C00 : 0x1800];
+    const u8* win_map = &mem->vram[(lcdc & 0x40) ? 0x1C00 : 0x1800];
+
+    int wx = (int)ppu->wx - 7;
+    bool window = (lcdc & 0x20) && ly >= ppu->wy && ppu->wx <= 166;
+    bool used_window = false;
+
+    u8 y = (u8)(ly + ppu->scy);
+    for (int x = 0; x < LCD_WIDTH; x++) {
+      u8 color;
+      if (window && x >= wx) {
+        u8 wy = ppu->window_line;
+        u8 tx = (u8)(x - wx);
+        u8 index = win_map[(wy / 8) * 32 + tx / 8];
+        color = tile_pixel(&mem->vram[bg_tile_offset(lcdc, index)], tx % 8, wy % 8);
+        used_window = true;
+      } else {
+        u8 bx = (u8)(x + ppu->scx);
+        u8 index = bg_map[(y / 8) * 32 + bx / 8];
+        color = tile_pixel(&mem->vram[bg_tile_offset(lcdc, index)], bx % 8, y % 8);
+      }
+
+      bg_color[x] = color;
+      out[x] = palette_shade(ppu->bgp, color);
+    }
+
+    if (used_window)
+      ppu->window_line++;
+  } else {
+    memset(bg_color, 0, sizeof(bg_color));
+    memset(out, 0, LCD_WIDTH);
+  }
+
+  if (!(lcdc & 0x02))
+    return;
+
+  // OAM scan: the first 10 sprites on this line, in OAM order
+  int height = (lcdc & 0x04) ? 16 : 8;
+  const u8* line_sprites[PPU_MAX_LINE_SPRITES];
+  int count = 0;
+
+  for (int i = 0; i < OAM_SIZE / 4 && count < PPU_MAX_LINE_SPRITES; i++) {
+    const u8* sprite = &mem->oam[i * 4];
+    int top = (int)sprite[0] - 16;
+    if (ly >= top && ly < top + height)
+      line_sprites[count++] = sprite;
+  }
+
+  // Lower X wins, then lower OAM index. Drawing in reverse priority order lets the
+  // winner overwrite
+  for (int i = 1; i < count; i++) {
+    const u8* s = line_sprites[i];
+    int j = i - 1;
+    while (j >= 0 && line_sprites[j][1] > s[1]) {
+      line_sprites[j + 1] = line_sprites[j];
+      j--;
+    }
+    line_sprites[j + 1] = s;
+  }
+
+  for (int i = count - 1; i >= 0; i--) {
+    const u8* sprite = line_sprites[i];
+    int top   = (int)sprite[0] - 16;
+    int left  = (int)sprite[1] - 8;
+    u8 tile   = sprite[2];
+    u8 attr   = sprite[3];
+
+    int row = ly - top;
+    if (attr & 0x40) row = height - 1 - row;
+    if (height == 16) tile &= 0xFE;
+
+    const u8* data = &mem->vram[tile * 16 + (row / 8) * 16];
+    u8 palette = (attr & 0x10) ? ppu->obp1 : ppu->obp0;
+
+    for (int px = 0; px < 8; px++) {
+      int x = left + px;
+      if (x < 0 || x >= LCD_WIDTH) continue;
+
+      u8 color = tile_pixel(data, (attr & 0x20) ? 7 - px : px, row % 8);
+      if (color == 0) continue;
+      if ((attr & 0x80) && bg_color[x] != 0) continue;
+
+      out[x] = palette_shade(palette, color);
+    }
+  }
+}
+
+u8 ppu_read_register(const Ppu* ppu, u16 addr) {
+  switch (addr) {
+    case 0xFF40: return ppu->lcdc;
+    case 0xFF41: return (u8)(0x80 | ppu->stat);
+    case 0xFF42: return ppu->scy;
+    case 0xFF43: return ppu->scx;
+    case 0xFF44: return ppu->ly;
+    case 0xFF45: return ppu->lyc;
+    case 0xFF46: return ppu->dma;
+    case 0xFF47: return ppu->bgp;
+    case 0xFF48: return ppu->obp0;
+    case 0xFF49: return ppu->obp1;
+    case 0xFF4A: return ppu->wy;
+    case 0xFF4B: return ppu->wx;
+    default:     return 0xFF;
+  }
+}
+
+void ppu_write_register(Ppu* ppu, u16 addr, u8 val) {
+  switch (addr) {
+    case 0xFF40: {
+      bool was_on = ppu->lcdc & 0x80;
+      ppu->lcdc = val;
+      if (was_on && !(val & 0x80)) {
+        ppu->ly  = 0;
+        ppu->dot = 0;
+        ppu->window_line = 0;
+        set_mode(ppu, PPU_MODE_HBLANK);
+      } else if (!was_on && (val & 0x80)) {
+        set_mode(ppu, PPU_MODE_OAM);
+      }
+    } break;
+    case 0xFF41: ppu->stat = (u8)((ppu->stat & 0x07) | (val & 0x78)); break;
+    case 0xFF42: ppu->scy  = val; break;
+    case 0xFF43: ppu->scx  = val; break;
+    case 0xFF44: break; // read only
+    case 0xFF45: ppu->lyc  = val; break;
+    case 0xFF46: ppu->dma  = val; break;
+    case 0xFF47: ppu->bgp  = val; break;
+    case 0xFF48: ppu->obp0 = val; break;
+    case 0xFF49: ppu->obp1 = val; break;
+    case 0xFF4A: ppu->wy   = val; break;
+    case 0xFF4B: ppu->wx   = val; break;
+    default: break;
+  }
 }
@@ -3,6 +3,25 @@
 
 #include <types.h>
 #include <lresult.h>
+#include <Emulator/mem.h>
+#include <Emulator/stats.h>
+
+#define LCD_WIDTH  160
+#define LCD_HEIGHT 144
+
+#define PPU_DOTS_PER_LINE  456
+#define PPU_LINES_PER_FRAME 154
+#define PPU_OAM_SCAN_DOTS  80
+#define PPU_DRAW_DOTS      172 // mode 3 length without sprite/scroll penalties
+#define PPU_MAX_LINE_SPRITES 10
+
+// STAT modes
+typedef enum {
+  PPU_MODE_HBLANK = 0,
+  PPU_MODE_VBLANK = 1,
+  PPU_MODE_OAM    = 2,
+  PPU_MODE_DRAW   = 3,
+} EPpuMode;
 
 typedef struct {
   // Pins
@@ -25,13 +44,42 @@ typedef struct {
   u8 wy;
   u8 wx;
 
-  // TODO: counters, fetchers, etc
+  // Counters
+  u16 dot;          // dot inside the current line
+  u8 window_line;   // internal window line counter
+  bool stat_line;   // OR of the enabled STAT interrupt sources, for edge detection
+  u64 frames;       // frames completed (VBlank entries)
+
+  // Shades (0-3, after the palettes) of the last rendered frame
+  u8 framebuffer[LCD_HEIGHT][LCD_WIDTH];
+
+  // TODO: pixel fifo, fetchers
+
+#if EMU_STATS
+  EMU_STATS_ALIGN PpuStats stats;
+#endif
 } Ppu;
 
 // To be called internally by cpu. Inititalizes the ppu's internals to default values
 Result ppu_init(Ppu* ppu);
 
-// TODO (empty)
-Result ppu_step(Ppu* ppu);
+// Advances the ppu by one dot (T-cycle). Requested interrupts are or'ed into interrupt_flag.
+// Returns 0 or an EAppError code
+int ppu_step(Ppu* ppu, const Mem* mem, u8* interrupt_flag);
+
+// Dots until the next ppu_step that can change the mode, LY or the STAT line (UINT32_MAX
+// with the LCD off). Every step before it only counts dots, see ppu_skip
+u32 ppu_dots_to_event(const Ppu* ppu);
+
+// Advances the ppu by `dots` dots at once, which must be less than ppu_dots_to_event
+void ppu_skip(Ppu* ppu, u32 dots);
+
+// Renders line `ppu->ly` into the framebuffer (background, window and sprites).
+// Called by ppu_step at the end of mode 3
+void ppu_render_line(Ppu* ppu, const Mem* mem);
+
+// LCD registers (0xFF40-0xFF4B)
+u8 ppu_read_register(const Ppu* ppu, u16 addr);
+void ppu_write_register(Ppu* ppu, u16 addr, u8 val);
 
 #endif // !PPU_H
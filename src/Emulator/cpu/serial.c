@@ -0,0 +1,101 @@
+#include "serial.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <string.h>
+
+#define SERIAL_INT 0x08
+
+// Tells the link, which may already have a byte for a waiting transfer
+static void serial_notify(Serial* serial, u64 now) {
+  if (!serial->link || !serial->link->armed)
+    return;
+
+  bool waiting = serial_waiting(serial);
+  if (serial->link->armed(serial->link, waiting, serial->sb) && waiting &&
+      serial->next_event == SERIAL_NO_EVENT)
+    serial->next_event = now + SERIAL_BYTE_CYCLES;
+}
+
+// Records the byte sent, ends the transfer and requests the interrupt
+static void serial_complete(Serial* serial, u8 in, u8* interrupt_flag) {
+  if (serial->output_len < SERIAL_OUTPUT_SIZE) {
+    serial->output[serial->output_len++] = (char)serial->sb;
+    serial->output[serial->output_len] = '\0';
+  }
+
+  serial->sb = in;
+  serial->sc &= (u8)~SC_TRANSFER;
+  serial->next_event = SERIAL_NO_EVENT;
+  *interrupt_flag |= SERIAL_INT;
+}
+
+Result serial_init(Serial* serial) {
+  if (!serial) {
+    return result_error(Error_NullPointer, "invalid serial to serial_init");
+  }
+  memset(serial, 0, sizeof(*serial));
+
+  serial->next_event = SERIAL_NO_EVENT;
+
+  EMU_LOG_TRACE(EMU_LOG_CPU, "serial initialized successfully");
+  return result_ok();
+}
+
+void serial_event(Serial* serial, u64 now, u8* interrupt_flag) {
+  u8 in = serial->link ? serial->link->exchange(serial->link, serial->sb, now) : 0xFF;
+  serial_complete(serial, in, interrupt_flag);
+}
+
+u8 serial_receive(Serial* serial, u8 in, u8* interrupt_flag) {
+  if (!serial_waiting(serial))
+    return 0xFF;
+
+  u8 out = serial->sb;
+  serial_complete(serial, in, interrupt_flag);
+  return out;
+}
+
+u8 serial_read_register(const Serial* serial, u16 addr) {
+  switch (addr) {
+    case 0xFF01: return serial->sb;
+    case 0xFF02: return serial->sc | 0x7E;
+    default:     return 0xFF;
+  }
+}
+
+void serial_write_register(Serial* serial, u64 now, u16 addr, u8 val) {
+  switch (addr) {
+    case 0xFF01:
+      serial->sb = val;
+      if (serial_waiting(serial))
+        serial_notify(serial, now);
+      break;
+
+    case 0xFF02: {
+      bool was_waiting = serial_waiting(serial);
+      serial->sc = val & (SC_TRANSFER | SC_INTERNAL);
+      serial->next_event = (val & SC_TRANSFER) && (val & SC_INTERNAL) ? now + SERIAL_BYTE_CYCLES
+                                                                      : SERIAL_NO_EVENT;
+      if (was_waiting || serial_waiting(serial))
+        serial_notify(serial, now);
+    } break;
+  }
+}
+
+// Not strstr: the output can hold NUL bytes
+bool serial_output_contains(const Serial* serial, const char* text) {
+  size_t len = strlen(text);
+  if (len > serial->output_len) return false;
+
+  for (size_t i = 0; i + len <= serial->output_len; i++) {
+    if (memcmp(&serial->output[i], text, len) == 0)
+      return true;
+  }
+  return false;
+}
+
+ESerialVerdict serial_verdict(const Serial* serial) {
+  if (serial_output_contains(serial, "Failed")) return SERIAL_VERDICT_FAILED;
+  if (serial_output_contains(serial, "Passed")) return SERIAL_VERDICT_PASSED;
+  return SERIAL_VERDICT_NONE;
+}
@@ -0,0 +1,79 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+
+// Serial port (SB 0xFF01, SC 0xFF02). Transfers are modelled a byte at a time: with the
+// internal clock the byte completes SERIAL_BYTE_CYCLES after the SC write (`next_event`,
+// compared against once per T-cycle like the timer), and is exchanged with whatever is
+// plugged into the port at that cycle. With the external clock the port waits for the
+// other end to clock it (serial_receive).
+//
+// Every byte sent is also appended to `output`, which is how test roms report results.
+
+#define SERIAL_NO_EVENT    UINT64_MAX
+#define SERIAL_BYTE_CYCLES 4096 // 8 bits at 8192 Hz
+#define SERIAL_OUTPUT_SIZE 4096
+
+// The other end of the cable, NULL when nothing is plugged in (bits shift in as 1s)
+typedef struct SerialLink {
+  // The transfer due at cycle `now` ends, `out` going over the cable: returns the byte
+  // shifted in
+  u8 (*exchange)(struct SerialLink* link, u8 out, u64 now);
+  // This end is (or stops) waiting for the other one to clock `sb` out. Optional. Returns
+  // true when the other end already clocked a byte this one hasn't taken in: the
+  // transfer then ends SERIAL_BYTE_CYCLES later, through exchange
+  bool (*armed)(struct SerialLink* link, bool armed, u8 sb);
+  void* ctx;
+} SerialLink;
+
+#define SC_TRANSFER 0x80
+#define SC_INTERNAL 0x01
+
+typedef struct {
+  u8 sb;
+  u8 sc; // SC_TRANSFER and SC_INTERNAL bits
+  u64 next_event; // end of the transfer, SERIAL_NO_EVENT when none (or waiting for the link)
+
+  SerialLink* link; // not owned
+
+  // Bytes sent so far, NUL terminated (and maybe holding NULs). Stops filling up once full
+  char output[SERIAL_OUTPUT_SIZE + 1];
+  u32 output_len;
+} Serial;
+
+// To be called internally by cpu. Nothing plugged in, no transfer
+Result serial_init(Serial* serial);
+
+// A transfer is waiting for the other end to clock it
+static inline bool serial_waiting(const Serial* serial) {
+  return (serial->sc & (SC_TRANSFER | SC_INTERNAL)) == SC_TRANSFER;
+}
+
+// Completes the transfer due at `now`. The serial interrupt is or'ed into
+// interrupt_flag
+void serial_event(Serial* serial, u64 now, u8* interrupt_flag);
+
+// The other end clocked `in` over the cable. Completes a transfer waiting for the
+// external clock and returns the byte shifted out, 0xFF when none is waiting
+u8 serial_receive(Serial* serial, u8 in, u8* interrupt_flag);
+
+// Serial registers (0xFF01-0xFF02) accessed at clock cycle `now`
+u8 serial_read_register(const Serial* serial, u16 addr);
+void serial_write_register(Serial* serial, u64 now, u16 addr, u8 val);
+
+// True once `text` was sent
+bool serial_output_contains(const Serial* serial, const char* text);
+
+typedef enum {
+  SERIAL_VERDICT_NONE = 0,
+  SERIAL_VERDICT_PASSED,
+  SERIAL_VERDICT_FAILED,
+} ESerialVerdict;
+
+// Result a test rom printed over serial ("Passed" or "Failed", as blargg's roms do)
+ESerialVerdict serial_verdict(const Serial* serial);
+
+#endif // !SERIAL_H
@@ -0,0 +1,170 @@
+#include "timer.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <string.h>
+
+// Counter bit whose falling edge clocks TIMA, by TAC bits 0-1 (4096, 262144, 65536,
+// 16384 Hz)
+static const u8 TIMER_BIT[4] = { 9, 3, 5, 7 };
+
+#define TIMER_INT 0x04
+#define TIMER_RELOAD_DELAY 4 // TIMA reads 0 for 4 T-cycles after overflowing
+#define TIMER_RELOAD_CYCLES 4 // the reload itself takes one M-cycle
+
+static inline bool timer_enabled(const Timer* timer) {
+  return (timer->tac & 0x04) != 0;
+}
+
+static inline u64 timer_counter(const Timer* timer, u64 now) {
+  return now - timer->div_base;
+}
+
+// Level of the counter bit selected by TAC, ANDed with the enable bit: TIMA ticks when it
+// goes from 1 to 0, so the DIV reset and TAC writes that drop it tick TIMA too
+static inline bool timer_input(const Timer* timer, u64 now) {
+  u8 bit = TIMER_BIT[timer->tac & 0x03];
+  return timer_enabled(timer) && ((timer_counter(timer, now) >> bit) & 1);
+}
+
+// Inside the M-cycle TIMA is reloaded in: TMA is still being copied, so TIMA writes are
+// lost and TMA writes reach TIMA as well
+static inline bool timer_reloading(const Timer* timer, u64 now) {
+  return timer->reloaded_at && now - timer->reloaded_at < TIMER_RELOAD_CYCLES;
+}
+
+// One TIMA increment at cycle `at`
+static void timer_tick(Timer* timer, u64 at) {
+  if (timer->reload_at) return;
+
+  if (timer->tima == 0xFF) {
+    timer->tima = 0x00;
+    timer->reload_at = at + TIMER_RELOAD_DELAY;
+  } else {
+    timer->tima++;
+  }
+}
+
+// Applies every falling edge and reload in (synced, now]
+static void timer_sync(Timer* timer, u64 now, u8* interrupt_flag) {
+  for (;;) {
+    if (timer->reload_at && timer->reload_at <= now) {
+      // Edges during the 4 cycles TIMA reads 0 are overwritten by the reload
+      timer->tima = timer->tma;
+      if (timer->synced < timer->reload_at)
+        timer->synced = timer->reload_at;
+      timer->reloaded_at = timer->reload_at;
+      timer->reload_at = 0;
+      *interrupt_flag |= TIMER_INT;
+    }
+
+    if (timer->reload_at || !timer_enabled(timer) || timer->synced >= now) {
+      if (timer->synced < now)
+        timer->synced = now;
+      return;
+    }
+
+    // Falling edges of bit b while the counter goes from x to y: (y >> (b + 1)) - (x >> (b + 1))
+    u8 shift = (u8)(TIMER_BIT[timer->tac & 0x03] + 1);
+    u64 from  = timer_counter(timer, timer->synced) >> shift;
+    u64 edges = (timer_counter(timer, now) >> shift) - from;
+
+    if (edges < 0x100u - timer->tima) {
+      timer->tima = (u8)(timer->tima + edges);
+      timer->synced = now;
+      return;
+    }
+
+    // Overflow on the edge that takes TIMA past 0xFF
+    u64 overflow = timer->div_base + ((from + (0x100u - timer->tima)) << shift);
+    timer->tima = 0x00;
+    timer->reload_at = overflow + TIMER_RELOAD_DELAY;
+    timer->synced = overflow;
+  }
+}
+
+static void timer_schedule(Timer* timer) {
+  if (timer->reload_at) {
+    timer->next_event = timer->reload_at;
+  } else if (timer_enabled(timer)) {
+    u8 shift = (u8)(TIMER_BIT[timer->tac & 0x03] + 1);
+    u64 from = timer_counter(timer, timer->synced) >> shift;
+    timer->next_event = timer->div_base + ((from + (0x100u - timer->tima)) << shift) + TIMER_RELOAD_DELAY;
+  } else {
+    timer->next_event = TIMER_NO_EVENT;
+  }
+}
+
+Result timer_init(Timer* timer) {
+  if (!timer) {
+    return result_error(Error_NullPointer, "invalid timer to timer_init");
+  }
+  memset(timer, 0, sizeof(*timer));
+
+  timer->next_event = TIMER_NO_EVENT;
+
+  EMU_LOG_TRACE(EMU_LOG_CPU, "timer initialized successfully");
+  return result_ok();
+}
+
+void timer_set_counter(Timer* timer, u64 now, u16 counter) {
+  timer->div_base = now - counter;
+  timer->synced   = now;
+  timer_schedule(timer);
+}
+
+void timer_event(Timer* timer, u64 now, u8* interrupt_flag) {
+  timer_sync(timer, now, interrupt_flag);
+  timer_schedule(timer);
+}
+
+u8 timer_read_register(Timer* timer, u64 now, u8* interrupt_flag, u16 addr) {
+  switch (addr) {
+    case 0xFF04: return (u8)(timer_counter(timer, now) >> 8);
+    case 0xFF05:
+      timer_event(timer, now, interrupt_flag);
+      return timer->tima;
+    case 0xFF06: return timer->tma;
+    case 0xFF07: return timer->tac | 0xF8;
+    default:     return 0xFF;
+  }
+}
+
+void timer_write_register(Timer* timer, u64 now, u8* interrupt_flag, u16 addr, u8 val) {
+  timer_sync(timer, now, interrupt_flag);
+
+  switch (addr) {
+    case 0xFF04:
+      // Resetting the counter drops the selected bit if it was set
+      if (timer_input(timer, now))
+        timer_tick(timer, now);
+      timer->div_base = now;
+      timer->synced   = now;
+      break;
+
+    case 0xFF05:
+      if (timer_reloading(timer, now))
+        break;
+      // Written during the 4 cycles before the reload: the reload and interrupt are cancelled
+      timer->reload_at = 0;
+      timer->tima = val;
+      break;
+
+    case 0xFF06:
+      timer->tma = val;
+      if (timer_reloading(timer, now))
+        timer->tima = val;
+      break;
+
+    case 0xFF07: {
+      bool before = timer_input(timer, now);
+      timer->tac = val & 0x07;
+      if (before && !timer_input(timer, now))
+        timer_tick(timer, now);
+    } break;
+
+    default:
+      break;
+  }
+
+  timer_schedule(timer);
+}
@@ -0,0 +1,43 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+
+// DIV/TIMA/TMA/TAC (0xFF04-0xFF07), computed from the cpu's clock_cycles instead of being
+// stepped. DIV is the top byte of a 16-bit counter running at the T-cycle rate; TIMA
+// counts the falling edges of one of its bits (selected by TAC), so both are derived on
+// access from the cycle count. The only scheduled work is the overflow: `next_event` is
+// the cycle at which TIMA is reloaded from TMA and the interrupt requested, which the cpu
+// compares against once per T-cycle (timer_event)
+
+#define TIMER_NO_EVENT UINT64_MAX
+
+typedef struct {
+  u64 div_base;    // clock cycle at which the internal counter was 0
+  u64 synced;      // clock cycle up to which TIMA is up to date
+  u64 reload_at;   // TIMA overflowed: cycle of the reload from TMA, 0 when none pending
+  u64 reloaded_at; // cycle of the last reload, 0 before the first one
+  u64 next_event;  // reload_at, or the cycle of the next one, TIMER_NO_EVENT when stopped
+
+  u8 tima;
+  u8 tma;
+  u8 tac;
+} Timer;
+
+// To be called internally by cpu. Counter, TIMA, TMA and TAC start at 0
+Result timer_init(Timer* timer);
+
+// Sets the internal counter (DIV is its high byte) as of clock cycle `now`
+void timer_set_counter(Timer* timer, u64 now, u16 counter);
+
+// Brings TIMA up to `now` and schedules the next overflow. Requested interrupts are or'ed
+// into interrupt_flag
+void timer_event(Timer* timer, u64 now, u8* interrupt_flag);
+
+// Timer registers (0xFF04-0xFF07) accessed at clock cycle `now`
+u8 timer_read_register(Timer* timer, u64 now, u8* interrupt_flag, u16 addr);
+void timer_write_register(Timer* timer, u64 now, u8* interrupt_flag, u16 addr, u8 val);
+
+#endif // !TIMER_H
@@ -0,0 +1,369 @@
+#include "debugger.h"
+#include <util.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+void debugger_init(Debugger* debugger) {
+  memset(debugger, 0, sizeof(*debugger));
+}
+
+static void update_watch_pages(Debugger* debugger) {
+  memset(debugger->watch_pages, 0, sizeof(debugger->watch_pages));
+  for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+    const Watchpoint* w = &debugger->watchpoints[i];
+    if (!w->used) continue;
+    for (u32 page = w->first >> 8; page <= (u32)(w->last >> 8); page++)
+      debugger->watch_pages[page] |= w->kind;
+  }
+}
+
+int debugger_add_breakpoint(Debugger* debugger, u16 addr, const DebugCondition* cond) {
+  for (int i = 0; i < DEBUG_MAX_BREAKPOINTS; i++) {
+    Breakpoint* b = &debugger->breakpoints[i];
+    if (b->used) continue;
+
+    memset(b, 0, sizeof(*b));
+    b->used = true;
+    b->addr = addr;
+    if (cond) b->cond = *cond;
+    debugger->break_pages[addr >> 8]++;
+    return i;
+  }
+  return -1;
+}
+
+int debugger_add_watchpoint(Debugger* debugger, u16 first, u16 last, u8 kind, const DebugCondition* cond) {
+  if (last < first) {
+    u16 t = first;
+    first = last;
+    last = t;
+  }
+
+  for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+    Watchpoint* w = &debugger->watchpoints[i];
+    if (w->used) continue;
+
+    memset(w, 0, sizeof(*w));
+    w->used  = true;
+    w->first = first;
+    w->last  = last;
+    w->kind  = kind & WATCH_ACCESS;
+    if (cond) w->cond = *cond;
+    update_watch_pages(debugger);
+    return i;
+  }
+  return -1;
+}
+
+bool debugger_remove_breakpoint(Debugger* debugger, u16 addr) {
+  bool removed = false;
+  for (int i = 0; i < DEBUG_MAX_BREAKPOINTS; i++) {
+    Breakpoint* b = &debugger->breakpoints[i];
+    if (!b->used || b->addr != addr) continue;
+
+    b->used = false;
+    debugger->break_pages[addr >> 8]--;
+    removed = true;
+  }
+  return removed;
+}
+
+bool debugger_remove_watchpoint(Debugger* debugger, u16 first, u16 last, u8 kind) {
+  bool removed = false;
+  for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+    Watchpoint* w = &debugger->watchpoints[i];
+    if (!w->used || w->first != first || w->last != last || w->kind != kind) continue;
+
+    w->used = false;
+    removed = true;
+  }
+  if (removed) update_watch_pages(debugger);
+  return removed;
+}
+
+bool debugger_empty(const Debugger* debugger) {
+  for (int i = 0; i < DEBUG_MAX_BREAKPOINTS; i++)
+    if (debugger->breakpoints[i].used) return false;
+  for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++)
+    if (debugger->watchpoints[i].used) return false;
+  return true;
+}
+
+static u16 operand_value(const DebugCondition* cond, Cpu* cpu, u8 value) {
+  switch (cond->operand) {
+    case DEBUG_OPERAND_REG8:  return *cpu_get_reg8(cpu, (ERegisterHalf)cond->index);
+    case DEBUG_OPERAND_REG16: return *cpu_get_reg16(cpu, (ERegisterFull)cond->index);
+    case DEBUG_OPERAND_MEM:   return mem_peek8(cpu->mem, cpu, cond->addr);
+    case DEBUG_OPERAND_VALUE: return value;
+  }
+  return 0;
+}
+
+static bool condition_holds(const DebugCondition* cond, Cpu* cpu, u8 value) {
+  if (cond->op == DEBUG_COND_NONE) return true;
+
+  u16 v = operand_value(cond, cpu, value);
+  switch (cond->op) {
+    case DEBUG_COND_EQ:  return v == cond->value;
+    case DEBUG_COND_NE:  return v != cond->value;
+    case DEBUG_COND_LT:  return v <  cond->value;
+    case DEBUG_COND_LE:  return v <= cond->value;
+    case DEBUG_COND_GT:  return v >  cond->value;
+    case DEBUG_COND_GE:  return v >= cond->value;
+    case DEBUG_COND_AND: return (v & cond->value) != 0;
+    case DEBUG_COND_NONE: break;
+  }
+  return true;
+}
+
+void debugger_check_breakpoints(Debugger* debugger, Cpu* cpu, u16 pc) {
+  for (int i = 0; i < DEBUG_MAX_BREAKPOINTS; i++) {
+    Breakpoint* b = &debugger->breakpoints[i];
+    if (!b->used || b->addr != pc || !condition_holds(&b->cond, cpu, 0)) continue;
+
+    b->hits++;
+    debugger->hit = (DebugHit){
+      .kind  = DEBUG_HIT_BREAKPOINT,
+      .index = i,
+      .pc    = pc,
+      .addr  = pc,
+      .cycle = cpu->clock_cycles,
+    };
+    cpu->paused = true;
+    return;
+  }
+}
+
+void debugger_check_watchpoints(Debugger* debugger, Cpu* cpu, u16 addr, u8 value, u8 kind) {
+  for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+    Watchpoint* w = &debugger->watchpoints[i];
+    if (!w->used || !(w->kind & kind) || addr < w->first || addr > w->last) continue;
+    if (!condition_holds(&w->cond, cpu, value)) continue;
+
+    w->hits++;
+    debugger->hit = (DebugHit){
+      .kind  = kind == WATCH_READ ? DEBUG_HIT_WATCH_READ : DEBUG_HIT_WATCH_WRITE,
+      .index = i,
+      .pc    = debugger->pc,
+      .addr  = addr,
+      .value = value,
+      .cycle = cpu->clock_cycles,
+    };
+    cpu->paused = true;
+    return;
+  }
+}
+
+// Parsing
+
+static const char* skip_spaces(const char* s) {
+  while (*s && isspace((unsigned char)*s)) s++;
+  return s;
+}
+
+// Hex number, with an optional `0x` or `$` prefix
+static bool parse_hex(const char** s, u16* out) {
+  const char* p = skip_spaces(*s);
+  if (*p == '$') p++;
+  else if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+
+  char* end;
+  unsigned long v = strtoul(p, &end, 16);
+  if (end == p || v > 0xFFFF) return false;
+
+  *out = (u16)v;
+  *s = end;
+  return true;
+}
+
+static bool parse_operand(const char** s, DebugCondition* cond) {
+  static const struct { const char* name; EDebugOperand operand; u8 index; } names[] = {
+    { "af", DEBUG_OPERAND_REG16, AF }, { "bc", DEBUG_OPERAND_REG16, BC },
+    { "de", DEBUG_OPERAND_REG16, DE }, { "hl", DEBUG_OPERAND_REG16, HL },
+    { "sp", DEBUG_OPERAND_REG16, SP }, { "pc", DEBUG_OPERAND_REG16, PC },
+    { "a",  DEBUG_OPERAND_REG8,  A  }, { "f",  DEBUG_OPERAND_REG8,  F  },
+    { "b",  DEBUG_OPERAND_REG8,  B  }, { "c",  DEBUG_OPERAND_REG8,  C  },
+    { "d",  DEBUG_OPERAND_REG8,  D  }, { "e",  DEBUG_OPERAND_REG8,  E  },
+    { "h",  DEBUG_OPERAND_REG8,  H  }, { "l",  DEBUG_OPERAND_REG8,  L  },
+    { "value", DEBUG_OPERAND_VALUE, 0 },
+  };
+
+  const char* p = skip_spaces(*s);
+  if (*p == '[') {
+    p++;
+    if (!parse_hex(&p, &cond->addr)) return false;
+    p = skip_spaces(p);
+    if (*p != ']') return false;
+    cond->operand = DEBUG_OPERAND_MEM;
+    *s = p + 1;
+    return true;
+  }
+
+  size_t len = 0;
+  while (isalpha((unsigned char)p[len])) len++;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strlen(names[i].name) == len && strncasecmp(p, names[i].name, len) == 0) {
+      cond->operand = names[i].operand;
+      cond->index   = names[i].index;
+      *s = p + len;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parse_op(const char** s, EDebugCondOp* op) {
+  static const struct { const char* text; EDebugCondOp op; } ops[] = {
+    { "==", DEBUG_COND_EQ }, { "!=", DEBUG_COND_NE }, { "<=", DEBUG_COND_LE },
+    { ">=", DEBUG_COND_GE }, { "<",  DEBUG_COND_LT }, { ">",  DEBUG_COND_GT },
+    { "&",  DEBUG_COND_AND },
+  };
+
+  const char* p = skip_spaces(*s);
+  for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    size_t len = strlen(ops[i].text);
+    if (strncmp(p, ops[i].text, len) == 0) {
+      *op = ops[i].op;
+      *s = p + len;
+      return true;
+    }
+  }
+  return false;
+}
+
+Result debugger_parse_condition(const char* text, DebugCondition* cond) {
+  if (!text || !cond) {
+    return result_error(Error_NullPointer, "invalid args to debugger_parse_condition");
+  }
+  memset(cond, 0, sizeof(*cond));
+
+  const char* p = text;
+  if (!parse_operand(&p, cond)) {
+    return result_error(Error_Unknown, "bad operand in condition '%s'", text);
+  }
+  if (!parse_op(&p, &cond->op)) {
+    return result_error(Error_Unknown, "bad operator in condition '%s'", text);
+  }
+  if (!parse_hex(&p, &cond->value) || *skip_spaces(p) != '\0') {
+    return result_error(Error_Unknown, "bad value in condition '%s'", text);
+  }
+  return result_ok();
+}
+
+Result debugger_command(Debugger* debugger, const char* line) {
+  if (!debugger || !line) {
+    return result_error(Error_NullPointer, "invalid args to debugger_command");
+  }
+
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", line);
+  char* comment = strchr(buf, '#');
+  if (comment) *comment = '\0';
+  buf[strcspn(buf, "\r\n")] = '\0';
+
+  const char* p = skip_spaces(buf);
+  if (*p == '\0') return result_ok();
+
+  char command[16];
+  size_t len = strcspn(p, " \t");
+  if (len >= sizeof(command)) len = sizeof(command) - 1;
+  memcpy(command, p, len);
+  command[len] = '\0';
+  p += len;
+
+  u16 first, last;
+  if (!parse_hex(&p, &first)) {
+    return result_error(Error_Unknown, "missing address in '%s'", line);
+  }
+  last = first;
+  if (*p == '-') {
+    p++;
+    if (!parse_hex(&p, &last)) {
+      return result_error(Error_Unknown, "bad address range in '%s'", line);
+    }
+  }
+
+  DebugCondition cond;
+  memset(&cond, 0, sizeof(cond));
+  p = skip_spaces(p);
+  if (strncmp(p, "if", 2) == 0 && (p[2] == '\0' || isspace((unsigned char)p[2]))) {
+    Result r = debugger_parse_condition(p + 2, &cond);
+    if (result_is_error(&r)) return r;
+  } else if (*p != '\0') {
+    return result_error(Error_Unknown, "trailing characters in '%s'", line);
+  }
+
+  int slot = 0;
+  if (strcmp(command, "break") == 0) {
+    slot = debugger_add_breakpoint(debugger, first, &cond);
+  } else if (strcmp(command, "watch") == 0) {
+    slot = debugger_add_watchpoint(debugger, first, last, WATCH_WRITE, &cond);
+  } else if (strcmp(command, "rwatch") == 0) {
+    slot = debugger_add_watchpoint(debugger, first, last, WATCH_READ, &cond);
+  } else if (strcmp(command, "awatch") == 0) {
+    slot = debugger_add_watchpoint(debugger, first, last, WATCH_ACCESS, &cond);
+  } else if (strcmp(command, "delete") == 0) {
+    bool removed = debugger_remove_breakpoint(debugger, first);
+    for (int i = 0; i < DEBUG_MAX_WATCHPOINTS; i++) {
+      const Watchpoint* w = &debugger->watchpoints[i];
+      if (w->used && w->first == first)
+        removed |= debugger_remove_watchpoint(debugger, w->first, w->last, w->kind);
+    }
+    if (!removed) {
+      return result_error(Error_Unknown, "nothing set at %04X", first);
+    }
+  } else {
+    return result_error(Error_Unknown, "unknown debugger command '%s'", command);
+  }
+
+  if (slot < 0) {
+    return result_error(Error_Unknown, "no free slot for '%s'", line);
+  }
+  return result_ok();
+}
+
+Result debugger_load(Debugger* debugger, const char* path) {
+  if (!debugger || !path) {
+    return result_error(Error_NullPointer, "invalid args to debugger_load");
+  }
+
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return result_error(Error_FileIO, "failed to open %s", path);
+  }
+
+  char line[256];
+  int line_no = 0;
+  while (fgets(line, sizeof(line), f)) {
+    line_no++;
+    Result r = debugger_command(debugger, line);
+    if (result_is_error(&r)) {
+      fclose(f);
+      return result_error(r.error_code, "%s:%d: %s", path, line_no, r.message);
+    }
+  }
+
+  fclose(f);
+  return result_ok();
+}
+
+void debugger_describe_hit(const Debugger* debugger, char* buf, size_t size) {
+  const DebugHit* hit = &debugger->hit;
+  switch (hit->kind) {
+    case DEBUG_HIT_NONE:
+      snprintf(buf, size, "no debugger hit");
+      break;
+    case DEBUG_HIT_BREAKPOINT:
+      snprintf(buf, size, "breakpoint %d at %04X", hit->index, hit->pc);
+      break;
+    case DEBUG_HIT_WATCH_READ:
+    case DEBUG_HIT_WATCH_WRITE:
+      snprintf(buf, size, "%s watchpoint %d at %04X (value %02X) from pc %04X",
+               hit->kind == DEBUG_HIT_WATCH_READ ? "read" : "write",
+               hit->index, hit->addr, hit->value, hit->pc);
+      break;
+  }
+}
@@ -0,0 +1,139 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu/cpu.h"
+
+// Pc breakpoints and memory watchpoints, both with an optional condition. A hit pauses
+// the cpu (cpu->paused) and is described in Debugger.hit.
+//
+// Nothing is paid while no debugger is attached (cpu->debugger is NULL). Once one is, the
+// hooks only look at per-page flags (256 byte pages): the breakpoint list is searched on
+// instructions decoded in a page holding a breakpoint, the watchpoints on accesses to a
+// page holding a watch of that kind.
+
+#define DEBUG_MAX_BREAKPOINTS 64
+#define DEBUG_MAX_WATCHPOINTS 64
+
+typedef enum {
+  WATCH_READ   = 1 << 0,
+  WATCH_WRITE  = 1 << 1,
+  WATCH_ACCESS = WATCH_READ | WATCH_WRITE,
+} EWatchKind;
+
+typedef enum {
+  DEBUG_COND_NONE = 0,
+  DEBUG_COND_EQ,
+  DEBUG_COND_NE,
+  DEBUG_COND_LT,
+  DEBUG_COND_LE,
+  DEBUG_COND_GT,
+  DEBUG_COND_GE,
+  DEBUG_COND_AND, // operand & value != 0
+} EDebugCondOp;
+
+typedef enum {
+  DEBUG_OPERAND_REG8 = 0,  // ERegisterHalf in `index`
+  DEBUG_OPERAND_REG16,     // ERegisterFull in `index`
+  DEBUG_OPERAND_MEM,       // byte at `addr`
+  DEBUG_OPERAND_VALUE,     // the byte read or written, watchpoints only
+} EDebugOperand;
+
+// `<operand> <op> <value>`, e.g. `a == 3`, `hl >= c000`, `[ff44] == 90`, `value & 80`
+typedef struct {
+  EDebugCondOp op;
+  EDebugOperand operand;
+  u8 index;
+  u16 addr;
+  u16 value;
+} DebugCondition;
+
+typedef struct {
+  bool used;
+  u16 addr;
+  DebugCondition cond;
+  u32 hits;
+} Breakpoint;
+
+typedef struct {
+  bool used;
+  u16 first;
+  u16 last;
+  u8 kind; // EWatchKind
+  DebugCondition cond;
+  u32 hits;
+} Watchpoint;
+
+typedef enum {
+  DEBUG_HIT_NONE = 0,
+  DEBUG_HIT_BREAKPOINT,
+  DEBUG_HIT_WATCH_READ,
+  DEBUG_HIT_WATCH_WRITE,
+} EDebugHitKind;
+
+typedef struct {
+  EDebugHitKind kind;
+  int index; // into breakpoints or watchpoints
+  u16 pc;    // instruction that hit
+  u16 addr;  // watched address
+  u8 value;  // byte read or written
+  u64 cycle;
+} DebugHit;
+
+typedef struct Debugger {
+  Breakpoint breakpoints[DEBUG_MAX_BREAKPOINTS];
+  Watchpoint watchpoints[DEBUG_MAX_WATCHPOINTS];
+  u8 break_pages[256]; // breakpoints per page
+  u8 watch_pages[256]; // EWatchKind of the watchpoints covering each page
+
+  u16 pc; // pc of the instruction being stepped, for watch hits
+  DebugHit hit;
+} Debugger;
+
+void debugger_init(Debugger* debugger);
+
+// Both return the slot index, or -1 when full. `cond` may be NULL
+int debugger_add_breakpoint(Debugger* debugger, u16 addr, const DebugCondition* cond);
+int debugger_add_watchpoint(Debugger* debugger, u16 first, u16 last, u8 kind, const DebugCondition* cond);
+
+// Both return false when nothing matched
+bool debugger_remove_breakpoint(Debugger* debugger, u16 addr);
+bool debugger_remove_watchpoint(Debugger* debugger, u16 first, u16 last, u8 kind);
+
+bool debugger_empty(const Debugger* debugger);
+
+// Parses a condition (see DebugCondition), numbers are hex
+Result debugger_parse_condition(const char* text, DebugCondition* cond);
+
+// One command: `break <addr> [if <cond>]`, `watch|rwatch|awatch <addr>[-<last>] [if <cond>]`
+// (write, read, access as in gdb) or `delete <addr>`, addresses in hex. Blank lines and
+// '#' comments are accepted
+Result debugger_command(Debugger* debugger, const char* line);
+
+// Runs every command in the file at `path`
+Result debugger_load(Debugger* debugger, const char* path);
+
+// `breakpoint 0 at 0150` / `write watchpoint 1 at c000 (value 3f) from pc 0213`
+void debugger_describe_hit(const Debugger* debugger, char* buf, size_t size);
+
+// Slow paths of the hooks below
+void debugger_check_breakpoints(Debugger* debugger, Cpu* cpu, u16 pc);
+void debugger_check_watchpoints(Debugger* debugger, Cpu* cpu, u16 addr, u8 value, u8 kind);
+
+// Called by cpu_step at every instruction boundary
+static inline void debugger_on_instruction(Debugger* debugger, Cpu* cpu, u16 pc) {
+  debugger->pc = pc;
+  if (debugger->break_pages[pc >> 8])
+    debugger_check_breakpoints(debugger, cpu, pc);
+}
+
+// Called by mem_read8/mem_write8, `kind` is WATCH_READ or WATCH_WRITE
+static inline void debugger_on_access(Debugger* debugger, Cpu* cpu, u16 addr, u8 value, u8 kind) {
+  if (debugger->watch_pages[addr >> 8] & kind)
+    debugger_check_watchpoints(debugger, cpu, addr, value, kind);
+}
+
+#endif // !DEBUGGER_H
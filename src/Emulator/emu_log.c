@@ -0,0 +1,63 @@
+#include "emu_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+u32 emu_log_mask = EMU_LOG_DEFAULT;
+
+typedef struct {
+  const char* name;
+  u32 mask;
+} CategoryName;
+
+static const CategoryName CATEGORY_NAMES[] = {
+  { "cpu",     EMU_LOG_CPU },
+  { "exec",    EMU_LOG_EXEC },
+  { "mem",     EMU_LOG_MEM },
+  { "ppu",     EMU_LOG_PPU },
+  { "apu",     EMU_LOG_APU },
+  { "joypad",  EMU_LOG_JOYPAD },
+  { "machine", EMU_LOG_MACHINE },
+  { "all",     EMU_LOG_ALL },
+  { "default", EMU_LOG_DEFAULT },
+  { "none",    0 },
+};
+
+bool emu_log_parse_mask(const char* spec, u32* mask) {
+  if (!spec || !mask) return false;
+
+  u32 result = 0;
+  const char* p = spec;
+
+  while (*p) {
+    const char* end = strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+
+    bool found = false;
+    for (size_t i = 0; i < sizeof(CATEGORY_NAMES) / sizeof(CATEGORY_NAMES[0]); i++) {
+      if (strlen(CATEGORY_NAMES[i].name) == len && strncmp(CATEGORY_NAMES[i].name, p, len) == 0) {
+        result |= CATEGORY_NAMES[i].mask;
+        found = true;
+        break;
+      }
+    }
+    if (!found && len > 0)
+      return false;
+
+    p += len;
+    if (*p == ',') p++;
+  }
+
+  *mask = result;
+  return true;
+}
+
+void emu_log_init_from_env(void) {
+  const char* spec = getenv("LGB_LOG");
+  if (!spec) return;
+
+  u32 mask;
+  if (emu_log_parse_mask(spec, &mask))
+    emu_log_mask = mask;
+  else
+    LOG_WARNING("invalid LGB_LOG=\"%s\", expected a list of: cpu,exec,mem,ppu,apu,joypad,machine,all,none", spec);
+}
@@ -0,0 +1,67 @@
+#ifndef EMU_LOG_H
+#define EMU_LOG_H
+
+#include <types.h>
+#include <stdbool.h>
+#include <llog.h>
+
+// Logging for the emulator core.
+//
+// Messages below EMU_LOG_LEVEL are compiled out (the level test is a constant, so the
+// call and its argument formatting disappear). What is left is filtered at runtime by
+// category through emu_log_mask.
+//
+// Per-event messages (one per instruction, per bus access...) never go through text
+// logging: they are pushed as binary records on the cpu's event channel (see event.h)
+// and only formatted by whoever drains it.
+
+#define EMU_LOG_LEVEL_OFF     0
+#define EMU_LOG_LEVEL_ERROR   1
+#define EMU_LOG_LEVEL_WARNING 2
+#define EMU_LOG_LEVEL_INFO    3
+#define EMU_LOG_LEVEL_TRACE   4
+
+#ifndef EMU_LOG_LEVEL
+#ifdef NDEBUG
+#define EMU_LOG_LEVEL EMU_LOG_LEVEL_WARNING
+#else
+#define EMU_LOG_LEVEL EMU_LOG_LEVEL_TRACE
+#endif
+#endif
+
+typedef enum {
+  EMU_LOG_CPU     = 1 << 0, // cpu state changes, bootrom
+  EMU_LOG_EXEC    = 1 << 1, // every executed instruction (event channel only)
+  EMU_LOG_MEM     = 1 << 2, // memory map, cartridge, open bus accesses
+  EMU_LOG_PPU     = 1 << 3,
+  EMU_LOG_APU     = 1 << 4,
+  EMU_LOG_JOYPAD  = 1 << 5,
+  EMU_LOG_MACHINE = 1 << 6, // machine setup, movies
+} EEmuLogCategory;
+
+#define EMU_LOG_ALL     0x7Fu
+// EXEC is too noisy to be on unless asked for
+#define EMU_LOG_DEFAULT (EMU_LOG_ALL & ~(u32)EMU_LOG_EXEC)
+
+// Categories enabled at runtime
+extern u32 emu_log_mask;
+
+// Parses a comma separated category list ("cpu,mem", "all", "none", "default")
+bool emu_log_parse_mask(const char* spec, u32* mask);
+
+// Sets emu_log_mask from the LGB_LOG environment variable, if set
+void emu_log_init_from_env(void);
+
+#define EMU_LOG_ENABLED(level, category) \
+  (EMU_LOG_LEVEL >= (level) && (emu_log_mask & (u32)(category)))
+
+#define EMU_LOG_TRACE(category, ...) \
+  do { if (EMU_LOG_ENABLED(EMU_LOG_LEVEL_TRACE, category)) LOG_TRACE(__VA_ARGS__); } while (0)
+#define EMU_LOG_INFO(category, ...) \
+  do { if (EMU_LOG_ENABLED(EMU_LOG_LEVEL_INFO, category)) LOG_INFO(__VA_ARGS__); } while (0)
+#define EMU_LOG_WARNING(category, ...) \
+  do { if (EMU_LOG_ENABLED(EMU_LOG_LEVEL_WARNING, category)) LOG_WARNING(__VA_ARGS__); } while (0)
+#define EMU_LOG_ERROR(category, ...) \
+  do { if (EMU_LOG_ENABLED(EMU_LOG_LEVEL_ERROR, category)) LOG_ERROR(__VA_ARGS__); } while (0)
+
+#endif // !EMU_LOG_H
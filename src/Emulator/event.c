@@ -0,0 +1,60 @@
+#include "event.h"
+#include <util.h>
+#include <stdlib.h>
+#include <string.h>
+
+Result emu_event_channel_init(EmuEventChannel* channel, u32 capacity) {
+  if (!channel || capacity == 0) {
+    return result_error(Error_NullPointer, "invalid args to emu_event_channel_init");
+  }
+
+  u32 size = 1;
+  while (size < capacity)
+    size <<= 1;
+
+  memset(channel, 0, sizeof(*channel));
+  channel->events = malloc(sizeof(EmuEvent) * size);
+  if (!channel->events) {
+    return result_error(Error_NullPointer, "no mem for %u events", size);
+  }
+
+  channel->capacity = size;
+  atomic_init(&channel->head, 0);
+  atomic_init(&channel->tail, 0);
+  atomic_init(&channel->dropped, 0);
+  return result_ok();
+}
+
+void emu_event_channel_destroy(EmuEventChannel* channel) {
+  if (!channel) return;
+
+  free(channel->events);
+  channel->events = NULL;
+  channel->capacity = 0;
+}
+
+u32 emu_event_drain(EmuEventChannel* channel, EmuEvent* out, u32 max) {
+  u32 tail = atomic_load_explicit(&channel->tail, memory_order_relaxed);
+  u32 head = atomic_load_explicit(&channel->head, memory_order_acquire);
+
+  u32 count = head - tail;
+  if (count > max) count = max;
+
+  for (u32 i = 0; i < count; i++)
+    out[i] = channel->events[(tail + i) & (channel->capacity - 1)];
+
+  atomic_store_explicit(&channel->tail, tail + count, memory_order_release);
+  return count;
+}
+
+const char* emu_event_kind_string(u8 kind) {
+  switch ((EEmuEventKind)kind) {
+    case EMU_EVENT_INSTR:          return "instr";
+    case EMU_EVENT_OPEN_BUS_READ:  return "open bus read";
+    case EMU_EVENT_OPEN_BUS_WRITE: return "open bus write";
+    case EMU_EVENT_BOOTROM_OFF:    return "bootrom off";
+    case EMU_EVENT_INTERRUPT:      return "interrupt";
+    case EMU_EVENT_NONE:
+    default:                       return "none";
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdatomic.h>
+#include "emu_log.h"
+
+// Binary event channel: fixed size records pushed by the emulation thread without any
+// formatting, drained and printed by another thread (or dropped when nobody does).
+// Single producer, single consumer. The producer never blocks: when the ring is full
+// the event is counted in `dropped` instead.
+
+typedef enum {
+  EMU_EVENT_NONE = 0,
+  EMU_EVENT_INSTR,         // value = opcode, pc = its address
+  EMU_EVENT_OPEN_BUS_READ, // addr = unmapped address read (no cartridge)
+  EMU_EVENT_OPEN_BUS_WRITE,// addr, value = unmapped write (no cartridge)
+  EMU_EVENT_BOOTROM_OFF,   // bootrom unmapped through 0xFF50
+  EMU_EVENT_INTERRUPT,     // value = IE & IF, pc = return address
+} EEmuEventKind;
+
+typedef struct {
+  u64 cycle;
+  u16 pc;
+  u16 addr;
+  u8 kind;  // EEmuEventKind
+  u8 value;
+  u8 reserved[2];
+} EmuEvent;
+
+typedef struct EmuEventChannel {
+  EmuEvent* events;
+  u32 capacity; // power of two
+  _Atomic u32 head; // next slot the producer writes
+  _Atomic u32 tail; // next slot the consumer reads
+  _Atomic u64 dropped;
+} EmuEventChannel;
+
+// `capacity` is rounded up to a power of two
+Result emu_event_channel_init(EmuEventChannel* channel, u32 capacity);
+void emu_event_channel_destroy(EmuEventChannel* channel);
+
+// Copies up to `max` events into `out`, returns how many
+u32 emu_event_drain(EmuEventChannel* channel, EmuEvent* out, u32 max);
+
+const char* emu_event_kind_string(u8 kind);
+
+static inline void emu_event_push(EmuEventChannel* channel, const EmuEvent* event) {
+  u32 head = atomic_load_explicit(&channel->head, memory_order_relaxed);
+  u32 tail = atomic_load_explicit(&channel->tail, memory_order_acquire);
+
+  if (head - tail >= channel->capacity) {
+    atomic_fetch_add_explicit(&channel->dropped, 1, memory_order_relaxed);
+    return;
+  }
+
+  channel->events[head & (channel->capacity - 1)] = *event;
+  atomic_store_explicit(&channel->head, head + 1, memory_order_release);
+}
+
+// Pushes an event built from designated initializers when `category` is traced and the
+// cpu has a channel attached. Compiles to nothing below EMU_LOG_LEVEL_TRACE
+#define EMU_EVENT(cpu, category, ...)                                       \
+  do {                                                                      \
+    if (EMU_LOG_ENABLED(EMU_LOG_LEVEL_TRACE, category) && (cpu)->events) {  \
+      EmuEvent event__ = { __VA_ARGS__ };                                   \
+      emu_event_push((cpu)->events, &event__);                              \
+    }                                                                       \
+  } while (0)
+
+#endif // !EVENT_H
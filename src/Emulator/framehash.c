@@ -0,0 +1,295 @@
+#include "framehash.h"
+#include <util.h>
+#include <Emulator/mem.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* REGION_NAMES[FRAMEHASH_MAX_REGIONS] = {
+  [FRAMEHASH_VRAM] = "vram",
+  [FRAMEHASH_WRAM] = "wram",
+  [FRAMEHASH_OAM]  = "oam",
+  [FRAMEHASH_HRAM] = "hram",
+  [FRAMEHASH_ERAM] = "eram",
+};
+
+//
+// XXH64
+//
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ull
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define XXH_PRIME64_3 0x165667B19E3779F9ull
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ull
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ull
+
+static inline u64 xxh_rotl(u64 x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 xxh_read64(const u8* p) {
+  u64 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline u32 xxh_read32(const u8* p) {
+  u32 v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline u64 xxh_round(u64 acc, u64 input) {
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline u64 xxh_merge_round(u64 acc, u64 val) {
+  acc ^= xxh_round(0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// Little endian hosts only, like the trace format
+u64 xxh64(const void* data, size_t len, u64 seed) {
+  const u8* p = (const u8*)data;
+  const u8* end = p + len;
+  u64 h;
+
+  if (len >= 32) {
+    u64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    u64 v2 = seed + XXH_PRIME64_2;
+    u64 v3 = seed;
+    u64 v4 = seed - XXH_PRIME64_1;
+
+    const u8* limit = end - 32;
+    do {
+      v1 = xxh_round(v1, xxh_read64(p));
+      v2 = xxh_round(v2, xxh_read64(p + 8));
+      v3 = xxh_round(v3, xxh_read64(p + 16));
+      v4 = xxh_round(v4, xxh_read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+    h = xxh_merge_round(h, v1);
+    h = xxh_merge_round(h, v2);
+    h = xxh_merge_round(h, v3);
+    h = xxh_merge_round(h, v4);
+  } else {
+    h = seed + XXH_PRIME64_5;
+  }
+
+  h += (u64)len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0, xxh_read64(p));
+    h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= (u64)xxh_read32(p) * XXH_PRIME64_1;
+    h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (u64)(*p) * XXH_PRIME64_5;
+    h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+//
+// Regions
+//
+
+static bool region_lookup(const char* name, size_t len, u8* region) {
+  for (u8 i = 0; i < FRAMEHASH_MAX_REGIONS; i++) {
+    if (strlen(REGION_NAMES[i]) == len && strncmp(REGION_NAMES[i], name, len) == 0) {
+      *region = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Appends the regions named in `list` (separated by commas or spaces)
+static Result parse_regions(FrameHasher* hasher, const char* list) {
+  const char* p = list;
+  while (p && *p) {
+    size_t len = strcspn(p, ", \t\r\n");
+    if (len > 0) {
+      u8 region;
+      if (!region_lookup(p, len, &region)) {
+        return result_error(Error_FileIO, "unknown hash region '%.*s'", (int)len, p);
+      }
+      if (hasher->region_count == FRAMEHASH_MAX_REGIONS) {
+        return result_error(Error_FileIO, "too many hash regions");
+      }
+      hasher->regions[hasher->region_count++] = region;
+    }
+    p += len;
+    if (*p) p++;
+  }
+  return result_ok();
+}
+
+static u64 hash_region(const Mem* mem, u8 region) {
+  switch (region) {
+    case FRAMEHASH_VRAM: return xxh64(mem->vram, sizeof(mem->vram), 0);
+    case FRAMEHASH_WRAM: return xxh64(mem->wram, sizeof(mem->wram), 0);
+    case FRAMEHASH_OAM:  return xxh64(mem->oam,  sizeof(mem->oam),  0);
+    case FRAMEHASH_HRAM: return xxh64(mem->hram, sizeof(mem->hram), 0);
+    case FRAMEHASH_ERAM: return xxh64(mem->eram, sizeof(mem->eram), 0);
+  }
+  return 0;
+}
+
+//
+// Record / compare
+//
+
+Result framehash_open_record(FrameHasher* hasher, const char* path, const char* regions) {
+  if (!hasher || !path) {
+    return result_error(Error_NullPointer, "invalid args to framehash_open_record");
+  }
+  memset(hasher, 0, sizeof(*hasher));
+  hasher->mode = FRAMEHASH_RECORD;
+
+  Result r = parse_regions(hasher, regions);
+  if (result_is_error(&r)) return r;
+
+  hasher->log = fopen(path, "w");
+  if (!hasher->log) {
+    return result_error(Error_FileIO, "failed to open hash log: %s", path);
+  }
+
+  fprintf(hasher->log, "# frame cycle framebuffer");
+  for (u8 i = 0; i < hasher->region_count; i++)
+    fprintf(hasher->log, " %s", REGION_NAMES[hasher->regions[i]]);
+  fputc('\n', hasher->log);
+
+  return result_ok();
+}
+
+Result framehash_open_compare(FrameHasher* hasher, const char* path) {
+  if (!hasher || !path) {
+    return result_error(Error_NullPointer, "invalid args to framehash_open_compare");
+  }
+  memset(hasher, 0, sizeof(*hasher));
+  hasher->mode = FRAMEHASH_COMPARE;
+
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return result_error(Error_FileIO, "failed to open golden hash log: %s", path);
+  }
+
+  static const char HEADER[] = "# frame cycle framebuffer";
+  char line[512];
+  Result r = result_ok();
+  if (!fgets(line, sizeof(line), f) || strncmp(line, HEADER, sizeof(HEADER) - 1) != 0) {
+    r = result_error(Error_FileIO, "%s: not a hash log", path);
+    goto done;
+  }
+  r = parse_regions(hasher, line + sizeof(HEADER) - 1);
+  if (result_is_error(&r)) goto done;
+
+  u32 per_frame = 1u + hasher->region_count;
+  u64 capacity = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+
+    if (hasher->golden_frames == capacity) {
+      capacity = capacity ? capacity * 2 : 1024;
+      u64* golden = realloc(hasher->golden, capacity * per_frame * sizeof(u64));
+      if (!golden) {
+        r = result_error(Error_NullPointer, "no mem for golden hashes");
+        goto done;
+      }
+      hasher->golden = golden;
+    }
+
+    char* p = line;
+    strtoull(p, &p, 10); // frame
+    strtoull(p, &p, 10); // cycle
+    u64* hashes = &hasher->golden[hasher->golden_frames * per_frame];
+    for (u32 i = 0; i < per_frame; i++) {
+      char* next;
+      hashes[i] = strtoull(p, &next, 16);
+      if (next == p) {
+        r = result_error(Error_FileIO, "%s: truncated line for frame %llu", path,
+                         (unsigned long long)hasher->golden_frames);
+        goto done;
+      }
+      p = next;
+    }
+    hasher->golden_frames++;
+  }
+
+done:
+  fclose(f);
+  if (result_is_error(&r))
+    framehash_close(hasher);
+  return r;
+}
+
+Result framehash_close(FrameHasher* hasher) {
+  if (!hasher) return result_ok();
+
+  Result r = result_ok();
+  if (hasher->log && fclose(hasher->log) != 0)
+    r = result_error(Error_FileIO, "failed to write hash log");
+  hasher->log = NULL;
+
+  free(hasher->golden);
+  hasher->golden = NULL;
+  hasher->golden_frames = 0;
+  return r;
+}
+
+static void hash_frame(FrameSink* sink, Cpu* cpu) {
+  FrameHasher* hasher = (FrameHasher*)sink;
+
+  u64 hashes[1 + FRAMEHASH_MAX_REGIONS];
+  hashes[0] = xxh64(cpu->ppu.framebuffer, sizeof(cpu->ppu.framebuffer), 0);
+  for (u8 i = 0; i < hasher->region_count; i++)
+    hashes[1 + i] = hash_region(cpu->mem, hasher->regions[i]);
+
+  u64 frame = hasher->frames++;
+  u32 per_frame = 1u + hasher->region_count;
+
+  if (hasher->mode == FRAMEHASH_RECORD) {
+    fprintf(hasher->log, "%llu %llu", (unsigned long long)frame, (unsigned long long)cpu->clock_cycles);
+    for (u32 i = 0; i < per_frame; i++)
+      fprintf(hasher->log, " %016llx", (unsigned long long)hashes[i]);
+    fputc('\n', hasher->log);
+    return;
+  }
+
+  // Past the end of the golden log there is nothing left to compare
+  if (hasher->diverged || frame >= hasher->golden_frames)
+    return;
+
+  const u64* expected = &hasher->golden[frame * per_frame];
+  for (u32 i = 0; i < per_frame; i++) {
+    if (hashes[i] == expected[i]) continue;
+
+    hasher->diverged = true;
+    snprintf(hasher->message, sizeof(hasher->message),
+             "frame %llu (cycle %llu): %s hash %016llx, expected %016llx",
+             (unsigned long long)frame, (unsigned long long)cpu->clock_cycles,
+             i == 0 ? "framebuffer" : REGION_NAMES[hasher->regions[i - 1]],
+             (unsigned long long)hashes[i], (unsigned long long)expected[i]);
+    cpu->paused = true;
+    return;
+  }
+}
+
+void framehash_attach(FrameHasher* hasher, Cpu* cpu) {
+  hasher->sink.frame = hash_frame;
+  cpu_add_frame_sink(cpu, &hasher->sink);
+}
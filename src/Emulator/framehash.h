@@ -0,0 +1,65 @@
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include "cpu/cpu.h"
+
+// Per frame hashes for regression runs: every time the ppu completes a frame (enters
+// VBlank), the framebuffer and a chosen set of memory regions are hashed with XXH64 and
+// either written to a log or compared against a golden log. Comparing stops the cpu at
+// the first frame that differs.
+//
+// The log is text, one line per frame: `<frame> <cycle> <hash>...` with the hashes in
+// hex, framebuffer first then the regions in the order of the header line
+// (`# frame cycle framebuffer vram wram`). The cycle is informative, only hashes are
+// compared.
+
+#define FRAMEHASH_MAX_REGIONS 5
+
+typedef enum {
+  FRAMEHASH_VRAM = 0,
+  FRAMEHASH_WRAM,
+  FRAMEHASH_OAM,
+  FRAMEHASH_HRAM,
+  FRAMEHASH_ERAM,
+} EFrameHashRegion;
+
+typedef enum {
+  FRAMEHASH_RECORD = 0,
+  FRAMEHASH_COMPARE,
+} EFrameHashMode;
+
+typedef struct FrameHasher {
+  FrameSink sink;
+  EFrameHashMode mode;
+  u8 regions[FRAMEHASH_MAX_REGIONS]; // EFrameHashRegion, hashed in this order
+  u8 region_count;
+
+  FILE* log;         // record mode
+  u64* golden;       // compare mode: 1 + region_count hashes per frame
+  u64 golden_frames;
+
+  u64 frames; // frames hashed
+  bool diverged;
+  char message[160]; // what differed, once diverged
+} FrameHasher;
+
+// XXH64 of `len` bytes
+u64 xxh64(const void* data, size_t len, u64 seed);
+
+// Writes hashes to `path`. `regions` is a comma separated list of vram, wram, oam, hram
+// and eram, NULL or empty for the framebuffer only
+Result framehash_open_record(FrameHasher* hasher, const char* path, const char* regions);
+
+// Compares against the log at `path`, with the regions it was recorded with
+Result framehash_open_compare(FrameHasher* hasher, const char* path);
+
+Result framehash_close(FrameHasher* hasher);
+
+// Starts hashing the frames the cpu completes from now on. In compare mode the cpu is
+// paused at the first one that doesn't match the golden log
+void framehash_attach(FrameHasher* hasher, Cpu* cpu);
+
+#endif // !FRAMEHASH_H
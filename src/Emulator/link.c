@@ -0,0 +1,71 @@
+#include "link.h"
+#include <util.h>
+#include <string.h>
+
+// The peer sits at the same cycle (see link_cable_run_cycles), so it is clocked right away
+static u8 cable_exchange(SerialLink* link, u8 out, u64 now) {
+  (void)now;
+  Cpu* peer = &((Machine*)link->ctx)->cpu;
+  return serial_receive(&peer->serial, out, &peer->interrupt_flag);
+}
+
+Result link_cable_init(LinkCable* cable, Machine* a, Machine* b) {
+  if (!cable || !a || !b || a == b) {
+    return result_error(Error_NullPointer, "invalid args to link_cable_init");
+  }
+  memset(cable, 0, sizeof(*cable));
+
+  cable->machines[0] = a;
+  cable->machines[1] = b;
+  for (int i = 0; i < 2; i++) {
+    cable->ends[i].exchange = cable_exchange;
+    cable->ends[i].ctx = cable->machines[1 - i];
+    cable->machines[i]->cpu.serial.link = &cable->ends[i];
+  }
+
+  return result_ok();
+}
+
+void link_cable_destroy(LinkCable* cable) {
+  if (!cable) return;
+
+  for (int i = 0; i < 2; i++) {
+    if (cable->machines[i] && cable->machines[i]->cpu.serial.link == &cable->ends[i])
+      cable->machines[i]->cpu.serial.link = NULL;
+  }
+}
+
+Result link_cable_run_cycles(LinkCable* cable, u64 cycles) {
+  if (!cable || !cable->machines[0] || !cable->machines[1]) {
+    return result_error(Error_NullPointer, "invalid cable to link_cable_run_cycles");
+  }
+
+  u64 done = 0;
+  while (done < cycles) {
+    u64 slice = cycles - done;
+    if (slice > LINK_SLICE_CYCLES)
+      slice = LINK_SLICE_CYCLES;
+
+    // Cut the slice at the first transfer end. That machine runs last, so its peer has
+    // already reached the cycle it gets clocked at
+    u64 due[2];
+    for (int i = 0; i < 2; i++) {
+      const Cpu* cpu = &cable->machines[i]->cpu;
+      due[i] = cpu->serial.next_event == SERIAL_NO_EVENT ? UINT64_MAX
+                                                         : cpu->serial.next_event - cpu->clock_cycles;
+      if (due[i] < slice)
+        slice = due[i];
+    }
+    int first = due[0] <= slice ? 1 : 0;
+
+    for (int k = 0; k < 2; k++) {
+      Machine* m = cable->machines[k == 0 ? first : 1 - first];
+      Result r = machine_run_cycles(m, slice);
+      if (result_is_error(&r)) return r;
+      if (m->cpu.paused) return result_ok();
+    }
+    done += slice;
+  }
+
+  return result_ok();
+}
@@ -0,0 +1,31 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <types.h>
+#include <lresult.h>
+#include <Emulator/machine.h>
+
+// Two machines in the same process joined by a link cable, stepped together by
+// link_cable_run_cycles. They only synchronize where a transfer could cross: every
+// LINK_SLICE_CYCLES, and at the cycle an internal clock transfer ends, where the other
+// machine is brought to the same cycle before it is clocked. Exchanges are then exact,
+// whichever end drives the clock.
+
+// Shorter than a transfer, so one started within a slice always ends in a later one
+#define LINK_SLICE_CYCLES (SERIAL_BYTE_CYCLES / 2)
+
+typedef struct {
+  Machine* machines[2]; // not owned
+  SerialLink ends[2];   // ends[i] is plugged into machines[i]
+} LinkCable;
+
+// Plugs the cable into both machines' serial ports
+Result link_cable_init(LinkCable* cable, Machine* a, Machine* b);
+
+// Unplugs it
+void link_cable_destroy(LinkCable* cable);
+
+// Runs both machines `cycles` more T-cycles, or until one pauses
+Result link_cable_run_cycles(LinkCable* cable, u64 cycles);
+
+#endif // !LINK_H
@@ -0,0 +1,468 @@
+#include "lockstep.h"
+#include <util.h>
+#include <llog.h>
+#include <string.h>
+
+typedef enum {
+  LS_SCALAR = 0,
+  LS_NOP,
+  LS_LD_R8_R8,
+  LS_LD_R8_IMM,
+  LS_LOGIC_R8,
+  LS_CB,
+} ELockstepOp;
+
+static ELockstepOp classify(u8 opcode) {
+  u8 dst = (opcode >> 3) & 0x07;
+  u8 src = opcode & 0x07;
+
+  if (opcode == 0x00)
+    return LS_NOP;
+  if (opcode >= 0x40 && opcode < 0x80 && dst != 6 && src != 6)
+    return LS_LD_R8_R8;
+  if ((opcode & 0xC7) == 0x06 && dst != 6)
+    return LS_LD_R8_IMM;
+  if (opcode >= 0x80 && opcode < 0xC0 && src != 6)
+    return LS_LOGIC_R8;
+  if (opcode == 0xCB)
+    return LS_CB;
+
+  return LS_SCALAR;
+}
+
+//
+// Vector helpers
+//
+static inline LaneVec vload(const u8* p) {
+  LaneVec v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void vstore(u8* p, LaneVec v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// Lanes where `mask` is 0xFF take `v`, the others keep `old`
+static inline LaneVec vblend(LaneVec v, LaneVec old, LaneVec mask) {
+  return (v & mask) | (old & ~mask);
+}
+
+// Comparisons give 0/-1 per lane, flags want 0/1
+static inline LaneVec vbit(LaneVec cmp) {
+  return cmp & 1;
+}
+
+static inline bool vany(LaneVec v) {
+  u64 w[2];
+  memcpy(w, &v, sizeof(w));
+  return (w[0] | w[1]) != 0;
+}
+
+static inline LaneVec vflags(LaneVec z, LaneVec n, LaneVec h, LaneVec c) {
+  return (LaneVec)((z << 7) | (n << 6) | (h << 5) | (c << 4));
+}
+
+//
+// Lane <-> machine transfer
+//
+static void load_lane(Lockstep* ls, int lane) {
+  Cpu* cpu = &ls->machines[lane]->cpu;
+
+  for (int r = 0; r < 8; r++)
+    ls->r8[r][lane] = *cpu_get_reg8_field(cpu, (u8)r);
+  ls->f[lane]      = cpu->r8[F];
+  ls->sp[lane]     = cpu->registers[SP].v;
+  ls->pc[lane]     = cpu->registers[PC].v;
+  ls->ir[lane]     = cpu->IR;
+  ls->cycles[lane] = cpu->clock_cycles;
+  ls->stopped[lane] = cpu->paused;
+}
+
+static void store_lane(Lockstep* ls, int lane) {
+  Cpu* cpu = &ls->machines[lane]->cpu;
+
+  for (int r = 0; r < 8; r++)
+    *cpu_get_reg8_field(cpu, (u8)r) = ls->r8[r][lane];
+  cpu->r8[F]                 = ls->f[lane];
+  cpu->registers[SP].v       = ls->sp[lane];
+  cpu->registers[PC].v       = ls->pc[lane];
+  cpu->IR                    = ls->ir[lane];
+  cpu->clock_cycles          = ls->cycles[lane];
+
+  // What the bus holds after an opcode fetch
+  cpu->addr_value = (u16)(ls->pc[lane] - 1);
+  cpu->data_value = ls->ir[lane];
+}
+
+// Ticks a machine until it sits between two instructions (the state the scalar core
+// leaves it in after the last T-cycle of an instruction)
+static Result reach_boundary(Machine* machine) {
+  Cpu* cpu = &machine->cpu;
+  while (cpu->has_instr || cpu->clock_phase != CLOCK_FALLING) {
+    if (machine_clock_tick(machine)) return cpu->error;
+    if (cpu->paused) break;
+  }
+  return result_ok();
+}
+
+static void scalar_step(Lockstep* ls, int lane) {
+  Machine* m = ls->machines[lane];
+  Cpu* cpu = &m->cpu;
+  store_lane(ls, lane);
+
+  int status = 0;
+  if (cpu->halted && !cpu->has_instr) {
+    // One step of a halted lane jumps to the next event that could wake it and runs that
+    // T-cycle. Still halted, the lane is back at the phase of an instruction boundary
+    do {
+      machine_skip_halted(m, ls->target[lane]);
+      status = machine_clock_tick(m);
+    } while (!status && !cpu->paused && cpu->halted && cpu->clock_phase != CLOCK_FALLING);
+
+    if (cpu->halted || status || cpu->paused)
+      goto done;
+  }
+
+  do {
+    status = machine_clock_tick(m);
+  } while (!status && !cpu->paused && !cpu->has_instr);
+
+  while (!status && !cpu->paused && cpu->has_instr)
+    status = machine_clock_tick(m);
+
+done:
+  load_lane(ls, lane);
+  if (status || cpu->paused)
+    ls->stopped[lane] = true;
+
+  ls->scalar_instrs++;
+}
+
+static inline u8 lane_read8(Lockstep* ls, int lane, u16 addr) {
+  Machine* m = ls->machines[lane];
+  if (ls->shared_rom && addr < ROM_BANK_SIZE)
+    return ls->shared_rom[addr];
+  return mem_read8(&m->mem, &m->cpu, addr);
+}
+
+Result lockstep_init(Lockstep* ls, Machine** machines, int count) {
+  if (!ls || !machines) {
+    return result_error(Error_NullPointer, "invalid args to lockstep_init");
+  }
+  if (count < 1 || count > LOCKSTEP_MAX_LANES) {
+    return result_error(Error_Unknown, "lockstep supports 1..%d lanes, got %d",
+                        LOCKSTEP_MAX_LANES, count);
+  }
+
+  memset(ls, 0, sizeof(*ls));
+  ls->lane_count = count;
+
+  // Bank 0 can only be shared when every lane has the same rom and no bootrom over it
+  const Mem* first = &machines[0]->mem;
+  bool shared = first->rom && first->rom_size >= ROM_BANK_SIZE;
+
+  for (int i = 0; i < count; i++) {
+    Machine* m = machines[i];
+    if (!m) {
+      return result_error(Error_NullPointer, "null machine for lane %d", i);
+    }
+    ls->machines[i] = m;
+    ls->target[i] = UINT64_MAX;
+    m->mem.dma_bulk = true;
+
+    Result r = reach_boundary(m);
+    if (result_is_error(&r)) return r;
+
+    if (m->cpu.bootrom_mapped || !m->mem.rom || m->mem.rom_size < ROM_BANK_SIZE ||
+        memcmp(m->mem.rom, first->rom, ROM_BANK_SIZE) != 0)
+      shared = false;
+
+    load_lane(ls, i);
+  }
+
+  ls->shared_rom = shared ? first->rom : NULL;
+  return result_ok();
+}
+
+void lockstep_store(Lockstep* ls) {
+  for (int i = 0; i < ls->lane_count; i++)
+    store_lane(ls, i);
+}
+
+//
+// Vector bodies, one 16 lane chunk at a time
+//
+static void vec_ld_r8_r8(Lockstep* ls, u8 opcode, int base, LaneVec mask) {
+  u8 dst = (opcode >> 3) & 0x07;
+  u8 src = opcode & 0x07;
+
+  LaneVec v = vload(&ls->r8[src][base]);
+  vstore(&ls->r8[dst][base], vblend(v, vload(&ls->r8[dst][base]), mask));
+}
+
+static void vec_ld_r8_imm(Lockstep* ls, u8 opcode, int base, LaneVec mask, const u8* imm) {
+  u8 dst = (opcode >> 3) & 0x07;
+
+  LaneVec v = vload(&imm[base]);
+  vstore(&ls->r8[dst][base], vblend(v, vload(&ls->r8[dst][base]), mask));
+}
+
+// Same semantics as logic_r8_op_t0
+static void vec_logic_r8(Lockstep* ls, u8 opcode, int base, LaneVec mask) {
+  u8 op_type = (opcode >> 3) & 0x07;
+  u8 src = opcode & 0x07;
+
+  LaneVec a     = vload(&ls->r8[7][base]);
+  LaneVec r     = vload(&ls->r8[src][base]);
+  LaneVec f     = vload(&ls->f[base]);
+  LaneVec carry = (f >> 4) & 1;
+  LaneVec zero  = a ^ a;
+  LaneVec one   = zero + 1;
+  LaneVec an    = a & 0x0F;
+  LaneVec rn    = r & 0x0F;
+
+  LaneVec res, n = zero, h = zero, c = zero;
+
+  switch (op_type) {
+    case 0: // ADD
+      res = a + r;
+      h = vbit((LaneVec)(an + rn > 0x0F));
+      c = vbit((LaneVec)(res < a));
+      break;
+
+    case 1: { // ADC
+      LaneVec t = a + r;
+      res = t + carry;
+      h = vbit((LaneVec)(an + rn + carry > 0x0F));
+      c = vbit((LaneVec)(t < a) | (LaneVec)(res < t));
+    } break;
+
+    case 2: // SUB
+    case 7: // CP
+      res = a - r;
+      n = one;
+      h = vbit((LaneVec)(an < rn));
+      c = vbit((LaneVec)(a < r));
+      break;
+
+    case 3: // SBC
+      res = a - r - carry;
+      n = one;
+      h = vbit((LaneVec)(an < rn) | ((LaneVec)(an == rn) & carry));
+      c = vbit((LaneVec)(a < r) | ((LaneVec)(a == r) & carry));
+      break;
+
+    case 4: res = a & r; h = one; break;
+    case 5: res = a ^ r; break;
+    case 6: res = a | r; break;
+
+    default:
+      return;
+  }
+
+  LaneVec z = vbit((LaneVec)(res == zero));
+  vstore(&ls->f[base], vblend(vflags(z, n, h, c), f, mask));
+
+  if (op_type != 7)
+    vstore(&ls->r8[7][base], vblend(res, a, mask));
+}
+
+// Same semantics as cb_op_t0, register operands only
+static void vec_cb(Lockstep* ls, u8 cb_opcode, int base, LaneVec mask) {
+  u8 op_type = (cb_opcode >> 6) & 0x03;
+  u8 bit_pos = (cb_opcode >> 3) & 0x07;
+  u8 reg     = cb_opcode & 0x07;
+
+  LaneVec x    = vload(&ls->r8[reg][base]);
+  LaneVec f    = vload(&ls->f[base]);
+  LaneVec zero = x ^ x;
+  LaneVec one  = zero + 1;
+  LaneVec res  = x;
+  LaneVec new_f;
+
+  switch (op_type) {
+    case 0x00: {
+      LaneVec old_c = (f >> 4) & 1;
+      LaneVec c;
+
+      switch (bit_pos) {
+        case 0x00: c = x >> 7; res = (LaneVec)((x << 1) | c);         break; // RLC
+        case 0x01: c = x & 1;  res = (LaneVec)((x >> 1) | (c << 7));  break; // RRC
+        case 0x02: c = x >> 7; res = (LaneVec)((x << 1) | old_c);     break; // RL
+        case 0x03: c = x & 1;  res = (LaneVec)((x >> 1) | (old_c << 7)); break; // RR
+        case 0x04: c = x >> 7; res = (LaneVec)(x << 1);               break; // SLA
+        case 0x05: c = x & 1;  res = (LaneVec)((x >> 1) | (x & 0x80)); break; // SRA
+        case 0x06: c = zero;   res = (LaneVec)((x << 4) | (x >> 4));  break; // SWAP
+        default:   c = x & 1;  res = x >> 1;                          break; // SRL
+      }
+
+      new_f = vflags(vbit((LaneVec)(res == zero)), zero, zero, c);
+    } break;
+
+    case 0x01: { // BIT
+      LaneVec z = vbit((LaneVec)((x & (u8)(1 << bit_pos)) == zero));
+      new_f = vflags(z, zero, one, (f >> 4) & 1);
+    } break;
+
+    case 0x02: // RES
+      res = x & (u8)~(1 << bit_pos);
+      new_f = f;
+      break;
+
+    default: // SET
+      res = x | (u8)(1 << bit_pos);
+      new_f = f;
+      break;
+  }
+
+  vstore(&ls->r8[reg][base], vblend(res, x, mask));
+  vstore(&ls->f[base], vblend(new_f, f, mask));
+}
+
+Result lockstep_step(Lockstep* ls) {
+  if (!ls) {
+    return result_error(Error_NullPointer, "invalid lockstep to lockstep_step");
+  }
+
+  int leader = -1;
+  for (int i = 0; i < ls->lane_count; i++) {
+    if (ls->stopped[i] || ls->cycles[i] >= ls->target[i]) continue;
+    if (leader < 0 || ls->cycles[i] < ls->cycles[leader])
+      leader = i;
+  }
+  if (leader < 0)
+    return result_ok();
+
+  u16 pc     = ls->pc[leader];
+  u8 opcode  = ls->ir[leader];
+  ELockstepOp kind = classify(opcode);
+
+  u8 group[LOCKSTEP_MAX_LANES] __attribute__((aligned(16)));
+  memset(group, 0, sizeof(group));
+
+  for (int i = 0; i < ls->lane_count; i++)
+    group[i] = (!ls->stopped[i] && ls->cycles[i] < ls->target[i] && ls->pc[i] == pc &&
+                ls->ir[i] == opcode) ? 0xFF : 0x00;
+
+  if (kind == LS_SCALAR) {
+    for (int i = 0; i < ls->lane_count; i++) {
+      if (group[i]) scalar_step(ls, i);
+    }
+    return result_ok();
+  }
+
+  // Traced lanes take the scalar path, which records them, and so do lanes that are
+  // halted or about to take an interrupt (or enable them) instead of executing IR, and
+  // lanes inside an OAM DMA
+  for (int i = 0; i < ls->lane_count; i++) {
+    const Cpu* cpu = &ls->machines[i]->cpu;
+    bool interrupts = cpu->halted || cpu->ime_pending || (cpu->ime && cpu_pending_interrupts(cpu));
+    bool dma = ls->cycles[i] < ls->machines[i]->mem.dma.end; // fetches may be blocked
+    if (group[i] && (cpu->trace || interrupts || dma)) {
+      scalar_step(ls, i);
+      group[i] = 0x00;
+    }
+  }
+  if (!group[leader])
+    return result_ok();
+
+  // Operand byte at PC (immediate or CB opcode), gathered per lane
+  u8 operand[LOCKSTEP_MAX_LANES] __attribute__((aligned(16)));
+  memset(operand, 0, sizeof(operand));
+
+  if (kind == LS_LD_R8_IMM || kind == LS_CB) {
+    for (int i = 0; i < ls->lane_count; i++) {
+      if (group[i]) operand[i] = lane_read8(ls, i, pc);
+    }
+  }
+
+  if (kind == LS_CB) {
+    // Lanes whose CB opcode differs from the leader's wait for a later step
+    u8 cb_opcode = operand[leader];
+    for (int i = 0; i < ls->lane_count; i++) {
+      if (group[i] && operand[i] != cb_opcode) group[i] = 0x00;
+    }
+
+    if ((cb_opcode & 0x07) == 6) {
+      for (int i = 0; i < ls->lane_count; i++) {
+        if (group[i]) scalar_step(ls, i);
+      }
+      return result_ok();
+    }
+  }
+
+  for (int base = 0; base < ls->lane_count; base += LOCKSTEP_VEC_LANES) {
+    LaneVec mask = vload(&group[base]);
+    if (!vany(mask)) continue;
+
+    switch (kind) {
+      case LS_LD_R8_R8:  vec_ld_r8_r8(ls, opcode, base, mask);           break;
+      case LS_LD_R8_IMM: vec_ld_r8_imm(ls, opcode, base, mask, operand); break;
+      case LS_LOGIC_R8:  vec_logic_r8(ls, opcode, base, mask);           break;
+      case LS_CB:        vec_cb(ls, operand[leader], base, mask);        break;
+      default: break;
+    }
+  }
+
+  // Overlapped fetch of the next opcode
+  bool two_bytes = kind == LS_LD_R8_IMM || kind == LS_CB;
+  u16 fetch_pc   = two_bytes ? (u16)(pc + 1) : pc;
+  u32 tcycles    = two_bytes ? 8 : 4;
+  int members    = 0;
+
+  for (int i = 0; i < ls->lane_count; i++) {
+    if (!group[i]) continue;
+    ls->ir[i]      = lane_read8(ls, i, fetch_pc);
+    ls->pc[i]      = (u16)(fetch_pc + 1);
+    ls->cycles[i] += tcycles;
+    members++;
+
+    // The ppu still runs dot by dot on every lane
+    Machine* m = ls->machines[i];
+    for (u32 t = 0; t < tcycles; t++) {
+      int status = ppu_step(&m->cpu.ppu, &m->mem, &m->cpu.interrupt_flag);
+      if (status) return result_error(status, "bad args to ppu_step");
+    }
+    if (ls->cycles[i] >= m->cpu.timer.next_event)
+      timer_event(&m->cpu.timer, ls->cycles[i], &m->cpu.interrupt_flag);
+    if (ls->cycles[i] >= m->cpu.serial.next_event)
+      serial_event(&m->cpu.serial, ls->cycles[i], &m->cpu.interrupt_flag);
+    if (ls->cycles[i] >= m->mem.dma.next)
+      mem_dma_run(&m->mem, &m->cpu, ls->cycles[i]);
+
+    // Frame input is latched where the scalar core would have latched it
+    if (ls->cycles[i] >= m->next_frame_cycle) {
+      Result r = machine_begin_frame(m);
+      if (result_is_error(&r)) return r;
+    }
+  }
+
+  ls->vector_steps++;
+  ls->vector_lanes += (u64)members;
+  return result_ok();
+}
+
+Result lockstep_run_cycles(Lockstep* ls, u64 cycles) {
+  if (!ls) {
+    return result_error(Error_NullPointer, "invalid lockstep to lockstep_run_cycles");
+  }
+
+  for (int i = 0; i < ls->lane_count; i++)
+    ls->target[i] = ls->cycles[i] + cycles;
+
+  Result r = result_ok();
+  for (;;) {
+    bool pending = false;
+    for (int i = 0; i < ls->lane_count && !pending; i++)
+      pending = !ls->stopped[i] && ls->cycles[i] < ls->target[i];
+    if (!pending) break;
+
+    r = lockstep_step(ls);
+    if (result_is_error(&r)) break;
+  }
+
+  for (int i = 0; i < ls->lane_count; i++)
+    ls->target[i] = UINT64_MAX;
+  return r;
+}
@@ -0,0 +1,66 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <types.h>
+#include <lresult.h>
+#include "machine.h"
+
+// Experimental batch core: N machines running the same rom (with different inputs) keep
+// their register files in struct-of-arrays form. Each step picks the most behind lane,
+// groups every lane sitting at the same PC/IR, and executes that opcode for the whole
+// group with SIMD. Opcodes without a vector implementation, and lanes that diverged,
+// go through the scalar (pin accurate) core of their own machine.
+//
+// A vector step only does what the instruction changes, advances the lane's clock and
+// steps the lane's peripherals for each of its T-cycles, as cpu_clock_tick would. It
+// drives no pins, emits no log or core events, and skips the profiler, the debugger,
+// the instrumentation counters and the frame sinks: lanes that need any of them belong
+// on the scalar core (traced lanes always take it). The bus is set to what the opcode
+// fetch leaves on it when the lanes are stored back.
+
+#define LOCKSTEP_VEC_LANES 16
+#define LOCKSTEP_MAX_LANES 64
+
+typedef u8 LaneVec __attribute__((vector_size(LOCKSTEP_VEC_LANES)));
+
+typedef struct {
+  int lane_count;
+  Machine* machines[LOCKSTEP_MAX_LANES];
+
+  // Indexed by the opcode's 3-bit register field like Cpu.r8 through CPU_R8_FIELD:
+  // B C D E H L (HL) A. Slot 6 carries Z, (HL) operands take the scalar path
+  u8 r8[8][LOCKSTEP_MAX_LANES] __attribute__((aligned(16)));
+  u8 f[LOCKSTEP_MAX_LANES] __attribute__((aligned(16)));
+  u8 ir[LOCKSTEP_MAX_LANES];
+  u16 sp[LOCKSTEP_MAX_LANES];
+  u16 pc[LOCKSTEP_MAX_LANES];
+  u64 cycles[LOCKSTEP_MAX_LANES];
+  u64 target[LOCKSTEP_MAX_LANES]; // lanes at or past it sit out, UINT64_MAX for none
+  bool stopped[LOCKSTEP_MAX_LANES];
+
+  // Bank 0 of the rom every lane shares, so fetches from it are done once per group
+  const u8* shared_rom;
+
+  // Stats
+  u64 vector_steps;  // group instructions executed with SIMD
+  u64 vector_lanes;  // lane instructions covered by those steps
+  u64 scalar_instrs; // lane instructions that went through the scalar core
+} Lockstep;
+
+// Takes over `count` machines sitting at an instruction boundary. Machines stay owned
+// by the caller; their cpu state is stale until lockstep_store(). OAM DMAs are switched
+// to the bulk copy (Mem.dma_bulk)
+Result lockstep_init(Lockstep* ls, Machine** machines, int count);
+
+// Executes one instruction for the group of lanes at the same PC as the most behind lane.
+// Lanes that reached their target don't take part, and halted lanes skip at most up to it
+Result lockstep_step(Lockstep* ls);
+
+// Steps until every live lane has run `cycles` more T-cycles (plus the rest of the
+// instruction that crosses the mark)
+Result lockstep_run_cycles(Lockstep* ls, u64 cycles);
+
+// Writes the lane state back into the machines
+void lockstep_store(Lockstep* ls);
+
+#endif // !LOCKSTEP_H
@@ -0,0 +1,307 @@
+#include "machine.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <Emulator/cpu/instructions/alu.h>
+#include <lresult.h>
+#include <string.h>
+
+Result machine_init(Machine* machine) {
+  if (!machine) {
+    return result_error(Error_NullPointer, "invalid machine to machine_init");
+  }
+
+  Result rmem = mem_init(&machine->mem);
+  if (result_is_error(&rmem)) {
+    return result_error(rmem.error_code,
+                        "failed to init mem: %s", rmem.message);
+  }
+
+  Result rcpu = cpu_init(&machine->cpu, &machine->mem);
+  if (result_is_error(&rcpu)) {
+    return result_error(rcpu.error_code,
+                        "failed to init cpu: %s", rcpu.message);
+  }
+
+  machine->movie            = NULL;
+  machine->input            = 0;
+  machine->frame            = 0;
+  machine->next_frame_cycle = 0;
+  machine->stats_cycle      = 0;
+  machine->fast_forward     = true;
+
+  EMU_LOG_TRACE(EMU_LOG_MACHINE, "machine initialized successfully");
+  return result_ok();
+}
+
+void machine_stats(const Machine* machine, EmuStats* out) {
+  memset(out, 0, sizeof(*out));
+  out->cycles = machine->cpu.clock_cycles - machine->stats_cycle;
+
+#if EMU_STATS
+  out->enabled = true;
+  out->timing  = EMU_STATS_TIMING;
+  out->cpu = machine->cpu.stats;
+  out->mem = machine->mem.stats;
+  out->ppu = machine->cpu.ppu.stats;
+#endif
+}
+
+void machine_stats_reset(Machine* machine) {
+#if EMU_STATS
+  memset(&machine->cpu.stats, 0, sizeof(machine->cpu.stats));
+  memset(&machine->mem.stats, 0, sizeof(machine->mem.stats));
+  memset(&machine->cpu.ppu.stats, 0, sizeof(machine->cpu.ppu.stats));
+#endif
+  machine->stats_cycle = machine->cpu.clock_cycles;
+}
+
+void machine_destroy(Machine* machine) {
+  if (!machine) return;
+
+  mem_destroy(&machine->mem);
+}
+
+Result machine_load_rom(Machine* machine, const char* path) {
+  if (!machine) {
+    return result_error(Error_NullPointer, "invalid machine to machine_load_rom");
+  }
+
+  return mem_load_rom(&machine->mem, path);
+}
+
+void machine_skip_bootrom(Machine* machine) {
+  Cpu* cpu = &machine->cpu;
+
+  // cpu_init already sets the post-boot register values. IR holds a NOP, so the first
+  // instruction stepped is that NOP's fetch of the opcode at PC
+  cpu->bootrom_mapped   = false;
+  cpu->registers[PC].v  = 0x0100;
+  cpu->IR               = 0x00;
+  cpu->has_instr        = false;
+
+  timer_set_counter(&cpu->timer, cpu->clock_cycles, 0xABCC);
+}
+
+Result machine_reset(Machine* machine) {
+  if (!machine) {
+    return result_error(Error_NullPointer, "invalid machine to machine_reset");
+  }
+  Cpu* cpu = &machine->cpu;
+  Mem* mem = &machine->mem;
+
+  // What outlives the power cycle
+  u8* rom                        = mem->rom;
+  u32 rom_size                   = mem->rom_size;
+  u16 rom_banks                  = mem->rom_banks;
+  ECartType type                 = mem->cart_type;
+  bool dma_bulk                  = mem->dma_bulk;
+  struct EmuEventChannel* events = cpu->events;
+  struct TraceRecorder* trace    = cpu->trace;
+  struct Profiler* profiler      = cpu->profiler;
+  struct Debugger* debugger      = cpu->debugger;
+  FrameSink* frame_sinks         = cpu->frame_sinks;
+  SerialLink* link               = cpu->serial.link;
+
+  Result r = mem_init(mem);
+  if (result_is_error(&r)) return r;
+  r = cpu_init(cpu, mem);
+  if (result_is_error(&r)) return r;
+
+  mem->rom         = rom;
+  mem->rom_size    = rom_size;
+  mem->rom_banks   = rom_banks;
+  mem->cart_type   = type;
+  mem->dma_bulk    = dma_bulk;
+  cpu->events      = events;
+  cpu->trace       = trace;
+  cpu->profiler    = profiler;
+  cpu->debugger    = debugger;
+  cpu->frame_sinks = frame_sinks;
+  cpu->serial.link = link;
+
+  machine->frame            = 0;
+  machine->next_frame_cycle = 0;
+  machine->stats_cycle      = 0;
+  machine_skip_bootrom(machine);
+  return result_ok();
+}
+
+Result machine_begin_frame(Machine* machine) {
+  if (!machine) {
+    return result_error(Error_NullPointer, "invalid machine to machine_begin_frame");
+  }
+
+  u8 buttons = machine->input;
+  Movie* movie = machine->movie;
+
+  if (movie && movie->mode == MOVIE_PLAYING) {
+    // Past the end of the movie nothing is held
+    movie_next_frame(movie, &buttons);
+  } else if (movie && movie->mode == MOVIE_RECORDING) {
+    Result r = movie_append_frame(movie, buttons);
+    if (result_is_error(&r)) return r;
+  }
+
+  if (joypad_set_buttons(&machine->cpu.joypad, buttons))
+    machine->cpu.interrupt_flag |= INT_JOYPAD;
+
+  machine->frame++;
+  machine->next_frame_cycle += CYCLES_PER_FRAME;
+  return result_ok();
+}
+
+int machine_clock_tick(Machine* machine) {
+  if (machine->cpu.clock_cycles >= machine->next_frame_cycle) {
+    Result r = machine_begin_frame(machine);
+    if (result_is_error(&r)) {
+      machine->cpu.error = r;
+      return r.error_code;
+    }
+  }
+
+  return cpu_clock_tick(&machine->cpu);
+}
+
+// Cycles that can be skipped before anything a halted cpu or a polling loop looks at may
+// change. The last one is ticked normally, so a run still ends on the phase that counts
+// `target`
+static u64 idle_window(const Machine* machine, u64 target) {
+  const Cpu* cpu = &machine->cpu;
+
+  u64 until = target - 1;
+  if (machine->next_frame_cycle && machine->next_frame_cycle - 1 < until)
+    until = machine->next_frame_cycle - 1;
+
+  u32 dots = ppu_dots_to_event(&cpu->ppu);
+  if (dots != UINT32_MAX && cpu->clock_cycles + dots - 1 < until)
+    until = cpu->clock_cycles + dots - 1;
+
+  if (cpu->timer.next_event - 1 < until)
+    until = cpu->timer.next_event - 1;
+  if (cpu->serial.next_event - 1 < until)
+    until = cpu->serial.next_event - 1;
+
+  return until > cpu->clock_cycles ? until - cpu->clock_cycles : 0;
+}
+
+// Registers whose value only changes on a ppu event, a timer overflow or serial transfer
+// (IF, SB, SC) or at a frame start (joypad input). DIV and TIMA count on their own. A
+// linked machine only clocks the port between runs
+static bool idle_pollable(u16 addr) {
+  return addr == 0xFF00 || addr == 0xFF01 || addr == 0xFF02 || addr == 0xFF0F ||
+         (addr >= 0xFF40 && addr <= 0xFF4B);
+}
+
+// Halted cycles only advance the clock and the ppu dot counter until the ppu changes mode
+// or line, the timer overflows, a serial transfer ends or the next frame begins (joypad
+// input), so those are jumped over in one go. Nothing else can wake the cpu: no register
+// is written while it is halted, and the ppu was stepped past the HALT's own writes
+void machine_skip_halted(Machine* machine, u64 target) {
+  Cpu* cpu = &machine->cpu;
+  if (!cpu->halted || cpu->has_instr || cpu->clock_phase != CLOCK_LOW)
+    return;
+
+  u64 n = idle_window(machine, target);
+  if (n == 0)
+    return;
+
+  ppu_skip(&cpu->ppu, (u32)n);
+  cpu->clock_cycles += n;
+  mem_dma_run(&machine->mem, cpu, cpu->clock_cycles);
+  EMU_STAT_ADD(cpu->stats.halt_skipped_cycles, n);
+}
+
+void machine_skip_idle(Machine* machine, u64 target) {
+  Cpu* cpu = &machine->cpu;
+  if (cpu->has_instr || cpu->halted || cpu->clock_phase != CLOCK_FALLING || cpu->IR != 0xF0)
+    return;
+  if (cpu->trace || cpu->profiler || cpu->debugger)
+    return;
+  if (cpu->ime_pending || (cpu->ime && cpu_pending_interrupts(cpu)))
+    return;
+  // The loop's own fetches may be blocked by a running OAM DMA
+  if (cpu->clock_cycles < machine->mem.dma.end)
+    return;
+
+  // ldh a, [n]
+  u16 head = (u16)(cpu->registers[PC].v - 1);
+  u16 reg  = (u16)(0xFF00 | mem_peek8(&machine->mem, cpu, cpu->registers[PC].v));
+  if (!idle_pollable(reg))
+    return;
+
+  // Optional cp d8 / and d8
+  u16 p = (u16)(head + 2);
+  u8 op = mem_peek8(&machine->mem, cpu, p);
+  u8 operand = 0;
+  u32 period = 12 + 12; // LDH + JR taken, in T-cycles
+  if (op == 0xFE || op == 0xE6) {
+    operand = mem_peek8(&machine->mem, cpu, (u16)(p + 1));
+    period += 8;
+    p += 2;
+  } else {
+    op = 0x00;
+  }
+
+  // jr cc, head, which just jumped here (it leaves WZ on its target). The state after
+  // each iteration is then the same: A/F from the value read, WZ = head, IR = 0xF0
+  u8 jr = mem_peek8(&machine->mem, cpu, p);
+  if (jr != 0x18 && (jr & 0xE7) != 0x20)
+    return;
+  u16 jr_target = (u16)(p + 2 + (int8_t)mem_peek8(&machine->mem, cpu, (u16)(p + 1)));
+  if (jr_target != head || cpu->instr.opcode != jr || cpu->instr.interrupt ||
+      cpu->registers[WZ].v != head)
+    return;
+
+  u64 iterations = idle_window(machine, target) / period;
+  if (iterations == 0)
+    return;
+
+  // One iteration on the value the register holds for the whole window
+  u8 a = cpu->r8[A];
+  u8 f = cpu->r8[F];
+  cpu->r8[A] = mem_peek8(&machine->mem, cpu, reg);
+  if (op == 0xFE)
+    alu_cp(cpu, operand);
+  else if (op == 0xE6)
+    alu_and(cpu, operand);
+
+  if (jr != 0x18) {
+    EFlag flag = (jr & 0x10) ? FC : FZ;
+    bool taken = cpu_get_flag(cpu, flag) == ((jr & 0x08) != 0);
+    if (!taken) {
+      // The loop exits on this value: run it normally
+      cpu->r8[A] = a;
+      cpu->r8[F] = f;
+      return;
+    }
+  }
+
+  u64 n = iterations * period;
+  ppu_skip(&cpu->ppu, (u32)n);
+  cpu->clock_cycles += n;
+  mem_dma_run(&machine->mem, cpu, cpu->clock_cycles);
+  EMU_STAT_ADD(cpu->stats.idle_skipped_cycles, n);
+}
+
+Result machine_run_cycles(Machine* machine, u64 cycles) {
+  if (!machine) {
+    return result_error(Error_NullPointer, "invalid machine to machine_run_cycles");
+  }
+
+  Cpu* cpu = &machine->cpu;
+  u64 target = cpu->clock_cycles + cycles;
+
+  while (cpu->clock_cycles < target && !cpu->paused) {
+    if (machine->fast_forward && !cpu->has_instr) {
+      if (cpu->halted)
+        machine_skip_halted(machine, target);
+      else if (cpu->clock_phase == CLOCK_FALLING)
+        machine_skip_idle(machine, target);
+    }
+
+    if (machine_clock_tick(machine))
+      return cpu->error;
+  }
+
+  return result_ok();
+}
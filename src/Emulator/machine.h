@@ -0,0 +1,75 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <types.h>
+#include <lresult.h>
+#include <Emulator/cpu/cpu.h>
+#include <Emulator/mem.h>
+#include <Emulator/movie.h>
+#include <Emulator/stats.h>
+
+// T-cycles in one 59.7Hz frame (154 lines * 456 dots)
+#define CYCLES_PER_FRAME 70224
+
+// A complete emulated GameBoy. Everything an emulation step touches lives in here,
+// so any number of machines can be stepped concurrently (one thread per machine)
+typedef struct Machine {
+  Cpu cpu;
+  Mem mem;
+
+  // Joypad input is latched once per frame, so a movie replays identically
+  Movie* movie;          // optional, not owned. Played back or recorded depending on its mode
+  u8 input;              // buttons held by the frontend, applied at the next frame start
+  u64 frame;             // frames started so far
+  u64 next_frame_cycle;  // clock_cycles at which the next frame starts
+  u64 stats_cycle;       // clock_cycles when the instrumentation counters were last reset
+
+  // machine_run_cycles jumps over halted cycles and idle polling loops (same end state
+  // as stepping them). On by default, off to step every cycle when debugging the core
+  bool fast_forward;
+} Machine;
+
+// Initializes mem and cpu to default values and links them together
+Result machine_init(Machine* machine);
+
+// Frees everything owned by the machine (not the machine itself)
+void machine_destroy(Machine* machine);
+
+// Loads a cartridge rom into the machine's memory map
+Result machine_load_rom(Machine* machine, const char* path);
+
+// Puts the cpu in the state the bootrom leaves it in, so execution starts at 0x0100
+void machine_skip_bootrom(Machine* machine);
+
+// Power cycles the machine straight into the post-boot state at frame 0, as a freshly
+// loaded one after machine_skip_bootrom. The cartridge rom, the movie, the input and the
+// host-side hooks (events, trace, profiler, debugger, frame sinks, serial link) are kept
+Result machine_reset(Machine* machine);
+
+// Latches the input for a new frame (from the movie when playing, else from `input`,
+// which is appended to the movie when recording). Called by machine_clock_tick
+Result machine_begin_frame(Machine* machine);
+
+// Advances the machine by one clock phase. Returns 0 or an EAppError code, with the
+// details in machine->cpu.error
+int machine_clock_tick(Machine* machine);
+
+// With the cpu halted at the LOW phase, jumps the clock (at most up to `target`) to just
+// before the next cycle that could wake it. Called by machine_run_cycles
+void machine_skip_halted(Machine* machine, u64 target);
+
+// At an instruction boundary inside a loop that only polls an I/O register and branches
+// back (`ldh a,[n]; [cp/and d8;] jr cc, loop`), jumps over every iteration that reads
+// the same value, i.e. up to the next ppu event or frame start (at most up to `target`).
+// Only called right after the loop's own JR, with no trace, profiler or debugger attached
+void machine_skip_idle(Machine* machine, u64 target);
+
+// Copies the instrumentation counters of every subsystem (see stats.h). `enabled` is
+// false when they are compiled out
+void machine_stats(const Machine* machine, EmuStats* out);
+void machine_stats_reset(Machine* machine);
+
+// Ticks until `cycles` more T-cycles have elapsed, or the cpu pauses (e.g. unimplemented opcode)
+Result machine_run_cycles(Machine* machine, u64 cycles);
+
+#endif // !MACHINE_H
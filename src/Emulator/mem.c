@@ -1,15 +1,71 @@
 #include "mem.h"
-#include <llog.h>
+#include <Emulator/emu_log.h>
+#include <Emulator/event.h>
+#include <Emulator/trace.h>
+#include <Emulator/debugger.h>
 #include <util.h>
 #include <lresult.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "cpu/cpu.h"
 
+static u8 cart_read8(const Mem* mem, u16 addr) {
+  if (addr < 0x4000) {
+    return addr < mem->rom_size ? mem->rom[addr] : 0xFF;
+  }
+  if (addr < 0x8000) {
+    u32 offset = (u32)mem->rom_bank * ROM_BANK_SIZE + (addr - 0x4000);
+    return offset < mem->rom_size ? mem->rom[offset] : 0xFF;
+  }
+  // External RAM
+  return mem->eram[addr - 0xA000];
+}
+
+static void cart_write8(Mem* mem, u16 addr, u8 val) {
+  if (addr >= 0xA000) {
+    mem->eram[addr - 0xA000] = val;
+    return;
+  }
+
+  if (mem->cart_type != CART_MBC1)
+    return;
+
+  // MBC1 rom bank select (lower 5 bits, bank 0 maps to 1)
+  if (addr >= 0x2000 && addr < 0x4000) {
+    u16 bank = val & 0x1F;
+    if (bank == 0) bank = 1;
+    mem->rom_bank = bank % mem->rom_banks;
+  }
+}
+
+#if EMU_STATS
+static inline EMemRegion cart_region(u16 addr) {
+  if (addr < 0x4000) return MEM_REGION_ROM0;
+  if (addr < 0x8000) return MEM_REGION_ROMX;
+  return MEM_REGION_ERAM;
+}
+#endif
+
 static u8 read_io_register(Cpu* cpu, u16 addr) {
   // TODO
   switch (addr) {
     case 0xFF00:
-      return 0xCF;
+      return joypad_read(&cpu->joypad);
+
+    case 0xFF01: case 0xFF02:
+      return serial_read_register(&cpu->serial, addr);
+
+    case 0xFF04: case 0xFF05: case 0xFF06: case 0xFF07:
+      return timer_read_register(&cpu->timer, cpu->clock_cycles, &cpu->interrupt_flag, addr);
+
+    case 0xFF0F:
+      return cpu->interrupt_flag | 0xE0;
+
+    case 0xFF40: case 0xFF41: case 0xFF42: case 0xFF43:
+    case 0xFF44: case 0xFF45: case 0xFF46: case 0xFF47:
+    case 0xFF48: case 0xFF49: case 0xFF4A: case 0xFF4B:
+      return ppu_read_register(&cpu->ppu, addr);
 
     default:
       return 0xFF;
@@ -18,10 +74,43 @@ static u8 read_io_register(Cpu* cpu, u16 addr) {
 
 static void write_io_register(Cpu* cpu, u16 addr, u8 val) {
   switch (addr) {
+    case 0xFF00:
+      joypad_write(&cpu->joypad, val);
+      return;
+
+    case 0xFF01: case 0xFF02:
+      serial_write_register(&cpu->serial, cpu->clock_cycles, addr, val);
+      return;
+
+    case 0xFF04: case 0xFF05: case 0xFF06: case 0xFF07:
+      timer_write_register(&cpu->timer, cpu->clock_cycles, &cpu->interrupt_flag, addr, val);
+      return;
+
+    case 0xFF0F:
+      cpu->interrupt_flag = val | 0xE0;
+      return;
+
+    case 0xFF46:
+      ppu_write_register(&cpu->ppu, addr, val);
+      mem_dma_start(cpu->mem, cpu, val);
+      return;
+
+    case 0xFF40: case 0xFF41: case 0xFF42: case 0xFF43:
+    case 0xFF44: case 0xFF45: case 0xFF47:
+    case 0xFF48: case 0xFF49: case 0xFF4A: case 0xFF4B:
+      ppu_write_register(&cpu->ppu, addr, val);
+      return;
+
     case 0xFF50: {
       if (val != 0) {
         cpu->bootrom_mapped = false;
-        LOG_TRACE("unmapped bootrom");
+        EMU_LOG_TRACE(EMU_LOG_CPU, "unmapped bootrom");
+        EMU_EVENT(cpu, EMU_LOG_CPU,
+                  .cycle = cpu->clock_cycles,
+                  .pc    = cpu->registers[PC].v,
+                  .addr  = addr,
+                  .kind  = EMU_EVENT_BOOTROM_OFF,
+                  .value = val);
       }
       return;
     }
@@ -33,24 +122,132 @@ Result mem_init(Mem *mem) {
     return result_error(Error_NullPointer, "invalid mem to mem_init");
   }
   memset(mem, 0, sizeof(*mem));
+  mem->cart_type = CART_NONE;
+  mem->rom_bank  = 1;
+  mem->dma.next  = OAM_DMA_IDLE;
+
+  return result_ok();
+}
+
+void mem_destroy(Mem* mem) {
+  if (!mem) return;
+
+  free(mem->rom);
+  mem->rom       = NULL;
+  mem->rom_size  = 0;
+  mem->cart_type = CART_NONE;
+}
+
+Result mem_load_rom(Mem* mem, const char* path) {
+  if (!mem || !path) {
+    return result_error(Error_NullPointer, "invalid args to mem_load_rom");
+  }
+
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return result_error(Error_FileIO, "failed to open rom at: %s", path);
+
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  if (size < 0x150) {
+    fclose(f);
+    return result_error(Error_FileIO, "rom too small to hold a header (%ld bytes): %s", size, path);
+  }
+
+  u8* rom = malloc((size_t)size);
+  if (!rom) {
+    fclose(f);
+    return result_error(Error_NullPointer, "no mem for rom (%ld bytes)", size);
+  }
 
+  size_t bytes_read = fread(rom, 1, (size_t)size, f);
+  fclose(f);
+  if (bytes_read < (size_t)size) {
+    free(rom);
+    return result_error(Error_FileIO, "short read on rom: %s", path);
+  }
+
+  Result r = mem_load_rom_data(mem, rom, (u32)size);
+  free(rom);
+  return r;
+}
+
+Result mem_load_rom_data(Mem* mem, const u8* data, u32 size) {
+  if (!mem || !data) {
+    return result_error(Error_NullPointer, "invalid args to mem_load_rom_data");
+  }
+  if (size < 0x150) {
+    return result_error(Error_FileIO, "rom too small to hold a header (%u bytes)", size);
+  }
+
+  u8* rom = malloc(size);
+  if (!rom) {
+    return result_error(Error_NullPointer, "no mem for rom (%u bytes)", size);
+  }
+  memcpy(rom, data, size);
+
+  ECartType type;
+  switch (rom[0x147]) {
+    case 0x00: case 0x08: case 0x09:
+      type = CART_ROM_ONLY;
+      break;
+    case 0x01: case 0x02: case 0x03:
+      type = CART_MBC1;
+      break;
+    default:
+      EMU_LOG_WARNING(EMU_LOG_MEM, "unsupported cartridge type 0x%02X, treating it as MBC1", rom[0x147]);
+      type = CART_MBC1;
+      break;
+  }
+
+  mem_destroy(mem);
+  mem->rom       = rom;
+  mem->rom_size  = size;
+  mem->rom_banks = (u16)((size + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE);
+  if (mem->rom_banks < 2) mem->rom_banks = 2;
+  mem->rom_bank  = 1;
+  mem->cart_type = type;
+
+  EMU_LOG_TRACE(EMU_LOG_MEM, "rom loaded successfully (%u bytes)", size);
   return result_ok();
 }
 
-u8 mem_read8(Mem *mem, Cpu *cpu, u16 addr) {
+// The OAM DMA holds the external and video buses: only I/O and HRAM answer the cpu
+static inline bool dma_blocks(const Mem* mem, const Cpu* cpu, u16 addr) {
+  return addr < 0xFF00 && cpu->clock_cycles < mem->dma.end && cpu->clock_cycles >= mem->dma.start;
+}
+
+static inline u8 read8(Mem* mem, Cpu* cpu, u16 addr) {
+  cpu->bus_access |= TRACE_FLAG_READ;
+
+  if (dma_blocks(mem, cpu, addr))
+    return 0xFF;
 
   if (cpu->bootrom_mapped) {
-    if (addr < 0x0100)
+    if (addr < 0x0100) {
+      EMU_STAT_INC(mem->stats.reads[MEM_REGION_BOOTROM]);
       return cpu->dmg_bootrom[addr];
+    }
   }
 
   if (addr < 0x8000 || (addr >= 0xA000 && addr < 0xC000)) {
-    LOG_WARNING("mem_read8 called with cart addr: %04X", addr);
-    return 0xFF;
+    EMU_STAT_INC(mem->stats.reads[cart_region(addr)]);
+    if (mem->cart_type == CART_NONE) {
+      EMU_EVENT(cpu, EMU_LOG_MEM,
+                .cycle = cpu->clock_cycles,
+                .pc    = cpu->registers[PC].v,
+                .addr  = addr,
+                .kind  = EMU_EVENT_OPEN_BUS_READ);
+      return 0xFF;
+    }
+    return cart_read8(mem, addr);
   }
 
   // VRAM
   if (addr >= 0x8000 && addr < 0xA000) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_VRAM]);
     u16 index = addr - 0x8000;
     if (index < VRAM_SIZE)
       return mem->vram[index];
@@ -58,6 +255,7 @@ u8 mem_read8(Mem *mem, Cpu *cpu, u16 addr) {
   }
   // WRAM
   else if (addr >= 0xC000 && addr < 0xE000) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_WRAM]);
     u16 index = addr - 0xC000;
     if (index < WRAM_SIZE)
       return mem->wram[index];
@@ -65,6 +263,7 @@ u8 mem_read8(Mem *mem, Cpu *cpu, u16 addr) {
   }
   // Mirrored WRAM region
   else if (addr >= 0xE000 && addr < 0xFE00) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_ECHO]);
     u16 mirror = addr - 0xE000;
     if (mirror < 0x2000) 
       return mem->wram[mirror];
@@ -72,6 +271,7 @@ u8 mem_read8(Mem *mem, Cpu *cpu, u16 addr) {
   }
   // OAM
   else if (addr >= 0xFE00 && addr < 0xFEA0) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_OAM]);
     u16 index = addr - 0xFE00;
     if (index < OAM_SIZE) 
       return mem->oam[index];
@@ -79,65 +279,174 @@ u8 mem_read8(Mem *mem, Cpu *cpu, u16 addr) {
   }
   // Unusable
   else if (addr >= 0xFEA0 && addr < 0xFF00) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_UNUSABLE]);
     return 0xFF;
   }
   else if (addr >= 0xFF00 && addr < 0xFF80) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_IO]);
+    EMU_STAT_INC(mem->stats.io_reads[addr - 0xFF00]);
     return read_io_register(cpu, addr);
   }
   else if (addr >= 0xFF80 && addr < 0xFFFF) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_HRAM]);
     u16 index = addr - 0xFF80;
     if (index < HRAM_SIZE) 
       return mem->hram[index];
     return 0xFF;
   }
-  else if (addr == 0xFFFF)
+  else if (addr == 0xFFFF) {
+    EMU_STAT_INC(mem->stats.reads[MEM_REGION_IE]);
     return cpu->interrupt_enable;
+  }
 
   // unreachable
   return 0xFF;
 }
 
+u8 mem_read8(Mem* mem, Cpu* cpu, u16 addr) {
+  u8 value = read8(mem, cpu, addr);
+  if (cpu->debugger)
+    debugger_on_access(cpu->debugger, cpu, addr, value, WATCH_READ);
+  return value;
+}
+
+u8 mem_peek8(Mem* mem, Cpu* cpu, u16 addr) {
+  if (cpu->bootrom_mapped && addr < 0x0100)
+    return cpu->dmg_bootrom[addr];
+  if (addr < 0x8000 || (addr >= 0xA000 && addr < 0xC000))
+    return mem->cart_type == CART_NONE ? 0xFF : cart_read8(mem, addr);
+
+  if (addr < 0xA000) return mem->vram[addr - 0x8000];
+  if (addr < 0xE000) return mem->wram[addr - 0xC000];
+  if (addr < 0xFE00) return mem->wram[addr - 0xE000];
+  if (addr < 0xFEA0) return mem->oam[addr - 0xFE00];
+  if (addr < 0xFF00) return 0xFF;
+  if (addr < 0xFF80) return read_io_register(cpu, addr);
+  if (addr < 0xFFFF) return mem->hram[addr - 0xFF80];
+  return cpu->interrupt_enable;
+}
+
 void mem_write8(Mem *mem, Cpu *cpu, u16 addr, u8 value) {
+  cpu->bus_access |= TRACE_FLAG_WRITE;
+  if (cpu->debugger)
+    debugger_on_access(cpu->debugger, cpu, addr, value, WATCH_WRITE);
+  if (dma_blocks(mem, cpu, addr))
+    return;
   if (addr < 0x8000 || (addr >= 0xA000 && addr < 0xC000)) {
-    LOG_WARNING("mem_write8 called with cart addr: %04X", addr);
+    EMU_STAT_INC(mem->stats.writes[cart_region(addr)]);
+    if (mem->cart_type == CART_NONE)
+      EMU_EVENT(cpu, EMU_LOG_MEM,
+                .cycle = cpu->clock_cycles,
+                .pc    = cpu->registers[PC].v,
+                .addr  = addr,
+                .kind  = EMU_EVENT_OPEN_BUS_WRITE,
+                .value = value);
+    else
+      cart_write8(mem, addr, value);
+    return;
   }
 
   // VRAM
   if (addr >= 0x8000 && addr < 0xA000) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_VRAM]);
     u16 index = addr - 0x8000;
     if (index < VRAM_SIZE)
       mem->vram[index] = value;
   }
   // WRAM
   else if (addr >= 0xC000 && addr < 0xE000) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_WRAM]);
     u16 index = addr - 0xC000;
     if (index < WRAM_SIZE)
       mem->wram[index] = value;
   }
   // Mirrored WRAM region
   else if (addr >= 0xE000 && addr < 0xFE00) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_ECHO]);
     u16 mirror = addr - 0xE000;
     if (mirror < 0x2000) 
       mem->wram[mirror] = value;
   }
   // OAM
   else if (addr >= 0xFE00 && addr < 0xFEA0) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_OAM]);
     u16 index = addr - 0xFE00;
     if (index < OAM_SIZE) 
       mem->oam[index] = value;
   }
   // Unusable
   else if (addr >= 0xFEA0 && addr < 0xFF00) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_UNUSABLE]);
     return;
   }
   else if (addr >= 0xFF00 && addr < 0xFF80) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_IO]);
+    EMU_STAT_INC(mem->stats.io_writes[addr - 0xFF00]);
     write_io_register(cpu, addr, value);
   }
   else if (addr >= 0xFF80 && addr < 0xFFFF) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_HRAM]);
     u16 index = addr - 0xFF80;
     if (index < HRAM_SIZE) 
       mem->hram[index] = value;
   }
-  else if (addr == 0xFFFF)
+  else if (addr == 0xFFFF) {
+    EMU_STAT_INC(mem->stats.writes[MEM_REGION_IE]);
     cpu->interrupt_enable = value;
+  }
+}
+
+// Source bytes [index, index + count) as one flat array, or NULL when the range isn't
+// (cartridge ram, rom past its end or across a bank edge, no cartridge)
+static const u8* dma_source(const Mem* mem, u16 addr, u8 count) {
+  u16 last = (u16)(addr + count - 1);
+
+  if (addr < 0x4000 && last < 0x4000 && mem->cart_type != CART_NONE && last < mem->rom_size)
+    return &mem->rom[addr];
+  if (addr >= 0x4000 && last < 0x8000 && mem->cart_type != CART_NONE) {
+    u32 offset = (u32)mem->rom_bank * ROM_BANK_SIZE + (addr - 0x4000);
+    return offset + count <= mem->rom_size ? &mem->rom[offset] : NULL;
+  }
+  if (addr >= 0x8000 && last < 0xA000)
+    return &mem->vram[addr - 0x8000];
+  // 0xE000-0xFFFF read the WRAM behind the echo
+  if (addr >= 0xC000 && ((addr - 0xC000) & 0x1FFF) + count <= WRAM_SIZE)
+    return &mem->wram[(addr - 0xC000) & 0x1FFF];
+  return NULL;
+}
+
+void mem_dma_start(Mem* mem, Cpu* cpu, u8 value) {
+  OamDma* dma = &mem->dma;
+  dma->source = (u16)(value << 8);
+  dma->copied = 0;
+  dma->start  = cpu->clock_cycles + 4;
+  dma->next   = dma->start;
+  dma->end    = dma->start + OAM_SIZE * 4;
+
+  if (mem->dma_bulk)
+    mem_dma_run(mem, cpu, dma->end);
+}
+
+void mem_dma_run(Mem* mem, Cpu* cpu, u64 now) {
+  OamDma* dma = &mem->dma;
+  if (now < dma->next)
+    return;
+
+  u64 due = (now - dma->start) / 4 + 1;
+  u8 to = due < OAM_SIZE ? (u8)due : OAM_SIZE;
+  u8 count = (u8)(to - dma->copied);
+  u16 addr = (u16)(dma->source + dma->copied);
+
+  const u8* src = dma_source(mem, addr, count);
+  if (src) {
+    memcpy(&mem->oam[dma->copied], src, count);
+  } else {
+    for (u8 i = 0; i < count; i++) {
+      u16 a = (u16)(addr + i);
+      mem->oam[dma->copied + i] = a >= 0xE000 ? mem->wram[(a - 0xC000) & 0x1FFF] : mem_peek8(mem, cpu, a);
+    }
+  }
+
+  dma->copied = to;
+  dma->next = to < OAM_SIZE ? dma->start + (u64)to * 4 : OAM_DMA_IDLE;
 }
@@ -3,6 +3,7 @@
 
 #include <lresult.h>
 #include <types.h>
+#include "stats.h"
 
 struct Cpu;
 
@@ -10,21 +11,78 @@ struct Cpu;
 #define VRAM_SIZE (8 * 1024)
 #define OAM_SIZE  (0xA0)
 #define HRAM_SIZE (0x7F)
+#define ERAM_SIZE (8 * 1024)
+#define ROM_BANK_SIZE (16 * 1024)
+
+typedef enum {
+  CART_NONE = 0,
+  CART_ROM_ONLY,
+  CART_MBC1,
+} ECartType;
+
+#define OAM_DMA_IDLE UINT64_MAX
+
+// OAM DMA (0xFF46): OAM_SIZE bytes from `source`, one per M-cycle, starting one M-cycle
+// after the write. The cpu can only reach I/O and HRAM until `end`
+typedef struct {
+  u16 source;
+  u8 copied; // bytes already in OAM
+  u64 start; // clock cycle of the first byte
+  u64 next;  // clock cycle of the next byte, OAM_DMA_IDLE when everything is copied
+  u64 end;   // clock cycle the bus is released
+} OamDma;
 
 typedef struct {
   u8 wram[WRAM_SIZE];
   u8 vram[VRAM_SIZE];
   u8 oam[OAM_SIZE];
   u8 hram[HRAM_SIZE];
+
+  // Cartridge
+  ECartType cart_type;
+  u8* rom;
+  u32 rom_size;
+  u16 rom_banks;
+  u16 rom_bank; // bank mapped at 0x4000-0x7FFF
+  u8 eram[ERAM_SIZE];
+
+  OamDma dma;
+  // Copy all of OAM when the DMA starts instead of byte by byte. Nothing the cpu can
+  // write is readable by the DMA while it runs, so only the ppu (reading OAM mid
+  // transfer) can tell the difference. For instruction level cores
+  bool dma_bulk;
+
+#if EMU_STATS
+  EMU_STATS_ALIGN MemStats stats;
+#endif
 } Mem;
 
 // Inititalizes the memory with default values 
 Result mem_init(Mem* mem);
 
+// Frees the cartridge rom, if any
+void mem_destroy(Mem* mem);
+
+// Loads a cartridge rom image from disk (ROM only and MBC1 carts)
+Result mem_load_rom(Mem* mem, const char* path);
+
+// Same as mem_load_rom, from a rom image already in memory (copied)
+Result mem_load_rom_data(Mem* mem, const u8* data, u32 size);
+
 // Returns the byte at the specified address
 u8 mem_read8(Mem* mem, struct Cpu* cpu, u16 addr);
 
+// Same as mem_read8, without counting the access or triggering watchpoints. For debuggers
+u8 mem_peek8(Mem* mem, struct Cpu* cpu, u16 addr);
+
 // Write the byte at the specified address
 void mem_write8(Mem* mem, struct Cpu* cpu, u16 addr, u8 val);
 
+// Starts an OAM DMA from `value` << 8 (write to 0xFF46 at cpu->clock_cycles)
+void mem_dma_start(Mem* mem, struct Cpu* cpu, u8 value);
+
+// Copies every DMA byte due by clock cycle `now`: one per call when called every cycle,
+// or the whole span at once after a jump in time
+void mem_dma_run(Mem* mem, struct Cpu* cpu, u64 now);
+
 #endif // !MEM_H
@@ -0,0 +1,185 @@
+#include "movie.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void movie_init(Movie* movie) {
+  memset(movie, 0, sizeof(*movie));
+  movie->mode = MOVIE_IDLE;
+}
+
+void movie_destroy(Movie* movie) {
+  if (!movie) return;
+
+  free(movie->runs);
+  movie_init(movie);
+}
+
+void movie_rewind(Movie* movie) {
+  movie->cursor_run   = 0;
+  movie->cursor_frame = 0;
+}
+
+static Result reserve_runs(Movie* movie, u32 count) {
+  if (count <= movie->run_capacity)
+    return result_ok();
+
+  u32 capacity = movie->run_capacity ? movie->run_capacity : 64;
+  while (capacity < count)
+    capacity = capacity > UINT32_MAX / 2 ? count : capacity * 2;
+
+  MovieRun* runs = realloc(movie->runs, sizeof(MovieRun) * capacity);
+  if (!runs) {
+    return result_error(Error_NullPointer, "no mem for %u movie runs", capacity);
+  }
+
+  movie->runs = runs;
+  movie->run_capacity = capacity;
+  return result_ok();
+}
+
+Result movie_append_frame(Movie* movie, u8 buttons) {
+  if (!movie) {
+    return result_error(Error_NullPointer, "invalid movie to movie_append_frame");
+  }
+
+  if (movie->run_count > 0) {
+    MovieRun* last = &movie->runs[movie->run_count - 1];
+    if (last->buttons == buttons && last->frames < MOVIE_MAX_RUN) {
+      last->frames++;
+      movie->frame_count++;
+      return result_ok();
+    }
+  }
+
+  Result r = reserve_runs(movie, movie->run_count + 1);
+  if (result_is_error(&r)) return r;
+
+  movie->runs[movie->run_count].buttons = buttons;
+  movie->runs[movie->run_count].frames  = 1;
+  movie->run_count++;
+  movie->frame_count++;
+
+  return result_ok();
+}
+
+bool movie_next_frame(Movie* movie, u8* buttons) {
+  while (movie->cursor_run < movie->run_count) {
+    const MovieRun* run = &movie->runs[movie->cursor_run];
+    if (movie->cursor_frame < run->frames) {
+      movie->cursor_frame++;
+      *buttons = run->buttons;
+      return true;
+    }
+    movie->cursor_run++;
+    movie->cursor_frame = 0;
+  }
+
+  *buttons = 0;
+  return false;
+}
+
+static void put_u16(u8* p, u16 v) { p[0] = (u8)v; p[1] = (u8)(v >> 8); }
+static void put_u32(u8* p, u32 v) { put_u16(p, (u16)v); put_u16(p + 2, (u16)(v >> 16)); }
+static u16 get_u16(const u8* p) { return (u16)(p[0] | (p[1] << 8)); }
+static u32 get_u32(const u8* p) { return (u32)get_u16(p) | ((u32)get_u16(p + 2) << 16); }
+
+Result movie_save(const Movie* movie, const char* path) {
+  if (!movie || !path) {
+    return result_error(Error_NullPointer, "invalid args to movie_save");
+  }
+
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return result_error(Error_FileIO, "failed to create movie: %s", path);
+
+  u8 header[MOVIE_HEADER_SIZE] = {0};
+  memcpy(header, MOVIE_MAGIC, 4);
+  header[4] = MOVIE_VERSION;
+  put_u32(header + 8, movie->frame_count);
+  put_u32(header + 12, movie->run_count);
+
+  bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header);
+  for (u32 i = 0; ok && i < movie->run_count; i++) {
+    u8 rec[MOVIE_RUN_SIZE];
+    rec[0] = movie->runs[i].buttons;
+    put_u16(rec + 1, movie->runs[i].frames);
+    ok = fwrite(rec, 1, sizeof(rec), f) == sizeof(rec);
+  }
+
+  if (fclose(f) != 0 || !ok)
+    return result_error(Error_FileIO, "failed to write movie: %s", path);
+
+  EMU_LOG_TRACE(EMU_LOG_MACHINE, "movie saved (%u frames, %u runs)", movie->frame_count, movie->run_count);
+  return result_ok();
+}
+
+Result movie_load(Movie* movie, const char* path) {
+  if (!movie || !path) {
+    return result_error(Error_NullPointer, "invalid args to movie_load");
+  }
+
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return result_error(Error_FileIO, "failed to open movie: %s", path);
+
+  u8 header[MOVIE_HEADER_SIZE];
+  if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+      memcmp(header, MOVIE_MAGIC, 4) != 0) {
+    fclose(f);
+    return result_error(Error_FileIO, "not a movie file: %s", path);
+  }
+  if (header[4] != MOVIE_VERSION) {
+    fclose(f);
+    return result_error(Error_FileIO, "unsupported movie version %u: %s", header[4], path);
+  }
+
+  u32 frame_count = get_u32(header + 8);
+  u32 run_count   = get_u32(header + 12);
+
+  // The count comes from the file: it has to fit in what follows the header before
+  // anything is allocated for it
+  long size = -1;
+  if (fseek(f, 0, SEEK_END) == 0)
+    size = ftell(f);
+  if (size < 0 || fseek(f, MOVIE_HEADER_SIZE, SEEK_SET) != 0) {
+    fclose(f);
+    return result_error(Error_FileIO, "failed to read movie: %s", path);
+  }
+  if (run_count > (u64)(size - MOVIE_HEADER_SIZE) / MOVIE_RUN_SIZE) {
+    fclose(f);
+    return result_error(Error_FileIO, "truncated movie (%u runs in %ld bytes): %s", run_count, size, path);
+  }
+
+  movie_destroy(movie);
+
+  Result r = reserve_runs(movie, run_count);
+  if (result_is_error(&r)) {
+    fclose(f);
+    return r;
+  }
+
+  u32 frames = 0;
+  for (u32 i = 0; i < run_count; i++) {
+    u8 rec[MOVIE_RUN_SIZE];
+    if (fread(rec, 1, sizeof(rec), f) != sizeof(rec)) {
+      fclose(f);
+      movie_destroy(movie);
+      return result_error(Error_FileIO, "truncated movie: %s", path);
+    }
+    movie->runs[i].buttons = rec[0];
+    movie->runs[i].frames  = get_u16(rec + 1);
+    frames += movie->runs[i].frames;
+  }
+  fclose(f);
+
+  movie->run_count   = run_count;
+  movie->frame_count = frames;
+  if (frames != frame_count)
+    EMU_LOG_WARNING(EMU_LOG_MACHINE, "movie header says %u frames, runs hold %u: %s", frame_count, frames, path);
+
+  EMU_LOG_TRACE(EMU_LOG_MACHINE, "movie loaded (%u frames, %u runs)", frames, run_count);
+  return result_ok();
+}
@@ -0,0 +1,63 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+
+// Input movie: one joypad bitmask (EJoypadButton bits) per frame, run-length encoded.
+//
+// File layout (little endian):
+//   "LGBM"  magic
+//   u8      version (1)
+//   u8[3]   reserved
+//   u32     frame count
+//   u32     run count
+//   runs    run count * { u8 buttons; u16 frames; }
+
+#define MOVIE_MAGIC "LGBM"
+#define MOVIE_VERSION 1
+#define MOVIE_MAX_RUN 0xFFFF
+#define MOVIE_HEADER_SIZE 16
+#define MOVIE_RUN_SIZE 3 // bytes per run in the file
+
+typedef struct {
+  u8 buttons;
+  u16 frames;
+} MovieRun;
+
+typedef enum {
+  MOVIE_IDLE = 0,
+  MOVIE_RECORDING,
+  MOVIE_PLAYING,
+} EMovieMode;
+
+typedef struct {
+  MovieRun* runs;
+  u32 run_count;
+  u32 run_capacity;
+  u32 frame_count;
+
+  EMovieMode mode;
+
+  // Playback cursor
+  u32 cursor_run;
+  u32 cursor_frame; // frame inside cursor_run
+} Movie;
+
+void movie_init(Movie* movie);
+void movie_destroy(Movie* movie);
+
+Result movie_load(Movie* movie, const char* path);
+Result movie_save(const Movie* movie, const char* path);
+
+// Appends one frame of input to the recording
+Result movie_append_frame(Movie* movie, u8 buttons);
+
+// Input for the next frame of playback. Returns false (and no buttons) past the end
+bool movie_next_frame(Movie* movie, u8* buttons);
+
+// Moves the playback cursor back to the first frame
+void movie_rewind(Movie* movie);
+
+#endif // !MOVIE_H
@@ -0,0 +1,239 @@
+#include "profiler.h"
+#include "cpu/instruction.h"
+#include <util.h>
+#include <stdlib.h>
+#include <string.h>
+
+const u8 profiler_opcode_length[256] = {
+  1,3,1,1,1,1,2,1,3,1,1,1,1,1,2,1, // 0x00
+  2,3,1,1,1,1,2,1,2,1,1,1,1,1,2,1, // 0x10
+  2,3,1,1,1,1,2,1,2,1,1,1,1,1,2,1, // 0x20
+  2,3,1,1,1,1,2,1,2,1,1,1,1,1,2,1, // 0x30
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x40
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x50
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x60
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x70
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x80
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0x90
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xA0
+  1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, // 0xB0
+  1,1,3,3,3,1,2,1,1,1,3,2,3,3,2,1, // 0xC0
+  1,1,3,1,3,1,2,1,1,1,3,1,3,1,2,1, // 0xD0
+  2,1,1,1,1,1,2,1,2,1,3,1,1,1,2,1, // 0xE0
+  2,1,1,1,1,1,2,1,2,1,3,1,1,1,2,1, // 0xF0
+};
+
+typedef struct {
+  u32 key;
+  u64 cycles;
+  u32 hits;
+} ProfileEntry;
+
+Result profiler_init(Profiler* profiler, const Mem* mem) {
+  if (!profiler || !mem) {
+    return result_error(Error_NullPointer, "invalid args to profiler_init");
+  }
+  memset(profiler, 0, sizeof(*profiler));
+
+  profiler->rom_banks = mem->cart_type == CART_NONE ? 0 : mem->rom_banks;
+  profiler->key_count = PROFILER_BANK_KEY + (u32)profiler->rom_banks * 0x4000u;
+
+  profiler->cycles  = calloc(profiler->key_count, sizeof(u64));
+  profiler->hits    = calloc(profiler->key_count, sizeof(u32));
+  profiler->opcodes = calloc(profiler->key_count, sizeof(u8));
+  profiler->entries = calloc((profiler->key_count + 7) / 8, sizeof(u8));
+  if (!profiler->cycles || !profiler->hits || !profiler->opcodes || !profiler->entries) {
+    profiler_destroy(profiler);
+    return result_error(Error_NullPointer, "no mem for profiler (%u keys)", profiler->key_count);
+  }
+
+  return result_ok();
+}
+
+void profiler_destroy(Profiler* profiler) {
+  if (!profiler) return;
+
+  free(profiler->cycles);
+  free(profiler->hits);
+  free(profiler->opcodes);
+  free(profiler->entries);
+  profiler->cycles = NULL;
+  profiler->hits = NULL;
+  profiler->opcodes = NULL;
+  profiler->entries = NULL;
+  profiler->key_count = 0;
+}
+
+void profiler_reset(Profiler* profiler) {
+  memset(profiler->cycles, 0, sizeof(u64) * profiler->key_count);
+  memset(profiler->hits, 0, sizeof(u32) * profiler->key_count);
+  memset(profiler->entries, 0, (profiler->key_count + 7) / 8);
+  profiler->started = false;
+  profiler->total_cycles = 0;
+}
+
+// `bank:addr` as in rgbds symbol files, `boot:addr` for the bootrom
+static void key_label(u32 key, char* buf, size_t size) {
+  if (key < PROFILER_BOOTROM_KEY)
+    snprintf(buf, size, "00:%04X", key);
+  else if (key < PROFILER_BANK_KEY)
+    snprintf(buf, size, "boot:%04X", key - PROFILER_BOOTROM_KEY);
+  else
+    snprintf(buf, size, "%02X:%04X", (key - PROFILER_BANK_KEY) / 0x4000u,
+             0x4000u + (key - PROFILER_BANK_KEY) % 0x4000u);
+}
+
+// First key of the region (flat space, bootrom, or one bank) holding `key`
+static u32 region_start(u32 key) {
+  if (key < PROFILER_BOOTROM_KEY) return 0;
+  if (key < PROFILER_BANK_KEY) return PROFILER_BOOTROM_KEY;
+  return PROFILER_BANK_KEY + (key - PROFILER_BANK_KEY) / 0x4000u * 0x4000u;
+}
+
+static bool is_entry(const Profiler* profiler, u32 key) {
+  return profiler->entries[key >> 3] & (1u << (key & 7));
+}
+
+static const char* mnemonic(u8 opcode) {
+  ResultInstr r = instruction_decode(opcode);
+  return result_Instr_is_err(&r) ? "???" : result_Instr_get_data(&r).mnemonic;
+}
+
+static int compare_cycles(const void* a, const void* b) {
+  u64 ca = ((const ProfileEntry*)a)->cycles;
+  u64 cb = ((const ProfileEntry*)b)->cycles;
+  return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+// Walks the executed keys in address order, calling `visit` with the routine each one
+// belongs to
+typedef void (*ProfileVisit)(const Profiler* profiler, u32 routine, u32 key, void* ctx);
+
+static void walk(const Profiler* profiler, ProfileVisit visit, void* ctx) {
+  u32 routine = 0;
+  u32 region = (u32)-1;
+
+  for (u32 key = 0; key < profiler->key_count; key++) {
+    u32 start = region_start(key);
+    if (start != region) {
+      region = start;
+      routine = start;
+    }
+    if (is_entry(profiler, key))
+      routine = key;
+    if (profiler->hits[key])
+      visit(profiler, routine, key, ctx);
+  }
+}
+
+typedef struct {
+  ProfileEntry* entries;
+  u32 count;
+} RoutineList;
+
+static void collect_routine(const Profiler* profiler, u32 routine, u32 key, void* ctx) {
+  RoutineList* list = (RoutineList*)ctx;
+  if (list->count == 0 || list->entries[list->count - 1].key != routine) {
+    list->entries[list->count++] = (ProfileEntry){ .key = routine };
+  }
+  list->entries[list->count - 1].cycles += profiler->cycles[key];
+  list->entries[list->count - 1].hits += profiler->hits[key];
+}
+
+static double percent(u64 part, u64 total) {
+  return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+void profiler_report(const Profiler* profiler, FILE* out, u32 top) {
+  u32 used = 0;
+  u64 instructions = 0;
+  for (u32 key = 0; key < profiler->key_count; key++) {
+    if (profiler->hits[key]) {
+      used++;
+      instructions += profiler->hits[key];
+    }
+  }
+
+  fprintf(out, "guest profile: %llu cycles, %llu instructions at %u addresses\n",
+          (unsigned long long)profiler->total_cycles, (unsigned long long)instructions, used);
+  if (used == 0) return;
+
+  ProfileEntry* entries = malloc(sizeof(ProfileEntry) * used);
+  if (!entries) {
+    fprintf(out, "  (no mem for the report)\n");
+    return;
+  }
+
+  // Routines
+  RoutineList routines = { entries, 0 };
+  walk(profiler, collect_routine, &routines);
+  qsort(routines.entries, routines.count, sizeof(ProfileEntry), compare_cycles);
+
+  fprintf(out, "\n  %-10s %14s %7s %12s\n", "routine", "cycles", "%", "instrs");
+  for (u32 i = 0; i < routines.count && i < top; i++) {
+    char label[16];
+    key_label(routines.entries[i].key, label, sizeof(label));
+    fprintf(out, "  %-10s %14llu %6.2f%% %12u\n", label,
+            (unsigned long long)routines.entries[i].cycles,
+            percent(routines.entries[i].cycles, profiler->total_cycles),
+            routines.entries[i].hits);
+  }
+
+  // Instructions
+  u32 count = 0;
+  for (u32 key = 0; key < profiler->key_count; key++) {
+    if (profiler->hits[key])
+      entries[count++] = (ProfileEntry){ key, profiler->cycles[key], profiler->hits[key] };
+  }
+  qsort(entries, count, sizeof(ProfileEntry), compare_cycles);
+
+  fprintf(out, "\n  %-10s %-14s %14s %7s %12s %8s\n", "pc", "instruction", "cycles", "%", "hits", "cyc/hit");
+  for (u32 i = 0; i < count && i < top; i++) {
+    char label[16];
+    key_label(entries[i].key, label, sizeof(label));
+    fprintf(out, "  %-10s %-14s %14llu %6.2f%% %12u %8.1f\n", label,
+            mnemonic(profiler->opcodes[entries[i].key]),
+            (unsigned long long)entries[i].cycles,
+            percent(entries[i].cycles, profiler->total_cycles),
+            entries[i].hits, (double)entries[i].cycles / entries[i].hits);
+  }
+
+  free(entries);
+}
+
+static void write_folded(const Profiler* profiler, u32 routine, u32 key, void* ctx) {
+  FILE* f = (FILE*)ctx;
+  if (!profiler->cycles[key]) return;
+
+  char routine_label[16], label[16], name[32];
+  key_label(routine, routine_label, sizeof(routine_label));
+  key_label(key, label, sizeof(label));
+
+  // Frame names can't hold the spaces flamegraph.pl splits the count on
+  snprintf(name, sizeof(name), "%s", mnemonic(profiler->opcodes[key]));
+  for (char* c = name; *c; c++)
+    if (*c == ' ' || *c == ';') *c = '_';
+
+  fprintf(f, "%s;%s_%s %llu\n", routine_label, label, name,
+          (unsigned long long)profiler->cycles[key]);
+}
+
+Result profiler_export_folded(const Profiler* profiler, const char* path) {
+  if (!profiler || !path) {
+    return result_error(Error_NullPointer, "invalid args to profiler_export_folded");
+  }
+
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    return result_error(Error_FileIO, "failed to open %s", path);
+  }
+
+  walk(profiler, write_folded, f);
+
+  bool failed = ferror(f);
+  fclose(f);
+  if (failed) {
+    return result_error(Error_FileIO, "failed to write %s", path);
+  }
+  return result_ok();
+}
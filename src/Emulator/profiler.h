@@ -0,0 +1,97 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include "cpu/cpu.h"
+
+// Guest profiler: T-cycles spent at every guest instruction, keyed by pc and rom bank.
+// cpu_step calls profiler_enter at each instruction boundary, which charges the cycles
+// since the previous boundary to the previous instruction. No sampling, no allocation.
+//
+// Keys: [0, 0x10000) is the address space outside the switchable rom bank, then 256 keys
+// for the bootrom, then 0x4000 keys per rom bank for 0x4000-0x7FFF.
+// Routines are recovered from the run: call/rst targets, interrupt vectors and the first
+// instruction are marked as entries, every other pc belongs to the nearest entry before it.
+
+#define PROFILER_BOOTROM_KEY 0x10000u
+#define PROFILER_BANK_KEY    (PROFILER_BOOTROM_KEY + 0x100u)
+
+typedef struct Profiler {
+  u64* cycles;  // per key
+  u32* hits;    // instructions executed per key
+  u8* opcodes;  // last opcode seen per key
+  u8* entries;  // bitmap of routine entry keys
+  u32 key_count;
+  u16 rom_banks;
+
+  bool started;
+  u32 last_key;
+  u16 last_pc;
+  u8 last_opcode;
+  u64 last_cycle;
+  u64 total_cycles;
+} Profiler;
+
+extern const u8 profiler_opcode_length[256];
+
+// Sized for the cartridge currently loaded in `mem`
+Result profiler_init(Profiler* profiler, const Mem* mem);
+void profiler_destroy(Profiler* profiler);
+void profiler_reset(Profiler* profiler);
+
+// Hottest `top` routines and instructions, with mnemonics
+void profiler_report(const Profiler* profiler, FILE* out, u32 top);
+
+// Folded stacks (`routine;instruction cycles` per line) for flamegraph.pl, inferno,
+// speedscope...
+Result profiler_export_folded(const Profiler* profiler, const char* path);
+
+static inline bool profiler_is_call(u8 opcode) {
+  switch (opcode) {
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+    case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static inline u32 profiler_key(const Profiler* profiler, const Cpu* cpu, u16 pc) {
+  if (pc < 0x0100 && cpu->bootrom_mapped)
+    return PROFILER_BOOTROM_KEY + pc;
+  if (pc >= 0x4000 && pc < 0x8000 && cpu->mem && cpu->mem->rom_bank < profiler->rom_banks)
+    return PROFILER_BANK_KEY + (u32)cpu->mem->rom_bank * 0x4000u + (pc - 0x4000u);
+  return pc;
+}
+
+static inline void profiler_enter(Profiler* profiler, const Cpu* cpu, u16 pc, u8 opcode) {
+  u32 key = profiler_key(profiler, cpu, pc);
+  u64 now = cpu->clock_cycles;
+
+  if (profiler->started) {
+    u64 spent = now - profiler->last_cycle;
+    profiler->cycles[profiler->last_key] += spent;
+    profiler->total_cycles += spent;
+
+    u16 fallthrough = (u16)(profiler->last_pc + profiler_opcode_length[profiler->last_opcode]);
+    bool called = pc != fallthrough && profiler_is_call(profiler->last_opcode);
+    bool vector = pc != fallthrough && (pc & 0xFFC7) == 0x0040 && pc <= 0x0060;
+    if (called || vector)
+      profiler->entries[key >> 3] |= (u8)(1u << (key & 7));
+  } else {
+    profiler->entries[key >> 3] |= (u8)(1u << (key & 7));
+    profiler->started = true;
+  }
+
+  profiler->hits[key]++;
+  profiler->opcodes[key] = opcode;
+  profiler->last_key = key;
+  profiler->last_pc = pc;
+  profiler->last_opcode = opcode;
+  profiler->last_cycle = now;
+}
+
+#endif // !PROFILER_H
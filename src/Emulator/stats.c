@@ -0,0 +1,124 @@
+#include "stats.h"
+#include "machine.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define STATS_IO_TOP 8
+
+const char* mem_region_name(EMemRegion region) {
+  switch (region) {
+    case MEM_REGION_BOOTROM:  return "bootrom";
+    case MEM_REGION_ROM0:     return "rom0";
+    case MEM_REGION_ROMX:     return "romx";
+    case MEM_REGION_VRAM:     return "vram";
+    case MEM_REGION_ERAM:     return "eram";
+    case MEM_REGION_WRAM:     return "wram";
+    case MEM_REGION_ECHO:     return "echo";
+    case MEM_REGION_OAM:      return "oam";
+    case MEM_REGION_UNUSABLE: return "unusable";
+    case MEM_REGION_IO:       return "io";
+    case MEM_REGION_HRAM:     return "hram";
+    case MEM_REGION_IE:       return "ie";
+    case MEM_REGION_COUNT:    break;
+  }
+  return "?";
+}
+
+static const char* io_name(u16 addr) {
+  switch (addr) {
+    case 0xFF00: return "P1";
+    case 0xFF01: return "SB";
+    case 0xFF02: return "SC";
+    case 0xFF04: return "DIV";
+    case 0xFF05: return "TIMA";
+    case 0xFF06: return "TMA";
+    case 0xFF07: return "TAC";
+    case 0xFF0F: return "IF";
+    case 0xFF26: return "NR52";
+    case 0xFF40: return "LCDC";
+    case 0xFF41: return "STAT";
+    case 0xFF42: return "SCY";
+    case 0xFF43: return "SCX";
+    case 0xFF44: return "LY";
+    case 0xFF45: return "LYC";
+    case 0xFF46: return "DMA";
+    case 0xFF47: return "BGP";
+    case 0xFF48: return "OBP0";
+    case 0xFF49: return "OBP1";
+    case 0xFF4A: return "WY";
+    case 0xFF4B: return "WX";
+    case 0xFF50: return "BOOT";
+    default:
+      if (addr >= 0xFF10 && addr < 0xFF40) return "apu";
+      return "";
+  }
+}
+
+static double per_frame(u64 count, u64 cycles) {
+  return cycles ? (double)count * (double)CYCLES_PER_FRAME / (double)cycles : 0.0;
+}
+
+void emu_stats_report(const EmuStats* stats, FILE* out) {
+  if (!stats->enabled) {
+    fprintf(out, "stats: compiled out (EMU_STATS=0)\n");
+    return;
+  }
+
+  u64 cycles = stats->cycles;
+  fprintf(out, "stats over %llu cycles (%.1f frames), per frame in brackets\n",
+          (unsigned long long)cycles, (double)cycles / (double)CYCLES_PER_FRAME);
+
+  fprintf(out, "  cpu: %llu decodes [%.0f]", (unsigned long long)stats->cpu.decodes,
+          per_frame(stats->cpu.decodes, cycles));
+  if (stats->timing && stats->cpu.decodes)
+    fprintf(out, ", %.1f host cycles/decode",
+            (double)stats->cpu.decode_host_cycles / (double)stats->cpu.decodes);
+  if (stats->cpu.halt_skipped_cycles)
+    fprintf(out, ", %llu halted cycles skipped", (unsigned long long)stats->cpu.halt_skipped_cycles);
+  if (stats->cpu.idle_skipped_cycles)
+    fprintf(out, ", %llu idle loop cycles skipped", (unsigned long long)stats->cpu.idle_skipped_cycles);
+  fprintf(out, "\n");
+
+  fprintf(out, "  ppu: %llu lines [%.0f]", (unsigned long long)stats->ppu.lines,
+          per_frame(stats->ppu.lines, cycles));
+  if (stats->timing && stats->ppu.lines)
+    fprintf(out, ", %.0f host cycles/line",
+            (double)stats->ppu.render_host_cycles / (double)stats->ppu.lines);
+  fprintf(out, "\n");
+
+  fprintf(out, "  mem: %-9s %14s %10s %14s %10s\n", "region", "reads", "[frame]", "writes", "[frame]");
+  for (int i = 0; i < MEM_REGION_COUNT; i++) {
+    u64 r = stats->mem.reads[i], w = stats->mem.writes[i];
+    if (!r && !w) continue;
+    fprintf(out, "       %-9s %14llu %10.0f %14llu %10.0f\n", mem_region_name((EMemRegion)i),
+            (unsigned long long)r, per_frame(r, cycles),
+            (unsigned long long)w, per_frame(w, cycles));
+  }
+
+  // Busiest I/O registers
+  int order[EMU_STATS_IO_COUNT];
+  int count = 0;
+  for (int i = 0; i < EMU_STATS_IO_COUNT; i++) {
+    if (stats->mem.io_reads[i] || stats->mem.io_writes[i])
+      order[count++] = i;
+  }
+  for (int i = 1; i < count; i++) {
+    int v = order[i];
+    u64 key = stats->mem.io_reads[v] + stats->mem.io_writes[v];
+    int j = i - 1;
+    while (j >= 0 && stats->mem.io_reads[order[j]] + stats->mem.io_writes[order[j]] < key) {
+      order[j + 1] = order[j];
+      j--;
+    }
+    order[j + 1] = v;
+  }
+
+  if (count)
+    fprintf(out, "  io:  %-11s %12s %12s\n", "register", "reads", "writes");
+  for (int i = 0; i < count && i < STATS_IO_TOP; i++) {
+    u16 addr = (u16)(0xFF00 + order[i]);
+    fprintf(out, "       %04X %-6s %12llu %12llu\n", addr, io_name(addr),
+            (unsigned long long)stats->mem.io_reads[order[i]],
+            (unsigned long long)stats->mem.io_writes[order[i]]);
+  }
+}
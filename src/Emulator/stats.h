@@ -0,0 +1,100 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <types.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Host-side instrumentation: plain counters owned by each subsystem of a machine (cpu,
+// mem, ppu). Subsystems declare their block with EMU_STATS_ALIGN so it sits on its own
+// cache line and machines stepped on different threads never share one. Collected with
+// machine_stats (see machine.h).
+//
+// EMU_STATS=0 removes the counters and every increment at compile time.
+// EMU_STATS_TIMING=1 also times decode and line rendering with the host cycle counter.
+
+#ifndef EMU_STATS
+#define EMU_STATS 1
+#endif
+
+#ifndef EMU_STATS_TIMING
+#define EMU_STATS_TIMING 0
+#endif
+
+#define EMU_STATS_ALIGN _Alignas(64)
+#define EMU_STATS_IO_COUNT 0x80 // 0xFF00-0xFF7F
+
+typedef enum {
+  MEM_REGION_BOOTROM = 0,
+  MEM_REGION_ROM0,
+  MEM_REGION_ROMX,
+  MEM_REGION_VRAM,
+  MEM_REGION_ERAM,
+  MEM_REGION_WRAM,
+  MEM_REGION_ECHO,
+  MEM_REGION_OAM,
+  MEM_REGION_UNUSABLE,
+  MEM_REGION_IO,
+  MEM_REGION_HRAM,
+  MEM_REGION_IE,
+  MEM_REGION_COUNT,
+} EMemRegion;
+
+typedef struct {
+  u64 decodes;
+  u64 decode_host_cycles; // EMU_STATS_TIMING only
+  u64 halt_skipped_cycles; // jumped over by machine_run_cycles while halted
+  u64 idle_skipped_cycles; // jumped over in polling loops (machine_skip_idle)
+} CpuStats;
+
+typedef struct {
+  u64 reads[MEM_REGION_COUNT];
+  u64 writes[MEM_REGION_COUNT];
+  u64 io_reads[EMU_STATS_IO_COUNT];
+  u64 io_writes[EMU_STATS_IO_COUNT];
+} MemStats;
+
+typedef struct {
+  u64 lines;
+  u64 render_host_cycles; // EMU_STATS_TIMING only
+} PpuStats;
+
+// Everything at once, as returned by machine_stats
+typedef struct {
+  bool enabled;
+  bool timing;
+  u64 cycles; // T-cycles the counters cover
+  CpuStats cpu;
+  MemStats mem;
+  PpuStats ppu;
+} EmuStats;
+
+#if EMU_STATS
+#define EMU_STAT_INC(counter)    ((counter)++)
+#define EMU_STAT_ADD(counter, n) ((counter) += (n))
+#else
+#define EMU_STAT_INC(counter)    ((void)0)
+#define EMU_STAT_ADD(counter, n) ((void)0)
+#endif
+
+// From util.h, which can't be included here (it pulls in cpu.h)
+u64 host_cycles_now(void);
+
+// Runs `stmt`, adding the host cycles it took to `counter` when timing is compiled in
+#if EMU_STATS && EMU_STATS_TIMING
+#define EMU_STAT_TIMED(counter, stmt)                \
+  do {                                               \
+    u64 stat_start__ = host_cycles_now();            \
+    stmt;                                            \
+    (counter) += host_cycles_now() - stat_start__;   \
+  } while (0)
+#else
+#define EMU_STAT_TIMED(counter, stmt) do { stmt; } while (0)
+#endif
+
+const char* mem_region_name(EMemRegion region);
+
+// Counters as a short table, I/O registers sorted by accesses
+void emu_stats_report(const EmuStats* stats, FILE* out);
+
+#endif // !STATS_H
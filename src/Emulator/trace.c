@@ -0,0 +1,134 @@
+#include "trace.h"
+#include <util.h>
+#include <Emulator/emu_log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static u64 round_pow2(u64 v) {
+  u64 size = 1;
+  while (size < v)
+    size <<= 1;
+  return size;
+}
+
+static void fill_header(const TraceRecorder* trace, TraceFileHeader* header) {
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, TRACE_MAGIC, 4);
+  header->version     = TRACE_VERSION;
+  header->record_size = sizeof(TraceRecord);
+  header->granularity = (u32)trace->granularity;
+  header->capacity    = trace->capacity;
+  header->count       = trace->count;
+}
+
+Result trace_open_ring(TraceRecorder* trace, u64 capacity, ETraceGranularity granularity) {
+  if (!trace || capacity == 0) {
+    return result_error(Error_NullPointer, "invalid args to trace_open_ring");
+  }
+
+  memset(trace, 0, sizeof(*trace));
+  trace->fd          = -1;
+  trace->capacity    = round_pow2(capacity);
+  trace->granularity = granularity;
+
+  trace->records = calloc(trace->capacity, sizeof(TraceRecord));
+  if (!trace->records) {
+    return result_error(Error_NullPointer, "no mem for %llu trace records",
+                        (unsigned long long)trace->capacity);
+  }
+
+  return result_ok();
+}
+
+Result trace_open_file(TraceRecorder* trace, const char* path, u64 capacity, ETraceGranularity granularity) {
+  if (!trace || !path || capacity == 0) {
+    return result_error(Error_NullPointer, "invalid args to trace_open_file");
+  }
+
+  memset(trace, 0, sizeof(*trace));
+  trace->capacity    = round_pow2(capacity);
+  trace->granularity = granularity;
+  trace->flush_mask  = trace->capacity >= 8 ? trace->capacity / 8 - 1 : 0;
+  trace->map_size    = sizeof(TraceFileHeader) + trace->capacity * sizeof(TraceRecord);
+
+  trace->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (trace->fd < 0) {
+    return result_error(Error_FileIO, "failed to create trace: %s", path);
+  }
+
+  if (ftruncate(trace->fd, (off_t)trace->map_size) != 0) {
+    close(trace->fd);
+    return result_error(Error_FileIO, "failed to size trace (%zu bytes): %s", trace->map_size, path);
+  }
+
+  void* map = mmap(NULL, trace->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, trace->fd, 0);
+  if (map == MAP_FAILED) {
+    close(trace->fd);
+    return result_error(Error_FileIO, "failed to map trace: %s", path);
+  }
+
+  trace->map     = map;
+  trace->records = (TraceRecord*)(trace->map + sizeof(TraceFileHeader));
+
+  TraceFileHeader header;
+  fill_header(trace, &header);
+  memcpy(trace->map, &header, sizeof(header));
+
+  EMU_LOG_TRACE(EMU_LOG_MACHINE, "tracing to %s (%llu records)", path, (unsigned long long)trace->capacity);
+  return result_ok();
+}
+
+void trace_flush(TraceRecorder* trace) {
+  if (!trace->map) return;
+
+  TraceFileHeader header;
+  fill_header(trace, &header);
+  memcpy(trace->map, &header, sizeof(header));
+  msync(trace->map, trace->map_size, MS_ASYNC);
+}
+
+Result trace_save(const TraceRecorder* trace, const char* path) {
+  if (!trace || !path || !trace->records) {
+    return result_error(Error_NullPointer, "invalid args to trace_save");
+  }
+
+  FILE* f = fopen(path, "wb");
+  if (!f)
+    return result_error(Error_FileIO, "failed to create trace: %s", path);
+
+  TraceFileHeader header;
+  fill_header(trace, &header);
+
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+            fwrite(trace->records, sizeof(TraceRecord), trace->capacity, f) == trace->capacity;
+
+  if (fclose(f) != 0 || !ok)
+    return result_error(Error_FileIO, "failed to write trace: %s", path);
+  return result_ok();
+}
+
+Result trace_close(TraceRecorder* trace) {
+  if (!trace) {
+    return result_error(Error_NullPointer, "invalid trace to trace_close");
+  }
+
+  Result r = result_ok();
+  if (trace->map) {
+    trace_flush(trace);
+    if (msync(trace->map, trace->map_size, MS_SYNC) != 0)
+      r = result_error(Error_FileIO, "failed to flush trace");
+    munmap(trace->map, trace->map_size);
+    close(trace->fd);
+  } else {
+    free(trace->records);
+  }
+
+  trace->records = NULL;
+  trace->map     = NULL;
+  trace->fd      = -1;
+  return r;
+}
@@ -0,0 +1,110 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+#include <Emulator/cpu/cpu.h>
+
+// Execution trace recorder: one fixed size record per instruction (or per M-cycle)
+// written into a preallocated ring, either in memory or in an mmap'ed file that is
+// flushed in the background. Recording is one 32 byte store into the ring, cheap enough
+// to leave on for long runs; the ring keeps the most recent `capacity` records.
+//
+// File layout: TraceFileHeader, then `capacity` TraceRecords. When more than `capacity`
+// records were written, the oldest one is at index (count % capacity)
+
+#define TRACE_MAGIC "LGBT"
+#define TRACE_VERSION 1
+
+typedef enum {
+  TRACE_PER_INSTRUCTION = 0,
+  TRACE_PER_MCYCLE,
+} ETraceGranularity;
+
+// TraceRecord.flags
+typedef enum {
+  TRACE_FLAG_INSTR = 1 << 0, // first record of an instruction (taken at decode)
+  TRACE_FLAG_READ  = 1 << 1, // the cpu read the bus during this step
+  TRACE_FLAG_WRITE = 1 << 2, // the cpu wrote the bus during this step
+  TRACE_FLAG_INTERRUPT = 1 << 3, // first record of an interrupt dispatch, opcode is the IR it discards
+} ETraceFlag;
+
+typedef struct {
+  u64 cycle;
+  u16 pc;
+  u16 af;
+  u16 bc;
+  u16 de;
+  u16 hl;
+  u16 sp;
+  u16 addr;   // address bus
+  u8 data;    // data bus
+  u8 opcode;
+  u8 flags;   // ETraceFlag
+  u8 mcycle;  // M-cycle index inside the instruction
+  u8 reserved[6];
+} TraceRecord;
+
+_Static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay 32 bytes");
+
+typedef struct {
+  char magic[4];
+  u32 version;
+  u32 record_size;
+  u32 granularity;
+  u64 capacity;
+  u64 count; // records written since the start (can exceed capacity)
+} TraceFileHeader;
+
+typedef struct TraceRecorder {
+  TraceRecord* records;
+  u64 capacity; // power of two
+  u64 count;
+  ETraceGranularity granularity;
+
+  // mmap'ed file mode
+  int fd;
+  u8* map;
+  size_t map_size;
+  u64 flush_mask;  // flush when count & flush_mask wraps to 0
+} TraceRecorder;
+
+// In memory ring of `capacity` records (rounded up to a power of two)
+Result trace_open_ring(TraceRecorder* trace, u64 capacity, ETraceGranularity granularity);
+
+// Ring backed by an mmap'ed file at `path`, flushed asynchronously every capacity/8 records
+Result trace_open_file(TraceRecorder* trace, const char* path, u64 capacity, ETraceGranularity granularity);
+
+// Writes an in memory ring to `path`, in the file format
+Result trace_save(const TraceRecorder* trace, const char* path);
+
+// Flushes (file mode) and frees everything
+Result trace_close(TraceRecorder* trace);
+
+// Slow path of trace_record: periodic flush of the mmap'ed file
+void trace_flush(TraceRecorder* trace);
+
+// Records the cpu's current state, with `pc` as the instruction's address
+static inline void trace_record(TraceRecorder* trace, const Cpu* cpu, u16 pc, u8 opcode, u8 flags, u8 mcycle) {
+  TraceRecord* r = &trace->records[trace->count & (trace->capacity - 1)];
+
+  r->cycle  = cpu->clock_cycles;
+  r->pc     = pc;
+  r->af     = cpu->registers[AF].v;
+  r->bc     = cpu->registers[BC].v;
+  r->de     = cpu->registers[DE].v;
+  r->hl     = cpu->registers[HL].v;
+  r->sp     = cpu->registers[SP].v;
+  r->addr   = cpu->addr_value;
+  r->data   = cpu->data_value;
+  r->opcode = opcode;
+  r->flags  = flags;
+  r->mcycle = mcycle;
+
+  trace->count++;
+  if (trace->map && (trace->count & trace->flush_mask) == 0)
+    trace_flush(trace);
+}
+
+#endif // !TRACE_H
@@ -0,0 +1,575 @@
+#include "batch.h"
+#include <util.h>
+#include <llog.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+
+static const char* job_state_string(EBatchJobState state) {
+  switch (state) {
+    case BATCH_JOB_PENDING: return "pending";
+    case BATCH_JOB_RUNNING: return "running";
+    case BATCH_JOB_DONE:    return "done";
+    case BATCH_JOB_STOPPED: return "stopped";
+    case BATCH_JOB_FAILED:  return "failed";
+  }
+  return "?";
+}
+
+void batch_init(Batch* batch) {
+  memset(batch, 0, sizeof(*batch));
+}
+
+static void write_serial_output(const BatchRun* run) {
+  FILE* f = fopen(run->job.serial_path, "wb");
+  if (!f) {
+    LOG_WARNING("%s: failed to open serial output", run->job.serial_path);
+    return;
+  }
+  const Serial* serial = &run->machine->cpu.serial;
+  fwrite(serial->output, 1, serial->output_len, f);
+  fclose(f);
+}
+
+static void release_machine(BatchRun* run) {
+  if (!run->machine) return;
+
+  if (run->job.serial_path[0])
+    write_serial_output(run);
+
+  if (run->hashing) {
+    const FrameHasher* h = &run->hasher;
+    if (h->mode == FRAMEHASH_COMPARE && !h->diverged && !run->message[0]) {
+      u64 compared = h->frames < h->golden_frames ? h->frames : h->golden_frames;
+      snprintf(run->message, sizeof(run->message), "%llu frames match the golden hashes%s",
+               (unsigned long long)compared, h->frames > h->golden_frames ? " (golden log ended)" : "");
+    }
+    Result r = framehash_close(&run->hasher);
+    if (result_is_error(&r))
+      LOG_WARNING("%s: %s", run->job.hash_path, r.message);
+    run->hashing = false;
+  }
+
+  if (run->dumping) {
+    Result r = framedump_close(&run->dump);
+    if (result_is_error(&r))
+      LOG_WARNING("%s: %s", run->job.dump_path, r.message);
+    else
+      LOG_INFO("%s: %llu frames written, %llu dropped", run->job.dump_path,
+               (unsigned long long)run->dump.written, (unsigned long long)run->dump.dropped);
+    run->dumping = false;
+  }
+
+  machine_stats(run->machine, &run->stats);
+  machine_destroy(run->machine);
+  free(run->machine);
+  run->machine = NULL;
+  movie_destroy(&run->movie);
+
+  if (run->tracing) {
+    Result r = trace_close(&run->trace);
+    if (result_is_error(&r))
+      LOG_WARNING("%s: %s", run->job.trace_path, r.message);
+    run->tracing = false;
+  }
+
+  // The counters stay around for batch_report
+  if (run->profiling) {
+    Result r = profiler_export_folded(&run->profile, run->job.profile_path);
+    if (result_is_error(&r))
+      LOG_WARNING("%s: %s", run->job.profile_path, r.message);
+  }
+}
+
+void batch_destroy(Batch* batch) {
+  if (!batch) return;
+
+  for (int i = 0; i < batch->run_count; i++) {
+    release_machine(&batch->runs[i]);
+    profiler_destroy(&batch->runs[i].profile);
+  }
+
+  for (int i = 0; i < batch->group_count; i++)
+    free(batch->groups[i].ls);
+  free(batch->groups);
+  batch->groups = NULL;
+  batch->group_count = 0;
+
+  pool_destroy(&batch->pool);
+  free(batch->runs);
+  batch->runs = NULL;
+  batch->run_count = 0;
+  batch->run_capacity = 0;
+}
+
+Result batch_add_job(Batch* batch, const BatchJob* job) {
+  if (!batch || !job) {
+    return result_error(Error_NullPointer, "invalid args to batch_add_job");
+  }
+
+  if (batch->run_count == batch->run_capacity) {
+    int capacity = batch->run_capacity ? batch->run_capacity * 2 : 16;
+    BatchRun* runs = realloc(batch->runs, sizeof(BatchRun) * (size_t)capacity);
+    if (!runs) {
+      return result_error(Error_NullPointer, "no mem for batch jobs");
+    }
+    batch->runs = runs;
+    batch->run_capacity = capacity;
+  }
+
+  BatchRun* run = &batch->runs[batch->run_count++];
+  memset(run, 0, sizeof(*run));
+  run->job = *job;
+  run->group = -1;
+  run->budget_cycles = job->cycles ? job->cycles : job->frames * CYCLES_PER_FRAME;
+
+  return result_ok();
+}
+
+Result batch_load_jobs(Batch* batch, const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return result_error(Error_FileIO, "failed to open job file: %s", path);
+
+  char line[2048];
+  int line_no = 0;
+  while (fgets(line, sizeof(line), f)) {
+    line_no++;
+
+    char* comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+
+    BatchJob job;
+    memset(&job, 0, sizeof(job));
+    job.frames = BATCH_DEFAULT_FRAMES;
+
+    char* save = NULL;
+    char* tok = strtok_r(line, " \t\r\n", &save);
+    if (!tok) continue;
+
+    strncpy(job.rom_path, tok, sizeof(job.rom_path) - 1);
+
+    while ((tok = strtok_r(NULL, " \t\r\n", &save))) {
+      if (strncmp(tok, "frames=", 7) == 0) {
+        job.frames = strtoull(tok + 7, NULL, 10);
+      } else if (strncmp(tok, "cycles=", 7) == 0) {
+        job.cycles = strtoull(tok + 7, NULL, 10);
+      } else if (strncmp(tok, "input=", 6) == 0) {
+        strncpy(job.input_path, tok + 6, sizeof(job.input_path) - 1);
+      } else if (strncmp(tok, "trace=", 6) == 0) {
+        strncpy(job.trace_path, tok + 6, sizeof(job.trace_path) - 1);
+        job.trace_mcycles = false;
+      } else if (strncmp(tok, "trace-mcycles=", 14) == 0) {
+        strncpy(job.trace_path, tok + 14, sizeof(job.trace_path) - 1);
+        job.trace_mcycles = true;
+      } else if (strncmp(tok, "profile=", 8) == 0) {
+        strncpy(job.profile_path, tok + 8, sizeof(job.profile_path) - 1);
+      } else if (strncmp(tok, "debug=", 6) == 0) {
+        strncpy(job.debug_path, tok + 6, sizeof(job.debug_path) - 1);
+      } else if (strncmp(tok, "serial=", 7) == 0) {
+        strncpy(job.serial_path, tok + 7, sizeof(job.serial_path) - 1);
+      } else if (strncmp(tok, "hash=", 5) == 0) {
+        strncpy(job.hash_path, tok + 5, sizeof(job.hash_path) - 1);
+      } else if (strncmp(tok, "hash-regions=", 13) == 0) {
+        strncpy(job.hash_regions, tok + 13, sizeof(job.hash_regions) - 1);
+      } else if (strncmp(tok, "compare=", 8) == 0) {
+        strncpy(job.compare_path, tok + 8, sizeof(job.compare_path) - 1);
+      } else if (strncmp(tok, "dump=", 5) == 0) {
+        strncpy(job.dump_path, tok + 5, sizeof(job.dump_path) - 1);
+      } else if (strcmp(tok, "dump-policy=drop") == 0) {
+        job.dump_policy = FRAMEDUMP_DROP;
+      } else if (strcmp(tok, "dump-policy=block") == 0) {
+        job.dump_policy = FRAMEDUMP_BLOCK;
+      } else if (strcmp(tok, "no-skip") == 0) {
+        job.no_skip = true;
+      } else if (strcmp(tok, "dma-bulk") == 0) {
+        job.dma_bulk = true;
+      } else {
+        fclose(f);
+        return result_error(Error_FileIO, "%s:%d: unknown job option '%s'", path, line_no, tok);
+      }
+    }
+
+    Result r = batch_add_job(batch, &job);
+    if (result_is_error(&r)) {
+      fclose(f);
+      return r;
+    }
+  }
+
+  fclose(f);
+  return result_ok();
+}
+
+static Result start_job(BatchRun* run) {
+  run->machine = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!run->machine) {
+    return result_error(Error_NullPointer, "no mem for Machine struct");
+  }
+
+  Result r = machine_init(run->machine);
+  if (result_is_error(&r)) return r;
+
+  r = machine_load_rom(run->machine, run->job.rom_path);
+  if (result_is_error(&r)) return r;
+
+  machine_skip_bootrom(run->machine);
+  run->machine->fast_forward = !run->job.no_skip;
+  run->machine->mem.dma_bulk = run->job.dma_bulk;
+
+  if (run->job.input_path[0]) {
+    r = movie_load(&run->movie, run->job.input_path);
+    if (result_is_error(&r)) return r;
+
+    run->movie.mode = MOVIE_PLAYING;
+    run->machine->movie = &run->movie;
+  }
+
+  if (run->job.trace_path[0]) {
+    ETraceGranularity granularity = run->job.trace_mcycles ? TRACE_PER_MCYCLE : TRACE_PER_INSTRUCTION;
+    r = trace_open_file(&run->trace, run->job.trace_path, BATCH_TRACE_RECORDS, granularity);
+    if (result_is_error(&r)) return r;
+
+    run->tracing = true;
+    run->machine->cpu.trace = &run->trace;
+  }
+
+  if (run->job.profile_path[0]) {
+    r = profiler_init(&run->profile, &run->machine->mem);
+    if (result_is_error(&r)) return r;
+
+    run->profiling = true;
+    run->machine->cpu.profiler = &run->profile;
+  }
+
+  if (run->job.debug_path[0]) {
+    debugger_init(&run->debugger);
+    r = debugger_load(&run->debugger, run->job.debug_path);
+    if (result_is_error(&r)) return r;
+
+    if (!debugger_empty(&run->debugger))
+      run->machine->cpu.debugger = &run->debugger;
+  }
+
+  if (run->job.hash_path[0] || run->job.compare_path[0]) {
+    r = run->job.compare_path[0] ? framehash_open_compare(&run->hasher, run->job.compare_path)
+                                 : framehash_open_record(&run->hasher, run->job.hash_path, run->job.hash_regions);
+    if (result_is_error(&r)) return r;
+
+    run->hashing = true;
+    framehash_attach(&run->hasher, &run->machine->cpu);
+  }
+
+  if (run->job.dump_path[0]) {
+    r = framedump_open(&run->dump, run->job.dump_path, run->job.dump_policy);
+    if (result_is_error(&r)) return r;
+
+    run->dumping = true;
+    framedump_attach(&run->dump, &run->machine->cpu);
+  }
+
+  return result_ok();
+}
+
+// Starts every job of the group and hands the machines that started to a Lockstep
+static void start_group(Batch* batch, BatchGroup* group) {
+  Machine* machines[LOCKSTEP_MAX_LANES];
+  group->lane_count = 0;
+
+  for (int i = 0; i < group->count; i++) {
+    BatchRun* run = &batch->runs[group->runs[i]];
+    run->state = BATCH_JOB_RUNNING;
+
+    Result r = start_job(run);
+    if (result_is_error(&r)) {
+      run->state = BATCH_JOB_FAILED;
+      snprintf(run->message, sizeof(run->message), "%s", r.message);
+      release_machine(run);
+      continue;
+    }
+    machines[group->lane_count] = run->machine;
+    group->lanes[group->lane_count++] = group->runs[i];
+  }
+  if (group->lane_count == 0) return;
+
+  Result r = result_ok();
+  group->ls = malloc(sizeof(Lockstep));
+  if (!group->ls)
+    r = result_error(Error_NullPointer, "no mem for Lockstep");
+  else
+    r = lockstep_init(group->ls, machines, group->lane_count);
+
+  if (result_is_error(&r)) {
+    for (int i = 0; i < group->lane_count; i++) {
+      BatchRun* run = &batch->runs[group->lanes[i]];
+      run->state = BATCH_JOB_FAILED;
+      snprintf(run->message, sizeof(run->message), "%s", r.message);
+      release_machine(run);
+    }
+    free(group->ls);
+    group->ls = NULL;
+    group->lane_count = 0;
+  }
+}
+
+// One time slice of a lockstep group, as long as the shortest budget left in it. Lanes
+// whose job ended are stopped, the machines are released once they all have
+static bool run_group_quantum(Batch* batch, BatchGroup* group, int task) {
+  if (task != group->runs[0])
+    return false;
+
+  if (!group->ls) {
+    start_group(batch, group);
+    if (!group->ls) return false;
+  }
+
+  Lockstep* ls = group->ls;
+  u64 quantum = (u64)batch->options.quantum_frames * CYCLES_PER_FRAME;
+  u64 start_cycles[LOCKSTEP_MAX_LANES];
+  int live = 0;
+
+  for (int i = 0; i < ls->lane_count; i++) {
+    const BatchRun* run = &batch->runs[group->lanes[i]];
+    start_cycles[i] = ls->cycles[i];
+    if (ls->stopped[i]) continue;
+
+    live++;
+    u64 left = run->budget_cycles - run->cycles_run;
+    if (quantum > left) quantum = left;
+  }
+
+  u64 start = time_now_ns();
+  Result r = lockstep_run_cycles(ls, quantum);
+  u64 wall_ns = time_now_ns() - start;
+  lockstep_store(ls);
+
+  bool running = false;
+  for (int i = 0; i < ls->lane_count; i++) {
+    BatchRun* run = &batch->runs[group->lanes[i]];
+    if (run->state != BATCH_JOB_RUNNING) continue;
+
+    const Machine* m = run->machine;
+    run->wall_ns    += live ? wall_ns / (u64)live : 0;
+    run->cycles_run += ls->cycles[i] - start_cycles[i];
+    run->quanta++;
+
+    if (result_is_error(&r)) {
+      run->state = BATCH_JOB_FAILED;
+      snprintf(run->message, sizeof(run->message), "%s", r.message);
+    } else if (ls->stopped[i]) {
+      run->state = m->cpu.paused ? BATCH_JOB_STOPPED : BATCH_JOB_FAILED;
+      snprintf(run->message, sizeof(run->message), "%s", m->cpu.error.message);
+    } else if (run->job.serial_path[0] && serial_verdict(&m->cpu.serial) != SERIAL_VERDICT_NONE) {
+      run->state = BATCH_JOB_DONE;
+      snprintf(run->message, sizeof(run->message), "serial: %s",
+               serial_verdict(&m->cpu.serial) == SERIAL_VERDICT_PASSED ? "Passed" : "Failed");
+    } else if (run->cycles_run >= run->budget_cycles) {
+      run->state = BATCH_JOB_DONE;
+    }
+
+    // A lane whose job ended is left out of later steps
+    if (run->state == BATCH_JOB_RUNNING)
+      running = true;
+    else
+      ls->stopped[i] = true;
+  }
+  if (running) return true;
+
+  group->vector_lanes  = ls->vector_lanes;
+  group->scalar_instrs = ls->scalar_instrs;
+  for (int i = 0; i < ls->lane_count; i++)
+    release_machine(&batch->runs[group->lanes[i]]);
+  free(group->ls);
+  group->ls = NULL;
+  return false;
+}
+
+// One time slice of one job. Returns true while the job still has budget left
+static bool run_quantum(void* ctx, int task, int worker) {
+  (void)worker;
+  Batch* batch = (Batch*)ctx;
+  BatchRun* run = &batch->runs[task];
+
+  if (run->group >= 0)
+    return run_group_quantum(batch, &batch->groups[run->group], task);
+
+  if (run->state == BATCH_JOB_PENDING) {
+    run->state = BATCH_JOB_RUNNING;
+
+    Result r = start_job(run);
+    if (result_is_error(&r)) {
+      run->state = BATCH_JOB_FAILED;
+      snprintf(run->message, sizeof(run->message), "%s", r.message);
+      release_machine(run);
+      return false;
+    }
+  }
+
+  u64 quantum = (u64)batch->options.quantum_frames * CYCLES_PER_FRAME;
+  u64 left = run->budget_cycles - run->cycles_run;
+  if (quantum > left) quantum = left;
+
+  Machine* m = run->machine;
+  u64 start_cycles = m->cpu.clock_cycles;
+  u64 start = time_now_ns();
+
+  Result r = machine_run_cycles(m, quantum);
+
+  run->wall_ns    += time_now_ns() - start;
+  run->cycles_run += m->cpu.clock_cycles - start_cycles;
+  run->quanta++;
+
+  if (result_is_error(&r) || m->cpu.paused) {
+    run->state = m->cpu.paused ? BATCH_JOB_STOPPED : BATCH_JOB_FAILED;
+    if (!result_is_error(&r) && run->debugger.hit.kind != DEBUG_HIT_NONE)
+      debugger_describe_hit(&run->debugger, run->message, sizeof(run->message));
+    else if (!result_is_error(&r) && run->hashing && run->hasher.diverged)
+      snprintf(run->message, sizeof(run->message), "%s", run->hasher.message);
+    else
+      snprintf(run->message, sizeof(run->message), "%s", r.message);
+  } else if (run->job.serial_path[0] && serial_verdict(&m->cpu.serial) != SERIAL_VERDICT_NONE) {
+    // Test roms report over serial, no need to run out the budget
+    run->state = BATCH_JOB_DONE;
+    snprintf(run->message, sizeof(run->message), "serial: %s",
+             serial_verdict(&m->cpu.serial) == SERIAL_VERDICT_PASSED ? "Passed" : "Failed");
+  } else if (run->cycles_run >= run->budget_cycles) {
+    run->state = BATCH_JOB_DONE;
+  }
+
+  if (run->state != BATCH_JOB_RUNNING) {
+    release_machine(run);
+    return false;
+  }
+  return true;
+}
+
+// The vector path of the lockstep core runs no per-instruction hooks and notifies no
+// frame sinks, so jobs that need them run on their own
+static bool lockstep_eligible(const BatchJob* job) {
+  return !job->trace_path[0] && !job->profile_path[0] && !job->debug_path[0] &&
+         !job->hash_path[0] && !job->compare_path[0] && !job->dump_path[0];
+}
+
+static Result group_jobs(Batch* batch) {
+  batch->groups = calloc(batch->run_count ? (size_t)batch->run_count : 1, sizeof(BatchGroup));
+  if (!batch->groups) {
+    return result_error(Error_NullPointer, "no mem for lockstep groups");
+  }
+
+  for (int i = 0; i < batch->run_count; i++) {
+    const BatchRun* run = &batch->runs[i];
+    if (run->group >= 0 || !lockstep_eligible(&run->job)) continue;
+
+    BatchGroup* group = &batch->groups[batch->group_count];
+    group->count = 0;
+    for (int j = i; j < batch->run_count && group->count < LOCKSTEP_MAX_LANES; j++) {
+      const BatchRun* other = &batch->runs[j];
+      if (other->group < 0 && lockstep_eligible(&other->job) &&
+          strcmp(other->job.rom_path, run->job.rom_path) == 0)
+        group->runs[group->count++] = j;
+    }
+
+    // A job alone on its rom stays on the scalar core
+    if (group->count < 2) continue;
+
+    for (int k = 0; k < group->count; k++)
+      batch->runs[group->runs[k]].group = batch->group_count;
+    batch->group_count++;
+  }
+
+  return result_ok();
+}
+
+Result batch_run(Batch* batch, const BatchOptions* options) {
+  if (!batch || !options) {
+    return result_error(Error_NullPointer, "invalid args to batch_run");
+  }
+
+  batch->options = *options;
+  if (batch->options.threads <= 0)
+    batch->options.threads = SDL_GetCPUCount();
+  if (batch->options.threads > batch->run_count)
+    batch->options.threads = batch->run_count > 0 ? batch->run_count : 1;
+  if (batch->options.quantum_frames == 0)
+    batch->options.quantum_frames = 1;
+
+  if (batch->options.lockstep) {
+    Result r = group_jobs(batch);
+    if (result_is_error(&r)) return r;
+  }
+
+  u64 start = time_now_ns();
+  Result r = pool_run(&batch->pool, batch->options.threads, batch->run_count,
+                      run_quantum, batch, batch->options.pin_threads);
+  batch->wall_ns = time_now_ns() - start;
+
+  return r;
+}
+
+static double mhz(u64 cycles, u64 ns) {
+  return ns ? (double)cycles * 1000.0 / (double)ns : 0.0;
+}
+
+void batch_report(const Batch* batch, FILE* out) {
+  u64 total_cycles = 0;
+  int done = 0;
+
+  fprintf(out, "%-4s %-8s %10s %14s %10s %9s %7s  %s\n",
+          "job", "state", "frames", "cycles", "wall_ms", "MHz", "quanta", "rom");
+
+  for (int i = 0; i < batch->run_count; i++) {
+    const BatchRun* run = &batch->runs[i];
+    total_cycles += run->cycles_run;
+    if (run->state == BATCH_JOB_DONE) done++;
+
+    fprintf(out, "%-4d %-8s %10.1f %14llu %10.2f %9.3f %7u  %s\n",
+            i, job_state_string(run->state),
+            (double)run->cycles_run / CYCLES_PER_FRAME,
+            (unsigned long long)run->cycles_run,
+            (double)run->wall_ns / 1e6,
+            mhz(run->cycles_run, run->wall_ns),
+            run->quanta,
+            run->job.rom_path);
+
+    if (run->message[0])
+      fprintf(out, "     -> %s\n", run->message);
+  }
+
+  fprintf(out, "\n%d/%d jobs done on %d threads: %llu cycles in %.2f ms, aggregate %.3f MHz (%.2fx DMG)\n",
+          done, batch->run_count, batch->options.threads,
+          (unsigned long long)total_cycles, (double)batch->wall_ns / 1e6,
+          mhz(total_cycles, batch->wall_ns),
+          mhz(total_cycles, batch->wall_ns) / 4.194304);
+
+  for (int i = 0; i < batch->pool.worker_count; i++) {
+    const PoolWorker* w = &batch->pool.workers[i];
+    fprintf(out, "  worker %d: %llu quanta, %llu steals\n", i,
+            (unsigned long long)w->quanta, (unsigned long long)w->steals);
+  }
+
+  for (int i = 0; i < batch->group_count; i++) {
+    const BatchGroup* group = &batch->groups[i];
+    u64 lane_instrs = group->vector_lanes + group->scalar_instrs;
+    fprintf(out, "  lockstep group %d: %d jobs on %s, %.1f%% of %llu instructions vectorized\n",
+            i, group->lane_count, batch->runs[group->runs[0]].job.rom_path,
+            lane_instrs ? 100.0 * (double)group->vector_lanes / (double)lane_instrs : 0.0,
+            (unsigned long long)lane_instrs);
+  }
+
+  for (int i = 0; i < batch->run_count; i++) {
+    const BatchRun* run = &batch->runs[i];
+    if (!run->profiling) continue;
+
+    fprintf(out, "\njob %d (%s), folded stacks in %s\n", i, run->job.rom_path, run->job.profile_path);
+    profiler_report(&run->profile, out, BATCH_PROFILE_TOP);
+  }
+
+  if (!batch->options.stats) return;
+  for (int i = 0; i < batch->run_count; i++) {
+    const BatchRun* run = &batch->runs[i];
+    if (run->state == BATCH_JOB_FAILED || run->state == BATCH_JOB_PENDING) continue;
+
+    fprintf(out, "\njob %d (%s) ", i, run->job.rom_path);
+    emu_stats_report(&run->stats, out);
+  }
+}
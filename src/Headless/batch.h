@@ -0,0 +1,128 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include <Emulator/machine.h>
+#include <Emulator/trace.h>
+#include <Emulator/profiler.h>
+#include <Emulator/debugger.h>
+#include <Emulator/framehash.h>
+#include <Emulator/lockstep.h>
+#include "pool.h"
+#include "framedump.h"
+
+#define BATCH_PATH_MAX 512
+#define BATCH_DEFAULT_FRAMES 600
+#define BATCH_TRACE_RECORDS (1u << 20) // 32MB trace ring per traced job
+#define BATCH_PROFILE_TOP 10             // routines and instructions listed per profiled job
+
+typedef struct {
+  char rom_path[BATCH_PATH_MAX];
+  char input_path[BATCH_PATH_MAX]; // input movie (.lgbm), empty for none
+  char trace_path[BATCH_PATH_MAX]; // execution trace output, empty for none
+  bool trace_mcycles;              // one trace record per M-cycle instead of per instruction
+  char profile_path[BATCH_PATH_MAX]; // guest profile output (folded stacks), empty for none
+  char debug_path[BATCH_PATH_MAX];   // debugger script, the job stops at the first hit
+  char serial_path[BATCH_PATH_MAX];  // serial output, the job ends once it reports Passed/Failed
+  char hash_path[BATCH_PATH_MAX];    // per frame hash log to write, empty for none
+  char hash_regions[64];             // memory regions hashed with the framebuffer (framehash.h)
+  char compare_path[BATCH_PATH_MAX]; // golden hash log, the job stops at the first difference
+  char dump_path[BATCH_PATH_MAX];    // video dump, a .y4m file or a png directory (framedump.h)
+  EFrameDumpPolicy dump_policy;      // when the dump writer falls behind
+  u64 frames; // frame budget
+  u64 cycles; // T-cycle budget, overrides frames when non-zero
+  bool no_skip; // step every halted and idle loop cycle (Machine.fast_forward off)
+  bool dma_bulk; // copy OAM in one go when a DMA starts (Mem.dma_bulk)
+} BatchJob;
+
+typedef enum {
+  BATCH_JOB_PENDING = 0,
+  BATCH_JOB_RUNNING,
+  BATCH_JOB_DONE,
+  BATCH_JOB_STOPPED, // the guest stopped the cpu (e.g. unimplemented opcode)
+  BATCH_JOB_FAILED,
+} EBatchJobState;
+
+typedef struct {
+  BatchJob job;
+  Machine* machine; // only allocated while the job is running
+  Movie movie;      // played back into the machine when the job has an input movie
+  TraceRecorder trace;
+  bool tracing;
+  Profiler profile; // kept after the machine is released, for batch_report
+  bool profiling;
+  Debugger debugger;
+  FrameHasher hasher; // records hash_path or compares against compare_path
+  bool hashing;
+  FrameDump dump;
+  bool dumping;
+  int group; // index into Batch.groups, -1 when the job runs on its own
+  EmuStats stats; // collected when the machine is released, with --stats
+
+  EBatchJobState state;
+  u64 budget_cycles;
+  u64 cycles_run;
+  u64 wall_ns; // time spent inside this job's quanta
+  u32 quanta;
+  char message[256];
+} BatchRun;
+
+typedef struct {
+  int threads;        // 0 = one per core
+  u32 quantum_frames; // length of a time slice, in frames
+  bool pin_threads;
+  bool stats; // report the instrumentation counters of every job
+  bool lockstep; // run jobs on the same rom together on the lockstep core
+} BatchOptions;
+
+// Jobs on the same rom stepped together by the lockstep core. The group runs in the
+// pool task of its first job, the tasks of the others end right away
+typedef struct {
+  int runs[LOCKSTEP_MAX_LANES]; // indices into Batch.runs
+  int count;
+  int lanes[LOCKSTEP_MAX_LANES]; // the runs that started, in lane order
+  int lane_count;
+  Lockstep* ls; // only allocated while the group is running
+
+  // Kept from the Lockstep for batch_report
+  u64 vector_lanes;
+  u64 scalar_instrs;
+} BatchGroup;
+
+typedef struct {
+  BatchRun* runs;
+  int run_count;
+  int run_capacity;
+
+  BatchGroup* groups;
+  int group_count;
+
+  BatchOptions options;
+  WorkPool pool;
+  u64 wall_ns;
+} Batch;
+
+void batch_init(Batch* batch);
+void batch_destroy(Batch* batch);
+
+Result batch_add_job(Batch* batch, const BatchJob* job);
+
+// Reads one job per line: `<rom> [frames=N] [cycles=N] [input=<file>] [trace=<file>]
+// [trace-mcycles=<file>] [profile=<file>] [debug=<file>] [serial=<file>]
+// [hash=<file> [hash-regions=<list>] | compare=<file>]
+// [dump=<file.y4m|dir> [dump-policy=drop|block]] [no-skip] [dma-bulk]`, '#' starts a
+// comment
+Result batch_load_jobs(Batch* batch, const char* path);
+
+// Runs every job to completion, one machine per job, time-sliced in frame-sized quanta.
+// With options->lockstep, jobs on the same rom share lockstep groups of up to
+// LOCKSTEP_MAX_LANES, except traced, profiled, debugged, hashed and dumped jobs
+Result batch_run(Batch* batch, const BatchOptions* options);
+
+// Per-job throughput and aggregate emulated MHz, then the hottest guest code of
+// profiled jobs and the instrumentation counters with --stats
+void batch_report(const Batch* batch, FILE* out);
+
+#endif // !BATCH_H
@@ -0,0 +1,277 @@
+#include "framedump.h"
+#include <util.h>
+#include <llog.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Shade (0 = lightest) to 8-bit luma
+static const u8 SHADE_LUMA[4] = { 0xFF, 0xAA, 0x55, 0x00 };
+
+// Y4M frame rate: one frame per CYCLES_PER_FRAME T-cycles of the 4194304 Hz clock
+#define Y4M_HEADER "YUV4MPEG2 W160 H144 F4194304:70224 Ip A1:1 C420jpeg\n"
+#define Y4M_CHROMA_SIZE ((LCD_WIDTH / 2) * (LCD_HEIGHT / 2))
+
+// PNG rows: a filter byte then 4 pixels per byte
+#define PNG_ROW_BYTES (1 + LCD_WIDTH / 4)
+#define PNG_RAW_SIZE  (PNG_ROW_BYTES * LCD_HEIGHT)
+
+//
+// Encoders (writer thread)
+//
+
+static Result write_y4m(FrameDump* dump, const FrameDumpBuffer* buf) {
+  static const char FRAME[] = "FRAME\n";
+  u8 luma[LCD_HEIGHT * LCD_WIDTH];
+  u8 chroma[Y4M_CHROMA_SIZE * 2];
+
+  const u8* src = &buf->pixels[0][0];
+  for (int i = 0; i < LCD_HEIGHT * LCD_WIDTH; i++)
+    luma[i] = SHADE_LUMA[src[i] & 0x03];
+  memset(chroma, 0x80, sizeof(chroma));
+
+  if (fwrite(FRAME, 1, sizeof(FRAME) - 1, dump->y4m) != sizeof(FRAME) - 1 ||
+      fwrite(luma, 1, sizeof(luma), dump->y4m) != sizeof(luma) ||
+      fwrite(chroma, 1, sizeof(chroma), dump->y4m) != sizeof(chroma)) {
+    return result_error(Error_FileIO, "failed to write %s: %s", dump->path, strerror(errno));
+  }
+  return result_ok();
+}
+
+// Bitwise, no table to share between writer threads: a frame is only a few KB
+static u32 crc32_update(u32 crc, const u8* data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void put_be32(u8* p, u32 v) {
+  p[0] = (u8)(v >> 24);
+  p[1] = (u8)(v >> 16);
+  p[2] = (u8)(v >> 8);
+  p[3] = (u8)v;
+}
+
+// Length, type, data, CRC of type + data
+static size_t png_chunk(u8* out, const char type[4], const u8* data, u32 len) {
+  put_be32(out, len);
+  memcpy(out + 4, type, 4);
+  if (len) memcpy(out + 8, data, len);
+  put_be32(out + 8 + len, crc32_update(0, out + 4, 4 + len));
+  return 12 + len;
+}
+
+// 2-bit grayscale, the image data in one stored (uncompressed) deflate block: the whole
+// frame is under 6KB that way, and costs nothing to encode
+static Result write_png(FrameDump* dump, const FrameDumpBuffer* buf) {
+  static const u8 SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  // zlib header, stored block header, rows, adler32
+  u8 zlib[2 + 5 + PNG_RAW_SIZE + 4];
+  u8* raw = zlib + 7;
+  for (int y = 0; y < LCD_HEIGHT; y++) {
+    u8* row = raw + y * PNG_ROW_BYTES;
+    row[0] = 0; // no filter
+    for (int x = 0; x < LCD_WIDTH; x += 4) {
+      u8 packed = 0;
+      for (int k = 0; k < 4; k++)
+        packed = (u8)((packed << 2) | (3 - (buf->pixels[y][x + k] & 0x03)));
+      row[1 + x / 4] = packed;
+    }
+  }
+
+  u32 a = 1, b = 0;
+  for (int i = 0; i < PNG_RAW_SIZE; i++) {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  zlib[0] = 0x78;
+  zlib[1] = 0x01;
+  zlib[2] = 0x01; // final block, stored
+  zlib[3] = (u8)PNG_RAW_SIZE;
+  zlib[4] = (u8)(PNG_RAW_SIZE >> 8);
+  zlib[5] = (u8)~PNG_RAW_SIZE;
+  zlib[6] = (u8)(~PNG_RAW_SIZE >> 8);
+  put_be32(zlib + 7 + PNG_RAW_SIZE, (b << 16) | a);
+
+  u8 ihdr[13];
+  put_be32(ihdr, LCD_WIDTH);
+  put_be32(ihdr + 4, LCD_HEIGHT);
+  ihdr[8]  = 2; // bit depth
+  ihdr[9]  = 0; // grayscale
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+
+  u8 file[sizeof(SIGNATURE) + 12 + sizeof(ihdr) + 12 + sizeof(zlib) + 12];
+  size_t len = sizeof(SIGNATURE);
+  memcpy(file, SIGNATURE, sizeof(SIGNATURE));
+  len += png_chunk(file + len, "IHDR", ihdr, sizeof(ihdr));
+  len += png_chunk(file + len, "IDAT", zlib, sizeof(zlib));
+  len += png_chunk(file + len, "IEND", NULL, 0);
+
+  char name[sizeof(dump->path) + 32];
+  snprintf(name, sizeof(name), "%s/frame_%06llu.png", dump->path, (unsigned long long)buf->frame);
+  FILE* f = fopen(name, "wb");
+  if (!f) {
+    return result_error(Error_FileIO, "failed to open %s: %s", name, strerror(errno));
+  }
+  bool ok = fwrite(file, 1, len, f) == len;
+  if (fclose(f) != 0) ok = false;
+  if (!ok) {
+    return result_error(Error_FileIO, "failed to write %s", name);
+  }
+  return result_ok();
+}
+
+static int writer_thread(void* data) {
+  FrameDump* dump = (FrameDump*)data;
+
+  SDL_LockMutex(dump->lock);
+  for (;;) {
+    while (dump->queue_count == 0 && !dump->closing)
+      SDL_CondWait(dump->queued, dump->lock);
+    if (dump->queue_count == 0)
+      break;
+
+    int index = dump->queue[dump->queue_head];
+    dump->queue_head = (dump->queue_head + 1) % FRAMEDUMP_POOL_FRAMES;
+    dump->queue_count--;
+    bool failed = result_is_error(&dump->error);
+    SDL_UnlockMutex(dump->lock);
+
+    Result r = result_ok();
+    if (!failed) {
+      const FrameDumpBuffer* buf = &dump->buffers[index];
+      r = dump->format == FRAMEDUMP_Y4M ? write_y4m(dump, buf) : write_png(dump, buf);
+    }
+
+    SDL_LockMutex(dump->lock);
+    if (result_is_error(&r) && !result_is_error(&dump->error))
+      dump->error = r;
+    else if (!failed)
+      dump->written++;
+    dump->free_list[dump->free_count++] = index;
+    SDL_CondSignal(dump->freed);
+  }
+  SDL_UnlockMutex(dump->lock);
+
+  return 0;
+}
+
+//
+// Emulation thread
+//
+
+static void dump_frame(FrameSink* sink, Cpu* cpu) {
+  FrameDump* dump = (FrameDump*)sink;
+  u64 frame = dump->frames++;
+
+  SDL_LockMutex(dump->lock);
+  while (dump->free_count == 0) {
+    if (dump->policy == FRAMEDUMP_DROP) {
+      dump->dropped++;
+      SDL_UnlockMutex(dump->lock);
+      return;
+    }
+    SDL_CondWait(dump->freed, dump->lock);
+  }
+  int index = dump->free_list[--dump->free_count];
+  SDL_UnlockMutex(dump->lock);
+
+  FrameDumpBuffer* buf = &dump->buffers[index];
+  memcpy(buf->pixels, cpu->ppu.framebuffer, sizeof(buf->pixels));
+  buf->frame = frame;
+
+  SDL_LockMutex(dump->lock);
+  dump->queue[(dump->queue_head + dump->queue_count) % FRAMEDUMP_POOL_FRAMES] = index;
+  dump->queue_count++;
+  SDL_CondSignal(dump->queued);
+  SDL_UnlockMutex(dump->lock);
+}
+
+static bool has_suffix(const char* s, const char* suffix) {
+  size_t n = strlen(s), k = strlen(suffix);
+  return n >= k && strcmp(s + n - k, suffix) == 0;
+}
+
+Result framedump_open(FrameDump* dump, const char* path, EFrameDumpPolicy policy) {
+  if (!dump || !path) {
+    return result_error(Error_NullPointer, "invalid args to framedump_open");
+  }
+  memset(dump, 0, sizeof(*dump));
+  dump->policy = policy;
+  dump->format = has_suffix(path, ".y4m") ? FRAMEDUMP_Y4M : FRAMEDUMP_PNG;
+  dump->error  = result_ok();
+  if (strlen(path) >= sizeof(dump->path)) {
+    return result_error(Error_FileIO, "dump path too long: %s", path);
+  }
+  strcpy(dump->path, path);
+
+  if (dump->format == FRAMEDUMP_Y4M) {
+    dump->y4m = fopen(path, "wb");
+    if (!dump->y4m) {
+      return result_error(Error_FileIO, "failed to open %s: %s", path, strerror(errno));
+    }
+    fputs(Y4M_HEADER, dump->y4m);
+  } else if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+    return result_error(Error_FileIO, "failed to create %s: %s", path, strerror(errno));
+  }
+
+  dump->buffers = malloc(sizeof(FrameDumpBuffer) * FRAMEDUMP_POOL_FRAMES);
+  dump->lock    = SDL_CreateMutex();
+  dump->queued  = SDL_CreateCond();
+  dump->freed   = SDL_CreateCond();
+  if (!dump->buffers || !dump->lock || !dump->queued || !dump->freed) {
+    framedump_close(dump);
+    return result_error(Error_NullPointer, "no mem for frame dump buffers");
+  }
+  for (int i = 0; i < FRAMEDUMP_POOL_FRAMES; i++)
+    dump->free_list[dump->free_count++] = i;
+
+  dump->writer = SDL_CreateThread(writer_thread, "FrameDump", dump);
+  if (!dump->writer) {
+    framedump_close(dump);
+    return result_error(Error_Unknown, "failed to start the frame dump writer");
+  }
+
+  return result_ok();
+}
+
+void framedump_attach(FrameDump* dump, Cpu* cpu) {
+  dump->sink.frame = dump_frame;
+  cpu_add_frame_sink(cpu, &dump->sink);
+}
+
+Result framedump_close(FrameDump* dump) {
+  if (!dump) return result_ok();
+
+  if (dump->writer) {
+    SDL_LockMutex(dump->lock);
+    dump->closing = true;
+    SDL_CondSignal(dump->queued);
+    SDL_UnlockMutex(dump->lock);
+    SDL_WaitThread(dump->writer, NULL);
+    dump->writer = NULL;
+  }
+
+  Result r = dump->error;
+  if (dump->y4m && fclose(dump->y4m) != 0 && !result_is_error(&r))
+    r = result_error(Error_FileIO, "failed to write %s", dump->path);
+  dump->y4m = NULL;
+
+  if (dump->freed)  SDL_DestroyCond(dump->freed);
+  if (dump->queued) SDL_DestroyCond(dump->queued);
+  if (dump->lock)   SDL_DestroyMutex(dump->lock);
+  dump->freed = dump->queued = NULL;
+  dump->lock = NULL;
+
+  free(dump->buffers);
+  dump->buffers = NULL;
+  return r;
+}
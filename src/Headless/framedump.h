@@ -0,0 +1,73 @@
+#ifndef FRAMEDUMP_H
+#define FRAMEDUMP_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include <SDL2/SDL_thread.h>
+#include <Emulator/cpu/cpu.h>
+
+// Video dump of the frames a machine completes, encoded and written on a thread of its
+// own. The emulation thread only copies the framebuffer into a free buffer of a small
+// pool and queues it; the writer turns it into a Y4M frame (one raw 4:2:0 stream) or a
+// PNG file (2-bit grayscale, one file per frame) and returns the buffer.
+//
+// When the writer falls behind and the pool runs out, the policy either drops the frame
+// (the emulation never waits; PNG names keep the frame number, so gaps show) or blocks
+// the emulation until a buffer is free.
+
+#define FRAMEDUMP_POOL_FRAMES 8
+
+typedef enum {
+  FRAMEDUMP_Y4M = 0,
+  FRAMEDUMP_PNG,
+} EFrameDumpFormat;
+
+typedef enum {
+  FRAMEDUMP_DROP = 0,
+  FRAMEDUMP_BLOCK,
+} EFrameDumpPolicy;
+
+typedef struct {
+  u8 pixels[LCD_HEIGHT][LCD_WIDTH]; // shades, as in Ppu.framebuffer
+  u64 frame;
+} FrameDumpBuffer;
+
+typedef struct FrameDump {
+  FrameSink sink;
+  EFrameDumpFormat format;
+  EFrameDumpPolicy policy;
+  char path[512]; // .y4m file, or the directory of the png sequence
+  FILE* y4m;
+
+  FrameDumpBuffer* buffers; // FRAMEDUMP_POOL_FRAMES
+  int free_list[FRAMEDUMP_POOL_FRAMES]; // stack of buffers the emulation can fill
+  int free_count;
+  int queue[FRAMEDUMP_POOL_FRAMES];     // ring of buffers waiting for the writer
+  int queue_head;
+  int queue_count;
+
+  SDL_mutex* lock;
+  SDL_cond* queued; // signaled by the emulation thread
+  SDL_cond* freed;  // signaled by the writer
+  SDL_Thread* writer;
+  bool closing;
+  Result error; // first write failure; the writer discards every frame after it
+
+  u64 frames;  // completed frames seen
+  u64 dropped; // not dumped (pool empty with FRAMEDUMP_DROP)
+  u64 written; // by the writer
+} FrameDump;
+
+// Starts the writer. A path ending in .y4m is a Y4M stream, anything else a directory
+// (created if needed) that gets frame_<number>.png files
+Result framedump_open(FrameDump* dump, const char* path, EFrameDumpPolicy policy);
+
+// Dumps the frames the cpu completes from now on
+void framedump_attach(FrameDump* dump, Cpu* cpu);
+
+// Writes what is still queued, stops the writer and closes the output. Returns the first
+// write error, if any
+Result framedump_close(FrameDump* dump);
+
+#endif // !FRAMEDUMP_H
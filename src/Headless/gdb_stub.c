@@ -0,0 +1,721 @@
+#include "gdb_stub.h"
+#include <util.h>
+#include <llog.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define GDB_REGISTER_COUNT 6
+
+// gdb register numbers, in target.xml order
+static const ERegisterFull GDB_REGISTERS[GDB_REGISTER_COUNT] = { AF, BC, DE, HL, SP, PC };
+
+static const char TARGET_XML[] =
+  "<?xml version=\"1.0\"?>"
+  "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+  "<target version=\"1.0\">"
+  "<feature name=\"org.lgb.lr35902\">"
+  "<reg name=\"af\" bitsize=\"16\" type=\"int\" regnum=\"0\"/>"
+  "<reg name=\"bc\" bitsize=\"16\" type=\"int\"/>"
+  "<reg name=\"de\" bitsize=\"16\" type=\"int\"/>"
+  "<reg name=\"hl\" bitsize=\"16\" type=\"data_ptr\"/>"
+  "<reg name=\"sp\" bitsize=\"16\" type=\"data_ptr\"/>"
+  "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+  "</feature>"
+  "</target>";
+
+typedef enum {
+  GDB_ACTION_REPLY = 0,
+  GDB_ACTION_CONTINUE,
+  GDB_ACTION_STEP,
+  GDB_ACTION_DETACH,
+  GDB_ACTION_KILL,
+} EGdbAction;
+
+// Socket
+
+static Result open_listener(GdbStub* stub, const char* address) {
+  bool tcp = *address != '\0';
+  for (const char* c = address; *c; c++)
+    if (!isdigit((unsigned char)*c)) tcp = false;
+
+  int fd;
+  if (tcp) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return result_error(Error_FileIO, "socket: %s", strerror(errno));
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((u16)atoi(address));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      return result_error(Error_FileIO, "failed to bind 127.0.0.1:%s: %s", address, strerror(errno));
+    }
+  } else {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(address) >= sizeof(addr.sun_path)) {
+      return result_error(Error_FileIO, "socket path too long: %s", address);
+    }
+    strcpy(addr.sun_path, address);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return result_error(Error_FileIO, "socket: %s", strerror(errno));
+    }
+    unlink(address);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      return result_error(Error_FileIO, "failed to bind %s: %s", address, strerror(errno));
+    }
+    snprintf(stub->unix_path, sizeof(stub->unix_path), "%s", address);
+  }
+
+  if (listen(fd, 1) != 0) {
+    close(fd);
+    return result_error(Error_FileIO, "listen: %s", strerror(errno));
+  }
+
+  stub->listen_fd = fd;
+  return result_ok();
+}
+
+Result gdb_stub_init(GdbStub* stub, Machine* machine, const char* address) {
+  if (!stub || !machine || !address) {
+    return result_error(Error_NullPointer, "invalid args to gdb_stub_init");
+  }
+  memset(stub, 0, sizeof(*stub));
+  stub->machine   = machine;
+  stub->listen_fd = -1;
+  stub->client_fd = -1;
+  debugger_init(&stub->debugger);
+
+  return open_listener(stub, address);
+}
+
+static void drop_client(GdbStub* stub) {
+  if (stub->client_fd >= 0)
+    close(stub->client_fd);
+  stub->client_fd = -1;
+  stub->rx_len = stub->rx_pos = 0;
+
+  // Breakpoints belong to the session, the machine goes back to full speed
+  debugger_init(&stub->debugger);
+  stub->machine->cpu.debugger = NULL;
+  stub->running = false;
+}
+
+void gdb_stub_destroy(GdbStub* stub) {
+  if (!stub) return;
+
+  drop_client(stub);
+  if (stub->listen_fd >= 0)
+    close(stub->listen_fd);
+  stub->listen_fd = -1;
+  if (stub->unix_path[0])
+    unlink(stub->unix_path);
+}
+
+// Packets
+
+static const char HEX[] = "0123456789abcdef";
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Two hex digits, false on anything else
+static bool parse_hex_byte(const char* h, u8* out) {
+  int hi = hex_digit(h[0]);
+  int lo = hi < 0 ? -1 : hex_digit(h[1]);
+  if (lo < 0) return false;
+  *out = (u8)(hi << 4 | lo);
+  return true;
+}
+
+// A register as gdb sends it: four hex digits, low byte first
+static bool parse_hex_reg(const char* h, u16* out) {
+  u8 lo, hi;
+  if (!parse_hex_byte(h, &lo) || !parse_hex_byte(h + 2, &hi)) return false;
+  *out = (u16)(hi << 8 | lo);
+  return true;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    data += n;
+    len  -= (size_t)n;
+  }
+  return true;
+}
+
+// Next byte from the client, -1 when it went away
+static int read_byte(GdbStub* stub) {
+  if (stub->rx_pos == stub->rx_len) {
+    ssize_t n;
+    do {
+      n = recv(stub->client_fd, stub->rx, sizeof(stub->rx), 0);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+    stub->rx_len = (int)n;
+    stub->rx_pos = 0;
+  }
+  return (u8)stub->rx[stub->rx_pos++];
+}
+
+static bool send_packet(GdbStub* stub, const char* payload) {
+  size_t len = strlen(payload);
+  u8 sum = 0;
+  for (size_t i = 0; i < len; i++)
+    sum += (u8)payload[i];
+
+  char frame[GDB_PACKET_MAX + 8];
+  if (len + 4 >= sizeof(frame)) return false;
+  frame[0] = '$';
+  memcpy(frame + 1, payload, len);
+  frame[len + 1] = '#';
+  frame[len + 2] = HEX[sum >> 4];
+  frame[len + 3] = HEX[sum & 0xF];
+
+  for (int attempt = 0; attempt < 3; attempt++) {
+    if (!send_all(stub->client_fd, frame, len + 4)) return false;
+    if (stub->no_ack) return true;
+
+    int c = read_byte(stub);
+    if (c < 0) return false;
+    if (c == '+') return true;
+  }
+  return false;
+}
+
+// 1 when a packet was read into stub->packet, 0 for an interrupt request (0x03),
+// -1 when the client went away
+static int read_packet(GdbStub* stub) {
+  for (;;) {
+    int c = read_byte(stub);
+    if (c < 0) return -1;
+    if (c == 0x03) return 0;
+    if (c != '$') continue;
+
+    size_t len = 0;
+    u8 sum = 0;
+    while ((c = read_byte(stub)) >= 0 && c != '#') {
+      if (len + 1 < sizeof(stub->packet))
+        stub->packet[len++] = (char)c;
+      sum += (u8)c;
+    }
+    int hi = read_byte(stub);
+    int lo = read_byte(stub);
+    if (c < 0 || hi < 0 || lo < 0) return -1;
+    stub->packet[len] = '\0';
+
+    if (stub->no_ack) return 1;
+
+    u8 checksum;
+    const char digits[2] = { (char)hi, (char)lo };
+    bool valid = parse_hex_byte(digits, &checksum) && checksum == sum;
+    if (!send_all(stub->client_fd, valid ? "+" : "-", 1)) return -1;
+    if (valid) return 1;
+  }
+}
+
+// Machine state
+
+// True right after the cpu decoded an instruction, before any of it ran (the LOW phase
+// step of the first T-cycle does nothing). This is where breakpoints stop it. A halted
+// cpu decodes nothing until an interrupt wakes it, which may be never (`di; halt`), so
+// the LOW phase of each halted cycle counts too: pc is then the address after the HALT
+static bool at_boundary(const Cpu* cpu) {
+  if (cpu->clock_phase != CLOCK_LOW) return false;
+  if (cpu->halted && !cpu->has_instr) return true;
+  return cpu->has_instr && cpu->instr.current_mcycle == 0 && cpu->instr.current_tcycle == 0;
+}
+
+// Ticks to the next boundary, past any hit on the way
+static Result run_to_boundary(Machine* machine) {
+  Cpu* cpu = &machine->cpu;
+  while (!at_boundary(cpu)) {
+    if (machine_clock_tick(machine)) return cpu->error;
+    cpu->paused = false;
+  }
+  return result_ok();
+}
+
+// A halted cpu steps from one cycle that could wake it to the next
+static Result step_instruction(Machine* machine) {
+  if (machine->fast_forward)
+    machine_skip_halted(machine, UINT64_MAX);
+  if (machine_clock_tick(machine)) return machine->cpu.error;
+  machine->cpu.paused = false;
+  return run_to_boundary(machine);
+}
+
+static u16 register_value(const Cpu* cpu, int num) {
+  ERegisterFull reg = GDB_REGISTERS[num];
+  if (reg == PC) return (u16)(cpu->registers[PC].v - 1);
+  return cpu->registers[reg].v;
+}
+
+static bool set_register(Cpu* cpu, int num, u16 value) {
+  if (num < 0 || num >= GDB_REGISTER_COUNT) return false;
+  ERegisterFull reg = GDB_REGISTERS[num];
+
+  if (reg == PC) {
+    // Fetch and decode again from the new pc
+    u8 opcode = mem_peek8(cpu->mem, cpu, value);
+    ResultInstr rdec = instruction_decode(opcode);
+    if (result_Instr_is_err(&rdec)) return false;
+
+    cpu->IR = opcode;
+    cpu->registers[PC].v = (u16)(value + 1);
+    if (cpu->has_instr)
+      cpu->instr = result_Instr_get_data(&rdec);
+    return true;
+  }
+
+  if (reg == AF) value &= 0xFFF0;
+  cpu->registers[reg].v = value;
+  return true;
+}
+
+static void sync_debugger(GdbStub* stub) {
+  stub->machine->cpu.debugger = debugger_empty(&stub->debugger) ? NULL : &stub->debugger;
+}
+
+// `S05` or `T05<reason>` for the last debugger hit
+static void stop_reply(GdbStub* stub, char* out, size_t size) {
+  const DebugHit* hit = &stub->debugger.hit;
+  switch (hit->kind) {
+    case DEBUG_HIT_BREAKPOINT:
+      snprintf(out, size, "T05swbreak:;");
+      break;
+    case DEBUG_HIT_WATCH_READ:
+    case DEBUG_HIT_WATCH_WRITE: {
+      const char* reason = hit->kind == DEBUG_HIT_WATCH_READ ? "rwatch" : "watch";
+      if (stub->debugger.watchpoints[hit->index].kind == WATCH_ACCESS)
+        reason = "awatch";
+      snprintf(out, size, "T05%s:%04x;", reason, hit->addr);
+    } break;
+    case DEBUG_HIT_NONE:
+      snprintf(out, size, "S05");
+      break;
+  }
+  stub->debugger.hit.kind = DEBUG_HIT_NONE;
+}
+
+static bool parse_hex_arg(const char** s, u32* out) {
+  char* end;
+  unsigned long v = strtoul(*s, &end, 16);
+  if (end == *s) return false;
+  *out = (u32)v;
+  *s = end;
+  return true;
+}
+
+// Z/z packets: `<type>,<addr>,<kind>`
+static void handle_breakpoint(GdbStub* stub, bool insert) {
+  const char* p = stub->packet + 1;
+  u32 type, addr, kind;
+  if (!parse_hex_arg(&p, &type) || *p++ != ',' || !parse_hex_arg(&p, &addr) ||
+      *p++ != ',' || !parse_hex_arg(&p, &kind) || addr > 0xFFFF) {
+    snprintf(stub->reply, sizeof(stub->reply), "E01");
+    return;
+  }
+
+  u16 first = (u16)addr;
+  u16 last  = (u16)(addr + (kind ? kind : 1) - 1);
+  u8 watch  = type == 2 ? WATCH_WRITE : type == 3 ? WATCH_READ : WATCH_ACCESS;
+  bool ok;
+
+  if (type == 0 || type == 1) {
+    ok = insert ? debugger_add_breakpoint(&stub->debugger, first, NULL) >= 0
+                : debugger_remove_breakpoint(&stub->debugger, first);
+  } else if (type <= 4) {
+    ok = insert ? debugger_add_watchpoint(&stub->debugger, first, last, watch, NULL) >= 0
+                : debugger_remove_watchpoint(&stub->debugger, first, last, watch);
+  } else {
+    stub->reply[0] = '\0'; // unsupported type
+    return;
+  }
+
+  sync_debugger(stub);
+  snprintf(stub->reply, sizeof(stub->reply), ok ? "OK" : "E0E");
+}
+
+// qXfer:features:read:target.xml:<offset>,<length>
+static void handle_features(GdbStub* stub, const char* args) {
+  u32 offset, length;
+  if (!parse_hex_arg(&args, &offset) || *args++ != ',' || !parse_hex_arg(&args, &length)) {
+    snprintf(stub->reply, sizeof(stub->reply), "E00");
+    return;
+  }
+
+  u32 size = (u32)sizeof(TARGET_XML) - 1;
+  if (offset >= size) {
+    snprintf(stub->reply, sizeof(stub->reply), "l");
+    return;
+  }
+  if (length > sizeof(stub->reply) - 2) length = sizeof(stub->reply) - 2;
+
+  u32 count = size - offset < length ? size - offset : length;
+  stub->reply[0] = offset + count < size ? 'm' : 'l';
+  memcpy(stub->reply + 1, TARGET_XML + offset, count);
+  stub->reply[count + 1] = '\0';
+}
+
+static void handle_query(GdbStub* stub) {
+  const char* q = stub->packet;
+  char* reply = stub->reply;
+  size_t size = sizeof(stub->reply);
+
+  if (strncmp(q, "qSupported", 10) == 0) {
+    snprintf(reply, size, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+;swbreak+;hwbreak+",
+             GDB_PACKET_MAX);
+  } else if (strncmp(q, "qXfer:features:read:target.xml:", 31) == 0) {
+    handle_features(stub, q + 31);
+  } else if (strcmp(q, "qAttached") == 0) {
+    snprintf(reply, size, "1");
+  } else if (strcmp(q, "qC") == 0) {
+    snprintf(reply, size, "QC1");
+  } else if (strcmp(q, "qfThreadInfo") == 0) {
+    snprintf(reply, size, "m1");
+  } else if (strcmp(q, "qsThreadInfo") == 0) {
+    snprintf(reply, size, "l");
+  } else if (strcmp(q, "QStartNoAckMode") == 0) {
+    snprintf(reply, size, "OK");
+  } else {
+    reply[0] = '\0';
+  }
+}
+
+static EGdbAction handle_packet(GdbStub* stub) {
+  Cpu* cpu = &stub->machine->cpu;
+  const char* p = stub->packet;
+  char* reply = stub->reply;
+  size_t size = sizeof(stub->reply);
+  reply[0] = '\0';
+
+  switch (p[0]) {
+    case '?':
+      stop_reply(stub, reply, size);
+      break;
+
+    case 'g':
+      for (int i = 0; i < GDB_REGISTER_COUNT; i++) {
+        u16 v = register_value(cpu, i);
+        snprintf(reply + i * 4, size - (size_t)i * 4, "%02x%02x", v & 0xFF, v >> 8);
+      }
+      break;
+
+    case 'G': {
+      if (strlen(p + 1) < GDB_REGISTER_COUNT * 4) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      // Nothing is written unless every register parses
+      u16 values[GDB_REGISTER_COUNT];
+      bool ok = true;
+      for (int i = 0; i < GDB_REGISTER_COUNT && ok; i++)
+        ok = parse_hex_reg(p + 1 + i * 4, &values[i]);
+      for (int i = 0; i < GDB_REGISTER_COUNT && ok; i++)
+        ok &= set_register(cpu, i, values[i]);
+      snprintf(reply, size, ok ? "OK" : "E01");
+    } break;
+
+    case 'p': {
+      u32 reg;
+      p++;
+      if (!parse_hex_arg(&p, &reg) || reg >= GDB_REGISTER_COUNT) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      u16 v = register_value(cpu, (int)reg);
+      snprintf(reply, size, "%02x%02x", v & 0xFF, v >> 8);
+    } break;
+
+    case 'P': {
+      u32 reg;
+      p++;
+      u16 v;
+      if (!parse_hex_arg(&p, &reg) || *p++ != '=' || strlen(p) < 4 || !parse_hex_reg(p, &v)) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      snprintf(reply, size, set_register(cpu, (int)reg, v) ? "OK" : "E01");
+    } break;
+
+    case 'm': {
+      u32 addr, len;
+      p++;
+      if (!parse_hex_arg(&p, &addr) || *p++ != ',' || !parse_hex_arg(&p, &len)) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      if (len > (size - 1) / 2) len = (u32)(size - 1) / 2;
+      for (u32 i = 0; i < len; i++) {
+        u8 v = mem_peek8(cpu->mem, cpu, (u16)(addr + i));
+        reply[i * 2]     = HEX[v >> 4];
+        reply[i * 2 + 1] = HEX[v & 0xF];
+      }
+      reply[len * 2] = '\0';
+    } break;
+
+    case 'M': {
+      u32 addr, len;
+      p++;
+      if (!parse_hex_arg(&p, &addr) || *p++ != ',' || !parse_hex_arg(&p, &len) ||
+          *p++ != ':' || strlen(p) < len * 2) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      bool valid = true;
+      u8 b;
+      for (u32 i = 0; i < len && valid; i++)
+        valid = parse_hex_byte(p + i * 2, &b);
+      if (!valid) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      // Through the bus like a cpu write (mbc registers, io), without tripping watchpoints
+      struct Debugger* debugger = cpu->debugger;
+      u8 bus_access = cpu->bus_access;
+      cpu->debugger = NULL;
+      for (u32 i = 0; i < len; i++) {
+        parse_hex_byte(p + i * 2, &b);
+        mem_write8(cpu->mem, cpu, (u16)(addr + i), b);
+      }
+      cpu->debugger = debugger;
+      cpu->bus_access = bus_access;
+      snprintf(reply, size, "OK");
+    } break;
+
+    case 'c':
+    case 's': {
+      u32 addr;
+      p++;
+      if (parse_hex_arg(&p, &addr) && !set_register(cpu, PC, (u16)addr)) {
+        snprintf(reply, size, "E01");
+        break;
+      }
+      return stub->packet[0] == 'c' ? GDB_ACTION_CONTINUE : GDB_ACTION_STEP;
+    }
+
+    case 'v':
+      if (strcmp(p, "vCont?") == 0) {
+        snprintf(reply, size, "vCont;c;C;s;S");
+      } else if (strncmp(p, "vCont;", 6) == 0) {
+        // Single thread: the first action applies
+        char action = p[6];
+        if (action == 'c' || action == 'C') return GDB_ACTION_CONTINUE;
+        if (action == 's' || action == 'S') return GDB_ACTION_STEP;
+        snprintf(reply, size, "E01");
+      }
+      break;
+
+    case 'H':
+    case 'T':
+      snprintf(reply, size, "OK");
+      break;
+
+    case 'Z':
+    case 'z':
+      handle_breakpoint(stub, p[0] == 'Z');
+      break;
+
+    case 'q':
+    case 'Q':
+      handle_query(stub);
+      if (strcmp(p, "QStartNoAckMode") == 0) {
+        send_packet(stub, reply);
+        stub->no_ack = true;
+        reply[0] = '\0';
+        return GDB_ACTION_REPLY;
+      }
+      break;
+
+    case 'D':
+      snprintf(reply, size, "OK");
+      return GDB_ACTION_DETACH;
+
+    case 'k':
+      return GDB_ACTION_KILL;
+
+    default:
+      break;
+  }
+
+  send_packet(stub, reply);
+  return GDB_ACTION_REPLY;
+}
+
+// Serving
+
+static void accept_client(GdbStub* stub) {
+  int fd = accept(stub->listen_fd, NULL, NULL);
+  if (fd < 0) return;
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  stub->client_fd = fd;
+  stub->no_ack = false;
+  stub->running = false;
+  stub->rx_len = stub->rx_pos = 0;
+
+  // The client expects a stopped target
+  Machine* m = stub->machine;
+  if (!m->cpu.paused) {
+    Result r = run_to_boundary(m);
+    if (result_is_error(&r))
+      LOG_WARNING("gdb: %s", r.message);
+  }
+  LOG_INFO("gdb: client attached, stopped at pc %04X", register_value(&m->cpu, PC));
+}
+
+// Full speed until a client connects
+static void serve_detached(GdbStub* stub) {
+  Machine* m = stub->machine;
+  struct pollfd pfd = { .fd = stub->listen_fd, .events = POLLIN };
+
+  // A stopped machine has nothing better to do than wait
+  if (poll(&pfd, 1, m->cpu.paused ? -1 : 0) > 0) {
+    accept_client(stub);
+    return;
+  }
+
+  Result r = machine_run_cycles(m, CYCLES_PER_FRAME);
+  if (result_is_error(&r)) {
+    LOG_WARNING("gdb: machine stopped: %s", r.message);
+    m->cpu.paused = true;
+  }
+}
+
+static void serve_running(GdbStub* stub) {
+  Machine* m = stub->machine;
+  Cpu* cpu = &m->cpu;
+  char reply[64];
+
+  Result r = machine_run_cycles(m, GDB_RUN_SLICE);
+  if (result_is_error(&r)) {
+    LOG_WARNING("gdb: %s", r.message);
+    stub->running = false;
+    send_packet(stub, "S04");
+    return;
+  }
+
+  if (cpu->paused) {
+    // Watch hits stop mid-instruction, gdb reports them after it
+    cpu->paused = false;
+    r = run_to_boundary(m);
+    stub->running = false;
+    if (result_is_error(&r)) {
+      send_packet(stub, "S04");
+      return;
+    }
+    stop_reply(stub, reply, sizeof(reply));
+    send_packet(stub, reply);
+    return;
+  }
+
+  struct pollfd pfd = { .fd = stub->client_fd, .events = POLLIN };
+  if (poll(&pfd, 1, 0) <= 0) return;
+
+  int c = read_byte(stub);
+  if (c < 0) {
+    LOG_INFO("gdb: client went away");
+    drop_client(stub);
+    return;
+  }
+  if (c == 0x03) {
+    r = run_to_boundary(m);
+    stub->running = false;
+    stub->debugger.hit.kind = DEBUG_HIT_NONE;
+    send_packet(stub, result_is_error(&r) ? "S04" : "S02");
+  }
+}
+
+static void serve_stopped(GdbStub* stub) {
+  Machine* m = stub->machine;
+  int got = read_packet(stub);
+  if (got < 0) {
+    LOG_INFO("gdb: client went away");
+    drop_client(stub);
+    return;
+  }
+  if (got == 0) return; // already stopped
+
+  switch (handle_packet(stub)) {
+    case GDB_ACTION_REPLY:
+      break;
+
+    case GDB_ACTION_CONTINUE:
+      m->cpu.paused = false;
+      stub->running = true;
+      break;
+
+    case GDB_ACTION_STEP: {
+      m->cpu.paused = false;
+      Result r = step_instruction(m);
+      char reply[64];
+      if (result_is_error(&r)) {
+        snprintf(reply, sizeof(reply), "S04");
+      } else {
+        // A breakpoint on the next instruction is not a reason to report
+        if (stub->debugger.hit.kind == DEBUG_HIT_BREAKPOINT)
+          stub->debugger.hit.kind = DEBUG_HIT_NONE;
+        stop_reply(stub, reply, sizeof(reply));
+      }
+      send_packet(stub, reply);
+    } break;
+
+    case GDB_ACTION_DETACH:
+      send_packet(stub, stub->reply);
+      LOG_INFO("gdb: client detached");
+      drop_client(stub);
+      m->cpu.paused = false;
+      break;
+
+    case GDB_ACTION_KILL:
+      drop_client(stub);
+      stub->killed = true;
+      break;
+  }
+}
+
+Result gdb_stub_run(GdbStub* stub) {
+  if (!stub || stub->listen_fd < 0) {
+    return result_error(Error_NullPointer, "invalid stub to gdb_stub_run");
+  }
+
+  while (!stub->killed) {
+    if (stub->client_fd < 0)
+      serve_detached(stub);
+    else if (stub->running)
+      serve_running(stub);
+    else
+      serve_stopped(stub);
+  }
+  return result_ok();
+}
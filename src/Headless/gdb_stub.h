@@ -0,0 +1,49 @@
+#ifndef GDB_STUB_H
+#define GDB_STUB_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+#include <Emulator/machine.h>
+#include <Emulator/debugger.h>
+
+// GDB remote serial protocol server for one machine, on a loopback TCP port or a Unix
+// socket. The machine runs at full speed while nobody is attached; a client connecting
+// stops it at the next instruction boundary.
+//
+// Registers are af, bc, de, hl, sp, pc (16 bits, little endian, described by target.xml).
+// pc is the address of the instruction about to execute: the core has already fetched
+// its opcode, so it is Cpu.registers[PC] - 1. A halted cpu stops where it waits, with pc
+// the address after the HALT, and a step runs it to the next event that could wake it.
+// Breakpoints (Z0/Z1) and watchpoints (Z2/Z3/Z4) go to a Debugger attached to the cpu
+// only while something is set.
+
+#define GDB_PACKET_MAX 4096
+#define GDB_RUN_SLICE  456 // T-cycles run between checks for a client interrupt (one line)
+
+typedef struct {
+  Machine* machine;
+  Debugger debugger;
+
+  int listen_fd;
+  int client_fd; // -1 when nobody is attached
+  char unix_path[108]; // unlinked on destroy, empty for TCP
+  bool no_ack;   // QStartNoAckMode
+  bool running;  // the client continued the machine
+  bool killed;
+
+  char rx[512]; // bytes received and not parsed yet
+  int rx_len;
+  int rx_pos;
+  char packet[GDB_PACKET_MAX];
+  char reply[GDB_PACKET_MAX];
+} GdbStub;
+
+// `address` is a port number (bound to 127.0.0.1) or a Unix socket path
+Result gdb_stub_init(GdbStub* stub, Machine* machine, const char* address);
+void gdb_stub_destroy(GdbStub* stub);
+
+// Serves clients one after the other until one sends `k` (kill)
+Result gdb_stub_run(GdbStub* stub);
+
+#endif // !GDB_STUB_H
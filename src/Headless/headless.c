@@ -0,0 +1,347 @@
+#include "headless.h"
+#include "batch.h"
+#include "macrobench.h"
+#include "synth_rom.h"
+#include "gdb_stub.h"
+#include "serial_socket.h"
+#include <Emulator/link.h>
+#include <util.h>
+#include <llog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "usage:\n"
+          "  %s                      run the GUI\n"
+          "  %s --batch <jobs file>  run every job headless\n"
+          "      [--threads N]       worker threads (default: one per core)\n"
+          "      [--quantum N]       frames per time slice (default: 1)\n"
+          "      [--no-pin]          do not pin workers to cores\n"
+          "      [--stats]           print the instrumentation counters of every job\n"
+          "      [--lockstep]        run jobs on the same rom together on the SIMD core\n"
+          "  %s --bench [rom ...]    end-to-end throughput, one JSON line per rom\n"
+          "      [--frames N]        frames per rom (default: %d)\n"
+          "      [--no-synth]        skip the generated roms (synth:alu, synth:mem, ...)\n"
+          "  %s --gdb <port|socket> <rom>\n"
+          "                          run headless, serving gdb on a loopback port or Unix socket\n"
+          "  %s --serial <rom>       run headless, printing what the rom sends over serial,\n"
+          "                          until it reports Passed or Failed\n"
+          "      [--frames N]        frame budget (default: %d)\n"
+          "      [--peer <rom>]      link cable to a second machine in this process\n"
+          "      [--listen <socket> | --connect <socket>]\n"
+          "                          link cable to another lgb over a Unix socket\n"
+          "\n"
+          "job file lines: <rom> [frames=N] [cycles=N] [input=<file>]\n"
+          "                [trace=<file> | trace-mcycles=<file>] [profile=<file>]\n"
+          "                [debug=<file>] [serial=<file>]\n"
+          "                [hash=<file> [hash-regions=vram,wram,oam,hram,eram] | compare=<file>]\n"
+          "                [dump=<file.y4m | dir> [dump-policy=drop|block]] [no-skip] [dma-bulk]\n",
+          prog, prog, prog, MACROBENCH_DEFAULT_FRAMES, prog, prog, BATCH_DEFAULT_FRAMES);
+}
+
+bool headless_requested(int argc, char** argv) {
+  return argc > 1 && (strcmp(argv[1], "--batch") == 0 || strcmp(argv[1], "--bench") == 0 ||
+                      strcmp(argv[1], "--gdb") == 0 || strcmp(argv[1], "--serial") == 0);
+}
+
+static int run_batch(int argc, char** argv) {
+  const char* jobs_path = NULL;
+  BatchOptions options = {
+    .threads        = 0,
+    .quantum_frames = 1,
+    .pin_threads    = true,
+    .stats          = false,
+    .lockstep       = false,
+  };
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      jobs_path = argv[++i];
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--quantum") == 0 && i + 1 < argc) {
+      options.quantum_frames = (u32)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--no-pin") == 0) {
+      options.pin_threads = false;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      options.stats = true;
+    } else if (strcmp(argv[i], "--lockstep") == 0) {
+      options.lockstep = true;
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!jobs_path) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Batch batch;
+  batch_init(&batch);
+
+  Result r = batch_load_jobs(&batch, jobs_path);
+  if (result_is_error(&r)) {
+    LOG_ERROR("failed to load jobs: %s (%s)", r.message, error_string(r.error_code));
+    batch_destroy(&batch);
+    return EXIT_FAILURE;
+  }
+
+  r = batch_run(&batch, &options);
+  if (result_is_error(&r)) {
+    LOG_ERROR("batch run failed: %s (%s)", r.message, error_string(r.error_code));
+    batch_destroy(&batch);
+    return EXIT_FAILURE;
+  }
+
+  batch_report(&batch, stdout);
+  batch_destroy(&batch);
+  return EXIT_SUCCESS;
+}
+
+static int run_bench(int argc, char** argv) {
+  u64 frames = MACROBENCH_DEFAULT_FRAMES;
+  bool synth = true;
+
+  const char** roms = malloc(sizeof(char*) * (size_t)(argc + SYNTH_COUNT));
+  if (!roms) {
+    LOG_ERROR("no mem for rom list");
+    return EXIT_FAILURE;
+  }
+  int rom_count = 0;
+
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--no-synth") == 0) {
+      synth = false;
+    } else if (argv[i][0] == '-') {
+      print_usage(argv[0]);
+      free(roms);
+      return EXIT_FAILURE;
+    } else {
+      roms[rom_count++] = argv[i];
+    }
+  }
+
+  static char synth_names[SYNTH_COUNT][32];
+  if (synth) {
+    for (int i = 0; i < SYNTH_COUNT; i++) {
+      snprintf(synth_names[i], sizeof(synth_names[i]), "synth:%s", synth_rom_name((ESynthRom)i));
+      roms[rom_count++] = synth_names[i];
+    }
+  }
+
+  MacroBenchResult* results = calloc((size_t)(rom_count ? rom_count : 1), sizeof(MacroBenchResult));
+  if (!results) {
+    LOG_ERROR("no mem for bench results");
+    free(roms);
+    return EXIT_FAILURE;
+  }
+
+  int done = 0;
+  int status = EXIT_SUCCESS;
+  for (int i = 0; i < rom_count; i++) {
+    Result r = macrobench_run(roms[i], frames, &results[done]);
+    if (result_is_error(&r)) {
+      LOG_ERROR("bench %s: %s (%s)", roms[i], r.message, error_string(r.error_code));
+      status = EXIT_FAILURE;
+      continue;
+    }
+    macrobench_report(&results[done], stdout);
+    done++;
+  }
+
+  macrobench_report_summary(results, done, stdout);
+
+  free(results);
+  free(roms);
+  return status;
+}
+
+static int run_gdb(int argc, char** argv) {
+  if (argc != 4) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Machine* machine = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!machine) {
+    LOG_ERROR("no mem for Machine struct");
+    return EXIT_FAILURE;
+  }
+
+  GdbStub stub;
+  int status = EXIT_FAILURE;
+  bool stub_open = false;
+
+  Result r = machine_init(machine);
+  if (result_is_error(&r)) goto done;
+
+  r = machine_load_rom(machine, argv[3]);
+  if (result_is_error(&r)) goto done;
+  machine_skip_bootrom(machine);
+
+  r = gdb_stub_init(&stub, machine, argv[2]);
+  if (result_is_error(&r)) goto done;
+  stub_open = true;
+
+  LOG_INFO("gdb: listening on %s, running %s", argv[2], argv[3]);
+  r = gdb_stub_run(&stub);
+  if (!result_is_error(&r)) status = EXIT_SUCCESS;
+
+done:
+  if (result_is_error(&r))
+    LOG_ERROR("gdb: %s (%s)", r.message, error_string(r.error_code));
+  if (stub_open)
+    gdb_stub_destroy(&stub);
+  machine_destroy(machine);
+  free(machine);
+  return status;
+}
+
+static Result load_machine(Machine** out, const char* rom) {
+  Machine* m = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!m) {
+    return result_error(Error_NullPointer, "no mem for Machine struct");
+  }
+  *out = m;
+
+  Result r = machine_init(m);
+  if (result_is_error(&r)) return r;
+
+  r = machine_load_rom(m, rom);
+  if (result_is_error(&r)) return r;
+
+  machine_skip_bootrom(m);
+  return result_ok();
+}
+
+static void free_machine(Machine* m) {
+  if (!m) return;
+  machine_destroy(m);
+  free(m);
+}
+
+// Prints the serial output of `m` past `printed`
+static void print_serial(const Machine* m, u32* printed) {
+  const Serial* serial = &m->cpu.serial;
+  if (serial->output_len == *printed) return;
+
+  fwrite(serial->output + *printed, 1, serial->output_len - *printed, stdout);
+  fflush(stdout);
+  *printed = serial->output_len;
+}
+
+static int run_serial(int argc, char** argv) {
+  const char* rom = NULL;
+  const char* peer_rom = NULL;
+  const char* listen_path = NULL;
+  const char* connect_path = NULL;
+  u64 frames = BATCH_DEFAULT_FRAMES;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--serial") == 0 && i + 1 < argc) {
+      rom = argv[++i];
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      frames = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--peer") == 0 && i + 1 < argc) {
+      peer_rom = argv[++i];
+    } else if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) {
+      listen_path = argv[++i];
+    } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+      connect_path = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!rom || (peer_rom != NULL) + (listen_path != NULL) + (connect_path != NULL) > 1) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Machine* machine = NULL;
+  Machine* peer = NULL;
+  LinkCable cable;
+  SerialSocket sock;
+  bool cabled = false, socketed = false;
+  int status = EXIT_FAILURE;
+
+  Result r = load_machine(&machine, rom);
+  if (result_is_error(&r)) goto done;
+
+  if (peer_rom) {
+    r = load_machine(&peer, peer_rom);
+    if (result_is_error(&r)) goto done;
+    r = link_cable_init(&cable, machine, peer);
+    if (result_is_error(&r)) goto done;
+    cabled = true;
+  } else if (listen_path || connect_path) {
+    r = listen_path ? serial_socket_listen(&sock, machine, listen_path)
+                    : serial_socket_connect(&sock, machine, connect_path);
+    if (result_is_error(&r)) goto done;
+    socketed = true;
+  }
+
+  u32 printed = 0;
+  ESerialVerdict verdict = SERIAL_VERDICT_NONE;
+  for (u64 frame = 0; frame < frames && verdict == SERIAL_VERDICT_NONE; frame++) {
+    if (socketed) {
+      r = serial_socket_poll(&sock);
+      if (result_is_error(&r)) goto done;
+    }
+
+    r = cabled ? link_cable_run_cycles(&cable, CYCLES_PER_FRAME)
+               : machine_run_cycles(machine, CYCLES_PER_FRAME);
+    if (result_is_error(&r)) goto done;
+    if (machine->cpu.paused || (peer && peer->cpu.paused)) {
+      r = result_error(Error_Unknown, "cpu stopped at frame %llu", (unsigned long long)frame);
+      goto done;
+    }
+
+    print_serial(machine, &printed);
+    verdict = serial_verdict(&machine->cpu.serial);
+  }
+  if (printed && machine->cpu.serial.output[printed - 1] != '\n') {
+    putchar('\n');
+    fflush(stdout);
+  }
+
+  if (peer)
+    printf("peer: %s\n", peer->cpu.serial.output);
+  if (socketed)
+    LOG_INFO("serial: %llu bytes clocked out, %llu in",
+             (unsigned long long)sock.bytes_sent, (unsigned long long)sock.bytes_received);
+
+  status = verdict == SERIAL_VERDICT_FAILED ? EXIT_FAILURE : EXIT_SUCCESS;
+
+done:
+  if (result_is_error(&r))
+    LOG_ERROR("serial: %s (%s)", r.message, error_string(r.error_code));
+  if (cabled)
+    link_cable_destroy(&cable);
+  if (socketed)
+    serial_socket_destroy(&sock);
+  free_machine(peer);
+  free_machine(machine);
+  return status;
+}
+
+int headless_main(int argc, char** argv) {
+  if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+    return run_batch(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    return run_bench(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--gdb") == 0)
+    return run_gdb(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--serial") == 0)
+    return run_serial(argc, argv);
+
+  print_usage(argv[0]);
+  return EXIT_FAILURE;
+}
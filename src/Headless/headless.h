@@ -0,0 +1,12 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stdbool.h>
+
+// True when the command line asks for one of the display-less modes
+bool headless_requested(int argc, char** argv);
+
+// Entry point of the display-less modes, returns the process exit code
+int headless_main(int argc, char** argv);
+
+#endif // !HEADLESS_H
@@ -0,0 +1,138 @@
+#include "macrobench.h"
+#include "synth_rom.h"
+#include <Emulator/machine.h>
+#include <util.h>
+#include <llog.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define SYNTH_PREFIX "synth:"
+
+static Result load_rom(Machine* machine, const char* rom) {
+  size_t prefix = strlen(SYNTH_PREFIX);
+  if (strncmp(rom, SYNTH_PREFIX, prefix) != 0)
+    return machine_load_rom(machine, rom);
+
+  ESynthRom kind;
+  if (!synth_rom_lookup(rom + prefix, &kind)) {
+    return result_error(Error_FileIO, "unknown synthetic rom: %s", rom);
+  }
+
+  static u8 image[SYNTH_ROM_SIZE];
+  synth_rom_build(kind, image);
+  return mem_load_rom_data(&machine->mem, image, SYNTH_ROM_SIZE);
+}
+
+Result macrobench_run(const char* rom, u64 frames, MacroBenchResult* result) {
+  if (!rom || !result) {
+    return result_error(Error_NullPointer, "invalid args to macrobench_run");
+  }
+
+  memset(result, 0, sizeof(*result));
+  snprintf(result->name, sizeof(result->name), "%s", rom);
+  result->frames = frames;
+
+  Machine* machine = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!machine) {
+    return result_error(Error_NullPointer, "no mem for Machine struct");
+  }
+
+  Result r = machine_init(machine);
+  if (!result_is_error(&r))
+    r = load_rom(machine, rom);
+  if (result_is_error(&r)) {
+    machine_destroy(machine);
+    free(machine);
+    return r;
+  }
+  machine_skip_bootrom(machine);
+
+  u64 start_host = host_cycles_now();
+  u64 start = time_now_ns();
+
+  r = machine_run_cycles(machine, frames * CYCLES_PER_FRAME);
+
+  result->wall_ns     = time_now_ns() - start;
+  result->host_cycles = host_cycles_now() - start_host;
+  result->cycles      = machine->cpu.clock_cycles;
+  result->stopped     = machine->cpu.paused || result_is_error(&r);
+  if (result->stopped)
+    snprintf(result->message, sizeof(result->message), "%s", r.message);
+
+  machine_destroy(machine);
+  free(machine);
+  return result_ok();
+}
+
+static double emulated_mhz(u64 cycles, u64 ns) {
+  return ns ? (double)cycles * 1000.0 / (double)ns : 0.0;
+}
+
+// Writes `s` as a JSON string
+static void write_json_string(FILE* out, const char* s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', out);
+    if ((unsigned char)*s < 0x20)
+      continue;
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+void macrobench_report(const MacroBenchResult* result, FILE* out) {
+  fprintf(out, "{\"rom\":");
+  write_json_string(out, result->name);
+  fprintf(out, ",\"frames\":%llu,\"cycles\":%llu,\"wall_ns\":%llu,\"emu_mhz\":%.3f,",
+          (unsigned long long)result->frames,
+          (unsigned long long)result->cycles,
+          (unsigned long long)result->wall_ns,
+          emulated_mhz(result->cycles, result->wall_ns));
+
+  if (result->host_cycles && result->cycles)
+    fprintf(out, "\"host_cycles_per_cycle\":%.2f,",
+            (double)result->host_cycles / (double)result->cycles);
+  else
+    fprintf(out, "\"host_cycles_per_cycle\":null,");
+
+  fprintf(out, "\"stopped\":%s", result->stopped ? "true" : "false");
+  if (result->stopped) {
+    fprintf(out, ",\"message\":");
+    write_json_string(out, result->message);
+  }
+  fprintf(out, "}\n");
+  fflush(out);
+}
+
+void macrobench_report_summary(const MacroBenchResult* results, int count, FILE* out) {
+  u64 cycles = 0, wall_ns = 0, host_cycles = 0;
+  int stopped = 0;
+
+  for (int i = 0; i < count; i++) {
+    cycles      += results[i].cycles;
+    wall_ns     += results[i].wall_ns;
+    host_cycles += results[i].host_cycles;
+    if (results[i].stopped) stopped++;
+  }
+
+  // ru_maxrss is in kilobytes on Linux
+  struct rusage usage;
+  long peak_rss_kb = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+
+  fprintf(out, "{\"summary\":true,\"roms\":%d,\"stopped\":%d,\"cycles\":%llu,\"wall_ns\":%llu,"
+               "\"emu_mhz\":%.3f,\"dmg_speed\":%.3f,",
+          count, stopped,
+          (unsigned long long)cycles, (unsigned long long)wall_ns,
+          emulated_mhz(cycles, wall_ns),
+          emulated_mhz(cycles, wall_ns) / 4.194304);
+
+  if (host_cycles && cycles)
+    fprintf(out, "\"host_cycles_per_cycle\":%.2f,", (double)host_cycles / (double)cycles);
+  else
+    fprintf(out, "\"host_cycles_per_cycle\":null,");
+
+  fprintf(out, "\"peak_rss_kb\":%ld}\n", peak_rss_kb);
+  fflush(out);
+}
@@ -0,0 +1,32 @@
+#ifndef MACROBENCH_H
+#define MACROBENCH_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define MACROBENCH_DEFAULT_FRAMES 300
+#define MACROBENCH_NAME_MAX 512
+
+// End-to-end throughput of one rom, run single threaded from power on (bootrom skipped)
+typedef struct {
+  char name[MACROBENCH_NAME_MAX]; // rom path, or "synth:<name>" for generated roms
+  u64 frames;      // frames requested
+  u64 cycles;      // T-cycles actually emulated
+  u64 wall_ns;
+  u64 host_cycles; // host timestamp counter ticks, 0 if unavailable
+  bool stopped;    // the cpu stopped before the frame budget ran out
+  char message[256];
+} MacroBenchResult;
+
+// Runs `rom` (a path, or "synth:<name>") for `frames` frames
+Result macrobench_run(const char* rom, u64 frames, MacroBenchResult* result);
+
+// One JSON object per line, same shape as lgb-bench
+void macrobench_report(const MacroBenchResult* result, FILE* out);
+
+// Totals over every result, plus the process' peak RSS
+void macrobench_report_summary(const MacroBenchResult* results, int count, FILE* out);
+
+#endif // !MACROBENCH_H
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+#include "pool.h"
+#include <util.h>
+#include <llog.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+static Result deque_init(PoolDeque* d, int capacity) {
+  memset(d, 0, sizeof(*d));
+  d->tasks = malloc(sizeof(int) * (capacity > 0 ? capacity : 1));
+  d->lock  = SDL_CreateMutex();
+  if (!d->tasks || !d->lock) {
+    return result_error(Error_NullPointer, "no mem for pool deque");
+  }
+  d->capacity = capacity;
+  return result_ok();
+}
+
+static void deque_destroy(PoolDeque* d) {
+  free(d->tasks);
+  d->tasks = NULL;
+  if (d->lock) {
+    SDL_DestroyMutex(d->lock);
+    d->lock = NULL;
+  }
+}
+
+// Every task sits in exactly one deque at a time, so a deque sized for all tasks never fills up
+static void deque_push_back(PoolDeque* d, int task) {
+  SDL_LockMutex(d->lock);
+  d->tasks[(d->head + d->count) % d->capacity] = task;
+  d->count++;
+  SDL_UnlockMutex(d->lock);
+}
+
+static int deque_pop_front(PoolDeque* d) {
+  int task = -1;
+  SDL_LockMutex(d->lock);
+  if (d->count > 0) {
+    task = d->tasks[d->head];
+    d->head = (d->head + 1) % d->capacity;
+    d->count--;
+  }
+  SDL_UnlockMutex(d->lock);
+  return task;
+}
+
+static int deque_steal_back(PoolDeque* d) {
+  int task = -1;
+  SDL_LockMutex(d->lock);
+  if (d->count > 0) {
+    d->count--;
+    task = d->tasks[(d->head + d->count) % d->capacity];
+  }
+  SDL_UnlockMutex(d->lock);
+  return task;
+}
+
+static void pin_current_thread(int core) {
+#ifdef __linux__
+  int cores = SDL_GetCPUCount();
+  if (cores <= 0) return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core % cores, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    LOG_WARNING("failed to pin worker thread to core %d", core % cores);
+#else
+  (void)core;
+#endif
+}
+
+static int worker_thread_func(void* data) {
+  PoolWorker* self = (PoolWorker*)data;
+  WorkPool* pool = self->pool;
+
+  if (pool->pin_threads)
+    pin_current_thread(self->index);
+
+  while (atomic_load(&pool->outstanding) > 0) {
+    int task = deque_pop_front(&self->deque);
+
+    for (int i = 1; task < 0 && i < pool->worker_count; i++) {
+      PoolWorker* victim = &pool->workers[(self->index + i) % pool->worker_count];
+      task = deque_steal_back(&victim->deque);
+      if (task >= 0)
+        self->steals++;
+    }
+
+    if (task < 0) {
+      // Everything left is currently running on other workers
+      sched_yield();
+      continue;
+    }
+
+    self->quanta++;
+    if (pool->fn(pool->ctx, task, self->index))
+      deque_push_back(&self->deque, task);
+    else
+      atomic_fetch_sub(&pool->outstanding, 1);
+  }
+
+  return 0;
+}
+
+Result pool_run(WorkPool* pool, int worker_count, int task_count,
+                PoolTaskFn fn, void* ctx, bool pin_threads) {
+  if (!pool || !fn) {
+    return result_error(Error_NullPointer, "invalid args to pool_run");
+  }
+  if (worker_count < 1) worker_count = 1;
+
+  memset(pool, 0, sizeof(*pool));
+  pool->fn           = fn;
+  pool->ctx          = ctx;
+  pool->pin_threads  = pin_threads;
+  pool->worker_count = worker_count;
+  atomic_store(&pool->outstanding, task_count);
+
+  pool->workers = calloc((size_t)worker_count, sizeof(PoolWorker));
+  if (!pool->workers) {
+    return result_error(Error_NullPointer, "no mem for pool workers");
+  }
+
+  for (int i = 0; i < worker_count; i++) {
+    PoolWorker* w = &pool->workers[i];
+    w->pool  = pool;
+    w->index = i;
+
+    Result rd = deque_init(&w->deque, task_count);
+    if (result_is_error(&rd)) {
+      pool_destroy(pool);
+      return rd;
+    }
+  }
+
+  // Initial round robin distribution, stealing evens out the rest
+  for (int t = 0; t < task_count; t++)
+    deque_push_back(&pool->workers[t % worker_count].deque, t);
+
+  int started = 0;
+  for (int i = 0; i < worker_count; i++) {
+    PoolWorker* w = &pool->workers[i];
+    w->thread = SDL_CreateThread(worker_thread_func, "PoolWorker", w);
+    if (!w->thread) {
+      LOG_ERROR("failed to start pool worker %d", i);
+      break;
+    }
+    started++;
+  }
+
+  // Workers that did start will steal the tasks of the ones that did not
+  if (started == 0) {
+    pool_destroy(pool);
+    return result_error(Error_Unknown, "could not start any pool worker");
+  }
+
+  for (int i = 0; i < started; i++) {
+    int thread_return;
+    SDL_WaitThread(pool->workers[i].thread, &thread_return);
+    pool->workers[i].thread = NULL;
+  }
+
+  return result_ok();
+}
+
+void pool_destroy(WorkPool* pool) {
+  if (!pool || !pool->workers) return;
+
+  for (int i = 0; i < pool->worker_count; i++)
+    deque_destroy(&pool->workers[i].deque);
+
+  free(pool->workers);
+  pool->workers = NULL;
+  pool->worker_count = 0;
+}
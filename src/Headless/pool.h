@@ -0,0 +1,54 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <SDL2/SDL_thread.h>
+
+// Runs one quantum of `task` on `worker`. Returns true if the task wants another quantum
+typedef bool (*PoolTaskFn)(void* ctx, int task, int worker);
+
+// Ring of task ids. The owner pops from the front and requeues at the back (round robin
+// between its tasks), thieves take from the back
+typedef struct {
+  SDL_mutex* lock;
+  int* tasks;
+  int capacity;
+  int head;
+  int count;
+} PoolDeque;
+
+struct WorkPool;
+
+typedef struct {
+  struct WorkPool* pool;
+  int index;
+  SDL_Thread* thread;
+  PoolDeque deque;
+
+  u64 quanta; // quanta executed by this worker
+  u64 steals; // tasks taken from another worker's deque
+} PoolWorker;
+
+typedef struct WorkPool {
+  PoolWorker* workers;
+  int worker_count;
+
+  PoolTaskFn fn;
+  void* ctx;
+
+  atomic_int outstanding; // tasks not finished yet
+  bool pin_threads;
+} WorkPool;
+
+// Spreads `task_count` tasks over `worker_count` threads and blocks until every task is done.
+// With `pin_threads`, worker i is pinned to core i (mod core count)
+Result pool_run(WorkPool* pool, int worker_count, int task_count,
+                PoolTaskFn fn, void* ctx, bool pin_threads);
+
+// Frees the workers and deques of a finished pool
+void pool_destroy(WorkPool* pool);
+
+#endif // !POOL_H
@@ -0,0 +1,274 @@
+#include "serial_socket.h"
+#include <util.h>
+#include <llog.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Socket
+
+static Result make_address(struct sockaddr_un* addr, const char* path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    return result_error(Error_FileIO, "socket path too long: %s", path);
+  }
+  strcpy(addr->sun_path, path);
+  return result_ok();
+}
+
+static u8 inbox_pop(SerialSocket* sock) {
+  u8 byte = sock->inbox[sock->inbox_head];
+  sock->inbox_head = (sock->inbox_head + 1) % SERIAL_SOCKET_QUEUE;
+  sock->inbox_len--;
+  return byte;
+}
+
+static void drop_peer(SerialSocket* sock) {
+  if (sock->fd >= 0)
+    close(sock->fd);
+  sock->fd = -1;
+  sock->peer_waiting = false;
+  sock->tx_len = 0;
+  sock->rx_len = 0;
+}
+
+// Sends what the socket takes right now and keeps the rest for the next call. A peer
+// that went away is dropped like on the receive side, the run carries on unlinked
+static Result flush_queue(SerialSocket* sock) {
+  if (sock->fd < 0) {
+    // Nobody to tell yet: the peer learns the current state when it connects
+    sock->tx_len = 0;
+    return result_ok();
+  }
+
+  u32 sent = 0;
+  while (sent < sock->tx_len) {
+    ssize_t n = send(sock->fd, sock->tx + sent, sock->tx_len - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) {
+      LOG_INFO("serial: peer disconnected (%s)", n < 0 ? strerror(errno) : "send returned 0");
+      drop_peer(sock);
+      return result_ok();
+    }
+    sent += (u32)n;
+  }
+  memmove(sock->tx, sock->tx + sent, sock->tx_len - sent);
+  sock->tx_len -= sent;
+  return result_ok();
+}
+
+static void queue_message(SerialSocket* sock, ESerialSocketMessage kind, u8 data) {
+  if (sock->tx_len + 2 > sizeof(sock->tx)) {
+    flush_queue(sock);
+    // Still full: the peer stopped reading, and a lost message would desync the link
+    if (sock->tx_len + 2 > sizeof(sock->tx)) {
+      LOG_WARNING("serial: peer is not reading, dropping it");
+      drop_peer(sock);
+    }
+  }
+  sock->tx[sock->tx_len++] = (u8)kind;
+  sock->tx[sock->tx_len++] = data;
+}
+
+// Link callbacks, called by the core in the middle of a run
+
+static u8 socket_exchange(SerialLink* link, u8 out, u64 now) {
+  (void)now;
+  SerialSocket* sock = (SerialSocket*)link->ctx;
+
+  // A waiting transfer taking in the next inbox byte (see socket_armed)
+  if (serial_waiting(&sock->machine->cpu.serial))
+    return sock->inbox_len ? inbox_pop(sock) : 0xFF;
+
+  u8 in = sock->peer_waiting ? sock->peer_sb : 0xFF;
+  sock->peer_waiting = false;
+  sock->bytes_sent++;
+  queue_message(sock, SERIAL_MSG_CLOCKED, out);
+  return in;
+}
+
+static bool socket_armed(SerialLink* link, bool armed, u8 sb) {
+  SerialSocket* sock = (SerialSocket*)link->ctx;
+  if (armed && sock->inbox_len)
+    return true;
+
+  queue_message(sock, armed ? SERIAL_MSG_WAITING : SERIAL_MSG_IDLE, sb);
+  return false;
+}
+
+static void plug(SerialSocket* sock, Machine* machine) {
+  memset(sock, 0, sizeof(*sock));
+  sock->machine   = machine;
+  sock->listen_fd = -1;
+  sock->fd        = -1;
+
+  sock->link.exchange = socket_exchange;
+  sock->link.armed    = socket_armed;
+  sock->link.ctx      = sock;
+  machine->cpu.serial.link = &sock->link;
+}
+
+// A peer connecting late hasn't seen the waiting message
+static void peer_connected(SerialSocket* sock, int fd) {
+  sock->fd = fd;
+  sock->tx_len = 0;
+
+  const Serial* serial = &sock->machine->cpu.serial;
+  if (serial_waiting(serial))
+    queue_message(sock, SERIAL_MSG_WAITING, serial->sb);
+}
+
+Result serial_socket_listen(SerialSocket* sock, Machine* machine, const char* path) {
+  if (!sock || !machine || !path) {
+    return result_error(Error_NullPointer, "invalid args to serial_socket_listen");
+  }
+
+  struct sockaddr_un addr;
+  Result r = make_address(&addr, path);
+  if (result_is_error(&r)) return r;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return result_error(Error_FileIO, "socket: %s", strerror(errno));
+  }
+  unlink(path);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return result_error(Error_FileIO, "failed to bind %s: %s", path, strerror(errno));
+  }
+  if (listen(fd, 1) != 0) {
+    close(fd);
+    return result_error(Error_FileIO, "listen: %s", strerror(errno));
+  }
+
+  plug(sock, machine);
+  sock->listen_fd = fd;
+  snprintf(sock->unix_path, sizeof(sock->unix_path), "%s", path);
+  return result_ok();
+}
+
+Result serial_socket_connect(SerialSocket* sock, Machine* machine, const char* path) {
+  if (!sock || !machine || !path) {
+    return result_error(Error_NullPointer, "invalid args to serial_socket_connect");
+  }
+
+  struct sockaddr_un addr;
+  Result r = make_address(&addr, path);
+  if (result_is_error(&r)) return r;
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return result_error(Error_FileIO, "socket: %s", strerror(errno));
+  }
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return result_error(Error_FileIO, "failed to connect to %s: %s", path, strerror(errno));
+  }
+
+  plug(sock, machine);
+  peer_connected(sock, fd);
+  return result_ok();
+}
+
+void serial_socket_destroy(SerialSocket* sock) {
+  if (!sock) return;
+
+  if (sock->machine && sock->machine->cpu.serial.link == &sock->link)
+    sock->machine->cpu.serial.link = NULL;
+
+  // The bytes clocked out in the last run, as far as the socket takes them
+  flush_queue(sock);
+
+  drop_peer(sock);
+  if (sock->listen_fd >= 0)
+    close(sock->listen_fd);
+  sock->listen_fd = -1;
+  if (sock->unix_path[0])
+    unlink(sock->unix_path);
+}
+
+// Polling
+
+static void apply_message(SerialSocket* sock, u8 kind, u8 data) {
+  Cpu* cpu = &sock->machine->cpu;
+
+  switch (kind) {
+    case SERIAL_MSG_WAITING:
+      sock->peer_waiting = true;
+      sock->peer_sb = data;
+      break;
+    case SERIAL_MSG_IDLE:
+      sock->peer_waiting = false;
+      break;
+    case SERIAL_MSG_CLOCKED:
+      if (serial_waiting(&cpu->serial) && cpu->serial.next_event == SERIAL_NO_EVENT && !sock->inbox_len) {
+        serial_receive(&cpu->serial, data, &cpu->interrupt_flag);
+      } else if (sock->inbox_len < SERIAL_SOCKET_QUEUE) {
+        sock->inbox[(sock->inbox_head + sock->inbox_len) % SERIAL_SOCKET_QUEUE] = data;
+        sock->inbox_len++;
+      } else {
+        LOG_WARNING("serial: inbox full, byte 0x%02X lost", data);
+      }
+      sock->bytes_received++;
+      break;
+    default:
+      LOG_WARNING("serial: unknown message 0x%02X", kind);
+      break;
+  }
+}
+
+static Result receive_messages(SerialSocket* sock) {
+  struct pollfd pfd = { .fd = sock->fd, .events = POLLIN };
+
+  while (sock->fd >= 0 && poll(&pfd, 1, 0) > 0) {
+    ssize_t n = recv(sock->fd, sock->rx + sock->rx_len, sizeof(sock->rx) - sock->rx_len, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      drop_peer(sock);
+      LOG_INFO("serial: peer disconnected");
+      return result_ok();
+    }
+    sock->rx_len += (u32)n;
+
+    u32 i = 0;
+    for (; i + 2 <= sock->rx_len; i += 2)
+      apply_message(sock, sock->rx[i], sock->rx[i + 1]);
+    memmove(sock->rx, sock->rx + i, sock->rx_len - i);
+    sock->rx_len -= i;
+  }
+
+  // A transfer already waiting takes in the first inbox byte
+  Serial* serial = &sock->machine->cpu.serial;
+  if (sock->inbox_len && serial_waiting(serial) && serial->next_event == SERIAL_NO_EVENT)
+    serial_receive(serial, inbox_pop(sock), &sock->machine->cpu.interrupt_flag);
+
+  return result_ok();
+}
+
+Result serial_socket_poll(SerialSocket* sock) {
+  if (!sock) {
+    return result_error(Error_NullPointer, "invalid socket to serial_socket_poll");
+  }
+
+  if (sock->fd < 0 && sock->listen_fd >= 0) {
+    struct pollfd pfd = { .fd = sock->listen_fd, .events = POLLIN };
+    if (poll(&pfd, 1, 0) > 0) {
+      int fd = accept(sock->listen_fd, NULL, NULL);
+      if (fd >= 0) {
+        LOG_INFO("serial: peer connected on %s", sock->unix_path);
+        peer_connected(sock, fd);
+      }
+    }
+  }
+
+  Result r = flush_queue(sock);
+  if (result_is_error(&r)) return r;
+
+  return receive_messages(sock);
+}
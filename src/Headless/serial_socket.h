@@ -0,0 +1,65 @@
+#ifndef SERIAL_SOCKET_H
+#define SERIAL_SOCKET_H
+
+#include <types.h>
+#include <lresult.h>
+#include <stdbool.h>
+#include <Emulator/machine.h>
+
+// Link cable to an lgb in another process, over a Unix domain socket. Neither end ever
+// waits for the other: each one tells its peer when it starts (or stops) waiting for the
+// external clock and with which byte in SB, and an end driving the clock exchanges with
+// the last byte announced (0xFF when the peer isn't waiting) and sends its own byte over.
+// Messages are queued during a run and exchanged in a batch by serial_socket_poll, so
+// the socket's latency only delays when the other machine sees a byte, never the
+// emulation. Bytes clocked in by the peer faster than this end takes them in wait in an
+// inbox, one transfer time apart.
+//
+// Messages are two bytes, a SerialSocketMessage then the data byte.
+
+#define SERIAL_SOCKET_QUEUE 256 // messages queued before a run flushes them itself
+
+typedef enum {
+  SERIAL_MSG_WAITING = 'W', // waiting for the external clock, data = SB
+  SERIAL_MSG_IDLE    = 'I', // not waiting anymore
+  SERIAL_MSG_CLOCKED = 'X', // clocked a byte out, data = the byte
+} ESerialSocketMessage;
+
+typedef struct {
+  Machine* machine;
+  SerialLink link;
+
+  int listen_fd;       // -1 when connecting. Kept open to accept a new peer after one leaves
+  int fd;              // -1 until the peer is connected
+  char unix_path[108]; // unlinked on destroy, empty when connecting
+
+  bool peer_waiting;
+  u8 peer_sb;
+
+  u8 inbox[SERIAL_SOCKET_QUEUE]; // bytes the peer clocked in, not taken in yet (ring)
+  u32 inbox_head;
+  u32 inbox_len;
+
+  u8 tx[SERIAL_SOCKET_QUEUE * 2];
+  u32 tx_len;
+  u8 rx[SERIAL_SOCKET_QUEUE * 2];
+  u32 rx_len;
+
+  u64 bytes_sent;     // clocked out by this end
+  u64 bytes_received; // clocked in by the peer
+} SerialSocket;
+
+// Plugs the machine into a socket at `path`, either waiting for the peer to connect
+// (listen) or connecting to one that listens
+Result serial_socket_listen(SerialSocket* sock, Machine* machine, const char* path);
+Result serial_socket_connect(SerialSocket* sock, Machine* machine, const char* path);
+
+// Sends what is still queued, unplugs the machine and closes the socket
+void serial_socket_destroy(SerialSocket* sock);
+
+// Accepts the peer when it connects, sends the queued messages and applies the received
+// ones. Never blocks: what the socket doesn't take stays queued, and a peer that went
+// away is dropped and waited for again. Call it between runs
+Result serial_socket_poll(SerialSocket* sock);
+
+#endif // !SERIAL_SOCKET_H
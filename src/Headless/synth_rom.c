@@ -0,0 +1,238 @@
+#include "synth_rom.h"
+#include <string.h>
+
+#define ENTRY_POINT 0x0100
+#define CODE_START  0x0150
+
+static const char* SYNTH_NAMES[SYNTH_COUNT] = {
+  [SYNTH_ALU] = "alu",
+  [SYNTH_MEM] = "mem",
+  [SYNTH_CB]  = "cb",
+  [SYNTH_IRQ] = "irq",
+  [SYNTH_POLL] = "poll",
+};
+
+typedef struct {
+  u8* rom;
+  u16 pc;
+} Emitter;
+
+static void emit8(Emitter* e, u8 v) {
+  if (e->pc < SYNTH_ROM_SIZE)
+    e->rom[e->pc] = v;
+  e->pc++;
+}
+
+static void emit16(Emitter* e, u8 opcode, u16 v) {
+  emit8(e, opcode);
+  emit8(e, (u8)v);
+  emit8(e, (u8)(v >> 8));
+}
+
+static void emit_jp(Emitter* e, u16 addr)            { emit16(e, 0xC3, addr); }
+static void emit_ld_r8_imm(Emitter* e, int r, u8 v)  { emit8(e, (u8)(0x06 | (r << 3))); emit8(e, v); }
+static void emit_ld_r16_imm(Emitter* e, int rr, u16 v) { emit16(e, (u8)(0x01 | (rr << 4)), v); }
+
+// r8 operand order of the opcode table: B C D E H L (HL) A
+enum { R_B = 0, R_C, R_D, R_E, R_H, R_L, R_HL, R_A };
+// r16 operand order: BC DE HL SP
+enum { RR_BC = 0, RR_DE, RR_HL, RR_SP };
+
+// Seeds every register with a distinct value
+static void emit_seed_registers(Emitter* e) {
+  emit_ld_r8_imm(e, R_A, 0x5A);
+  emit_ld_r8_imm(e, R_B, 0x13);
+  emit_ld_r8_imm(e, R_C, 0x37);
+  emit_ld_r8_imm(e, R_D, 0x81);
+  emit_ld_r8_imm(e, R_E, 0xC4);
+  emit_ld_r8_imm(e, R_H, 0x2F);
+  emit_ld_r8_imm(e, R_L, 0xE9);
+}
+
+static void build_alu(Emitter* e) {
+  emit_seed_registers(e);
+
+  u16 loop = e->pc;
+  for (int op = 0; op < 8; op++) {
+    for (int r = 0; r < 8; r++) {
+      if (r == R_HL) continue;
+      emit8(e, (u8)(0x80 | (op << 3) | r));
+    }
+    // Keep the operands moving
+    emit8(e, (u8)(0x40 | (((op + 1) % 6) << 3) | R_A)); // LD r, A
+  }
+  emit_jp(e, loop);
+}
+
+static void build_mem(Emitter* e) {
+  emit_seed_registers(e);
+
+  u16 loop = e->pc;
+  emit_ld_r16_imm(e, RR_HL, 0xC000);
+  emit_ld_r16_imm(e, RR_BC, 0xD000);
+  emit_ld_r16_imm(e, RR_DE, 0xFF80);
+
+  for (int i = 0; i < 32; i++) {
+    emit8(e, 0x22);                  // LD (HL+), A
+    emit8(e, 0x02);                  // LD (BC), A
+    emit8(e, 0x03);                  // INC BC
+    emit8(e, 0x12);                  // LD (DE), A
+    emit8(e, 0x13);                  // INC DE
+    emit8(e, (u8)(0x80 | (i % 6)));  // ADD A, r (B..L)
+  }
+  for (int i = 0; i < 16; i++)
+    emit8(e, 0x32);                  // LD (HL-), A
+  emit_jp(e, loop);
+}
+
+static void build_cb(Emitter* e) {
+  emit_seed_registers(e);
+
+  u16 loop = e->pc;
+  for (int op = 0; op < 256; op++) {
+    if ((op & 0x07) == R_HL) continue;
+    emit8(e, 0xCB);
+    emit8(e, (u8)op);
+  }
+  emit_jp(e, loop);
+}
+
+static void build_irq(Emitter* e) {
+  emit_seed_registers(e);
+
+  // IE = all sources
+  emit_ld_r16_imm(e, RR_BC, 0xFFFF);
+  emit_ld_r8_imm(e, R_A, 0x1F);
+  emit8(e, 0x02);
+
+  // STAT: LYC, mode 2, mode 1, mode 0 sources, LYC = 0x40
+  emit_ld_r16_imm(e, RR_BC, 0xFF41);
+  emit_ld_r8_imm(e, R_A, 0x78);
+  emit8(e, 0x02);
+  emit8(e, 0x03);                    // INC BC -> 0xFF42
+  emit8(e, 0x03);
+  emit8(e, 0x03);
+  emit8(e, 0x03);                    // 0xFF45
+  emit_ld_r8_imm(e, R_A, 0x40);
+  emit8(e, 0x02);
+
+  // Timer on at 65536Hz, overflowing every 16384 cycles
+  emit_ld_r16_imm(e, RR_BC, 0xFF07);
+  emit_ld_r8_imm(e, R_A, 0x06);
+  emit8(e, 0x02);
+
+  // LCD on
+  emit_ld_r16_imm(e, RR_BC, 0xFF40);
+  emit_ld_r8_imm(e, R_A, 0x91);
+  emit8(e, 0x02);
+
+  // Sleep until the next interrupt, then a bit of work after its handler returned
+  emit8(e, 0xFB);                    // EI
+  u16 loop = e->pc;
+  emit8(e, 0x76);                    // HALT
+  for (int i = 0; i < 48; i++)
+    emit8(e, (u8)(0xA8 | (i % 6)));  // XOR A, r
+  emit_jp(e, loop);
+
+  // Every vector (VBlank, STAT, timer, serial, joypad) just returns
+  u16 code_end = e->pc;
+  for (u16 vector = 0x40; vector <= 0x60; vector += 8) {
+    e->pc = vector;
+    emit8(e, 0xD9);                  // RETI
+  }
+  e->pc = code_end;
+}
+
+// ldh a, [reg]; cp value; jr cc, back to the ldh
+static void emit_poll(Emitter* e, u8 reg, u8 value, u8 jr_cc) {
+  u16 loop = e->pc;
+  emit8(e, 0xF0);
+  emit8(e, reg);
+  emit8(e, 0xFE);
+  emit8(e, value);
+  emit8(e, jr_cc);
+  emit8(e, (u8)(loop - (e->pc + 1)));
+}
+
+static void build_poll(Emitter* e) {
+  emit_seed_registers(e);
+
+  // OAM DMA routine copied to HRAM (the only memory the cpu can fetch from while the DMA
+  // runs): start it from 0xC000, wait 40 * 20 cycles, jump back to `dma_return`
+  u8 dma_routine[] = {
+    0xE0, 0x46,        // LDH [0x46], A
+    0x3E, 0x28,        // LD A, 40
+    0xD6, 0x01,        // SUB A, 1
+    0x20, 0xFC,        // JR NZ, -4
+    0xC3, 0x00, 0x00,  // JP dma_return
+  };
+  u16 dma_return_at = 9;
+
+  emit_ld_r16_imm(e, RR_DE, 0xFF80);
+  u16 patch = e->pc;
+  for (u16 i = 0; i < sizeof(dma_routine); i++) {
+    emit_ld_r8_imm(e, R_A, dma_routine[i]);
+    emit8(e, 0x12);                  // LD (DE), A
+    emit8(e, 0x13);                  // INC DE
+  }
+  // Each byte took 4 bytes of code, its immediate at offset 1
+  u16 dma_return_lo = (u16)(patch + dma_return_at * 4 + 1);
+
+  // LCD on
+  emit_ld_r16_imm(e, RR_BC, 0xFF40);
+  emit_ld_r8_imm(e, R_A, 0x91);
+  emit8(e, 0x02);
+
+  // Busy-wait for VBlank (LY == 144), refresh OAM and do a bit of work, then wait for
+  // its end
+  u16 loop = e->pc;
+  emit_poll(e, 0x44, 0x90, 0x20);    // until LY == 144 (JR NZ)
+  emit_ld_r8_imm(e, R_A, 0xC0);
+  emit_jp(e, 0xFF80);
+  u16 dma_return = e->pc;
+  for (int i = 0; i < 48; i++)
+    emit8(e, (u8)(0xA8 | (i % 6)));  // XOR A, r
+  emit_poll(e, 0x44, 0x90, 0x30);    // until LY < 144 (JR NC)
+  emit_jp(e, loop);
+
+  e->rom[dma_return_lo]     = (u8)dma_return;
+  e->rom[dma_return_lo + 4] = (u8)(dma_return >> 8);
+}
+
+const char* synth_rom_name(ESynthRom kind) {
+  if (kind < 0 || kind >= SYNTH_COUNT) return "?";
+  return SYNTH_NAMES[kind];
+}
+
+bool synth_rom_lookup(const char* name, ESynthRom* kind) {
+  for (int i = 0; i < SYNTH_COUNT; i++) {
+    if (strcmp(name, SYNTH_NAMES[i]) == 0) {
+      *kind = (ESynthRom)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void synth_rom_build(ESynthRom kind, u8* rom) {
+  memset(rom, 0, SYNTH_ROM_SIZE);
+
+  Emitter e = { .rom = rom, .pc = ENTRY_POINT };
+  emit_jp(&e, CODE_START);
+
+  // Header: title, rom only, 32KB, no ram
+  memcpy(&rom[0x134], "LGB SYNTH", 9);
+  rom[0x147] = 0x00;
+  rom[0x148] = 0x00;
+  rom[0x149] = 0x00;
+
+  e.pc = CODE_START;
+  switch (kind) {
+    case SYNTH_ALU: build_alu(&e); break;
+    case SYNTH_MEM: build_mem(&e); break;
+    case SYNTH_CB:  build_cb(&e);  break;
+    case SYNTH_IRQ: build_irq(&e); break;
+    case SYNTH_POLL: build_poll(&e); break;
+    default: break;
+  }
+}
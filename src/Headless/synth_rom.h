@@ -0,0 +1,29 @@
+#ifndef SYNTH_ROM_H
+#define SYNTH_ROM_H
+
+#include <types.h>
+#include <stdbool.h>
+
+#define SYNTH_ROM_SIZE (32 * 1024)
+
+// Generated test roms. Each one sets up its registers then loops forever over a block
+// that stresses one part of the machine
+typedef enum {
+  SYNTH_ALU = 0, // 8-bit ALU ops and register moves
+  SYNTH_MEM,     // stores through (BC), (DE), (HL+), (HL-) into WRAM and HRAM
+  SYNTH_CB,      // every CB op on registers
+  SYNTH_IRQ,     // LCD, every STAT source and the timer on, HALTs until each interrupt
+  SYNTH_POLL,    // LCD on, busy-waits on LY for the start and end of every VBlank
+  SYNTH_COUNT,
+} ESynthRom;
+
+// Name used on the command line (e.g. "alu")
+const char* synth_rom_name(ESynthRom kind);
+
+// Looks up a rom by name, returns false if there is none
+bool synth_rom_lookup(const char* name, ESynthRom* kind);
+
+// Writes the rom image (SYNTH_ROM_SIZE bytes) into `rom`
+void synth_rom_build(ESynthRom kind, u8* rom);
+
+#endif // !SYNTH_ROM_H
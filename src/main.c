@@ -1,12 +1,29 @@
 #include <App/app.h>
 #include <Emulator/cpu/cpu.h>
+#include <Headless/headless.h>
+#include <Emulator/emu_log.h>
 #include <llog.h>
 #include "util.h"
 #include <stdlib.h>
+#include <string.h>
 
-int main() {
-  // App initialization
-  ResultApp ra = app_create();
+int main(int argc, char** argv) {
+  emu_log_init_from_env();
+
+  if (headless_requested(argc, argv))
+    return headless_main(argc, argv);
+
+  // App initialization: lgb [rom] [--debug <script>]
+  const char* rom_path = NULL;
+  const char* debug_path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--debug") == 0 && i + 1 < argc)
+      debug_path = argv[++i];
+    else
+      rom_path = argv[i];
+  }
+
+  ResultApp ra = app_create(rom_path, debug_path);
   if (result_App_is_err(&ra)) {
     LOG_ERROR("failed to create app: %s (%s)", ra.message, error_string(ra.error_code));
     return EXIT_FAILURE;
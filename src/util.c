@@ -1,4 +1,9 @@
 #include "util.h"
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 void pin_set_low(Pin* pin)  { pin->state = PIN_LOW;  }
 void pin_set_high(Pin* pin) { pin->state = PIN_HIGH; }
@@ -36,3 +41,17 @@ void set_data_bus_value(Cpu* cpu, u8 value) {
       pin_set_low(&cpu->data_bus[i]);
   }  
 }
+
+u64 time_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+u64 host_cycles_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return (u64)__rdtsc();
+#else
+  return 0;
+#endif
+}
@@ -57,4 +57,10 @@ void set_bus_hiz(Cpu* cpu);
 void set_addr_bus_value(Cpu* cpu, u16 value);
 void set_data_bus_value(Cpu* cpu, u8 value);
 
+// Monotonic host time in nanoseconds
+u64 time_now_ns(void);
+
+// Host cpu timestamp counter (rdtsc on x86), 0 where there is none
+u64 host_cycles_now(void);
+
 #endif // !UTIL_H
@@ -0,0 +1,107 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <types.h>
+#include <lresult.h>
+#include <Emulator/machine.h>
+#include <Headless/synth_rom.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every file in tests/ is one executable and one ctest test. EXPECT reports a failed
+// check and carries on; main returns test_result() so the test fails if any did
+
+static int test_failures;
+
+#define EXPECT(cond, ...)                                   \
+  do {                                                      \
+    if (!(cond)) {                                          \
+      test_failures++;                                      \
+      fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);       \
+      fprintf(stderr, __VA_ARGS__);                         \
+      fputc('\n', stderr);                                  \
+    }                                                       \
+  } while (0)
+
+static inline int test_result(void) {
+  if (test_failures)
+    fprintf(stderr, "%d check(s) failed\n", test_failures);
+  return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// A machine running a generated rom from the state the bootrom leaves, NULL on failure
+static inline Machine* test_synth_machine(ESynthRom kind) {
+  static u8 rom[SYNTH_ROM_SIZE];
+  synth_rom_build(kind, rom);
+
+  Machine* m = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!m) return NULL;
+
+  Result r = machine_init(m);
+  if (!result_is_error(&r))
+    r = mem_load_rom_data(&m->mem, rom, sizeof(rom));
+  if (result_is_error(&r)) {
+    fprintf(stderr, "synth:%s: %s\n", synth_rom_name(kind), r.message);
+    free(m);
+    return NULL;
+  }
+
+  machine_skip_bootrom(m);
+  return m;
+}
+
+static inline void test_free_machine(Machine* m) {
+  if (!m) return;
+  machine_destroy(m);
+  free(m);
+}
+
+// Checks that two machines are in the same emulated state: registers, interrupts, the
+// ppu and its framebuffer, WRAM/HRAM/OAM/VRAM and the timer registers. Counters, pins
+// and host-side hooks are not part of it. `what` names the pair in failures
+static inline bool test_same_state(Machine* a, Machine* b, const char* what) {
+  int before = test_failures;
+  Cpu* ca = &a->cpu;
+  Cpu* cb = &b->cpu;
+
+  EXPECT(ca->clock_cycles == cb->clock_cycles, "%s: clock %llu != %llu", what,
+         (unsigned long long)ca->clock_cycles, (unsigned long long)cb->clock_cycles);
+  for (int i = 0; i < WZ; i++) {
+    EXPECT(ca->registers[i].v == cb->registers[i].v, "%s: register %d %04X != %04X",
+           what, i, ca->registers[i].v, cb->registers[i].v);
+  }
+  EXPECT(ca->IR == cb->IR, "%s: IR %02X != %02X", what, ca->IR, cb->IR);
+  EXPECT(ca->interrupt_flag == cb->interrupt_flag, "%s: IF %02X != %02X", what,
+         ca->interrupt_flag, cb->interrupt_flag);
+  EXPECT(ca->interrupt_enable == cb->interrupt_enable, "%s: IE %02X != %02X", what,
+         ca->interrupt_enable, cb->interrupt_enable);
+  EXPECT(ca->ime == cb->ime && ca->ime_pending == cb->ime_pending, "%s: IME differs", what);
+  EXPECT(ca->halted == cb->halted, "%s: halted %d != %d", what, ca->halted, cb->halted);
+
+  const Ppu* pa = &ca->ppu;
+  const Ppu* pb = &cb->ppu;
+  EXPECT(pa->dot == pb->dot && pa->ly == pb->ly, "%s: ppu at %u/%u != %u/%u", what,
+         pa->ly, pa->dot, pb->ly, pb->dot);
+  EXPECT(pa->stat == pb->stat && pa->lcdc == pb->lcdc && pa->stat_line == pb->stat_line,
+         "%s: STAT/LCDC differ", what);
+  EXPECT(pa->frames == pb->frames && pa->window_line == pb->window_line,
+         "%s: ppu counters differ", what);
+  EXPECT(memcmp(pa->framebuffer, pb->framebuffer, sizeof(pa->framebuffer)) == 0,
+         "%s: framebuffers differ", what);
+
+  EXPECT(memcmp(a->mem.wram, b->mem.wram, WRAM_SIZE) == 0, "%s: WRAM differs", what);
+  EXPECT(memcmp(a->mem.hram, b->mem.hram, HRAM_SIZE) == 0, "%s: HRAM differs", what);
+  EXPECT(memcmp(a->mem.oam, b->mem.oam, OAM_SIZE) == 0, "%s: OAM differs", what);
+  EXPECT(memcmp(a->mem.vram, b->mem.vram, VRAM_SIZE) == 0, "%s: VRAM differs", what);
+
+  for (u16 addr = 0xFF04; addr <= 0xFF07; addr++) {
+    u8 va = mem_peek8(&a->mem, ca, addr);
+    u8 vb = mem_peek8(&b->mem, cb, addr);
+    EXPECT(va == vb, "%s: %04X %02X != %02X", what, addr, va, vb);
+  }
+
+  return test_failures == before;
+}
+
+#endif // !TEST_H
@@ -0,0 +1,50 @@
+// OAM DMA copied in one go (Mem.dma_bulk) against byte by byte: synth:poll starts one
+// from 0xC000 every VBlank, from a pattern changed each frame, and outside the transfers
+// both machines must be in the same state
+
+#include "test.h"
+
+#define RUN_FRAMES 24
+
+static void fill_source(Machine* m, u32 frame) {
+  for (int i = 0; i < OAM_SIZE; i++)
+    m->mem.wram[i] = (u8)(i * 7 + frame * 13 + 1);
+}
+
+int main(void) {
+  Machine* bulk = test_synth_machine(SYNTH_POLL);
+  Machine* bytes = test_synth_machine(SYNTH_POLL);
+  if (!bulk || !bytes) goto done;
+  bulk->mem.dma_bulk = true;
+
+  char what[64];
+  u32 compared = 0;
+  for (u32 frame = 0; frame < RUN_FRAMES; frame++) {
+    // The last two frames keep the pattern, so OAM has to end up holding it
+    if (frame < RUN_FRAMES - 2) {
+      fill_source(bulk, frame);
+      fill_source(bytes, frame);
+    }
+
+    Result r = machine_run_cycles(bulk, CYCLES_PER_FRAME);
+    EXPECT(!result_is_error(&r), "bulk: %s", r.message);
+    Result rb = machine_run_cycles(bytes, CYCLES_PER_FRAME);
+    EXPECT(!result_is_error(&rb), "bytes: %s", rb.message);
+    if (result_is_error(&r) || result_is_error(&rb)) break;
+
+    if (bulk->mem.dma.next != OAM_DMA_IDLE || bytes->mem.dma.next != OAM_DMA_IDLE)
+      continue;
+    snprintf(what, sizeof(what), "frame %u", frame);
+    if (!test_same_state(bulk, bytes, what)) break;
+    compared++;
+  }
+
+  EXPECT(compared > RUN_FRAMES / 2, "only %u frames ended outside a transfer", compared);
+  EXPECT(memcmp(bulk->mem.oam, bulk->mem.wram, OAM_SIZE) == 0, "bulk OAM doesn't hold the source");
+  EXPECT(memcmp(bytes->mem.oam, bytes->mem.wram, OAM_SIZE) == 0, "OAM doesn't hold the source");
+
+done:
+  test_free_machine(bulk);
+  test_free_machine(bytes);
+  return test_result();
+}
@@ -0,0 +1,56 @@
+// machine_run_cycles with fast_forward on against the same machine stepping every
+// cycle: runs of uneven length, so they end before, inside and after the skipped
+// stretches, must leave both machines in the same state after every run
+
+#include "test.h"
+
+#define RUN_FRAMES 40
+
+static void run_kind(ESynthRom kind) {
+  Machine* fast = test_synth_machine(kind);
+  Machine* slow = test_synth_machine(kind);
+  if (!fast || !slow) goto done;
+  slow->fast_forward = false;
+
+  char what[64];
+  u64 end = (u64)RUN_FRAMES * CYCLES_PER_FRAME;
+  for (u64 step = 0; fast->cpu.clock_cycles < end; step++) {
+    u64 n = 1 + (step * 7919) % 1500;
+    Result r = machine_run_cycles(fast, n);
+    EXPECT(!result_is_error(&r), "synth:%s fast: %s", synth_rom_name(kind), r.message);
+    Result rs = machine_run_cycles(slow, n);
+    EXPECT(!result_is_error(&rs), "synth:%s stepped: %s", synth_rom_name(kind), rs.message);
+    if (result_is_error(&r) || result_is_error(&rs)) break;
+
+    snprintf(what, sizeof(what), "synth:%s after %llu cycles", synth_rom_name(kind),
+             (unsigned long long)slow->cpu.clock_cycles);
+    EXPECT(fast->cpu.clock_phase == slow->cpu.clock_phase && fast->cpu.has_instr == slow->cpu.has_instr,
+           "%s: clock phase differs", what);
+    if (!test_same_state(fast, slow, what)) break;
+  }
+
+#if EMU_STATS
+  // Make sure the skips were taken at all
+  if (kind == SYNTH_IRQ) {
+    EXPECT(fast->cpu.stats.halt_skipped_cycles > end / 4, "synth:%s: only %llu halted cycles skipped",
+           synth_rom_name(kind), (unsigned long long)fast->cpu.stats.halt_skipped_cycles);
+  }
+  if (kind == SYNTH_POLL) {
+    EXPECT(fast->cpu.stats.idle_skipped_cycles > end / 4, "synth:%s: only %llu idle cycles skipped",
+           synth_rom_name(kind), (unsigned long long)fast->cpu.stats.idle_skipped_cycles);
+  }
+  EXPECT(slow->cpu.stats.halt_skipped_cycles == 0 && slow->cpu.stats.idle_skipped_cycles == 0,
+         "synth:%s: stepped machine skipped", synth_rom_name(kind));
+#endif
+
+done:
+  test_free_machine(fast);
+  test_free_machine(slow);
+}
+
+int main(void) {
+  run_kind(SYNTH_IRQ);
+  run_kind(SYNTH_POLL);
+
+  return test_result();
+}
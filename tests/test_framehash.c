@@ -0,0 +1,100 @@
+// Frame hashes: XXH64 against its reference vectors, then a hash log recorded from a run
+// and compared against the same run, and against one that changes WRAM halfway
+
+#include "test.h"
+#include <Emulator/framehash.h>
+
+#define HASH_PATH   "test_framehash.log"
+#define RUN_FRAMES  12
+#define TOUCH_FRAME 6
+
+static void test_xxh64(void) {
+  static const struct {
+    const char* data;
+    u64 seed;
+    u64 hash;
+  } vectors[] = {
+    { "", 0, 0xEF46DB3751D8E999ull },
+    { "abc", 0, 0x44BC2CF5AD770999ull },
+    { "Nobody inspects the spammish repetition", 0, 0xFBCEA83C8A378BF1ull },
+  };
+  for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+    u64 h = xxh64(vectors[i].data, strlen(vectors[i].data), vectors[i].seed);
+    EXPECT(h == vectors[i].hash, "xxh64(\"%s\") = %016llx, expected %016llx", vectors[i].data,
+           (unsigned long long)h, (unsigned long long)vectors[i].hash);
+  }
+}
+
+// Runs synth:irq for RUN_FRAMES frames with `hasher` attached. With `touch`, a WRAM byte
+// the rom never uses is changed before frame TOUCH_FRAME
+static void run_hashed(FrameHasher* hasher, bool touch) {
+  Machine* m = test_synth_machine(SYNTH_IRQ);
+  if (!m) return;
+  framehash_attach(hasher, &m->cpu);
+
+  for (u32 frame = 0; frame < RUN_FRAMES && !m->cpu.paused; frame++) {
+    if (touch && frame == TOUCH_FRAME)
+      m->mem.wram[WRAM_SIZE - 0x100] ^= 0x5A;
+    Result r = machine_run_cycles(m, CYCLES_PER_FRAME);
+    EXPECT(!result_is_error(&r), "frame %u: %s", frame, r.message);
+  }
+
+  cpu_remove_frame_sink(&m->cpu, &hasher->sink);
+  test_free_machine(m);
+}
+
+static void test_record_compare(void) {
+  FrameHasher hasher;
+  Result r = framehash_open_record(&hasher, HASH_PATH, "vram,wram,oam");
+  EXPECT(!result_is_error(&r), "record: %s", r.message);
+  if (result_is_error(&r)) return;
+  run_hashed(&hasher, false);
+  u64 recorded = hasher.frames;
+  r = framehash_close(&hasher);
+  EXPECT(!result_is_error(&r), "close: %s", r.message);
+  EXPECT(recorded >= RUN_FRAMES - 1, "only %llu frames recorded", (unsigned long long)recorded);
+
+  r = framehash_open_compare(&hasher, HASH_PATH);
+  EXPECT(!result_is_error(&r), "compare: %s", r.message);
+  if (result_is_error(&r)) return;
+  EXPECT(hasher.golden_frames == recorded && hasher.region_count == 3,
+         "golden log: %llu frames, %u regions", (unsigned long long)hasher.golden_frames,
+         hasher.region_count);
+  run_hashed(&hasher, false);
+  EXPECT(!hasher.diverged, "same run diverged: %s", hasher.message);
+  EXPECT(hasher.frames == recorded, "%llu of %llu frames compared", (unsigned long long)hasher.frames,
+         (unsigned long long)recorded);
+  framehash_close(&hasher);
+
+  r = framehash_open_compare(&hasher, HASH_PATH);
+  if (result_is_error(&r)) return;
+  run_hashed(&hasher, true);
+  EXPECT(hasher.diverged && strstr(hasher.message, "wram"), "changed WRAM went unnoticed");
+  EXPECT(hasher.frames <= TOUCH_FRAME + 2, "divergence found %llu frames in",
+         (unsigned long long)hasher.frames);
+  framehash_close(&hasher);
+}
+
+static void test_bad_input(void) {
+  FrameHasher hasher;
+  Result r = framehash_open_record(&hasher, HASH_PATH, "vram,bogus");
+  EXPECT(result_is_error(&r), "unknown region accepted");
+  framehash_close(&hasher);
+
+  FILE* f = fopen(HASH_PATH, "w");
+  if (f) {
+    fputs("not a hash log\n", f);
+    fclose(f);
+  }
+  r = framehash_open_compare(&hasher, HASH_PATH);
+  EXPECT(result_is_error(&r), "file without a header loaded");
+}
+
+int main(void) {
+  test_xxh64();
+  test_record_compare();
+  test_bad_input();
+
+  remove(HASH_PATH);
+  return test_result();
+}
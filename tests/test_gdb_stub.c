@@ -0,0 +1,137 @@
+// The gdb stub attached to a machine sitting in `di; halt`, which never decodes another
+// instruction: attaching, reading the registers and stepping must all come back, with pc
+// on the address after the HALT
+
+#include "test.h"
+#include <Headless/gdb_stub.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SOCKET_PATH "test_gdb_stub.sock"
+#define ENTRY       0x0100
+#define TIMEOUT_S   10 // a stub that never stops the machine hangs the test instead
+
+static Machine* halted_machine(void) {
+  static u8 rom[SYNTH_ROM_SIZE];
+  synth_rom_build(SYNTH_ALU, rom);
+  rom[ENTRY] = 0xF3;     // di
+  rom[ENTRY + 1] = 0x76; // halt
+
+  Machine* m = aligned_alloc(_Alignof(Machine), sizeof(Machine));
+  if (!m) return NULL;
+  Result r = machine_init(m);
+  if (!result_is_error(&r))
+    r = mem_load_rom_data(&m->mem, rom, sizeof(rom));
+  if (result_is_error(&r)) {
+    fprintf(stderr, "halted rom: %s\n", r.message);
+    free(m);
+    return NULL;
+  }
+  machine_skip_bootrom(m);
+  return m;
+}
+
+static void* serve(void* arg) {
+  Result r = gdb_stub_run(arg);
+  EXPECT(!result_is_error(&r), "gdb_stub_run: %s", r.message);
+  return NULL;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+  while (len) {
+    ssize_t n = send(fd, data, len, 0);
+    if (n <= 0) return false;
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+// Sends `payload` and reads the reply into `reply`, acking both ways
+static bool exchange(int fd, const char* payload, char* reply, size_t size) {
+  char frame[64];
+  u8 sum = 0;
+  for (const char* p = payload; *p; p++)
+    sum += (u8)*p;
+  int len = snprintf(frame, sizeof(frame), "$%s#%02x", payload, sum);
+  if (!send_all(fd, frame, (size_t)len)) return false;
+
+  char c;
+  size_t n = 0;
+  bool in_packet = false;
+  while (recv(fd, &c, 1, 0) == 1) {
+    if (!in_packet) {
+      in_packet = c == '$';
+      continue;
+    }
+    if (c == '#') {
+      char checksum[2];
+      if (recv(fd, checksum, 2, MSG_WAITALL) != 2) return false;
+      reply[n] = '\0';
+      return send_all(fd, "+", 1);
+    }
+    if (n + 1 < size) reply[n++] = c;
+  }
+  return false;
+}
+
+// pc from a `g` reply: af, bc, de, hl, sp, pc as 16-bit little endian hex
+static u16 reply_pc(const char* regs) {
+  if (strlen(regs) < 24) return 0;
+  unsigned lo, hi;
+  if (sscanf(regs + 20, "%2x%2x", &lo, &hi) != 2) return 0;
+  return (u16)(lo | hi << 8);
+}
+
+int main(void) {
+  alarm(TIMEOUT_S);
+
+  Machine* m = halted_machine();
+  if (!m) return EXIT_FAILURE;
+  Result r = machine_run_cycles(m, 64);
+  EXPECT(!result_is_error(&r) && m->cpu.halted, "the rom did not halt");
+
+  GdbStub stub;
+  remove(SOCKET_PATH);
+  r = gdb_stub_init(&stub, m, SOCKET_PATH);
+  EXPECT(!result_is_error(&r), "gdb_stub_init: %s", r.message);
+  if (result_is_error(&r)) goto done;
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, serve, &stub) != 0) {
+    EXPECT(false, "pthread_create failed");
+    gdb_stub_destroy(&stub);
+    goto done;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", SOCKET_PATH);
+  EXPECT(fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0, "connect failed");
+
+  char reply[256];
+  EXPECT(exchange(fd, "?", reply, sizeof(reply)) && (reply[0] == 'S' || reply[0] == 'T'),
+         "no stop reply on attach");
+  EXPECT(exchange(fd, "g", reply, sizeof(reply)), "no reply to g");
+  EXPECT(reply_pc(reply) == ENTRY + 2, "pc %04X while halted, expected %04X", reply_pc(reply),
+         ENTRY + 2);
+
+  u64 before = m->cpu.clock_cycles;
+  EXPECT(exchange(fd, "s", reply, sizeof(reply)) && (reply[0] == 'S' || reply[0] == 'T'),
+         "no stop reply to a step");
+  EXPECT(m->cpu.halted && m->cpu.clock_cycles > before, "step on a halted cpu did not advance it");
+  EXPECT(exchange(fd, "g", reply, sizeof(reply)) && reply_pc(reply) == ENTRY + 2,
+         "pc %04X after a step, expected %04X", reply_pc(reply), ENTRY + 2);
+
+  send_all(fd, "$k#6b", 5);
+  pthread_join(thread, NULL);
+  close(fd);
+  gdb_stub_destroy(&stub);
+
+done:
+  test_free_machine(m);
+  return test_result();
+}
@@ -0,0 +1,91 @@
+// The lockstep core against the scalar core: lanes of every generated rom, started a
+// few cycles apart so they split and regroup, must end in the state the same machines
+// reach when ticked one by one
+
+#include "test.h"
+#include <Emulator/lockstep.h>
+
+#define LANES        8
+#define LANE_STAGGER 37 // T-cycles between the starts of two lanes
+#define RUN_FRAMES   10
+#define QUANTUM      (CYCLES_PER_FRAME / 3)
+#define MAX_INSTR_CYCLES 24 // longest instruction (CALL, interrupt dispatch)
+
+static Machine* staggered_machine(ESynthRom kind, int lane) {
+  Machine* m = test_synth_machine(kind);
+  if (!m) return NULL;
+
+  // Lanes copy OAM DMAs in one go, the reference has to do the same
+  m->mem.dma_bulk = true;
+  m->fast_forward = false;
+
+  Result r = machine_run_cycles(m, (u64)lane * LANE_STAGGER);
+  EXPECT(!result_is_error(&r), "synth:%s lane %d: %s", synth_rom_name(kind), lane, r.message);
+  return m;
+}
+
+static void run_kind(ESynthRom kind) {
+  Machine* lanes[LANES] = { 0 };
+  Machine* refs[LANES] = { 0 };
+  Lockstep* ls = malloc(sizeof(Lockstep));
+
+  for (int i = 0; i < LANES; i++) {
+    lanes[i] = staggered_machine(kind, i);
+    refs[i] = staggered_machine(kind, i);
+    if (!lanes[i] || !refs[i] || !ls) goto done;
+  }
+
+  // Run in quanta like the batch executor: no lane, halted ones included, may get more
+  // than the rest of the instruction that crosses the end of one
+  Result r = lockstep_init(ls, lanes, LANES);
+  for (u32 q = 0; q < RUN_FRAMES * 3 && !result_is_error(&r); q++) {
+    u64 start[LANES];
+    for (int i = 0; i < LANES; i++)
+      start[i] = ls->cycles[i];
+
+    r = lockstep_run_cycles(ls, QUANTUM);
+    for (int i = 0; i < LANES && !result_is_error(&r); i++) {
+      EXPECT(ls->stopped[i] || ls->cycles[i] - start[i] < QUANTUM + MAX_INSTR_CYCLES,
+             "synth:%s lane %d: ran %llu cycles of a %u cycle quantum", synth_rom_name(kind), i,
+             (unsigned long long)(ls->cycles[i] - start[i]), QUANTUM);
+    }
+  }
+  EXPECT(!result_is_error(&r), "synth:%s: %s", synth_rom_name(kind), r.message);
+  if (result_is_error(&r)) goto done;
+  lockstep_store(ls);
+
+  for (int i = 0; i < LANES; i++) {
+    EXPECT(!ls->stopped[i], "synth:%s: lane %d stopped", synth_rom_name(kind), i);
+
+    // The lane ends at an instruction boundary, tick the reference to the same one
+    Cpu* cpu = &refs[i]->cpu;
+    while (cpu->has_instr || cpu->clock_phase != CLOCK_FALLING ||
+           cpu->clock_cycles < lanes[i]->cpu.clock_cycles) {
+      if (machine_clock_tick(refs[i]) || cpu->paused) break;
+    }
+
+    char what[64];
+    snprintf(what, sizeof(what), "synth:%s lane %d", synth_rom_name(kind), i);
+    test_same_state(lanes[i], refs[i], what);
+  }
+
+  if (kind == SYNTH_ALU || kind == SYNTH_CB) {
+    EXPECT(ls->vector_lanes > ls->scalar_instrs, "synth:%s: only %llu of %llu instructions vectorized",
+           synth_rom_name(kind), (unsigned long long)ls->vector_lanes,
+           (unsigned long long)(ls->vector_lanes + ls->scalar_instrs));
+  }
+
+done:
+  for (int i = 0; i < LANES; i++) {
+    test_free_machine(lanes[i]);
+    test_free_machine(refs[i]);
+  }
+  free(ls);
+}
+
+int main(void) {
+  for (int kind = 0; kind < SYNTH_COUNT; kind++)
+    run_kind((ESynthRom)kind);
+
+  return test_result();
+}
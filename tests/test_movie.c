@@ -0,0 +1,154 @@
+// Input movies: recording, save/load round trip, playback, and files whose header
+// doesn't match what follows it
+
+#include "test.h"
+#include <Emulator/movie.h>
+
+#define MOVIE_PATH "test_movie.lgbm"
+
+static void write_file(const char* path, const u8* data, size_t size) {
+  FILE* f = fopen(path, "wb");
+  EXPECT(f != NULL, "failed to create %s", path);
+  if (!f) return;
+  fwrite(data, 1, size, f);
+  fclose(f);
+}
+
+// Header for `runs` runs followed by `records` run records of 1 frame each
+static size_t bogus_movie(u8* out, u32 runs, u32 records) {
+  memset(out, 0, MOVIE_HEADER_SIZE);
+  memcpy(out, MOVIE_MAGIC, 4);
+  out[4] = MOVIE_VERSION;
+  out[8] = (u8)records;
+  for (int i = 0; i < 4; i++)
+    out[12 + i] = (u8)(runs >> (8 * i));
+
+  u8* rec = out + MOVIE_HEADER_SIZE;
+  for (u32 i = 0; i < records; i++, rec += MOVIE_RUN_SIZE) {
+    rec[0] = (u8)i;
+    rec[1] = 1;
+    rec[2] = 0;
+  }
+  return MOVIE_HEADER_SIZE + (size_t)records * MOVIE_RUN_SIZE;
+}
+
+static void test_round_trip(void) {
+  Movie rec;
+  movie_init(&rec);
+
+  // Long holds split at MOVIE_MAX_RUN, alternating buttons make one run per frame
+  u32 frames = 0;
+  for (u32 i = 0; i < MOVIE_MAX_RUN + 10; i++, frames++)
+    movie_append_frame(&rec, 0x01);
+  for (u32 i = 0; i < 300; i++, frames++)
+    movie_append_frame(&rec, (u8)(i & 1 ? 0x10 : 0x20));
+
+  EXPECT(rec.frame_count == frames, "recorded %u frames, expected %u", rec.frame_count, frames);
+  EXPECT(rec.run_count == 2 + 300, "%u runs", rec.run_count);
+
+  Result r = movie_save(&rec, MOVIE_PATH);
+  EXPECT(!result_is_error(&r), "save: %s", r.message);
+
+  Movie play;
+  movie_init(&play);
+  r = movie_load(&play, MOVIE_PATH);
+  EXPECT(!result_is_error(&r), "load: %s", r.message);
+  EXPECT(play.frame_count == frames && play.run_count == rec.run_count, "loaded %u frames in %u runs",
+         play.frame_count, play.run_count);
+
+  movie_rewind(&rec);
+  u32 played = 0;
+  u8 a, b;
+  while (movie_next_frame(&play, &a)) {
+    bool more = movie_next_frame(&rec, &b);
+    if (!more || a != b) {
+      EXPECT(false, "frame %u: played %02X, recorded %02X", played, a, b);
+      break;
+    }
+    played++;
+  }
+  EXPECT(played == frames, "played %u of %u frames", played, frames);
+  EXPECT(!movie_next_frame(&play, &a) && a == 0, "input past the end");
+
+  movie_destroy(&rec);
+  movie_destroy(&play);
+}
+
+static void test_bad_headers(void) {
+  static u8 file[MOVIE_HEADER_SIZE + 16 * MOVIE_RUN_SIZE];
+  Movie movie;
+  movie_init(&movie);
+
+  // Run counts the file can't hold are rejected before anything is allocated for them,
+  // including ones that would overflow the capacity doubling
+  const u32 runs[] = { 17, 0x10000, 0x7FFFFFFF, 0x80000001, 0xFFFFFFFF };
+  for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+    write_file(MOVIE_PATH, file, bogus_movie(file, runs[i], 16));
+    Result r = movie_load(&movie, MOVIE_PATH);
+    EXPECT(result_is_error(&r), "%u runs in a 16 run file loaded", runs[i]);
+    EXPECT(movie.runs == NULL, "%u runs: allocated before the check", runs[i]);
+  }
+
+  write_file(MOVIE_PATH, file, bogus_movie(file, 16, 16));
+  Result r = movie_load(&movie, MOVIE_PATH);
+  EXPECT(!result_is_error(&r) && movie.run_count == 16 && movie.frame_count == 16,
+         "16 run file: %s", r.message);
+
+  write_file(MOVIE_PATH, file, bogus_movie(file, 0, 0));
+  r = movie_load(&movie, MOVIE_PATH);
+  EXPECT(!result_is_error(&r) && movie.run_count == 0, "empty movie: %s", r.message);
+
+  write_file(MOVIE_PATH, file, MOVIE_HEADER_SIZE - 1);
+  r = movie_load(&movie, MOVIE_PATH);
+  EXPECT(result_is_error(&r), "short header loaded");
+
+  movie_destroy(&movie);
+}
+
+// Recording the way the gui does it, after running a while: the movie has to replay on a
+// fresh machine started like a batch job
+static void test_record_after_reset(void) {
+  Machine* rec = test_synth_machine(SYNTH_IRQ);
+  Machine* play = test_synth_machine(SYNTH_IRQ);
+  Movie movie;
+  movie_init(&movie);
+  if (!rec || !play) goto done;
+
+  Result r = machine_run_cycles(rec, 3 * CYCLES_PER_FRAME + 1234);
+  EXPECT(!result_is_error(&r), "warm up: %s", r.message);
+
+  r = machine_reset(rec);
+  EXPECT(!result_is_error(&r), "reset: %s", r.message);
+  EXPECT(rec->frame == 0 && rec->cpu.clock_cycles == 0 && rec->cpu.registers[PC].v == 0x0100,
+         "reset left frame %llu, pc %04X", (unsigned long long)rec->frame, rec->cpu.registers[PC].v);
+  movie.mode = MOVIE_RECORDING;
+  rec->movie = &movie;
+  for (u32 frame = 0; frame < 8; frame++) {
+    rec->input = (u8)(1u << (frame % 8));
+    r = machine_run_cycles(rec, CYCLES_PER_FRAME);
+    EXPECT(!result_is_error(&r), "recording: %s", r.message);
+  }
+
+  movie_rewind(&movie);
+  movie.mode = MOVIE_PLAYING;
+  play->movie = &movie;
+  r = machine_run_cycles(play, rec->cpu.clock_cycles);
+  EXPECT(!result_is_error(&r), "playback: %s", r.message);
+  test_same_state(rec, play, "replayed recording");
+  EXPECT(rec->cpu.joypad.buttons == play->cpu.joypad.buttons, "joypad %02X, replayed %02X",
+         rec->cpu.joypad.buttons, play->cpu.joypad.buttons);
+
+done:
+  test_free_machine(rec);
+  test_free_machine(play);
+  movie_destroy(&movie);
+}
+
+int main(void) {
+  test_round_trip();
+  test_bad_headers();
+  test_record_after_reset();
+
+  remove(MOVIE_PATH);
+  return test_result();
+}
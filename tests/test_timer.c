@@ -0,0 +1,208 @@
+// The timer, which derives DIV and TIMA from the clock and only wakes up for overflows,
+// against a model that steps every T-cycle: random register accesses at random times,
+// then writes landing on every cycle around an overflow and its reload
+
+#include "test.h"
+#include <Emulator/cpu/timer.h>
+
+#define START_CYCLE 1000
+#define TIMER_INT   0x04
+
+static const u8 INPUT_BIT[4] = { 9, 3, 5, 7 };
+
+// Reference: the counter, the TAC-selected bit and TIMA stepped one cycle at a time
+typedef struct {
+  u64 now;
+  u16 counter;
+  bool input;
+  u8 tima, tma, tac;
+  u64 reload_at;   // 0 when no reload is pending
+  u64 reloaded_at; // 0 before the first reload
+  u8 interrupt_flag;
+} RefTimer;
+
+static bool ref_input(const RefTimer* ref) {
+  return (ref->tac & 0x04) && ((ref->counter >> INPUT_BIT[ref->tac & 0x03]) & 1);
+}
+
+static void ref_tick(RefTimer* ref) {
+  if (ref->reload_at) return;
+  if (ref->tima == 0xFF) {
+    ref->tima = 0;
+    ref->reload_at = ref->now + 4;
+  } else {
+    ref->tima++;
+  }
+}
+
+static void ref_step(RefTimer* ref) {
+  ref->now++;
+  ref->counter++;
+  if (ref->reload_at == ref->now) {
+    ref->tima = ref->tma;
+    ref->reload_at = 0;
+    ref->reloaded_at = ref->now;
+    ref->interrupt_flag |= TIMER_INT;
+  }
+  bool input = ref_input(ref);
+  if (ref->input && !input)
+    ref_tick(ref);
+  ref->input = input;
+}
+
+static bool ref_reloading(const RefTimer* ref) {
+  return ref->reloaded_at && ref->now - ref->reloaded_at < 4;
+}
+
+static void ref_write(RefTimer* ref, u16 addr, u8 val) {
+  switch (addr) {
+    case 0xFF04: ref->counter = 0; break;
+    case 0xFF05:
+      if (ref_reloading(ref)) break;
+      ref->reload_at = 0;
+      ref->tima = val;
+      break;
+    case 0xFF06:
+      ref->tma = val;
+      if (ref_reloading(ref)) ref->tima = val;
+      break;
+    case 0xFF07: ref->tac = val & 0x07; break;
+  }
+  bool input = ref_input(ref);
+  if (ref->input && !input)
+    ref_tick(ref);
+  ref->input = input;
+}
+
+// The timer under test, driven the way the cpu does: timer_event on its due cycles only
+typedef struct {
+  Timer timer;
+  u64 now;
+  u8 interrupt_flag;
+} Subject;
+
+static void advance(Subject* s, RefTimer* ref, u64 cycles) {
+  u64 target = s->now + cycles;
+  while (s->timer.next_event <= target)
+    timer_event(&s->timer, s->timer.next_event, &s->interrupt_flag);
+  s->now = target;
+
+  while (ref->now < target)
+    ref_step(ref);
+}
+
+static void setup(Subject* s, RefTimer* ref, u16 counter) {
+  memset(s, 0, sizeof(*s));
+  memset(ref, 0, sizeof(*ref));
+  timer_init(&s->timer);
+  s->now = START_CYCLE;
+  timer_set_counter(&s->timer, s->now, counter);
+  ref->now = START_CYCLE;
+  ref->counter = counter;
+}
+
+static void write_both(Subject* s, RefTimer* ref, u16 addr, u8 val) {
+  timer_write_register(&s->timer, s->now, &s->interrupt_flag, addr, val);
+  ref_write(ref, addr, val);
+}
+
+static bool same(Subject* s, RefTimer* ref, const char* what) {
+  int before = test_failures;
+  for (u16 addr = 0xFF04; addr <= 0xFF07; addr++) {
+    u8 got = timer_read_register(&s->timer, s->now, &s->interrupt_flag, addr);
+    u8 want = 0xFF;
+    switch (addr) {
+      case 0xFF04: want = (u8)(ref->counter >> 8); break;
+      case 0xFF05: want = ref->tima; break;
+      case 0xFF06: want = ref->tma; break;
+      case 0xFF07: want = ref->tac | 0xF8; break;
+    }
+    EXPECT(got == want, "%s at %llu: %04X %02X, stepped %02X", what, (unsigned long long)s->now,
+           addr, got, want);
+  }
+  EXPECT(s->interrupt_flag == ref->interrupt_flag, "%s at %llu: IF %02X, stepped %02X", what,
+         (unsigned long long)s->now, s->interrupt_flag, ref->interrupt_flag);
+  return test_failures == before;
+}
+
+static u32 rng_state = 12345;
+static u32 rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static void test_random(void) {
+  Subject s;
+  RefTimer ref;
+  setup(&s, &ref, 0xABCC);
+
+  for (int i = 0; i < 200000; i++) {
+    u32 r = rng();
+    // Mostly short gaps so writes land near edges and overflows, now and then a long one
+    advance(&s, &ref, (r & 0x700) ? r % 24 : r % 5000);
+
+    u32 op = rng() % 16;
+    u8 val = (u8)rng();
+    if (op == 0)
+      write_both(&s, &ref, 0xFF04, val);
+    else if (op <= 3)
+      write_both(&s, &ref, 0xFF05, (u8)(0xF0 | val));
+    else if (op <= 5)
+      write_both(&s, &ref, 0xFF06, val);
+    else if (op <= 7)
+      write_both(&s, &ref, 0xFF07, val);
+    else if (op == 8) {
+      s.interrupt_flag = 0;
+      ref.interrupt_flag = 0;
+    }
+    if (!same(&s, &ref, "random"))
+      return;
+  }
+}
+
+// TIMA overflows at the fastest rate, then one register is written `offset` cycles later
+static void overflow_then_write(u16 addr, u64 offset, Subject* s, RefTimer* ref) {
+  setup(s, ref, 0);
+  write_both(s, ref, 0xFF06, 0x50);
+  write_both(s, ref, 0xFF05, 0xFF);
+  write_both(s, ref, 0xFF07, 0x05); // bit 3: an edge every 16 cycles, the first overflows
+  advance(s, ref, 16 + offset);
+  write_both(s, ref, addr, 0x99);
+}
+
+static void test_reload_writes(void) {
+  Subject s;
+  RefTimer ref;
+  char what[64];
+
+  for (u64 offset = 0; offset < 24; offset++) {
+    for (u16 addr = 0xFF05; addr <= 0xFF06; addr++) {
+      overflow_then_write(addr, offset, &s, &ref);
+      snprintf(what, sizeof(what), "%04X written %llu cycles after the overflow", addr,
+               (unsigned long long)offset);
+      same(&s, &ref, what);
+      advance(&s, &ref, 32);
+      same(&s, &ref, what);
+    }
+  }
+
+  // Pinned down independently of the model: in the reload's M-cycle a TIMA write is
+  // lost and a TMA write is what TIMA ends up with
+  overflow_then_write(0xFF05, 4, &s, &ref);
+  EXPECT(timer_read_register(&s.timer, s.now, &s.interrupt_flag, 0xFF05) == 0x50,
+         "TIMA write in the reload cycle was not ignored");
+  overflow_then_write(0xFF06, 4, &s, &ref);
+  EXPECT(timer_read_register(&s.timer, s.now, &s.interrupt_flag, 0xFF05) == 0x99,
+         "TMA write in the reload cycle did not reach TIMA");
+  overflow_then_write(0xFF05, 2, &s, &ref);
+  EXPECT(!(s.interrupt_flag & TIMER_INT), "TIMA write before the reload did not cancel it");
+}
+
+int main(void) {
+  test_random();
+  test_reload_writes();
+
+  return test_result();
+}
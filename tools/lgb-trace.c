@@ -0,0 +1,108 @@
+// lgb-trace: prints an execution trace written by the trace recorder (Emulator/trace.h)
+//
+//   lgb-trace <trace file> [--last N]
+//
+// One line per record, oldest first:
+//   cycle  PC  opcode  mnemonic  AF BC DE HL SP  bus address/data and R/W
+
+#include <Emulator/trace.h>
+#include <Emulator/cpu/instruction.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* mnemonic(u8 opcode) {
+  static const char* cache[256];
+  static bool cached[256];
+
+  if (!cached[opcode]) {
+    ResultInstr r = instruction_decode(opcode);
+    cache[opcode]  = result_Instr_is_err(&r) ? "???" : result_Instr_get_data(&r).mnemonic;
+    cached[opcode] = true;
+  }
+  return cache[opcode];
+}
+
+static void print_record(const TraceRecord* r, ETraceGranularity granularity) {
+  const char* name = (r->flags & TRACE_FLAG_INTERRUPT) ? "INT" : mnemonic(r->opcode);
+  char rw[3] = "--";
+  if (r->flags & TRACE_FLAG_READ)  rw[0] = 'R';
+  if (r->flags & TRACE_FLAG_WRITE) rw[1] = 'W';
+
+  if (granularity == TRACE_PER_MCYCLE)
+    printf("%12llu  %04X  %02X %-14s M%u  ", (unsigned long long)r->cycle, r->pc,
+           r->opcode, (r->flags & (TRACE_FLAG_INSTR | TRACE_FLAG_INTERRUPT)) ? name : "", r->mcycle);
+  else
+    printf("%12llu  %04X  %02X %-14s  ", (unsigned long long)r->cycle, r->pc,
+           r->opcode, name);
+
+  printf("AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X  bus=%04X:%02X %s\n",
+         r->af, r->bc, r->de, r->hl, r->sp, r->addr, r->data,
+         granularity == TRACE_PER_MCYCLE ? rw : "");
+}
+
+int main(int argc, char** argv) {
+  const char* path = NULL;
+  u64 last = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--last") == 0 && i + 1 < argc) {
+      last = strtoull(argv[++i], NULL, 10);
+    } else if (!path && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      path = NULL;
+      break;
+    }
+  }
+
+  if (!path) {
+    fprintf(stderr, "usage: %s <trace file> [--last N]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "failed to open %s\n", path);
+    return EXIT_FAILURE;
+  }
+
+  TraceFileHeader header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s is not a trace file\n", path);
+    fclose(f);
+    return EXIT_FAILURE;
+  }
+  if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord) ||
+      header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0) {
+    fprintf(stderr, "%s: unsupported trace (version %u, %u byte records)\n",
+            path, header.version, header.record_size);
+    fclose(f);
+    return EXIT_FAILURE;
+  }
+
+  TraceRecord* records = malloc(sizeof(TraceRecord) * header.capacity);
+  if (!records || fread(records, sizeof(TraceRecord), header.capacity, f) != header.capacity) {
+    fprintf(stderr, "%s: truncated trace\n", path);
+    free(records);
+    fclose(f);
+    return EXIT_FAILURE;
+  }
+  fclose(f);
+
+  // Oldest record still in the ring
+  u64 available = header.count < header.capacity ? header.count : header.capacity;
+  u64 first = header.count - available;
+  if (last && last < available)
+    first = header.count - last;
+
+  if (header.count > header.capacity)
+    printf("# %llu records written, showing the last %llu\n",
+           (unsigned long long)header.count, (unsigned long long)(header.count - first));
+
+  for (u64 i = first; i < header.count; i++)
+    print_record(&records[i & (header.capacity - 1)], (ETraceGranularity)header.granularity);
+
+  free(records);
+  return EXIT_SUCCESS;
+}